@@ -52,6 +52,15 @@ ALIGN_EXTERN rc_t CC RefSeqMgr_Release(const RefSeqMgr* cself);
 
 ALIGN_EXTERN rc_t CC RefSeqMgr_SetCache(RefSeqMgr const *const cself, size_t cache, uint32_t keep_open_num);
 
+/* Keeps decoded bases of accessioned references as files in directory 'path',
+   named by accession and MD5, which are memory-mapped and shared between processes;
+   references without MD5 are always decoded.
+   path [IN] - NULL or empty to not use a disk cache;
+               initially taken from config node "refseq/disk_cache"
+   affects references opened after the call
+ */
+ALIGN_EXTERN rc_t CC RefSeqMgr_SetDiskCache(RefSeqMgr const *const cself, char const *path);
+
 /* return value if 0 means object was found, path is optional */
 ALIGN_EXTERN rc_t RefSeqMgr_Exists(const RefSeqMgr* cself, const char* accession, uint32_t accession_sz, char** path);
 
@@ -310,6 +310,26 @@ KDB_EXTERN rc_t CC KColumnBlobRead ( const KColumnBlob *self,
 KDB_EXTERN rc_t CC KColumnBlobReadAll ( const KColumnBlob * self, struct KDataBuffer * buffer,
     KColumnBlobCSData * opt_cs_data, size_t cs_data_size );
 
+/* ReadAllV
+ *  read a number of entire blobs, as with ReadAll, in one batch
+ *
+ *  blobs may belong to different columns. reads that fall into the same
+ *  underlying file are handed to KFileReadV together, so that blobs
+ *  lying close to one another are fetched with a single read.
+ *
+ *  "blobs" [ IN ] and "count" [ IN ] - blobs to read
+ *
+ *  "buffers" [ OUT ] - array of "count" KDataBuffer structures,
+ *  initialized as by ReadAll
+ *
+ *  "opt_cs_data [ OUT, NULL OKAY ] - optional array of "count" elements
+ *  for checksum data associated with the corresponding blob
+ *
+ *  "cs_data_size" [ IN ] - sizeof of * opt_cs_data if not NULL, 0 otherwise
+ */
+KDB_EXTERN rc_t CC KColumnBlobReadAllV ( const KColumnBlob * const * blobs, uint32_t count,
+    struct KDataBuffer * buffers, KColumnBlobCSData * opt_cs_data, size_t cs_data_size );
+
 /* Append
  *  append data to open blob
  *
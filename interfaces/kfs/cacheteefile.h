@@ -155,6 +155,39 @@ KFS_EXTERN rc_t CC IsCacheTeeComplete( const struct KFile * self, bool * complet
 
 KFS_EXTERN bool CC KFileIsKCacheTeeFile( const struct KFile * self );
 
+
+/* -----
+ * a byte range of the remote file
+ */
+typedef struct KCacheTeeRange KCacheTeeRange;
+struct KCacheTeeRange
+{
+    uint64_t pos;
+    uint64_t size;
+};
+
+/* -----
+ * starts a background thread that copies blocks of the remote file
+ * into the cache, while reads go on as usual. blocks already in the
+ * cache are skipped, by the filler as well as by reads.
+ *
+ * "ranges" [ IN, NULL OKAY ] and "range_count" [ IN ] - byte ranges to fill,
+ * in the order given. when NULL, the whole file is filled front to back.
+ *
+ * "bytes_per_sec" [ IN ] - limits the rate of remote reads, 0 for no limit
+ *
+ * self has to be an open cacheteefile, with a writable cache.
+ * only one filler may run at a time. the filler is stopped when the file
+ * is released.
+ */
+KFS_EXTERN rc_t CC KCacheTeeFileStartFill( const struct KFile * self,
+    const KCacheTeeRange * ranges, uint32_t range_count, uint64_t bytes_per_sec );
+
+/* -----
+ * waits for the background fill to finish, returning its status
+ */
+KFS_EXTERN rc_t CC KCacheTeeFileWaitFill( const struct KFile * self );
+
 #ifdef __cplusplus
 }
 #endif
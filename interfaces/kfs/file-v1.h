@@ -171,6 +171,30 @@ KFS_EXTERN rc_t CC KFileReadExactly_v1 ( const KFile_v1 *self,
 KFS_EXTERN rc_t CC KFileTimedReadExactly_v1 ( const KFile_v1 *self,
     uint64_t pos, void *buffer, size_t bytes, struct timeout_t *tm );
 
+/* ReadV
+ *  read a number of ranges in a single call
+ *
+ *  the requests are sorted by position, and requests that overlap or
+ *  lie close together are satisfied by one read of the spanning range,
+ *  so that scattered small reads turn into a few large ones.
+ *
+ *  "vec" [ IN/OUT ] and "count" [ IN ] - requests to satisfy. each
+ *  request reads as ReadAll does, and upon return its "num_read"
+ *  gives the number of bytes read into its buffer. the order of
+ *  the array is not changed.
+ */
+typedef struct KFileIOVec_v1 KFileIOVec_v1;
+struct KFileIOVec_v1
+{
+    uint64_t pos;
+    void *buffer;
+    size_t bsize;
+    size_t num_read;
+};
+
+KFS_EXTERN rc_t CC KFileReadV_v1 ( const KFile_v1 *self,
+    KFileIOVec_v1 *vec, uint32_t count );
+
 /* Write
  * TimedWrite
  *  write file at known position
@@ -43,6 +43,7 @@ extern "C" {
 /*--------------------------------------------------------------------------
  * forwards
  */
+struct KFile;
 struct KPageFile;
 
 
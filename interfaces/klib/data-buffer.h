@@ -199,6 +199,13 @@ KLIB_EXTERN bool CC KDataBufferWritable ( const KDataBuffer *self );
 KLIB_EXTERN rc_t CC KDataBufferCheckIntegrity ( const KDataBuffer *self );
 
 
+/* GetAllocStats
+ *  the number of buffer allocations that went to malloc,
+ *  and the number served from recycled storage
+ */
+KLIB_EXTERN void CC KDataBufferGetAllocStats ( uint64_t *allocs, uint64_t *reuses );
+
+
 #ifdef __cplusplus
 }
 #endif
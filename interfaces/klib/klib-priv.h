@@ -101,6 +101,17 @@ KLIB_EXTERN rc_t CC ReportInitVDB(
  */
 KLIB_EXTERN void CC ReportRecordZombieFile ( void );
 
+
+/*--------------------------------------------------------------------------
+ * Pack/Unpack
+ */
+
+/* DisableVector
+ *  restricts Pack and Unpack to their portable code
+ *  for comparison in tests and benchmarks
+ */
+KLIB_EXTERN void CC PackDisableVector ( bool disable );
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,6 +52,12 @@ extern "C" {
 KLIB_EXTERN KTime_t CC KTimeStamp ( void );
 KLIB_EXTERN KTimeMs_t CC KTimeMsStamp ( void );
 
+/* NsStamp
+ *  nanoseconds from a monotonic clock with an arbitrary origin,
+ *  for measuring intervals only
+ */
+KLIB_EXTERN uint64_t CC KTimeNsStamp ( void );
+
 /*--------------------------------------------------------------------------
  * KTime
  *  simple time structure
@@ -92,6 +98,19 @@ KLIB_EXTERN KTime_t CC KTimeMakeTime ( const KTime *self );
 KLIB_EXTERN rc_t CC KSleep( uint32_t seconds );
 KLIB_EXTERN rc_t CC KSleepMs( uint32_t milliseconds );
 
+/* Yield
+ *  give the rest of the time slice to another thread
+ */
+KLIB_EXTERN void CC KYield ( void );
+
+/* SpinBackoff
+ *  wait before retrying a busy spin lock, where "round" counts
+ *  the attempts that failed so far: pauses the cpu for the first
+ *  rounds and yields to other threads after that, so that a holder
+ *  that was preempted gets to run
+ */
+KLIB_EXTERN void CC KSpinBackoff ( uint32_t round );
+
 
 #ifdef __cplusplus
 }
@@ -66,6 +66,38 @@ KNS_EXTERN rc_t CC KNSManagerSetHTTPTimeouts ( struct KNSManager * self,
     int32_t readMillis, int32_t writeMillis );
 
 
+/* SetHTTPReadStreams
+ *  sets the number of connections that a KFile over HTTP may use
+ *  at once to satisfy a large read, by splitting it into range requests.
+ *  initially taken from configuration "/http/reads/streams"
+ *
+ *  "streams" [ IN ] - 0 or 1 keeps each read on a single connection
+ */
+KNS_EXTERN rc_t CC KNSManagerSetHTTPReadStreams ( struct KNSManager * self,
+    uint32_t streams );
+
+
+/* SetHTTPConnectionPool
+ *  sets how keep-alive connections are kept for reuse across
+ *  HTTP files and requests of a manager.
+ *  initially taken from configuration "/http/pool/per_host"
+ *  and "/http/pool/idle_ms"
+ *
+ *  "per_host" [ IN ] - maximum idle connections kept per host, port
+ *   and protocol. 0 closes idle connections and disables the pool
+ *
+ *  "idle_ms" [ IN ] - idle connections older than this are closed
+ */
+KNS_EXTERN rc_t CC KNSManagerSetHTTPConnectionPool ( struct KNSManager * self,
+    uint32_t per_host, uint32_t idle_ms );
+
+/* GetHTTPConnectionPool
+ *  returns the settings last made by SetHTTPConnectionPool
+ */
+KNS_EXTERN rc_t CC KNSManagerGetHTTPConnectionPool ( struct KNSManager const * self,
+    uint32_t * per_host, uint32_t * idle_ms );
+
+
 /* GetHTTPProxyPath
  *  returns path to HTTP proxy server ( if set ) or NULL.
  *  return status is 0 if the path is valid, non-zero otherwise
@@ -113,6 +113,12 @@ KPROC_EXTERN rc_t CC KProcMgrRemoveCleanupTask ( KProcMgr *self,
 KPROC_EXTERN bool CC KProcMgrOnMainThread ( void );
 
 
+/* GetNumProcessors
+ *  returns the number of online processors, at least 1
+ */
+KPROC_EXTERN uint32_t CC KProcMgrGetNumProcessors ( void );
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -67,6 +67,19 @@ KQ_EXTERN rc_t CC KQueueRelease ( const KQueue *self );
  */
 KQ_EXTERN rc_t CC KQueueMake ( KQueue **q, uint32_t capacity );
 
+/* MakeLockFree
+ * create an empty queue object that does not lock on push or pop
+ *
+ *  behaves like a queue from KQueueMake, but items go through a ring
+ *  of cells claimed with atomic operations. a thread finding the queue
+ *  full or empty retries for a while, then sleeps until woken or
+ *  timed out. meant for queues handling millions of items per second
+ *  between many threads.
+ *
+ *  "capacity" [ IN ] - minimum queue length, expanded to a power of 2
+ */
+KQ_EXTERN rc_t CC KQueueMakeLockFree ( KQueue **q, uint32_t capacity );
+
 /* Push
  *  add an object to the queue
  *
@@ -93,6 +106,34 @@ KQ_EXTERN rc_t CC KQueuePush ( KQueue *self, const void *item, struct timeout_t
  */
 KQ_EXTERN rc_t CC KQueuePop ( KQueue *self, void **item, struct timeout_t *tm );
 
+/* PushBatch
+ *  add up to "count" objects to the queue
+ *
+ *  "items" [ IN ] - pointers to items being queued, none NULL
+ *
+ *  "pushed" [ OUT ] - number of items queued, from the start of "items"
+ *
+ *  "tm" [ IN, NULL OKAY ] - as with Push, but only applies while no
+ *  space is available at all. once there is, as many items are queued
+ *  as fit without waiting.
+ */
+KQ_EXTERN rc_t CC KQueuePushBatch ( KQueue *self, const void * const *items,
+    uint32_t count, uint32_t *pushed, struct timeout_t *tm );
+
+/* PopBatch
+ *  pop up to "count" objects from queue
+ *
+ *  "items" [ OUT, OPAQUE* ] - return parameter for popped items
+ *
+ *  "popped" [ OUT ] - number of items returned
+ *
+ *  "tm" [ IN, NULL OKAY ] - as with Pop, but only applies while the
+ *  queue is empty. once it is not, as many items are returned as are
+ *  available without waiting.
+ */
+KQ_EXTERN rc_t CC KQueuePopBatch ( KQueue *self, void **items,
+    uint32_t count, uint32_t *popped, struct timeout_t *tm );
+
 /* Sealed
  *  ask if the queue has been closed off
  *  meaning there will be no further push operations
@@ -0,0 +1,156 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+
+#ifndef _h_kproc_threadpool_
+#define _h_kproc_threadpool_
+
+#ifndef _h_kproc_extern_
+#include <kproc/extern.h>
+#endif
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * forwards
+ */
+struct KTask;
+struct timeout_t;
+
+
+/*--------------------------------------------------------------------------
+ * KTaskFuture
+ *  the outcome of a task submitted to a KThreadPool
+ */
+typedef struct KTaskFuture KTaskFuture;
+
+
+/* AddRef
+ * Release
+ */
+KPROC_EXTERN rc_t CC KTaskFutureAddRef ( const KTaskFuture *self );
+KPROC_EXTERN rc_t CC KTaskFutureRelease ( const KTaskFuture *self );
+
+
+/* Wait
+ *  waits for the task to complete and returns its status
+ *  a task that no worker has started yet is run on the calling thread,
+ *  so that a worker may wait on tasks it has submitted itself
+ *
+ *  "status" [ OUT ] - return value of KTaskExecute
+ *
+ *  "tm" [ IN, NULL OKAY ] - optional timeout,
+ *  NULL means wait forever
+ */
+KPROC_EXTERN rc_t CC KTaskFutureWait ( KTaskFuture *self,
+    rc_t *status, struct timeout_t *tm );
+
+
+/* Done
+ *  returns true once the task has completed
+ */
+KPROC_EXTERN bool CC KTaskFutureDone ( const KTaskFuture *self );
+
+
+/*--------------------------------------------------------------------------
+ * KThreadPool
+ *  a fixed set of worker threads executing KTasks
+ *
+ *  every worker owns a double-ended queue. tasks are spread over
+ *  the queues as they are submitted; a worker takes the newest task of
+ *  its own queue and, when that is empty, steals the oldest task
+ *  of another.
+ */
+typedef struct KThreadPool KThreadPool;
+
+
+/* Make
+ *  create a pool
+ *
+ *  "threads" [ IN ] - number of worker threads,
+ *  0 means one per processor
+ */
+KPROC_EXTERN rc_t CC KThreadPoolMake ( KThreadPool **pool, uint32_t threads );
+
+
+/* AddRef
+ * Release
+ *  the last release runs all tasks still queued, then joins the workers
+ */
+KPROC_EXTERN rc_t CC KThreadPoolAddRef ( const KThreadPool *self );
+KPROC_EXTERN rc_t CC KThreadPoolRelease ( const KThreadPool *self );
+
+
+/* Submit
+ *  queue a task for execution on one of the workers
+ *  a new reference to "task" is held until it has been executed
+ *
+ *  "future" [ OUT, NULL OKAY ] - return parameter for the outcome,
+ *  NULL to have the task run detached
+ */
+KPROC_EXTERN rc_t CC KThreadPoolSubmit ( KThreadPool *self,
+    struct KTask *task, KTaskFuture **future );
+
+
+/* Threads
+ *  returns the number of workers
+ */
+KPROC_EXTERN uint32_t CC KThreadPoolThreads ( const KThreadPool *self );
+
+
+/* GetDefault
+ *  returns a new reference to the process-wide pool,
+ *  which is created on first use with the number of workers
+ *  set by KThreadPoolSetDefaultThreads(), or else given by
+ *  the configuration node "/kproc/threads"
+ *
+ *  libraries should submit their background work here instead of
+ *  starting threads of their own, so that together they do not
+ *  run more threads than there are processors
+ */
+KPROC_EXTERN rc_t CC KThreadPoolGetDefault ( KThreadPool **pool );
+
+
+/* SetDefaultThreads
+ *  sets the number of workers of the process-wide pool,
+ *  0 for one per processor
+ *  has no effect once the pool has been created
+ */
+KPROC_EXTERN void CC KThreadPoolSetDefaultThreads ( uint32_t threads );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_kproc_threadpool_ */
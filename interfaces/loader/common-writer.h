@@ -50,7 +50,7 @@ extern "C" {
 struct VDBManager;
 struct VDatabase;
 struct KMemBank;
-struct KBTree;
+struct KeyIdMap;
 struct KLoadProgressbar;
 struct ReaderFile;
 struct CommonWriter;
@@ -90,6 +90,8 @@ typedef struct CommonWriterSettings
     
     uint64_t maxAlignCount;
     size_t cache_size;
+    uint64_t id2valueMemLimit; /* bytes of spot assembly kept in RAM before spilling to tmpfs */
+    uint32_t id2valueGrowth; /* most sub-chunks of spot assembly mapped at once */
 
     uint64_t errCount;
     uint64_t maxErrCount;
@@ -122,6 +124,7 @@ typedef struct CommonWriterSettings
     INSDC_SRA_platform_id platform;
     bool parseSpotName;
     bool compressQuality;
+    bool id2valuePopulate; /* fault spot assembly storage in when it is mapped */
     uint64_t maxMateDistance;
 } CommonWriterSettings;
 
@@ -133,7 +136,7 @@ typedef struct CommonWriterSettings
 
 typedef struct SpotAssembler {
     const struct KLoadProgressbar *progress[4];
-    struct KBTree *key2id[NUM_ID_SPACES];
+    struct KeyIdMap *key2id;
     char *key2id_names;
     struct MMArray *id2value;
     struct KMemBank *fragsBoth; /*** mate will be there soon ***/
@@ -0,0 +1,54 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_keyidmap_
+#define _h_keyidmap_
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+/*--------------------------------------------------------------------------
+ * KeyIdMap
+ *  maps (id space, key) to ids assigned densely from 0 in each id space;
+ *  safe to use from multiple threads
+ */
+
+struct KeyIdMap;
+
+/* "spillBase" is the path prefix of the sorted runs written when more
+ * than "memLimit" bytes are in use; NULL or 0 keeps the map in memory */
+rc_t KeyIdMapMake(struct KeyIdMap **rslt, char const *spillBase, size_t memLimit);
+
+rc_t KeyIdMapEntry(struct KeyIdMap *self, uint32_t *id, bool *wasInserted,
+                   unsigned space, void const *key, size_t keylen);
+
+/* number of ids assigned in "space" */
+uint32_t KeyIdMapCount(struct KeyIdMap const *self, unsigned space);
+
+void KeyIdMapWhack(struct KeyIdMap *self);
+
+#endif
@@ -41,10 +41,33 @@ struct KFile;
 
 struct MMArray;
 
+/* "fp" may be NULL to keep the whole array in anonymous memory */
 rc_t MMArrayMake(struct MMArray **rslt, struct KFile *fp, uint32_t elemSize);
 
+/* most sub-chunks reserved at once; reservations start at one
+ * sub-chunk and double each time the array outgrows them */
+void MMArraySetGrowth(struct MMArray *self, uint32_t maxSubchunks);
+
+/* bytes reserved in anonymous memory before using the file */
+void MMArraySetMemoryLimit(struct MMArray *self, uint64_t maxBytes);
+
+/* fault in reservations when they are made rather than on first touch */
+void MMArraySetPopulate(struct MMArray *self, bool populate);
+
 rc_t MMArrayGet(struct MMArray *const self, void **const value, uint64_t const element);
 
+typedef struct MMArrayStats {
+    uint64_t subchunks;     /* sub-chunks touched */
+    uint64_t fileMaps;      /* reservations mapped from the file */
+    uint64_t fileBytes;
+    uint64_t anonMaps;      /* reservations in anonymous memory */
+    uint64_t anonBytes;
+    uint64_t minorFaults;   /* page faults of the process since MMArrayMake */
+    uint64_t majorFaults;
+} MMArrayStats;
+
+void MMArrayGetStats(struct MMArray const *self, MMArrayStats *stats);
+
 void MMArrayWhack(struct MMArray *self);
 
 #endif
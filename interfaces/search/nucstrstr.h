@@ -145,6 +145,29 @@ SEARCH_EXTERN void CC NucStrstrWhack ( NucStrstr *self );
 SEARCH_EXTERN int CC NucStrstrSearch ( const NucStrstr *self,
     const void *ncbi2na, unsigned int pos, unsigned int len,unsigned int* selflen );
 
+/* NucStrstrSearchMany
+ *  search buffer with several prepared queries at once, with the
+ *  same requirements on "ncbi2na", "pos" and "len" as NucStrstrSearch.
+ *  fixed-width queries of the same type share their passes over
+ *  the sequence.
+ *
+ *  "self" [ IN ] and "count" [ IN ] - queries to evaluate
+ *
+ *  "found" [ OUT ] - receives "count" results, as would be
+ *  returned from NucStrstrSearch for each query
+ *
+ *  return values:
+ *    the number of queries found
+ */
+SEARCH_EXTERN unsigned int CC NucStrstrSearchMany ( const NucStrstr *const *self,
+    unsigned int count, const void *ncbi2na, unsigned int pos, unsigned int len, int *found );
+
+/* NucStrstrDisableVector
+ *  when non-zero, restricts searches to the 128-bit code
+ *  for comparison in tests and benchmarks
+ */
+SEARCH_EXTERN void CC NucStrstrDisableVector ( int disable );
+
 #ifdef __cplusplus
 }
 #endif
@@ -335,6 +335,61 @@ VDB_EXTERN rc_t CC VCursorReadDirect ( const VCursor *self, int64_t row_id, uint
     uint32_t elem_bits, void *buffer, uint32_t blen, uint32_t *row_len );
 
 
+/* ReadRange
+ *  read consecutive rows of byte-aligned data into a buffer
+ *  in a single call
+ *
+ *  "first_row" [ IN ] - id of first row to read
+ *
+ *  "col_idx" [ IN ] - index of column to be read, returned by "AddColumn"
+ *
+ *  "elem_bits" [ IN ] - expected element size in bits, as in ReadDirect
+ *
+ *  "buffer" [ OUT ] and "blen" [ IN ] - return buffer for row data
+ *  where "blen" gives buffer capacity in elements. rows are packed
+ *  back to back.
+ *
+ *  "row_lens" [ OUT ] and "row_count" [ IN ] - number of rows to read
+ *  and return parameter for the length in elements of each row read
+ *
+ *  "rows_read" [ OUT ] - number of complete rows read, which may be
+ *  less than "row_count" when the buffer fills or the column ends.
+ *  if not even the first row fits, the return code indicates that
+ *  the buffer is too small and "row_lens[0]" gives the required length.
+ */
+VDB_EXTERN rc_t CC VCursorReadRange ( const VCursor *self, int64_t first_row, uint32_t col_idx,
+    uint32_t elem_bits, void *buffer, uint32_t blen, uint32_t *row_lens, uint32_t row_count,
+    uint32_t *rows_read );
+
+
+/* CellRangeDirect
+ *  zero-copy access to consecutive rows of a column within one blob
+ *
+ *  "first_row" [ IN ] - id of first row to access
+ *
+ *  "col_idx" [ IN ] - index of column to be read, returned by "AddColumn"
+ *
+ *  "blob" [ OUT ] - return parameter for a new reference to VBlob
+ *  holding the data. NB - must be released via VBlobRelease when
+ *  "base" is no longer needed.
+ *
+ *  "elem_bits" [ OUT, NULL OKAY ] - optional return parameter for
+ *  element size in bits
+ *
+ *  "base" [ OUT ] - start of blob data. row i starts at bit
+ *  "offsets[i] * elem_bits" from "base"
+ *
+ *  "offsets" [ OUT ], "row_lens" [ OUT ] and "row_count" [ IN ] -
+ *  offset and length in elements of up to "row_count" rows
+ *
+ *  "rows_read" [ OUT ] - number of rows returned, limited to
+ *  the rows remaining in the blob holding "first_row"
+ */
+VDB_EXTERN rc_t CC VCursorCellRangeDirect ( const VCursor *self, int64_t first_row,
+    uint32_t col_idx, struct VBlob const **blob, uint32_t *elem_bits, const void **base,
+    uint32_t *offsets, uint32_t *row_lens, uint32_t row_count, uint32_t *rows_read );
+
+
 /* ReadBits
  *  read single row of potentially bit-aligned column data into a buffer
  * ReadBitsDirect
@@ -234,6 +234,19 @@ struct VCursor
     }
 
 
+    /* ReadRange
+     *  read consecutive rows of byte-aligned data into a buffer
+     *  in a single call. see VCursorReadRange
+     */
+    inline rc_t ReadRange ( int64_t first_row, uint32_t col_idx, uint32_t elem_bits,
+        void *buffer, uint32_t blen, uint32_t *row_lens, uint32_t row_count,
+        uint32_t *rows_read ) const throw()
+    {
+        return VCursorReadRange ( this, first_row, col_idx, elem_bits, buffer, blen,
+            row_lens, row_count, rows_read );
+    }
+
+
     /* ReadBits
      *  read single row of potentially bit-aligned column data into a buffer
      *
@@ -301,6 +314,20 @@ struct VCursor
             base, boff, row_len );
     }
 
+
+    /* CellRangeDirect
+     *  zero-copy access to consecutive rows of a column within one blob.
+     *  see VCursorCellRangeDirect
+     */
+    inline rc_t CellRangeDirect ( int64_t first_row, uint32_t col_idx,
+        const VBlob **blob, uint32_t *elem_bits, const void **base,
+        uint32_t *offsets, uint32_t *row_lens, uint32_t row_count,
+        uint32_t *rows_read ) const throw()
+    {
+        return VCursorCellRangeDirect ( this, first_row, col_idx, blob, elem_bits,
+            base, offsets, row_lens, row_count, rows_read );
+    }
+
     /* Default
      *  give a default row value for column
      *
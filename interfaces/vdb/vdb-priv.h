@@ -97,11 +97,63 @@ VDB_EXTERN rc_t CC VDBManagerListExternalSchemaModules ( struct VDBManager const
  */
 VDB_EXTERN rc_t CC VDBManagerDisablePagemapThread ( struct VDBManager const *self );
 
+/* SetDecodeThreads
+ *  set the number of workers of the process-wide thread pool
+ *  ( see KThreadPoolGetDefault ) that each sequential reader may keep
+ *  busy decoding compressed column blobs ahead. overrides the
+ *  configuration value "vdb/decode/threads"; affects productions
+ *  that have not yet started reading.
+ *
+ *  "num_threads" [ IN ] - 0 disables decoding ahead,
+ *  capped at the size of the pool
+ */
+VDB_EXTERN rc_t CC VDBManagerSetDecodeThreads ( struct VDBManager const *self, uint32_t num_threads );
+
+/* SetSchemaCacheEntries
+ *  set the number of schemas, parsed from the text stored with
+ *  tables and databases opened for read, that are kept for reuse
+ *  by later opens. overrides the configuration value
+ *  "vdb/schema/cache/entries"
+ *
+ *  "max_entries" [ IN ] - 0 disables the cache
+ */
+VDB_EXTERN rc_t CC VDBManagerSetSchemaCacheEntries ( struct VDBManager const *self, uint32_t max_entries );
+
+/* GetSchemaCacheStats
+ */
+typedef struct VDBManagerSchemaCacheStats VDBManagerSchemaCacheStats;
+struct VDBManagerSchemaCacheStats
+{
+    /* opens that found their schema cached, that parsed
+       and cached it, and that parsed it against a schema
+       which could not be cached */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncached;
+
+    /* time spent parsing, and parse time avoided by hits */
+    uint64_t parse_ns;
+    uint64_t saved_ns;
+
+    /* entries held, and dropped to stay within the limit */
+    uint32_t entries;
+    uint32_t evictions;
+};
+
+VDB_EXTERN rc_t CC VDBManagerGetSchemaCacheStats ( struct VDBManager const *self,
+    VDBManagerSchemaCacheStats *stats );
+
 /* DisableFlushThread
  *  Disable the background cursor flush thread, may be useful when debugging
  */
 VDB_EXTERN rc_t CC VDBManagerDisableFlushThread ( struct VDBManager *self );
 
+/* DisableParallelEncoding
+ *  encode the columns of a flushed page one after another
+ *  instead of on the default thread pool
+ */
+VDB_EXTERN rc_t CC VDBManagerDisableParallelEncoding ( struct VDBManager *self );
+
 
 /* Make with custom VFSManager */
 VDB_EXTERN rc_t CC VDBManagerMakeReadWithVFSManager (
@@ -196,6 +248,25 @@ VDB_EXTERN bool CC VTableHasStaticColumn ( struct VTable const *self, const char
 VDB_EXTERN bool CC VTableVHasStaticColumn ( struct VTable const *self, const char *name, va_list args );
 
 
+/* SharesKColumns
+ *  true if every cursor on the table reads through the same KColumn
+ *  objects, as in the update library, where a manager opens each
+ *  read-only column once. such columns must not be read from several
+ *  threads at once. the read-only library gives each cursor its own.
+ */
+VDB_EXTERN bool CC VTableSharesKColumns ( struct VTable const *self );
+
+
+/* SetSharedBlobCacheCapacity
+ *  enables a blob cache that is shared by all read cursors
+ *  created on this table, including cursors used on different threads.
+ *  must be called before cursors are created.
+ *
+ *  "capacity" [ IN ] - total bytes to cache across all columns
+ */
+VDB_EXTERN rc_t CC VTableSetSharedBlobCacheCapacity ( struct VTable const *self, size_t capacity );
+
+
 /* VUntypedTableTest
  *  support for tables created before embedded schema
  *
@@ -282,6 +353,68 @@ VDB_EXTERN rc_t CC VCursorLinkedCursorSet(const struct VCursor *cself,const char
 VDB_EXTERN uint64_t CC VCursorSetCacheCapacity(struct VCursor *self,uint64_t capacity);
 VDB_EXTERN uint64_t CC VCursorGetCacheCapacity(const struct VCursor *self);
 
+/* SetReadAhead
+ *  opt-in background prefetch for sequential scans of a cached read cursor
+ *  a worker thread fetches and decodes the next "n_blobs" blobs
+ *  of every column the cursor is reading, overlapping I/O and
+ *  decompression with the consumer. must be called after VCursorOpen.
+ *
+ *  "n_blobs" [ IN ] - prefetch window per column, at most 64; 0 disables
+ */
+VDB_EXTERN rc_t CC VCursorSetReadAhead ( struct VCursor const *self, uint32_t n_blobs );
+
+/* GetStats
+ *  counters gathered while reading a column of a read cursor
+ *  physical columns and transform functions shared by several
+ *  columns of the cursor are included in the stats of each of them
+ *
+ *  "col_idx" [ IN ] - index of column, returned by "AddColumn"
+ */
+typedef struct VCursorColumnStats VCursorColumnStats;
+struct VCursorColumnStats
+{
+    /* blobs read from KColumns and their size in bytes */
+    uint64_t blobs_read;
+    uint64_t raw_bytes;
+
+    /* bytes delivered by the decompression chains */
+    uint64_t decoded_bytes;
+
+    /* time spent in transform functions */
+    uint64_t decode_ns;
+
+    /* reads answered from the cursor's blob cache, from read-ahead,
+       from the table's shared cache, and by producing a new blob;
+       all 0 without a blob cache */
+    uint64_t cache_hits;
+    uint64_t prefetch_hits;
+    uint64_t shared_hits;
+    uint64_t cache_misses;
+
+    /* page-map regions expanded to locate rows */
+    uint64_t pagemap_expands;
+};
+
+VDB_EXTERN rc_t CC VCursorGetStats ( struct VCursor const *self,
+    uint32_t col_idx, VCursorColumnStats *stats );
+
+/* ListFunctionStats
+ *  report calls and time of each transform function feeding a column
+ *
+ *  "f" [ IN ] and "data" [ IN, OPAQUE ] - callback invoked once per function
+ */
+VDB_EXTERN rc_t CC VCursorListFunctionStats ( struct VCursor const *self, uint32_t col_idx,
+    void ( CC * f ) ( const char *name, uint64_t calls, uint64_t decode_ns, void *data ),
+    void *data );
+
+/* DumpStats
+ *  write the stats of every column and its transform functions as text
+ *
+ *  "flush" [ IN ] and "dst" [ IN, OPAQUE ] - callback for writing
+ */
+VDB_EXTERN rc_t CC VCursorDumpStats ( struct VCursor const *self,
+    rc_t ( CC * flush ) ( void *dst, const void *buffer, size_t bsize ), void *dst );
+
 
 /*--------------------------------------------------------------------------
  * VCursorParams
@@ -490,92 +490,248 @@ static rc_t BGZFileInit(BGZFile *self, const KFile *kfp, BGZFile_vt *vt)
 
 /* MARK: BGZThreadFile *** Start *** */
 
-#include <kproc/thread.h>
-#include <kproc/lock.h>
-#include <kproc/cond.h>
+typedef struct BGZInflateTask BGZInflateTask;
+#define KTASK_IMPL struct BGZInflateTask
 
-typedef struct BGZThreadFile_s BGZThreadFile;
+#include <kproc/task.h>
+#include <kproc/impl.h>
+#include <kproc/threadpool.h>
+
+/* copies the next "len" bytes of the file to "dst" */
+static rc_t BGZFileReadBytes(BGZFile *const self, uint8_t dst[], unsigned const len, unsigned *const pNumRead)
+{
+    unsigned n = 0;
+    
+    while (n < len) {
+        unsigned avail;
+        
+        if (self->bpos >= self->bcount) {
+            rc_t const rc = BGZFileGetMoreBytes(self);
+            if (rc) {
+                *pNumRead = n;
+                return rc;
+            }
+        }
+        avail = (unsigned)(self->bcount - self->bpos);
+        if (avail > len - n)
+            avail = len - n;
+        memcpy(&dst[n], &self->buf[self->bpos], avail);
+        self->bpos += avail;
+        n += avail;
+    }
+    *pNumRead = n;
+    return 0;
+}
+
+/* reads the next BGZF block without inflating it
+ * returns (rcData, rcInsufficient) if eof
+ */
+static rc_t BGZFileReadRawBlock(BGZFile *const self, zlib_block_t dst, unsigned *const pNumRead)
+{
+    unsigned const hsize = 12; /* gzip header up to and including XLEN */
+    unsigned const tsize = 8;  /* CRC32 and ISIZE */
+    unsigned nread;
+    unsigned xlen;
+    unsigned bsize = 0;
+    unsigned i;
+    rc_t rc;
+    
+    *pNumRead = 0;
+    rc = BGZFileReadBytes(self, dst, hsize, &nread);
+    if (rc)
+        return nread == 0 ? rc : RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+    
+    if (dst[0] != 31 || dst[1] != 139 || dst[2] != Z_DEFLATED || (dst[3] & 4) == 0)
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid); /* not BGZF */
+    
+    xlen = LE2HUI16(&dst[10]);
+    if (hsize + xlen + tsize > sizeof(zlib_block_t))
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid);
+    rc = BGZFileReadBytes(self, &dst[hsize], xlen, &nread);
+    if (rc)
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+    
+    for (i = 0; i + 4 <= xlen; ) {
+        uint8_t const *const sub = &dst[hsize + i];
+        unsigned const slen = LE2HUI16(&sub[2]);
+        
+        if (sub[0] == 'B' && sub[1] == 'C' && slen == 2 && i + 6 <= xlen) {
+            bsize = 1 + LE2HUI16(&sub[4]);
+            break;
+        }
+        i += slen + 4;
+    }
+    if (bsize < hsize + xlen + tsize) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("BGZF Header extra field BC not found\n"));
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid); /* not BGZF */
+    }
+    rc = BGZFileReadBytes(self, &dst[hsize + xlen], bsize - hsize - xlen, &nread);
+    if (rc)
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+    
+    *pNumRead = bsize;
+    return 0;
+}
 
-#define BUFFER_COUNT (3)
+/* the most blocks that are read ahead of the consumer */
+#define BLOCKS_AHEAD (32)
 
-typedef struct BGZThreadFileWorkQElem_s BGZThreadFileWorkQElem;
+typedef struct BGZThreadFile_s BGZThreadFile;
+typedef struct BGZThreadFileBlock_s BGZThreadFileBlock;
 
-struct BGZThreadFileWorkQElem_s {
-    uint8_t *buf;
-    uint64_t pos;
-    unsigned bsz;
+struct BGZThreadFileBlock_s {
+    KTaskFuture *future;
+    uint64_t fnext;     /* position in file of the following block */
+    z_stream zs;
+    unsigned csize;
+    unsigned dsize;
+    zlib_block_t cdata; /* as read from the file */
+    zlib_block_t ddata; /* inflated */
 };
 
+/* blocks are scanned from the file in order by the reader,
+ * inflated on the thread pool, and handed back in order.
+ * the number of blocks in flight starts at one after a seek
+ * and doubles with every block read up to "max_ahead",
+ * so that index driven access does not inflate much it will not use.
+ */
 struct BGZThreadFile_s {
     BGZFile file;
-    KLock *lock;
-    KCondition *have_data;
-    KCondition *need_data;
-    KThread *th;
-    uint64_t pos;
-    BGZThreadFileWorkQElem que[BUFFER_COUNT];
-    rc_t volatile rc;
-    unsigned volatile nque;
-    bool eof;
-    uint8_t buffer[sizeof(zlib_block_t) * BUFFER_COUNT];
+    KThreadPool *pool;
+    BGZThreadFileBlock *blk;    /* ring of BLOCKS_AHEAD */
+    uint64_t pos;               /* position in file of the block at "head" */
+    rc_t rc;                    /* why scanning stopped */
+    unsigned head;
+    unsigned nque;
+    unsigned ahead;
+    unsigned max_ahead;
 };
 
-static rc_t BGZThreadFileRead(BGZThreadFile *self, zlib_block_t dst, unsigned *pNumRead)
+struct BGZInflateTask {
+    KTask dad;
+    BGZThreadFileBlock *blk;
+};
+
+static rc_t CC BGZInflateTaskWhack(BGZInflateTask *self)
+{
+    KTaskDestroy(&self->dad, "BGZInflateTask");
+    free(self);
+    return 0;
+}
+
+static rc_t CC BGZInflateTaskExecute(BGZInflateTask *self)
+{
+    BGZThreadFileBlock *const blk = self->blk;
+    int zr = inflateReset(&blk->zs);
+    
+    assert(zr == Z_OK);
+    blk->zs.next_in = (Bytef *)blk->cdata;
+    blk->zs.avail_in = blk->csize;
+    blk->zs.next_out = (Bytef *)blk->ddata;
+    blk->zs.avail_out = sizeof(blk->ddata);
+    
+    zr = inflate(&blk->zs, Z_FINISH);
+    if (zr != Z_STREAM_END || blk->zs.avail_in != 0) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("Unexpected Zlib result %i\n", zr));
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcCorrupt);
+    }
+    blk->dsize = (unsigned)blk->zs.total_out; /* <= 64k */
+    return 0;
+}
+
+static KTask_vt_v1 BGZInflateTask_vt = {
+    1, 0,
+    BGZInflateTaskWhack,
+    BGZInflateTaskExecute
+};
+
+static rc_t BGZThreadFileSubmit(BGZThreadFile *const self, BGZThreadFileBlock *const blk)
 {
     rc_t rc;
+    BGZInflateTask *const task = malloc(sizeof(*task));
     
-    *pNumRead = 0;
+    if (task == NULL)
+        return RC(rcAlign, rcFile, rcReading, rcMemory, rcExhausted);
     
-    KLockAcquire(self->lock);
-    if ((rc = self->rc) == 0) {
-        while (self->nque == 0 && (rc = self->rc) == 0)
-            KConditionWait(self->have_data, self->lock);
+    rc = KTaskInit(&task->dad, (KTask_vt const *)&BGZInflateTask_vt, "BGZInflateTask", "");
+    if (rc) {
+        free(task);
+        return rc;
+    }
+    task->blk = blk;
+    rc = KThreadPoolSubmit(self->pool, &task->dad, &blk->future);
+    KTaskRelease(&task->dad);
+    return rc;
+}
+
+/* scan blocks from the file until "ahead" of them are in flight */
+static void BGZThreadFileFill(BGZThreadFile *const self)
+{
+    while (self->rc == 0 && self->nque < self->ahead) {
+        BGZThreadFileBlock *const blk = &self->blk[(self->head + self->nque) % BLOCKS_AHEAD];
+        rc_t rc = BGZFileReadRawBlock(&self->file, blk->cdata, &blk->csize);
+        
         if (rc == 0) {
-            BGZThreadFileWorkQElem const work = self->que[0];
-            
-            self->pos = work.pos;
-            if (work.buf) {
-                memcpy(dst, work.buf, *pNumRead = work.bsz);
-                memmove(&self->que[0], &self->que[1], --self->nque * sizeof(self->que[0]));
-                KConditionSignal(self->need_data);
-            }
-            else {
-                self->eof = true;
-                self->rc = rc = RC(rcAlign, rcFile, rcReading, rcData, rcInsufficient);
-            }
+            blk->fnext = BGZFileGetPos(&self->file);
+            rc = BGZThreadFileSubmit(self, blk);
+        }
+        if (rc) {
+            self->rc = rc;
+            break;
         }
+        ++self->nque;
     }
-    KLockUnlock(self->lock);
-    return rc;
 }
 
-static rc_t CC BGZThreadFileMain(KThread const *const th, void *const vp)
+/* take the block at "head" out of the queue */
+static rc_t BGZThreadFilePop(BGZThreadFile *const self, BGZThreadFileBlock **const pblk)
 {
-    BGZThreadFile *const self = (BGZThreadFile *)vp;
-    rc_t rc = 0;
-    unsigned bufno;
+    BGZThreadFileBlock *const blk = &self->blk[self->head];
+    rc_t status = 0;
+    rc_t const rc = KTaskFutureWait(blk->future, &status, NULL);
     
-    KLockAcquire(self->lock);
-    for (bufno = 0; ; bufno = (bufno + 1) % BUFFER_COUNT) {
-        while (self->nque == BUFFER_COUNT)
-            KConditionWait(self->need_data, self->lock);
-        {
-            BGZThreadFileWorkQElem work;
-            
-            work.pos = BGZFileGetPos(&self->file);
-            work.buf = &self->buffer[bufno * sizeof(zlib_block_t)];
-            rc = BGZFileRead(&self->file, work.buf, &work.bsz);
-            if ( GetRCObject( rc ) == (enum RCObject)rcData && GetRCState( rc ) == rcInsufficient )
-                work.buf = NULL;
-            else if ( rc != 0 )
-                break;
-            self->que[self->nque++] = work;
-            KConditionSignal(self->have_data);
-        }
+    KTaskFutureRelease(blk->future);
+    blk->future = NULL;
+    self->head = (self->head + 1) % BLOCKS_AHEAD;
+    --self->nque;
+    self->pos = blk->fnext;
+    
+    *pblk = blk;
+    return rc ? rc : status;
+}
+
+static void BGZThreadFileDrain(BGZThreadFile *const self)
+{
+    while (self->nque) {
+        BGZThreadFileBlock *blk;
+        
+        BGZThreadFilePop(self, &blk);
     }
-    self->rc = rc;
-    KLockUnlock(self->lock);
-    return 0;
+}
+
+static rc_t BGZThreadFileRead(BGZThreadFile *self, zlib_block_t dst, unsigned *pNumRead)
+{
+    BGZThreadFileBlock *blk;
+    rc_t rc;
+    
+    *pNumRead = 0;
+    
+    BGZThreadFileFill(self);
+    if (self->nque == 0)
+        return self->rc; /* (rcData, rcInsufficient) if eof */
+    
+    rc = BGZThreadFilePop(self, &blk);
+    if (rc == 0)
+        memcpy(dst, blk->ddata, *pNumRead = blk->dsize);
+    
+    if (self->ahead < self->max_ahead) {
+        self->ahead *= 2;
+        if (self->ahead > self->max_ahead)
+            self->ahead = self->max_ahead;
+    }
+    /* keep the workers busy while the caller parses this block */
+    BGZThreadFileFill(self);
+    return rc;
 }
 
 static uint64_t BGZThreadFileGetPos(BGZThreadFile const *const self)
@@ -594,20 +750,29 @@ static uint64_t BGZThreadFileGetSize(BGZThreadFile const *const self)
     return BGZFileGetSize(&self->file);
 }
 
-static rc_t BGZThreadFileSetPos(BGZThreadFile *const self)
+static rc_t BGZThreadFileSetPos(BGZThreadFile *const self, uint64_t const pos)
 {
-    return RC(rcAlign, rcFile, rcPositioning, rcFunction, rcUnsupported);
+    /* the queued blocks are the ones wanted */
+    if (pos == self->pos)
+        return 0;
+    
+    BGZThreadFileDrain(self);
+    self->rc = 0;
+    self->pos = pos;
+    self->ahead = 1;
+    return BGZFileSetPos(&self->file, pos);
 }
 
 static void BGZThreadFileWhack(BGZThreadFile *const self)
 {
-    KThreadCancel(self->th);
-    KThreadWait(self->th, NULL);
+    unsigned i;
+    
+    BGZThreadFileDrain(self);
+    for (i = 0; i != BLOCKS_AHEAD; ++i)
+        inflateEnd(&self->blk[i].zs);
+    free(self->blk);
+    KThreadPoolRelease(self->pool);
     BGZFileWhack(&self->file);
-    KConditionRelease(self->need_data);
-    KConditionRelease(self->have_data);
-    KLockRelease(self->lock);
-    KThreadRelease(self->th);
 }
 
 static rc_t BGZThreadFileInit(BGZThreadFile *self, const KFile *kfp, BGZFile_vt *vt)
@@ -626,22 +791,30 @@ static rc_t BGZThreadFileInit(BGZThreadFile *self, const KFile *kfp, BGZFile_vt
     
     rc = BGZFileInit(&self->file, kfp, vt);
     if (rc == 0) {
-        rc = KLockMake(&self->lock);
+        rc = KThreadPoolGetDefault(&self->pool);
         if (rc == 0) {
-            rc = KConditionMake(&self->have_data);
-            if (rc == 0) {
-                rc = KConditionMake(&self->need_data);
-                if (rc == 0) {
-                    rc = KThreadMake(&self->th, BGZThreadFileMain, self);
-                    if (rc == 0) {
-                        *vt = my_vt;
-                        return 0;
-                    }
-                    KConditionRelease(self->need_data);
+            self->blk = calloc(BLOCKS_AHEAD, sizeof(self->blk[0]));
+            if (self->blk != NULL) {
+                unsigned i;
+                
+                for (i = 0; i != BLOCKS_AHEAD; ++i) {
+                    if (inflateInit2(&self->blk[i].zs, MAX_WBITS + 16) != Z_OK) /* max + enable gzip headers */
+                        break;
+                }
+                if (i == BLOCKS_AHEAD) {
+                    self->max_ahead = 4 * KThreadPoolThreads(self->pool);
+                    if (self->max_ahead > BLOCKS_AHEAD)
+                        self->max_ahead = BLOCKS_AHEAD;
+                    self->ahead = 1;
+                    *vt = my_vt;
+                    return 0;
                 }
-                KConditionRelease(self->have_data);
+                while (i != 0)
+                    inflateEnd(&self->blk[--i].zs);
+                free(self->blk);
             }
-            KLockRelease(self->lock);
+            rc = RC(rcAlign, rcFile, rcConstructing, rcMemory, rcExhausted);
+            KThreadPoolRelease(self->pool);
         }
         BGZFileWhack(&self->file);
     }
@@ -650,6 +823,19 @@ static rc_t BGZThreadFileInit(BGZThreadFile *self, const KFile *kfp, BGZFile_vt
     return rc;
 }
 
+/* inflating on the pool only pays when it has more than one worker */
+static bool BGZThreadFileIsUseful(void)
+{
+    KThreadPool *pool;
+    bool result = false;
+    
+    if (KThreadPoolGetDefault(&pool) == 0) {
+        result = KThreadPoolThreads(pool) > 1;
+        KThreadPoolRelease(pool);
+    }
+    return result;
+}
+
 #endif
 
 /* MARK: BAMFile structures */
@@ -1689,7 +1875,8 @@ static rc_t BAMFileMakeWithKFileAndHeader(BAMFile const **cself,
     
     KRefcountInit(&self->refcount, 1, "BAMFile", "new", "");
 #ifndef WINDOWS
-    if (threaded)
+    self->threaded = threaded && BGZThreadFileIsUseful();
+    if (self->threaded)
         rc = BGZThreadFileInit(&self->file.thread, file, &self->vt);
     else
 #endif
@@ -1709,7 +1896,7 @@ static rc_t BAMFileMakeWithKFileAndHeader(BAMFile const **cself,
 /* file is retained */
 LIB_EXPORT rc_t CC BAMFileMakeWithKFile(const BAMFile **cself, const KFile *file)
 {
-    return BAMFileMakeWithKFileAndHeader(cself, file, NULL, false);
+    return BAMFileMakeWithKFileAndHeader(cself, file, NULL, true);
 }
 
 LIB_EXPORT rc_t CC BAMFileVMakeWithDir(const BAMFile **result,
@@ -1783,7 +1970,7 @@ LIB_EXPORT rc_t CC BAMFileMakeWithHeader ( const BAMFile **cself,
     va_start(args, path);
     rc = KDirectoryVOpenFileRead(dir, &kf, path, args);
     if (rc == 0) {
-        rc = BAMFileMakeWithKFileAndHeader(cself, kf, headerText, false);
+        rc = BAMFileMakeWithKFileAndHeader(cself, kf, headerText, true);
         KFileRelease(kf);
     }
     va_end(args);
@@ -31,6 +31,10 @@
 #include <klib/text.h>
 #include <klib/printf.h>
 #include <klib/log.h>
+#include <klib/time.h>
+#include <kfs/directory.h>
+#include <kfs/file.h>
+#include <kfs/mmap.h>
 #include <kdb/manager.h>
 #include <kdb/meta.h>
 #include <kfg/config.h>
@@ -43,6 +47,7 @@
 #include <sysalloc.h>
 
 #include "refseq-mgr-priv.h"
+#include "reference-cmn.h"
 #include "reader-wgs.h"
 #include "debug.h"
 
@@ -60,6 +65,7 @@ struct RefSeqMgr {
     RefSeq *mru;
     RefSeq *lru;
     RefSeq **refSeq;
+    char *disk_cache;
     size_t cache;
     uint32_t reader_options;
     unsigned num_open_max;
@@ -79,6 +85,10 @@ enum {
 
 struct RefSeq_RefSeq {
     TableReaderRefSeq const *reader;
+    KMMap const *map;       /* of the disk cache file */
+    uint8_t const *bases;   /* NULL unless served from the disk cache */
+    INSDC_coord_len length;
+    bool circular;
     char name[1];
 };
 
@@ -299,6 +309,9 @@ static void RefSeq_RefSeq_close(RefSeq *const super)
     
     super->u.refSeq.reader = NULL;
     TableReaderRefSeq_Whack(reader);
+    KMMapRelease(super->u.refSeq.map);
+    super->u.refSeq.map = NULL;
+    super->u.refSeq.bases = NULL;
 }
 
 static void RefSeq_WGS_close(RefSeq *const super)
@@ -342,12 +355,20 @@ static rc_t RefSeq_WGS_setRow(RefSeq *const super,
     return RC(rcAlign, rcTable, rcAccessing, rcRow, rcInvalid);
 }
 
+static rc_t RefSeq_RefSeq_readDiskCache(struct RefSeq_RefSeq const *self,
+                                        INSDC_coord_zero offset,
+                                        INSDC_coord_len length,
+                                        uint8_t *buffer,
+                                        INSDC_coord_len *written);
+
 static rc_t RefSeq_RefSeq_read(RefSeq const *const super,
                                INSDC_coord_zero const offset,
                                INSDC_coord_len const length,
                                uint8_t *const buffer,
                                INSDC_coord_len *const written)
 {
+    if (super->u.refSeq.bases)
+        return RefSeq_RefSeq_readDiskCache(&super->u.refSeq, offset, length, buffer, written);
     return TableReaderRefSeq_Read(super->u.refSeq.reader, offset, length, buffer, written);
 }
 
@@ -504,6 +525,196 @@ static rc_t get_db_schema_info(VDatabase const *db,
     return rc;
 }
 
+/* MARK: RefSeq disk cache
+ *
+ * the decoded bases of an accessioned reference are kept in
+ * "<disk_cache>/<accession>.<md5>.<txt|4na>", one byte per base,
+ * and mapped into memory by every process that reads them.
+ * the file is written under a ".tmp" name, which is created exclusively,
+ * and renamed into place when complete, so that no reader sees it partially.
+ */
+
+/* a ".tmp" file this old was left behind by a builder that died */
+#define DISK_CACHE_STALE_SECONDS (60 * 60)
+#define DISK_CACHE_CHUNK (1024 * 1024)
+
+static rc_t RefSeq_RefSeq_diskCachePath(RefSeq const *const super,
+                                        RefSeqMgr const *const mgr,
+                                        size_t const psize, char path[])
+{
+    struct RefSeq_RefSeq const *const self = &super->u.refSeq;
+    static char const hexdigits[] = "0123456789abcdef";
+    uint8_t const *md5 = NULL;
+    char hex[33];
+    size_t num_writ;
+    unsigned i;
+    rc_t rc = TableReaderRefSeq_MD5(self->reader, &md5);
+
+    if (rc == 0 && md5 == NULL)
+        rc = RC(rcAlign, rcFile, rcOpening, rcChecksum, rcNotFound);
+    if (rc)
+        return rc;
+
+    for (i = 0; i < 16; ++i) {
+        hex[2 * i + 0] = hexdigits[md5[i] >> 4];
+        hex[2 * i + 1] = hexdigits[md5[i] & 0x0F];
+    }
+    hex[32] = '\0';
+    return string_printf(path, psize, &num_writ, "%s/%s.%s.%s",
+                         mgr->disk_cache, self->name, hex,
+                         (mgr->reader_options & errefseq_4NA) ? "4na" : "txt");
+}
+
+static rc_t RefSeq_RefSeq_diskCacheMap(RefSeq *const super,
+                                       KDirectory const *const dir,
+                                       char const path[])
+{
+    struct RefSeq_RefSeq *const self = &super->u.refSeq;
+    KFile const *file;
+    rc_t rc = KDirectoryOpenFileRead(dir, &file, "%s", path);
+
+    if (rc == 0) {
+        uint64_t fsize = 0;
+
+        rc = KFileSize(file, &fsize);
+        if (rc == 0 && fsize != self->length)
+            rc = RC(rcAlign, rcFile, rcOpening, rcSize, rcIncorrect);
+        if (rc == 0)
+            rc = KMMapMakeRead(&self->map, file);
+        if (rc == 0) {
+            void const *addr;
+
+            rc = KMMapAddrRead(self->map, &addr);
+            if (rc == 0)
+                self->bases = addr;
+            else {
+                KMMapRelease(self->map);
+                self->map = NULL;
+            }
+        }
+        KFileRelease(file);
+    }
+    return rc;
+}
+
+static rc_t RefSeq_RefSeq_diskCacheBuild(RefSeq const *const super,
+                                         KDirectory *const dir,
+                                         char const path[])
+{
+    struct RefSeq_RefSeq const *const self = &super->u.refSeq;
+    char tmp[4096];
+    size_t num_writ;
+    KFile *file;
+    rc_t rc = string_printf(tmp, sizeof(tmp), &num_writ, "%s.tmp", path);
+
+    if (rc)
+        return rc;
+
+    rc = KDirectoryCreateFile(dir, &file, false, 0664, kcmCreate | kcmParents, "%s", tmp);
+    if (GetRCState(rc) == rcExists) {
+        /* being built by someone else, unless it was abandoned */
+        KTime_t date;
+
+        if (KDirectoryDate(dir, &date, "%s", tmp) == 0 &&
+            date + DISK_CACHE_STALE_SECONDS < KTimeStamp() &&
+            KDirectoryRemove(dir, false, "%s", tmp) == 0)
+        {
+            rc = KDirectoryCreateFile(dir, &file, false, 0664, kcmCreate | kcmParents, "%s", tmp);
+        }
+    }
+    if (rc)
+        return rc;
+    {
+        uint8_t *const buffer = malloc(DISK_CACHE_CHUNK);
+        uint64_t pos = 0;
+
+        if (buffer == NULL)
+            rc = RC(rcAlign, rcFile, rcWriting, rcMemory, rcExhausted);
+        while (rc == 0 && pos < self->length) {
+            INSDC_coord_len const want = (self->length - pos < DISK_CACHE_CHUNK)
+                                       ? (INSDC_coord_len)(self->length - pos)
+                                       : DISK_CACHE_CHUNK;
+            INSDC_coord_len got = 0;
+
+            rc = TableReaderRefSeq_Read(self->reader, (INSDC_coord_zero)pos, want, buffer, &got);
+            if (rc == 0 && got != want)
+                rc = RC(rcAlign, rcFile, rcWriting, rcData, rcInsufficient);
+            if (rc == 0)
+                rc = KFileWriteAll(file, pos, buffer, got, &num_writ);
+            pos += got;
+        }
+        free(buffer);
+    }
+    KFileRelease(file);
+    if (rc == 0)
+        rc = KDirectoryRename(dir, true, tmp, path);
+    if (rc)
+        KDirectoryRemove(dir, false, "%s", tmp);
+    return rc;
+}
+
+/* failing to use the disk cache is not an error, the bases are decoded instead */
+static void RefSeq_RefSeq_openDiskCache(RefSeq *const super, RefSeqMgr const *const mgr)
+{
+    struct RefSeq_RefSeq *const self = &super->u.refSeq;
+    KDirectory *dir;
+    char path[4096];
+    rc_t rc;
+
+    if (mgr->disk_cache == NULL)
+        return;
+
+    rc = RefSeq_RefSeq_diskCachePath(super, mgr, sizeof(path), path);
+    if (rc == 0)
+        rc = TableReaderRefSeq_SeqLength(self->reader, &self->length);
+    if (rc == 0)
+        rc = TableReaderRefSeq_Circular(self->reader, &self->circular);
+    if (rc == 0 && self->length == 0)
+        rc = RC(rcAlign, rcFile, rcOpening, rcData, rcEmpty);
+    if (rc == 0)
+        rc = KDirectoryNativeDir(&dir);
+    if (rc == 0) {
+        rc = RefSeq_RefSeq_diskCacheMap(super, dir, path);
+        if (rc) {
+            rc = RefSeq_RefSeq_diskCacheBuild(super, dir, path);
+            if (rc == 0)
+                rc = RefSeq_RefSeq_diskCacheMap(super, dir, path);
+        }
+        KDirectoryRelease(dir);
+    }
+    ALIGN_CF_DBGERRP("disk cache for %s", rc, self->name);
+}
+
+static rc_t RefSeq_RefSeq_readDiskCache(struct RefSeq_RefSeq const *const self,
+                                        INSDC_coord_zero offset,
+                                        INSDC_coord_len const length,
+                                        uint8_t *const buffer,
+                                        INSDC_coord_len *const written)
+{
+    INSDC_coord_len n = 0;
+    rc_t const rc = ReferenceSeq_ReOffset(self->circular, self->length, &offset);
+
+    *written = 0;
+    if (rc)
+        return rc;
+    if (self->circular)
+        offset %= self->length;
+
+    while (n < length) {
+        INSDC_coord_len q = self->length - offset;
+
+        if (q > length - n)
+            q = length - n;
+        memcpy(&buffer[n], &self->bases[offset], q);
+        n += q;
+        if (!self->circular)
+            break;
+        offset = 0;
+    }
+    *written = n;
+    return 0;
+}
+
 static rc_t RefSeq_RefSeq_open(RefSeq *const super, RefSeqMgr const *const mgr)
 {
     struct RefSeq_RefSeq *const self = &super->u.refSeq;
@@ -517,6 +728,8 @@ static rc_t RefSeq_RefSeq_open(RefSeq *const super, RefSeqMgr const *const mgr)
         if (strcmp(scheme, "NCBI:refseq:tbl:reference") == 0) {
             rc = TableReaderRefSeq_MakeTable(&self->reader, mgr->vmgr, tbl,
                                              mgr->reader_options, mgr->cache);
+            if (rc == 0)
+                RefSeq_RefSeq_openDiskCache(super, mgr);
         }
         else {
             rc = RC(rcAlign, rcTable, rcOpening, rcType, rcInvalid);
@@ -539,6 +752,8 @@ static rc_t RefSeq_RefSeq_odd_open(RefSeq *const super, RefSeqMgr const *const m
         if (strcmp(scheme, "NCBI:refseq:tbl:reference") == 0) {
             rc = TableReaderRefSeq_MakeTable(&self->reader, mgr->vmgr, tbl,
                                              mgr->reader_options, mgr->cache);
+            if (rc == 0)
+                RefSeq_RefSeq_openDiskCache(super, mgr);
         }
         else {
             rc = RC(rcAlign, rcTable, rcOpening, rcType, rcInvalid);
@@ -641,6 +856,7 @@ static int AccessionType(VDBManager const *const mgr,
 }
 
 static void WhackAllReaders(RefSeqMgr *const mgr);
+static rc_t RefSeqMgr_KfgReadStr(const KConfig* kfg, const char* path, char* value, size_t value_sz);
 
 LIB_EXPORT rc_t CC RefSeqMgr_SetCache(RefSeqMgr const *const cself, size_t cache, uint32_t keep_open_num)
 {
@@ -655,6 +871,23 @@ LIB_EXPORT rc_t CC RefSeqMgr_SetCache(RefSeqMgr const *const cself, size_t cache
     return 0;
 }
 
+LIB_EXPORT rc_t CC RefSeqMgr_SetDiskCache(RefSeqMgr const *const cself, char const *const path)
+{
+    RefSeqMgr *const self = (RefSeqMgr *)cself;
+    char *copy = NULL;
+
+    if (self == NULL)
+        return RC(rcAlign, rcIndex, rcUpdating, rcSelf, rcNull);
+    if (path != NULL && path[0] != '\0') {
+        copy = string_dup(path, string_size(path));
+        if (copy == NULL)
+            return RC(rcAlign, rcIndex, rcUpdating, rcMemory, rcExhausted);
+    }
+    free(self->disk_cache);
+    self->disk_cache = copy;
+    return 0;
+}
+
 LIB_EXPORT rc_t CC RefSeqMgr_Make( const RefSeqMgr** cself, const VDBManager* vmgr,
                                    uint32_t reader_options, size_t cache, uint32_t keep_open_num )
 {
@@ -686,6 +919,14 @@ LIB_EXPORT rc_t CC RefSeqMgr_Make( const RefSeqMgr** cself, const VDBManager* vm
                     obj->reader_options = reader_options;
                 }
             }
+            if ( rc == 0 )
+            {
+                char disk_cache[ 4096 ];
+
+                rc = RefSeqMgr_KfgReadStr( obj->kfg, "refseq/disk_cache", disk_cache, sizeof( disk_cache ) );
+                if ( rc == 0 )
+                    rc = RefSeqMgr_SetDiskCache( obj, disk_cache );
+            }
         }
     }
 
@@ -712,6 +953,7 @@ LIB_EXPORT rc_t CC RefSeqMgr_Release(const RefSeqMgr* cself)
         for (i = 0; i < self->nRefSeqs; ++i)
             free(self->refSeq[i]);
         free(self->refSeq);
+        free(self->disk_cache);
         VDBManagerRelease(self->vmgr);
         KConfigRelease(self->kfg);
         free(self);
@@ -45,6 +45,12 @@
 #include <klib/data-buffer.h>
 #include <klib/sort.h>
 
+typedef struct rr_fetch_task rr_fetch_task;
+#define KTASK_IMPL rr_fetch_task
+#include <kproc/task.h>
+#include <kproc/impl.h>
+#include <kproc/threadpool.h>
+
 #include <vdb/vdb-priv.h>
 
 #include <bitstr.h>
@@ -76,175 +82,244 @@ VERSION     effect
 
 #if READ_RESTORER_VERSION == 2
 
-/* --------------------------- id_list --------------------------- */
+/* the reads of the align-id's of a window of rows are fetched in sorted
+   order, so that the alignment table is read blob by blob;
+   the window is as many align-id's as fit into RR_CACHE_BYTES */
+#define RR_CACHE_BYTES ( 32 * 1024 * 1024 )
 
+/* guessed read-length until some reads have been fetched */
+#define RR_DEFAULT_READ_LEN 150
 
-typedef struct id_list
-{
-    int64_t * list;
-    uint32_t count;
-} id_list;
+/* the window is split among workers of the thread-pool,
+   if every one gets at least RR_PARALLEL_MIN_IDS align-id's */
+#define RR_MAX_PARTS 8
+#define RR_PARALLEL_MIN_IDS 4096
+#define RR_WORKER_CURSOR_CACHE ( 8 * 1024 * 1024 )
 
+/* --------------------------- rr_part --------------------------- */
 
-static bool sort_align_ids( const id_list * src, id_list * dst )
+typedef struct rr_read
 {
-    bool res;
-    dst -> count = 0;
-    dst -> list = malloc( src -> count * sizeof( dst -> list[ 0 ] ) );
-    res = ( dst -> list != NULL );
-    if ( res )
-    {
-        uint32_t i;
-        /* filter out the zero id's */
-        for( i = 0; i < src -> count; i++ )
-        {
-            if ( src -> list[ i ] > 0 )
-                dst -> list[ dst -> count ++ ] = src -> list[ i ];
-        }
-        /* now we can sort */
-        if ( dst -> count > 0 )
-            ksort_int64_t( dst -> list, dst -> count );
-    }
-    return res;
-}
+    int64_t align_id;
+    uint64_t offset;
+    uint32_t len;
+} rr_read;
 
 
-/* --------------------------- rr_entry --------------------------- */
-
-typedef struct rr_entry
+/* the reads of a range of the sorted align-id's, packed into one buffer */
+typedef struct rr_part
 {
-    uint32_t read_len;
-    INSDC_4na_bin read[ 1 ];
-} rr_entry;
+    const int64_t * ids;
+    rr_read * reads;
+    KDataBuffer bases;
+    uint64_t max_bytes;
+    uint32_t id_count;
+    uint32_t read_count;
+    uint32_t max_reads;
+} rr_part;
 
 
-static rc_t rr_entry_release ( uint64_t key, const void * item, void * data )
+static void rr_part_release ( rr_part * p )
 {
-    if ( item != NULL )
-        free( ( void * ) item );
+    free( ( void * ) p -> reads );
+    KDataBufferWhack( & p -> bases );
+}
+
+static rc_t rr_part_reserve ( rr_part * p, uint32_t id_count )
+{
+    if ( id_count > p -> max_reads )
+    {
+        rr_read * reads = realloc( p -> reads, id_count * sizeof p -> reads[ 0 ] );
+        if ( reads == NULL )
+            return RC ( rcXF, rcFunction, rcAllocating, rcMemory, rcExhausted );
+        p -> reads = reads;
+        p -> max_reads = id_count;
+    }
+    if ( p -> bases . base == NULL )
+        return KDataBufferMakeBytes( & p -> bases, 0 );
     return 0;
 }
 
-static bool rr_entry_make ( rr_entry ** entry, const INSDC_4na_bin * read, uint32_t read_len )
+/* a read that does not fit "max_bytes" is left to be fetched on demand */
+static rc_t rr_part_fetch ( rr_part * p, const VCursor * curs, uint32_t read_idx )
 {
-    bool res = ( entry != NULL && read != NULL );
-    if ( res )
+    rc_t rc = 0;
+    uint64_t used = 0;
+    uint32_t i;
+
+    p -> read_count = 0;
+    for ( i = 0; i < p -> id_count && rc == 0; i++ )
     {
-        rr_entry * obj = malloc ( ( sizeof * obj ) + read_len - 1 );
-        res = ( obj != NULL );
-        if ( res )
+        const INSDC_4na_bin * read;
+        uint32_t read_len;
+
+        if ( VCursorCellDataDirect( curs, p -> ids[ i ], read_idx, NULL, ( const void** ) &read, NULL, &read_len ) != 0 )
+            continue;
+        if ( used + read_len > p -> max_bytes )
+            break;
+        if ( used + read_len > p -> bases . elem_count )
         {
-            obj -> read_len = read_len;
-            memcpy( &( obj -> read[ 0 ] ), read, read_len );
-            *entry = obj;
+            uint64_t size = p -> bases . elem_count * 2;
+            if ( size < used + read_len )
+                size = used + read_len;
+            if ( size > p -> max_bytes )
+                size = p -> max_bytes;
+            rc = KDataBufferResize( & p -> bases, size );
+        }
+        if ( rc == 0 )
+        {
+            rr_read * r = & p -> reads[ p -> read_count ++ ];
+            r -> align_id = p -> ids[ i ];
+            r -> offset = used;
+            r -> len = read_len;
+            memcpy( ( uint8_t * ) p -> bases . base + used, read, read_len );
+            used += read_len;
         }
     }
-    return res;
+    return rc;
 }
 
+static bool rr_part_find ( const rr_part * p, int64_t align_id, const INSDC_4na_bin ** read, uint32_t * read_len )
+{
+    uint32_t f = 0, e = p -> read_count;
+    while ( f < e )
+    {
+        uint32_t const m = f + ( ( e - f ) >> 1 );
+        const rr_read * r = & p -> reads[ m ];
+        if ( r -> align_id == align_id )
+        {
+            *read = ( const INSDC_4na_bin * ) p -> bases . base + r -> offset;
+            *read_len = r -> len;
+            return true;
+        }
+        if ( r -> align_id < align_id )
+            f = m + 1;
+        else
+            e = m;
+    }
+    return false;
+}
 
-/* --------------------------- rr_store --------------------------- */
 
-typedef struct rr_store
+/* --------------------------- rr_fetch_task --------------------------- */
+
+struct rr_fetch_task
 {
-    KVector * v;
-    int64_t first_seq_row_id;
-    int64_t last_seq_row_id;
-} rr_store;
+    KTask dad;
+    rr_part * part;
+    const VCursor * curs;
+    uint32_t read_idx;
+};
 
 
-static void rr_store_release ( rr_store * rr )
+static rc_t CC rr_fetch_task_whack ( rr_fetch_task * self )
 {
-    if ( rr != NULL )
-    {
-        KVectorVisitPtr( rr->v, false, rr_entry_release, NULL );        
-        KVectorRelease ( rr->v );
-        free( ( void * ) rr );
-    }
+    KTaskDestroy( & self -> dad, "rr_fetch_task" );
+    free( self );
+    return 0;
 }
 
-static rc_t rr_store_make ( rr_store ** rr )
+static rc_t CC rr_fetch_task_execute ( rr_fetch_task * self )
+{
+    return rr_part_fetch( self -> part, self -> curs, self -> read_idx );
+}
+
+static KTask_vt_v1 rr_fetch_task_vt =
+{
+    1, 0,
+    rr_fetch_task_whack,
+    rr_fetch_task_execute
+};
+
+static rc_t rr_fetch_task_submit ( KThreadPool * pool, rr_part * part, const VCursor * curs, uint32_t read_idx,
+    KTaskFuture ** future )
 {
     rc_t rc;
-    if ( rr == NULL )
-        rc = RC ( rcXF, rcFunction, rcConstructing, rcSelf, rcNull );
-    else
+    rr_fetch_task * t = malloc( sizeof * t );
+    if ( t == NULL )
+        return RC ( rcXF, rcFunction, rcExecuting, rcMemory, rcExhausted );
+
+    rc = KTaskInit( & t -> dad, ( const KTask_vt * ) & rr_fetch_task_vt, "rr_fetch_task", "" );
+    if ( rc != 0 )
     {
-        KVector * v;
-        *rr = NULL;
-        rc = KVectorMake ( &v );
-        if ( rc == 0 )
-        {
-            rr_store * obj = malloc ( sizeof * obj );
-            if ( obj == NULL )
-            {
-                KVectorRelease ( v );
-                rc = RC ( rcXF, rcFunction, rcConstructing, rcMemory, rcExhausted );
-            }
-            else
-            {
-                obj -> v = v;
-                *rr = obj;
-            }
-        }
+        free( t );
+        return rc;
     }
+    t -> part = part;
+    t -> curs = curs;
+    t -> read_idx = read_idx;
+
+    rc = KThreadPoolSubmit( pool, & t -> dad, future );
+    KTaskRelease( & t -> dad );
     return rc;
 }
 
 
-static bool rr_store_alignment( rr_store * rr, int64_t align_id, const VCursor * curs, uint32_t read_idx )
+/* --------------------------- rr_cache --------------------------- */
+
+/* the window covers the align-id's at [ first_elem, end_elem ) of the
+   blob ending at "blob_stop_id", starting with row "first_row_id" */
+typedef struct rr_cache
 {
-    bool res = false;
-    const INSDC_4na_bin * read = NULL;
-    uint32_t read_len;
-    rc_t rc = VCursorCellDataDirect( curs, align_id, read_idx, NULL, ( const void** ) &read, NULL, &read_len );
-    if ( rc == 0 )
-    {
-        rr_entry * entry;
-        res = rr_entry_make ( &entry, read, read_len );
-        if ( res )
-        {
-            uint64_t key = ( uint64_t ) align_id;
-            res = ( KVectorSetPtr ( rr -> v, key, entry ) == 0 );
-            if ( !res )
-                rr_entry_release( key, entry, NULL );
-        }
-    }
-    return res;
+    int64_t * ids;
+    uint32_t max_ids;
+    uint32_t part_count;
+    rr_part parts[ RR_MAX_PARTS ];
+
+    int64_t blob_stop_id;
+    int64_t first_row_id;
+    uint64_t first_elem;
+    uint64_t end_elem;
+} rr_cache;
+
+
+typedef struct rr_stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t fills;
+    uint64_t reads_fetched;
+    uint64_t bytes_fetched;
+} rr_stats;
+
+
+static void rr_cache_release ( rr_cache * c )
+{
+    uint32_t i;
+    for ( i = 0; i < RR_MAX_PARTS; i++ )
+        rr_part_release( & c -> parts[ i ] );
+    free( ( void * ) c -> ids );
+}
+
+static void rr_cache_clear ( rr_cache * c )
+{
+    c -> part_count = 0;
+    c -> first_elem = c -> end_elem = 0;
 }
 
+static bool rr_cache_covers ( const rr_cache * c, const VRowData * ids, int64_t row_id )
+{
+    return ( c -> part_count > 0 &&
+             ids -> blob_stop_id == c -> blob_stop_id &&
+             row_id >= c -> first_row_id &&
+             ids -> u . data . first_elem >= c -> first_elem &&
+             ids -> u . data . first_elem + ids -> u . data . elem_count <= c -> end_elem );
+}
 
-static bool rr_fill_cache( rr_store ** rr, const id_list * ids, const VCursor * curs, uint32_t read_idx,
-    int64_t row_id, int64_t last_row_id )
+static bool rr_cache_find ( const rr_cache * c, int64_t align_id, const INSDC_4na_bin ** read, uint32_t * read_len )
 {
-    bool res = ( rr_store_make ( rr ) == 0 );
-    if ( res )
+    uint32_t i;
+    for ( i = 0; i < c -> part_count; i++ )
     {
-        id_list sorted;
-        res = sort_align_ids( ids, &sorted );
-        if ( res )
+        const rr_part * p = & c -> parts[ i ];
+        if ( p -> read_count > 0 &&
+             align_id >= p -> reads[ 0 ] . align_id &&
+             align_id <= p -> reads[ p -> read_count - 1 ] . align_id )
         {
-            uint32_t i;
-            
-            rr_store * r = * rr;
-            for( i = 0; i < sorted . count; i++ )
-                rr_store_alignment( r, sorted . list[ i ], curs, read_idx );
-            free( ( void * ) sorted . list );
-            
-            r -> first_seq_row_id = row_id;
-            r -> last_seq_row_id = last_row_id;
+            return rr_part_find( p, align_id, read, read_len );
         }
     }
-    return res;
-}
-
-
-static bool rr_get_read ( rr_store * rr, int64_t align_id, rr_entry ** entry )
-{
-    uint64_t key = ( uint64_t ) align_id;
-    bool res = ( KVectorGetPtr ( rr -> v, key, ( void ** )entry ) == 0 );
-    if ( res && ( *entry == NULL ) ) res = false;
-    return res;
+    return false;
 }
 
 #endif
@@ -264,7 +339,13 @@ struct Read_Restorer
 
 #if READ_RESTORER_VERSION == 2
     uint32_t row_id_increments;     /* count how often we have an increment of the row_id */
-    rr_store * read_store;          /* if NULL we are not caching... */
+    rr_cache cache;                 /* if cache.part_count is 0 we are not caching... */
+    rr_stats stats;
+
+    /* private cursors for the parts fetched on the thread-pool */
+    const VCursor * worker_curs[ RR_MAX_PARTS ];
+    uint32_t worker_read_idx[ RR_MAX_PARTS ];
+    bool shared_columns;            /* cursors would share one KColumn */
 #endif
 };
 
@@ -274,10 +355,18 @@ void CC Read_Restorer_Whack ( void *obj )
     Read_Restorer * self = obj;
     if ( self != NULL )
     {
-        VCursorRelease ( self -> curs );
 #if READ_RESTORER_VERSION == 2
-        rr_store_release ( self -> read_store );
+        uint32_t i;
+
+        SUB_DEBUG( ( "SUB.Stats in 'seq-restore-read.c': hits=%lu misses=%lu fills=%lu reads=%lu bytes=%lu\n",
+                     self -> stats . hits, self -> stats . misses, self -> stats . fills,
+                     self -> stats . reads_fetched, self -> stats . bytes_fetched ) );
+
+        for ( i = 0; i < RR_MAX_PARTS; i++ )
+            VCursorRelease ( self -> worker_curs[ i ] );
+        rr_cache_release ( & self -> cache );
 #endif
+        VCursorRelease ( self -> curs );
         free ( self );
     }
 }
@@ -341,8 +430,11 @@ rc_t Read_Restorer_Make( Read_Restorer **objp, const VTable *tbl, const VCursor*
         if ( rc == 0 )
         {
 #if READ_RESTORER_VERSION == 2
-            /* - we have no cache to begin with ( obj->read_store is NULL because of memset above )
+            /* - we have no cache to begin with ( obj->cache.part_count is 0 because of memset above )
                - we make one if sequential access is detected */
+
+            /* the worker cursors may only run in parallel on columns of their own */
+            obj -> shared_columns = VTableSharesKColumns ( tbl );
 #endif
             if ( rc == 0 )
             {
@@ -379,49 +471,192 @@ static INSDC_4na_bin  map[]={
 #if READ_RESTORER_VERSION == 2
 
 
-/* caching strategy for READ_RESTORER_VERSION_2 */
-static void handle_caching( Read_Restorer * self, id_list * ids, int64_t row_id, int64_t last_row_id )
+static rc_t make_worker_cursor ( Read_Restorer * self, uint32_t idx )
 {
-    bool is_sequential = ( self -> read_store != NULL );
-    if ( is_sequential )
+    const VTable * tbl;
+    rc_t rc = VCursorOpenParentRead ( self -> curs, & tbl );
+    if ( rc == 0 )
     {
-        /* we are in sequential mode, because we have a cache,
-           check if we still are in sequential mode, decrement the age of the cache */
-        bool is_in_cache = ( ( row_id >= self -> read_store -> first_seq_row_id ) &&
-                             ( row_id <= self -> read_store -> last_seq_row_id ) );
-        if ( !is_in_cache )
+        const VCursor * curs;
+        rc = VTableCreateCachedCursorRead ( tbl, & curs, RR_WORKER_CURSOR_CACHE );
+        VTableRelease ( tbl );
+        if ( rc == 0 )
         {
-            is_sequential = ( row_id == self -> read_store -> last_seq_row_id + 1 );
-            
-            /* blow away the cache no matter if we are sequential or not */
-            rr_store_release ( self -> read_store );
-            self -> read_store = NULL;
-            self -> row_id_increments = 0;
-            
-            if ( is_sequential )
-            {
-                /* fill it again */
-                if ( !rr_fill_cache( & self -> read_store, ids, self -> curs, self -> read_idx, row_id, last_row_id ) )
-                    self -> read_store = NULL;
-            }
+            rc = VCursorAddColumn ( curs, & self -> worker_read_idx[ idx ], "( INSDC:4na:bin ) READ" );
+            if ( rc == 0 )
+                rc = VCursorOpen ( curs );
+            if ( rc == 0 )
+                self -> worker_curs[ idx ] = curs;
+            else
+                VCursorRelease ( curs );
         }
     }
+    return rc;
+}
+
+/* how many parts the sorted align-id's are fetched in */
+static uint32_t rr_part_count ( Read_Restorer * self, uint32_t id_count )
+{
+    uint32_t i, n = 1;
+    if ( id_count >= 2 * RR_PARALLEL_MIN_IDS && ! self -> shared_columns )
+    {
+        KThreadPool * pool;
+        if ( KThreadPoolGetDefault ( & pool ) == 0 )
+        {
+            n = KThreadPoolThreads ( pool );
+            KThreadPoolRelease ( pool );
+        }
+        if ( n > RR_MAX_PARTS )
+            n = RR_MAX_PARTS;
+        if ( n > id_count / RR_PARALLEL_MIN_IDS )
+            n = id_count / RR_PARALLEL_MIN_IDS;
+        for ( i = 1; i < n; i++ )
+        {
+            if ( self -> worker_curs[ i ] == NULL && make_worker_cursor ( self, i ) != 0 )
+                n = i;
+        }
+    }
+    return n;
+}
+
+static void rr_fetch_parts ( Read_Restorer * self )
+{
+    rr_cache * c = & self -> cache;
+    KTaskFuture * futures[ RR_MAX_PARTS ];
+    KThreadPool * pool = NULL;
+    uint32_t i;
+
+    memset ( futures, 0, sizeof futures );
+    if ( c -> part_count > 1 && KThreadPoolGetDefault ( & pool ) == 0 )
+    {
+        for ( i = 1; i < c -> part_count; i++ )
+        {
+            if ( rr_fetch_task_submit ( pool, & c -> parts[ i ], self -> worker_curs[ i ],
+                                        self -> worker_read_idx[ i ], & futures[ i ] ) != 0 )
+                futures[ i ] = NULL;
+        }
+        KThreadPoolRelease ( pool );
+    }
+
+    rr_part_fetch ( & c -> parts[ 0 ], self -> curs, self -> read_idx );
+
+    for ( i = 1; i < c -> part_count; i++ )
+    {
+        if ( futures[ i ] != NULL )
+        {
+            rc_t status;
+            if ( KTaskFutureWait ( futures[ i ], & status, NULL ) != 0 )
+                c -> parts[ i ] . read_count = 0;
+            KTaskFutureRelease ( futures[ i ] );
+        }
+        else
+        {
+            const VCursor * curs = self -> worker_curs[ i ];
+            rr_part_fetch ( & c -> parts[ i ], curs != NULL ? curs : self -> curs,
+                            curs != NULL ? self -> worker_read_idx[ i ] : self -> read_idx );
+        }
+    }
+}
+
+/* the window starts at the current row and extends to the end of the blob
+   of PRIM_ALIG_ID, or as far as the estimated reads fit into RR_CACHE_BYTES */
+static bool rr_fill_cache( Read_Restorer * self, const VRowData * ids, int64_t row_id )
+{
+    rr_cache * c = & self -> cache;
+    const int64_t * src = ids -> u . data . base;
+    uint64_t first_elem = ids -> u . data . first_elem;
+    uint64_t end_elem = ids -> u . data . base_elem_count;
+    uint64_t avg_len = RR_DEFAULT_READ_LEN;
+    uint64_t max_ids;
+    uint32_t i, count, part_count, per_part;
+    rc_t rc = 0;
+
+    if ( self -> stats . reads_fetched > 0 )
+        avg_len = self -> stats . bytes_fetched / self -> stats . reads_fetched + 1;
+    max_ids = RR_CACHE_BYTES / avg_len;
+    if ( max_ids < ids -> u . data . elem_count )
+        max_ids = ids -> u . data . elem_count;
+    if ( end_elem - first_elem > max_ids )
+        end_elem = first_elem + max_ids;
+
+    if ( end_elem - first_elem > c -> max_ids )
+    {
+        int64_t * list = realloc ( c -> ids, ( end_elem - first_elem ) * sizeof c -> ids[ 0 ] );
+        if ( list == NULL )
+            return false;
+        c -> ids = list;
+        c -> max_ids = ( uint32_t ) ( end_elem - first_elem );
+    }
+
+    /* filter out the zero id's, now we can sort */
+    for ( count = 0, i = 0; i < end_elem - first_elem; i++ )
+    {
+        if ( src[ first_elem + i ] > 0 )
+            c -> ids[ count ++ ] = src[ first_elem + i ];
+    }
+    if ( count > 0 )
+        ksort_int64_t( c -> ids, count );
+
+    part_count = rr_part_count ( self, count );
+    per_part = ( count + part_count - 1 ) / part_count;
+    for ( i = 0; i < part_count && rc == 0; i++ )
+    {
+        rr_part * p = & c -> parts[ i ];
+        uint32_t start = i * per_part;
+        p -> ids = c -> ids + start;
+        p -> id_count = ( start + per_part <= count ) ? per_part : count - start;
+        p -> read_count = 0;
+        p -> max_bytes = RR_CACHE_BYTES / part_count;
+        rc = rr_part_reserve ( p, p -> id_count );
+    }
+    if ( rc != 0 )
+        return false;
+
+    c -> part_count = part_count;
+    rr_fetch_parts ( self );
+
+    c -> blob_stop_id = ids -> blob_stop_id;
+    c -> first_row_id = row_id;
+    c -> first_elem = first_elem;
+    c -> end_elem = end_elem;
+
+    self -> stats . fills ++;
+    for ( i = 0; i < part_count; i++ )
+    {
+        const rr_part * p = & c -> parts[ i ];
+        if ( p -> read_count > 0 )
+        {
+            const rr_read * last = & p -> reads[ p -> read_count - 1 ];
+            self -> stats . reads_fetched += p -> read_count;
+            self -> stats . bytes_fetched += last -> offset + last -> len;
+        }
+    }
+    return true;
+}
+
+
+/* caching strategy for READ_RESTORER_VERSION_2 */
+static void handle_caching( Read_Restorer * self, const VRowData * ids, int64_t row_id )
+{
+    if ( row_id == ( self -> last_row_id + 1 ) )
+        self -> row_id_increments ++;
     else
+        self -> row_id_increments = 0;
+
+    if ( !rr_cache_covers ( & self -> cache, ids, row_id ) )
     {
-        /* we are not in sequential mode, because we do not have a cache
-           count how often we incremented the row-id by 1 to enter sequential mode */
-        if ( row_id == ( self -> last_row_id + 1 ) )
+        /* blow away the cache no matter if we are sequential or not */
+        rr_cache_clear ( & self -> cache );
+
+        /* fill it again, if we have been sequential long enough */
+        if ( self -> row_id_increments > ROW_ID_INC_COUNT )
         {
-            self -> row_id_increments ++;
-            is_sequential = ( self -> row_id_increments > ROW_ID_INC_COUNT );
-            if ( is_sequential )
+            if ( !rr_fill_cache( self, ids, row_id ) )
             {
-                if ( !rr_fill_cache( & self -> read_store, ids, self -> curs, self -> read_idx, row_id, last_row_id ) )
-                    self -> row_id_increments = 0;
+                rr_cache_clear ( & self -> cache );
+                self -> row_id_increments = 0;
             }
         }
-        else
-            self -> row_id_increments = 0;
     }
 
     self -> last_row_id = row_id;
@@ -433,12 +668,12 @@ static void handle_caching( Read_Restorer * self, id_list * ids, int64_t row_id,
     ( 1 ) - keep track of are we in sequential mode, is row_id continoulsy increasing?
           - if not trow away the cache
           
-    ( 2 ) - when entering sequential mode, create the cache, fill it with k/v-pairs
-            key ... alignment-id
-            value.. READ
+    ( 2 ) - when entering sequential mode, fill the cache with the READ's of a window
+            of the align-id's, fetched in sorted order, in parallel if the window is large,
+            and capped at RR_CACHE_BYTES
             
     ( 3 ) - if in sequential mode, keep track of the row_id beeing in the cache-window
-            if end of window reached: throw away the cache
+            if end of window reached: throw away the cache and fill it again
 
 -------------------------------------------------------------------------------------- */
 
@@ -456,17 +691,13 @@ static rc_t CC seq_restore_read_impl2 ( void *data, const VXformInfo *info, int6
     Read_Restorer   *self = data;
     INSDC_4na_bin   *dst;
     INSDC_coord_len len;
-    id_list align_ids;
+    const int64_t * align_ids        = argv[ 1 ] . u . data . base;
     uint32_t i; 
     uint32_t src_len                 = (uint32_t)argv[ 0 ] . u . data . elem_count;
     const INSDC_4na_bin * src        = argv[ 0 ] . u . data.base;
     const uint32_t num_reads         = (uint32_t)argv[ 1 ]. u . data . elem_count;
     const INSDC_coord_len * read_len = argv[ 2 ] . u . data.base;
     const uint8_t *read_type         = argv[ 3 ] . u . data.base;
-    int64_t last_row_id              = argv[ 1 ] . blob_stop_id;
-    
-    align_ids.list  = ( int64_t * )argv[ 1 ].u.data.base;
-    align_ids.count = ( uint32_t )( argv[ 1 ].u.data.base_elem_count - argv[ 1 ].u.data.first_elem );
     
     assert( argv[ 0 ].u.data.elem_bits == 8 );
     assert( argv[ 1 ].u.data.elem_bits == 64 );
@@ -475,11 +706,11 @@ static rc_t CC seq_restore_read_impl2 ( void *data, const VXformInfo *info, int6
     assert( argv[ 3 ].u.data.elem_count == num_reads );
     
     src   += argv [ 0 ] . u . data . first_elem;
-    align_ids.list += argv [ 1 ] . u . data . first_elem;
+    align_ids += argv [ 1 ] . u . data . first_elem;
     read_len  += argv [ 2 ] . u . data . first_elem;
     read_type += argv [ 3 ] . u . data . first_elem;
 
-    handle_caching( self, &align_ids, row_id, last_row_id );
+    handle_caching( self, &argv[ 1 ], row_id );
 
     for ( i = 0, len = 0; i < num_reads; i++ )
         len += read_len[ i ];
@@ -496,28 +727,25 @@ static rc_t CC seq_restore_read_impl2 ( void *data, const VXformInfo *info, int6
             memcpy( dst, src, len );
         else
         {
-            rr_entry * ep;
             const INSDC_4na_bin * rd;
             uint32_t rd_len;
             bool found_in_cache;
             
             for ( i = 0; i < num_reads && rc == 0; i++ ) /*** checking read by read ***/
             {
-                int64_t align_id = align_ids.list[ i ];
+                int64_t align_id = align_ids[ i ];
                 if ( align_id > 0 )
                 {
-                    found_in_cache = false;
-                    if ( self -> read_store != NULL )
-                        found_in_cache = rr_get_read ( self -> read_store, align_id, &ep );
+                    found_in_cache = rr_cache_find ( & self -> cache, align_id, &rd, &rd_len );
                     if ( found_in_cache )
                     {
                         /* we found it in the cache... */
-                        rd = &( ep->read[ 0 ] );
-                        rd_len = ep->read_len;
+                        self -> stats . hits ++;
                     }
                     else
                     {
                         /* we did not find it in the cache, get it from the alignment-table... */
+                        self -> stats . misses ++;
                         rc = VCursorCellDataDirect( self -> curs, align_id, self -> read_idx,
                                                     NULL, ( const void** ) &rd, NULL, &rd_len );
                     }
@@ -31,8 +31,10 @@
 #include "table-priv.h"
 #include "kdb-priv.h"
 #include <kdb/kdb-priv.h>
+#include <kfs/impl.h>
 #include <klib/checksum.h>
 #include <klib/data-buffer.h>
+#include <klib/sort.h>
 #include <klib/rc.h>
 #include <klib/printf.h>
 #include <klib/debug.h>
@@ -961,7 +963,7 @@ LIB_EXPORT rc_t CC KColumnBlobRead ( const KColumnBlob *self,
                 {
                     size_t nread = 0;
 
-                    rc = KColumnDataRead ( & col -> df, & self -> pmorig, offset - *num_read,
+                    rc = KColumnDataRead ( & col -> df, & self -> pmorig, offset + *num_read,
                         & ( ( char * ) buffer ) [ * num_read ], to_read - * num_read, & nread );
                     if ( rc != 0 )
                         break;
@@ -1106,6 +1108,173 @@ LIB_EXPORT rc_t CC KColumnBlobReadAll ( const KColumnBlob * self, KDataBuffer *
     return rc;
 }
 
+/* ReadAllV
+ *  read entire blobs in one batch
+ */
+typedef struct KColumnBlobReadReq KColumnBlobReadReq;
+struct KColumnBlobReadReq
+{
+    const KFile *f;
+    uint64_t pos;
+    size_t cs_bytes;
+    uint32_t idx;
+};
+
+static
+int64_t CC KColumnBlobReadReqCmp ( const void *a, const void *b, void *ignore )
+{
+    const KColumnBlobReadReq *ra = a;
+    const KColumnBlobReadReq *rb = b;
+
+    if ( ra -> f != rb -> f )
+        return ( size_t ) ra -> f < ( size_t ) rb -> f ? -1 : 1;
+    if ( ra -> pos != rb -> pos )
+        return ra -> pos < rb -> pos ? -1 : 1;
+    return 0;
+}
+
+static
+rc_t KColumnBlobReadReqInit ( KColumnBlobReadReq *req, const KColumnBlob *self,
+    KDataBuffer *buffer, size_t cs_bytes )
+{
+    uint64_t offset;
+    const KColumn *col = self -> col;
+    const struct KSysFile *sys;
+
+    /* checksum data follows the blob, so both come in one read */
+    rc_t rc = KDataBufferMakeBytes ( buffer, self -> loc . u . blob . size + cs_bytes );
+    if ( rc != 0 )
+        return rc;
+
+    req -> f = col -> df . f;
+    req -> pos = self -> pmorig . pg * col -> df . pgsize;
+    req -> cs_bytes = cs_bytes;
+
+    /* columns inside of an archive on local disk are read from the
+       archive file itself, so that reads across columns can merge */
+    sys = KFileGetSysFile ( req -> f, & offset );
+    if ( sys != NULL )
+    {
+        req -> f = ( const KFile* ) sys;
+        req -> pos += offset;
+    }
+
+    return 0;
+}
+
+LIB_EXPORT rc_t CC KColumnBlobReadAllV ( const KColumnBlob * const * blobs, uint32_t count,
+    KDataBuffer * buffers, KColumnBlobCSData * opt_cs_data, size_t cs_data_size )
+{
+    rc_t rc = 0;
+    uint32_t i, j, total;
+    KColumnBlobReadReq *req;
+    KFileIOVec *vec;
+
+    if ( count == 0 )
+        return 0;
+
+    if ( buffers == NULL )
+        return RC ( rcDB, rcBlob, rcReading, rcParam, rcNull );
+
+    memset ( buffers, 0, count * sizeof * buffers );
+    if ( opt_cs_data != NULL )
+        memset ( opt_cs_data, 0, count * sizeof * opt_cs_data );
+
+    if ( blobs == NULL )
+        return RC ( rcDB, rcBlob, rcReading, rcParam, rcNull );
+
+    req = malloc ( count * ( sizeof * req + sizeof * vec ) );
+    if ( req == NULL )
+        return RC ( rcDB, rcBlob, rcReading, rcMemory, rcExhausted );
+    vec = ( KFileIOVec* ) & req [ count ];
+
+    for ( i = total = 0; rc == 0 && i < count; ++ i )
+    {
+        const KColumnBlob *self = blobs [ i ];
+        if ( self == NULL )
+            rc = RC ( rcDB, rcBlob, rcReading, rcSelf, rcNull );
+
+        /* ignore blobs of size 0 */
+        else if ( self -> loc . u . blob . size != 0 )
+        {
+            size_t cs_bytes = 0;
+            if ( opt_cs_data != NULL )
+            {
+                switch ( self -> col -> checksum )
+                {
+                case kcsNone:
+                    break;
+                case kcsCRC32:
+                    cs_bytes = 4;
+                    break;
+                case kcsMD5:
+                    cs_bytes = 16;
+                    break;
+                }
+
+                if ( cs_data_size < cs_bytes )
+                {
+                    rc = RC ( rcDB, rcBlob, rcReading, rcParam, rcTooShort );
+                    break;
+                }
+            }
+
+            rc = KColumnBlobReadReqInit ( & req [ total ], self, & buffers [ i ], cs_bytes );
+            if ( rc == 0 )
+                req [ total ++ ] . idx = i;
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        /* group requests by file */
+        ksort ( req, total, sizeof * req, KColumnBlobReadReqCmp, NULL );
+
+        for ( i = 0; i < total; ++ i )
+        {
+            KDataBuffer *buffer = & buffers [ req [ i ] . idx ];
+            vec [ i ] . pos = req [ i ] . pos;
+            vec [ i ] . buffer = buffer -> base;
+            vec [ i ] . bsize = ( size_t ) KDataBufferBytes ( buffer );
+        }
+
+        for ( i = 0; rc == 0 && i < total; i = j )
+        {
+            j = i + 1;
+            while ( j < total && req [ j ] . f == req [ i ] . f )
+                ++ j;
+
+            rc = KFileReadV ( req [ i ] . f, & vec [ i ], j - i );
+        }
+
+        for ( i = 0; rc == 0 && i < total; ++ i )
+        {
+            KDataBuffer *buffer = & buffers [ req [ i ] . idx ];
+            size_t bsize = vec [ i ] . bsize - req [ i ] . cs_bytes;
+
+            if ( vec [ i ] . num_read != vec [ i ] . bsize )
+                rc = RC ( rcDB, rcBlob, rcReading, rcTransfer, rcIncomplete );
+            else if ( req [ i ] . cs_bytes != 0 )
+            {
+                memcpy ( & opt_cs_data [ req [ i ] . idx ],
+                    & ( ( const uint8_t* ) buffer -> base ) [ bsize ], req [ i ] . cs_bytes );
+                rc = KDataBufferResize ( buffer, bsize );
+            }
+        }
+    }
+
+    free ( req );
+
+    if ( rc != 0 )
+    {
+        for ( i = 0; i < count; ++ i )
+            KDataBufferWhack ( & buffers [ i ] );
+        memset ( buffers, 0, count * sizeof * buffers );
+    }
+
+    return rc;
+}
+
 
 /* GetDirectory
  */
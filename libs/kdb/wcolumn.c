@@ -2255,7 +2255,7 @@ LIB_EXPORT rc_t CC KColumnBlobRead ( const KColumnBlob *self,
                 while (*num_read < to_read) {
                     size_t nread = 0;
 
-                    rc = KColumnDataRead ( & col -> df, pm, offset - *num_read, (void *)((char *)buffer + *num_read), to_read - *num_read, &nread );
+                    rc = KColumnDataRead ( & col -> df, pm, offset + *num_read, (void *)((char *)buffer + *num_read), to_read - *num_read, &nread );
                     if (rc) break;
                     if (nread == 0) {
                         rc = RC ( rcDB, rcBlob, rcReading, rcFile, rcInsufficient );
@@ -2389,6 +2389,47 @@ LIB_EXPORT rc_t CC KColumnBlobReadAll ( const KColumnBlob * self, KDataBuffer *
     return rc;
 }
 
+/* ReadAllV
+ *  read entire blobs in one batch
+ *
+ *  blobs on an update cursor may be partly written and have no
+ *  single location in the data fork, so they are simply read in turn
+ */
+LIB_EXPORT rc_t CC KColumnBlobReadAllV ( const KColumnBlob * const * blobs, uint32_t count,
+    KDataBuffer * buffers, KColumnBlobCSData * opt_cs_data, size_t cs_data_size )
+{
+    rc_t rc = 0;
+    uint32_t i;
+
+    if ( count == 0 )
+        return 0;
+
+    if ( buffers == NULL )
+        return RC ( rcDB, rcBlob, rcReading, rcParam, rcNull );
+
+    memset ( buffers, 0, count * sizeof * buffers );
+    if ( opt_cs_data != NULL )
+        memset ( opt_cs_data, 0, count * sizeof * opt_cs_data );
+
+    if ( blobs == NULL )
+        return RC ( rcDB, rcBlob, rcReading, rcParam, rcNull );
+
+    for ( i = 0; rc == 0 && i < count; ++ i )
+    {
+        rc = KColumnBlobReadAll ( blobs [ i ], & buffers [ i ],
+            opt_cs_data == NULL ? NULL : & opt_cs_data [ i ], cs_data_size );
+    }
+
+    if ( rc != 0 )
+    {
+        for ( i = 0; i < count; ++ i )
+            KDataBufferWhack ( & buffers [ i ] );
+        memset ( buffers, 0, count * sizeof * buffers );
+    }
+
+    return rc;
+}
+
 /* KColumnBlobAppend
  *  append data to open blob
  *
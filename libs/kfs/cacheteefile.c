@@ -41,6 +41,7 @@ struct KCacheTeeFile;
 #include <kfs/cacheteefile.h>
 #include <kfs/defs.h>
 #include <kproc/queue.h>
+#include <kproc/thread.h>
 #include <atomic32.h>
 
 #include <sysalloc.h>
@@ -208,6 +209,12 @@ typedef struct KCacheTeeFile
     CacheStatistic stat;                    /* optional cache statistic */
 #endif
 
+    KThread * filler;                        /* optional background fill, see KCacheTeeFileStartFill() */
+    KCacheTeeRange * fill_ranges;            /* NULL means the whole file */
+    uint32_t fill_range_count;
+    uint64_t fill_rate;                        /* bytes per second, 0 for no limit */
+    atomic32_t fill_quit;
+
     bool local_read_only;
     char local_path [ 1 ];                    /* stores the path to the local cache, for eventual promoting at close */
 } KCacheTeeFile;
@@ -762,13 +769,24 @@ static rc_t promote_cache( KCacheTeeFile * self )
 
 /* Destroy
  */
+static rc_t stop_filler( KCacheTeeFile * self );
+
 static rc_t CC KCacheTeeFileDestroy( KCacheTeeFile * self )
 {
 #if USE_BUFFER_POOL
     rc_t rc;
     void * pool_page;
 #endif
-    bool already_promoted_by_other_instance = file_exist( self -> dir, self -> local_path );
+    bool already_promoted_by_other_instance;
+
+    /* the filler uses the bitmap and the files, it has to go first */
+    if ( self -> filler != NULL )
+    {
+        atomic32_set( & self -> fill_quit, 1 );
+        stop_filler( self );
+    }
+
+    already_promoted_by_other_instance = file_exist( self -> dir, self -> local_path );
     
 #if( CACHE_STAT > 0 )
     report_cache_stat( & self -> stat );
@@ -857,7 +875,21 @@ static rc_t write_bitmap( const KCacheTeeFile *cself, uint64_t block )
     if (bitmap_pos + to_write > cself->bitmap_bytes)
         to_write = cself->bitmap_bytes - bitmap_pos;
 
-    rc = KFileWriteAll( cself->local, pos, ( const void * ) &cself->bitmap[ block_word ], to_write, &written );
+    /* a reader and the filler may write the same word at once, and the older
+       snapshot may land last. bits are only ever set, so writing again until
+       the word did not change while writing leaves the newest one on disk */
+    {
+        uint32_t word = atomic32_read ( & cself -> bitmap [ block_word ] );
+        do
+        {
+            uint32_t snapshot = word;
+            rc = KFileWriteAll( cself->local, pos, ( const void * ) &snapshot, to_write, &written );
+            word = atomic32_read ( & cself -> bitmap [ block_word ] );
+            if ( word == snapshot )
+                break;
+        }
+        while ( rc == 0 );
+    }
 #else
     uint32_t block_byte = ( uint32_t ) ( block >> 3 );
     pos = cself->remote_size + block_byte;
@@ -1081,6 +1113,158 @@ static rc_t KCacheTeeFileRead_simple2( const KCacheTeeFile *cself, uint64_t pos,
     return rc;
 }
 
+/**********************************************************************************************
+    background fill
+**********************************************************************************************/
+
+/* the filler reads this much from remote at a time */
+#define FILL_RUN_BYTES ( 1024 * 1024 )
+/* and never sleeps longer than this before checking whether to quit */
+#define FILL_MAX_SLEEP_MS 100
+
+/* copies "count" blocks from remote into the local file, starting at "block",
+   then marks them in the bitmap. blocks the foreground read fetched in the
+   meantime are simply copied again. */
+static rc_t fill_blocks( const KCacheTeeFile *cself, uint64_t block, uint64_t count,
+                         uint8_t * buffer, size_t * fetched )
+{
+    uint64_t pos = block * cself->block_size;
+    size_t nread = 0;
+    rc_t rc = rd_remote_wr_local( cself, pos,
+        buffer, check_rd_len( cself, pos, ( size_t ) ( count * cself->block_size ) ), &nread );
+
+    *fetched = nread;
+    if ( rc == 0 )
+    {
+        uint64_t end = ( pos + nread == cself->remote_size ) ?
+            cself->block_count : block + nread / cself->block_size;
+        uint64_t b;
+        for ( b = block; b < end; ++b )
+            set_bitmap( cself, b, 1 );
+        /* one write per bitmap word touched */
+        for ( b = block; rc == 0 && b < end; ++b )
+        {
+#if USE_32BIT_BITMAP_WORDS
+            if ( b + 1 == end || ( ( b + 1 ) & 31 ) == 0 )
+#else
+            if ( b + 1 == end || ( ( b + 1 ) & 7 ) == 0 )
+#endif
+                rc = write_bitmap( cself, b );
+        }
+    }
+    return rc;
+}
+
+
+static rc_t fill_range( KCacheTeeFile * self, uint64_t pos, uint64_t size,
+                        uint8_t * buffer, uint64_t run_blocks,
+                        uint32_t start_ms, uint64_t * total )
+{
+    rc_t rc = 0;
+    uint64_t block, end;
+
+    if ( pos >= self -> remote_size )
+        return 0;
+    if ( size > self -> remote_size - pos )
+        size = self -> remote_size - pos;
+
+    block = pos / self -> block_size;
+    end = ( pos + size + self -> block_size - 1 ) / self -> block_size;
+
+    while ( rc == 0 && block < end && atomic32_read( & self -> fill_quit ) == 0 )
+    {
+        uint64_t count;
+        size_t fetched;
+
+        if ( IS_CACHE_BIT( self, block ) )
+        {
+            ++block;
+            continue;
+        }
+
+        for ( count = 1; count < run_blocks && block + count < end; ++count )
+        {
+            if ( IS_CACHE_BIT( self, block + count ) )
+                break;
+        }
+
+        rc = fill_blocks( self, block, count, buffer, &fetched );
+        block += count;
+        * total += fetched;
+
+        /* stay below the bandwidth limit by sleeping until the bytes
+           fetched so far are due */
+        if ( rc == 0 && self -> fill_rate != 0 )
+        {
+            uint64_t due_ms = ( * total * 1000 ) / self -> fill_rate;
+            while ( atomic32_read( & self -> fill_quit ) == 0 )
+            {
+                uint64_t elapsed_ms = ( uint32_t ) ( KTimeMsStamp () - start_ms );
+                if ( elapsed_ms >= due_ms )
+                    break;
+                KSleepMs ( due_ms - elapsed_ms < FILL_MAX_SLEEP_MS ?
+                           ( uint32_t ) ( due_ms - elapsed_ms ) : FILL_MAX_SLEEP_MS );
+            }
+        }
+    }
+    return rc;
+}
+
+
+static rc_t CC KCacheTeeFileFillThread( const KThread * t, void * data )
+{
+    KCacheTeeFile * self = data;
+    uint64_t run_blocks = FILL_RUN_BYTES / self -> block_size;
+    uint8_t * buffer;
+    rc_t rc = 0;
+
+    if ( run_blocks == 0 )
+        run_blocks = 1;
+
+    buffer = malloc ( run_blocks * self -> block_size );
+    if ( buffer == NULL )
+        rc = RC ( rcFS, rcFile, rcReading, rcMemory, rcExhausted );
+    else
+    {
+        uint32_t start_ms = ( uint32_t ) KTimeMsStamp ();
+        uint64_t total = 0;
+
+        if ( self -> fill_ranges == NULL )
+            rc = fill_range( self, 0, self -> remote_size, buffer, run_blocks, start_ms, &total );
+        else
+        {
+            uint32_t i;
+            for ( i = 0; rc == 0 && i < self -> fill_range_count; ++i )
+            {
+                rc = fill_range( self, self -> fill_ranges [ i ] . pos, self -> fill_ranges [ i ] . size,
+                                 buffer, run_blocks, start_ms, &total );
+            }
+        }
+        free ( buffer );
+    }
+
+    if ( rc != 0 && atomic32_read( & self -> fill_quit ) == 0 )
+        LOGERR( klogWarn, rc, "background fill of cache-file stopped" );
+
+    return rc;
+}
+
+
+static rc_t stop_filler( KCacheTeeFile * self )
+{
+    rc_t status = 0;
+    rc_t rc = KThreadWait ( self -> filler, &status );
+    KThreadRelease ( self -> filler );
+    self -> filler = NULL;
+
+    free ( self -> fill_ranges );
+    self -> fill_ranges = NULL;
+    self -> fill_range_count = 0;
+
+    return rc != 0 ? rc : status;
+}
+
+
 #if 0
 /**********************************************************************************************
     try #3
@@ -1335,6 +1519,11 @@ static rc_t make_cache_tee( struct KDirectory *self, struct KFile const **tee,
         cf -> valid_scratch_bytes = 0;
 #endif
         cf -> local_read_only = read_only;
+        cf -> filler = NULL;
+        cf -> fill_ranges = NULL;
+        cf -> fill_range_count = 0;
+        cf -> fill_rate = 0;
+        atomic32_set( & cf -> fill_quit, 0 );
 
 #if( CACHE_STAT > 0 )
         init_cache_stat( & cf -> stat );
@@ -1831,3 +2020,72 @@ LIB_EXPORT bool CC KFileIsKCacheTeeFile( const struct KFile * self )
 {
     return self != NULL && &self->vt->v1 == &vtKCacheTeeFile;
 }
+
+
+/* -----
+ * starts and waits for the background fill
+ */
+LIB_EXPORT rc_t CC KCacheTeeFileStartFill( const struct KFile * self,
+    const KCacheTeeRange * ranges, uint32_t range_count, uint64_t bytes_per_sec )
+{
+    rc_t rc = 0;
+    if ( self == NULL )
+        rc = RC ( rcFS, rcFile, rcCreating, rcSelf, rcNull );
+    else if ( ranges == NULL && range_count != 0 )
+        rc = RC ( rcFS, rcFile, rcCreating, rcParam, rcNull );
+    else if ( &self->vt->v1 != &vtKCacheTeeFile )
+        rc = RC ( rcFS, rcFile, rcCreating, rcSelf, rcInvalid );
+    else
+    {
+        struct KCacheTeeFile * ctf = ( struct KCacheTeeFile * )self;
+        if ( ctf -> local_read_only )
+            rc = RC ( rcFS, rcFile, rcCreating, rcFile, rcReadonly );
+        else if ( ctf -> filler != NULL )
+            rc = RC ( rcFS, rcFile, rcCreating, rcThread, rcBusy );
+        else
+        {
+            if ( ranges != NULL )
+            {
+                ctf -> fill_ranges = malloc ( sizeof * ranges * ( range_count > 0 ? range_count : 1 ) );
+                if ( ctf -> fill_ranges == NULL )
+                    rc = RC ( rcFS, rcFile, rcCreating, rcMemory, rcExhausted );
+                else
+                {
+                    memmove ( ctf -> fill_ranges, ranges, sizeof * ranges * range_count );
+                    ctf -> fill_range_count = range_count;
+                }
+            }
+            if ( rc == 0 )
+            {
+                ctf -> fill_rate = bytes_per_sec;
+                atomic32_set( & ctf -> fill_quit, 0 );
+                rc = KThreadMake ( & ctf -> filler, KCacheTeeFileFillThread, ctf );
+                if ( rc != 0 )
+                    ctf -> filler = NULL;
+            }
+            if ( rc != 0 )
+            {
+                free ( ctf -> fill_ranges );
+                ctf -> fill_ranges = NULL;
+                ctf -> fill_range_count = 0;
+            }
+        }
+    }
+    return rc;
+}
+
+LIB_EXPORT rc_t CC KCacheTeeFileWaitFill( const struct KFile * self )
+{
+    rc_t rc = 0;
+    if ( self == NULL )
+        rc = RC ( rcFS, rcFile, rcWaiting, rcSelf, rcNull );
+    else if ( &self->vt->v1 != &vtKCacheTeeFile )
+        rc = RC ( rcFS, rcFile, rcWaiting, rcSelf, rcInvalid );
+    else
+    {
+        struct KCacheTeeFile * ctf = ( struct KCacheTeeFile * )self;
+        if ( ctf -> filler != NULL )
+            rc = stop_filler( ctf );
+    }
+    return rc;
+}
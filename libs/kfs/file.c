@@ -27,11 +27,13 @@
 #include <kfs/extern.h>
 #include <kfs/impl.h>
 #include <klib/rc.h>
+#include <klib/sort.h>
 #include <kproc/timeout.h>
 #include <os-native.h>
 #include <sysalloc.h>
 
 #include <assert.h>
+#include <string.h>
 
 /*--------------------------------------------------------------------------
  * KFile
@@ -574,6 +576,141 @@ LIB_EXPORT rc_t CC KFileTimedReadExactly_v1 ( const KFile_v1 *self,
     return rc;
 }
 
+/* ReadV
+ *  read a number of ranges in a single call
+ *
+ *  requests separated by no more than KFILE_READV_GAP bytes are merged
+ *  into a single read of at most KFILE_READV_MAX bytes. the gap is cheap
+ *  to read compared with the cost of another request to a remote file.
+ */
+#define KFILE_READV_GAP ( 32 * 1024 )
+#define KFILE_READV_MAX ( 4 * 1024 * 1024 )
+#define KFILE_READV_STACK 16
+
+static
+int64_t CC KFileIOVecCmp ( const void *a, const void *b, void *ignore )
+{
+    const KFileIOVec_v1 *va = * ( const KFileIOVec_v1* const* ) a;
+    const KFileIOVec_v1 *vb = * ( const KFileIOVec_v1* const* ) b;
+
+    if ( va -> pos != vb -> pos )
+        return va -> pos < vb -> pos ? -1 : 1;
+    if ( va -> bsize != vb -> bsize )
+        return va -> bsize < vb -> bsize ? -1 : 1;
+    return 0;
+}
+
+static
+rc_t KFileReadVMerged ( const KFile_v1 *self, KFileIOVec_v1 **order,
+    uint32_t count, uint64_t start, uint64_t end )
+{
+    rc_t rc;
+    size_t num_read;
+    uint8_t *scratch = malloc ( ( size_t ) ( end - start ) );
+    if ( scratch == NULL )
+        return RC ( rcFS, rcFile, rcReading, rcMemory, rcExhausted );
+
+    rc = KFileReadAll_v1 ( self, start, scratch, ( size_t ) ( end - start ), & num_read );
+    if ( rc == 0 )
+    {
+        uint32_t i;
+        for ( i = 0; i < count; ++ i )
+        {
+            KFileIOVec_v1 *v = order [ i ];
+            size_t offset = ( size_t ) ( v -> pos - start );
+
+            v -> num_read = 0;
+            if ( offset < num_read )
+            {
+                v -> num_read = num_read - offset;
+                if ( v -> num_read > v -> bsize )
+                    v -> num_read = v -> bsize;
+                memcpy ( v -> buffer, & scratch [ offset ], v -> num_read );
+            }
+        }
+    }
+
+    free ( scratch );
+    return rc;
+}
+
+LIB_EXPORT rc_t CC KFileReadV_v1 ( const KFile_v1 *self,
+    KFileIOVec_v1 *vec, uint32_t count )
+{
+    rc_t rc = 0;
+    uint32_t i, j, total;
+    KFileIOVec_v1 *stack_order [ KFILE_READV_STACK ], **order = stack_order;
+
+    if ( vec == NULL )
+        return count == 0 ? 0 : RC ( rcFS, rcFile, rcReading, rcParam, rcNull );
+
+    for ( i = 0; i < count; ++ i )
+    {
+        vec [ i ] . num_read = 0;
+        if ( vec [ i ] . buffer == NULL && vec [ i ] . bsize != 0 )
+            return RC ( rcFS, rcFile, rcReading, rcBuffer, rcNull );
+    }
+
+    if ( self == NULL )
+        return RC ( rcFS, rcFile, rcReading, rcSelf, rcNull );
+
+    if ( ! self -> read_enabled )
+        return RC ( rcFS, rcFile, rcReading, rcFile, rcNoPerm );
+
+    if ( count > KFILE_READV_STACK )
+    {
+        order = malloc ( count * sizeof * order );
+        if ( order == NULL )
+            return RC ( rcFS, rcFile, rcReading, rcMemory, rcExhausted );
+    }
+
+    /* empty requests are already satisfied */
+    for ( i = total = 0; i < count; ++ i )
+    {
+        if ( vec [ i ] . bsize != 0 )
+            order [ total ++ ] = & vec [ i ];
+    }
+
+    ksort ( order, total, sizeof * order, KFileIOVecCmp, NULL );
+
+    for ( i = 0; rc == 0 && i < total; i = j )
+    {
+        uint64_t start = order [ i ] -> pos;
+        uint64_t end = start + order [ i ] -> bsize;
+
+        /* extend run while the next request is close enough */
+        for ( j = i + 1; j < total; ++ j )
+        {
+            uint64_t pos = order [ j ] -> pos;
+            uint64_t stop = pos + order [ j ] -> bsize;
+
+            if ( pos > end + KFILE_READV_GAP )
+                break;
+            if ( stop > end )
+            {
+                if ( stop - start > KFILE_READV_MAX )
+                    break;
+                end = stop;
+            }
+        }
+
+        if ( j == i + 1 )
+        {
+            KFileIOVec_v1 *v = order [ i ];
+            rc = KFileReadAll_v1 ( self, v -> pos, v -> buffer, v -> bsize, & v -> num_read );
+        }
+        else
+        {
+            rc = KFileReadVMerged ( self, & order [ i ], j - i, start, end );
+        }
+    }
+
+    if ( order != stack_order )
+        free ( order );
+
+    return rc;
+}
+
 /* Write
  *  write file at known position
  *
@@ -939,6 +1076,13 @@ LIB_EXPORT rc_t CC KFileTimedReadExactly ( const KFile_v1 *self,
     return KFileTimedReadExactly_v1 ( self, pos, buffer, bytes, tm );
 }
 
+#undef KFileReadV
+LIB_EXPORT rc_t CC KFileReadV ( const KFile_v1 *self,
+    KFileIOVec_v1 *vec, uint32_t count )
+{
+    return KFileReadV_v1 ( self, vec, count );
+}
+
 #undef KFileWrite
 LIB_EXPORT rc_t CC KFileWrite ( KFile_v1 *self, uint64_t pos,
     const void *buffer, size_t size, size_t *num_writ )
@@ -28,6 +28,7 @@
 #include <klib/data-buffer.h>
 #include <klib/rc.h>
 #include <atomic32.h>
+#include <atomic.h>
 #include <bitstr.h>
 #include <sysalloc.h>
 
@@ -115,9 +116,157 @@ static size_t roundup(size_t value, unsigned bits)
     return (value + mask) & (~mask);
 }
 
+/*--------------------------------------------------------------------------
+ * recycled storage
+ *  buffers of up to 512K are allocated in size classes of 4K, 6K, 8K, 12K ...
+ *  and returned to a free list per class when released, so that the churn
+ *  of blob-sized buffers on the read path does not go through malloc and free
+ *
+ *  the free lists are split into RECYCLE_SHARDS shards, each list holding
+ *  up to RECYCLE_SHARD_BYTES, or a single buffer of a larger class.
+ *  a thread starts at the shard picked by its stack address and never
+ *  waits for a list: one that is busy is skipped for the next shard.
+ */
+#define RECYCLE_CLASSES 15
+#define RECYCLE_MIN_BYTES 4096
+#define RECYCLE_MAX_BYTES ( 512 * 1024 )
+#define RECYCLE_SHARDS 8
+#define RECYCLE_SHARD_BYTES ( 64 * 1024 )
+
+typedef struct recycle_list_t recycle_list_t;
+struct recycle_list_t {
+    atomic32_t lock;
+    uint32_t count;
+    void *head;
+};
+
+typedef struct recycle_shard_t recycle_shard_t;
+struct recycle_shard_t {
+    recycle_list_t list [ RECYCLE_CLASSES ];
+    /* buffers taken from malloc, of any size, and from the lists */
+    atomic_t allocs;
+    atomic_t reuses;
+};
+
+static recycle_shard_t recycle_shard [ RECYCLE_SHARDS ];
+
+static size_t recycle_class_size(unsigned idx)
+{
+    return ((idx & 1) == 0 ? RECYCLE_MIN_BYTES : RECYCLE_MIN_BYTES / 2 * 3) << (idx / 2);
+}
+
+/* smallest class holding "capacity", RECYCLE_CLASSES if none */
+static unsigned recycle_class_of(size_t capacity)
+{
+    unsigned idx;
+    if (capacity == 0 || capacity > RECYCLE_MAX_BYTES)
+        return RECYCLE_CLASSES;
+    for (idx = 0; recycle_class_size(idx) < capacity; ++idx)
+        (void)0;
+    return idx;
+}
+
+/* threads run on stacks far apart, so the address of a local
+   tells them apart without thread-local storage */
+static unsigned recycle_shard_hint(void)
+{
+    int local;
+    uint32_t const h = (uint32_t)((size_t)&local >> 16) * 2654435761u;
+    return h >> 29;
+}
+
+static bool recycle_trylock(recycle_list_t *self)
+{
+    return atomic32_test_and_set(&self->lock, 1, 0) == 0;
+}
+
+static void recycle_unlock(recycle_list_t *self)
+{
+    atomic32_test_and_set(&self->lock, 0, 1);
+}
+
+/* returns recycled storage of the class, or NULL */
+static void *recycle_get(unsigned idx)
+{
+    unsigned i;
+    unsigned const hint = recycle_shard_hint();
+
+    for (i = 0; i < RECYCLE_SHARDS; ++i) {
+        recycle_list_t *self = &recycle_shard[(hint + i) % RECYCLE_SHARDS].list[idx];
+        if (recycle_trylock(self)) {
+            void *y = self->head;
+            if (y != NULL) {
+                self->head = *(void **)y;
+                --self->count;
+            }
+            recycle_unlock(self);
+            if (y != NULL) {
+                atomic_inc(&recycle_shard[hint].reuses);
+                return y;
+            }
+        }
+    }
+    atomic_inc(&recycle_shard[hint].allocs);
+    return NULL;
+}
+
+/* false if the storage is to be freed */
+static bool recycle_put(void *block, size_t capacity)
+{
+    unsigned const idx = recycle_class_of(capacity);
+
+    if (idx < RECYCLE_CLASSES && recycle_class_size(idx) == capacity) {
+        unsigned i;
+        unsigned const hint = recycle_shard_hint();
+
+        for (i = 0; i < RECYCLE_SHARDS; ++i) {
+            recycle_list_t *self = &recycle_shard[(hint + i) % RECYCLE_SHARDS].list[idx];
+            if (recycle_trylock(self)) {
+                bool const kept = self->count == 0 || (self->count + 1) * capacity <= RECYCLE_SHARD_BYTES;
+                if (kept) {
+                    *(void **)block = self->head;
+                    self->head = block;
+                    ++self->count;
+                }
+                recycle_unlock(self);
+                if (kept)
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+LIB_EXPORT void CC KDataBufferGetAllocStats(uint64_t *allocs, uint64_t *reuses)
+{
+    unsigned i;
+    uint64_t a = 0, r = 0;
+
+    for (i = 0; i < RECYCLE_SHARDS; ++i) {
+        a += atomic_read(&recycle_shard[i].allocs);
+        r += atomic_read(&recycle_shard[i].reuses);
+    }
+    if (allocs != NULL)
+        *allocs = a;
+    if (reuses != NULL)
+        *reuses = r;
+}
+
 static
 rc_t allocate(buffer_impl_t **target, size_t capacity) {
-    buffer_impl_t *y = malloc(capacity + sizeof(*y));
+    buffer_impl_t *y;
+    unsigned const idx = recycle_class_of(capacity);
+
+    if (idx < RECYCLE_CLASSES) {
+        capacity = recycle_class_size(idx);
+        y = recycle_get(idx);
+        if (y == NULL)
+            y = malloc(capacity + sizeof(*y));
+    }
+    else {
+        atomic_inc(&recycle_shard[recycle_shard_hint()].allocs);
+        y = malloc(capacity + sizeof(*y));
+    }
 
     if (y == NULL)
         return RC(rcRuntime, rcBuffer, rcAllocating, rcMemory, rcExhausted);
@@ -153,7 +302,8 @@ static void release(buffer_impl_t *self) {
         }
         self->foo = 55;
 #endif
-        free(self);
+        if (!recycle_put(self, self->allocated))
+            free(self);
     }
 #if DEBUG_MALLOC_FREE
     else if (refcount < 1) {
@@ -169,6 +319,8 @@ static rc_t reallocate(buffer_impl_t **target, size_t capacity) {
 
     if (capacity <= self->allocated)
         return 0;
+    if (capacity <= RECYCLE_MAX_BYTES)
+        capacity = recycle_class_size(recycle_class_of(capacity));
 
     /* check reference count for copies */
     if (atomic32_read(&self->refcount) <= 1)
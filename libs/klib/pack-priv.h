@@ -0,0 +1,78 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_pack_priv_
+#define _h_pack_priv_
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * vector kernels
+ *  the processor is examined once, upon first use. kernels work on whole
+ *  groups of elements taken from the start of the buffers, leaving any
+ *  remainder for the scalar code.
+ */
+
+/* PackVecCount
+ *  returns the number of leading elements that PackVec will take
+ *  returns 0 if there is no kernel for these sizes on this processor
+ */
+uint32_t PackVecCount ( uint32_t unpacked, uint32_t packed, uint32_t count );
+
+/* PackVec
+ *  packs "count" elements, as returned by PackVecCount
+ *  works left to right, and so may pack in place
+ */
+void PackVec ( uint32_t unpacked, uint32_t packed,
+    void *dst, const void *src, uint32_t count );
+
+/* UnpackVecCount
+ *  returns the number of leading elements that UnpackVec will take
+ *  never more than can be unpacked without reading past the
+ *  last source byte
+ */
+uint32_t UnpackVecCount ( uint32_t packed, uint32_t unpacked, uint32_t count );
+
+/* UnpackVec
+ *  unpacks "count" elements, as returned by UnpackVecCount
+ *  works right to left, and so may unpack in place
+ */
+void UnpackVec ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t count );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_pack_priv_ */
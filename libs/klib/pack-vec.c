@@ -0,0 +1,546 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <klib/extern.h>
+#include <klib/klib-priv.h>
+#include "pack-priv.h"
+
+#include <assert.h>
+
+/* the kernels are compiled for their own instruction sets
+   by function attribute, and chosen at run time. the library
+   itself continues to be built for the baseline processor */
+#if ( defined __GNUC__ || defined __clang__ ) && defined __x86_64__
+#define USE_VEC_KERNELS 1
+#include <immintrin.h>
+#else
+#define USE_VEC_KERNELS 0
+#endif
+
+/* fewer elements than this are not worth the setup */
+#define VEC_MIN_COUNT 64
+
+enum
+{
+    vecNone,
+    vecSSE41,
+    vecAVX2
+};
+
+static int vec_level = -1;
+static bool vec_disabled;
+
+
+/* PackDisableVector
+ */
+LIB_EXPORT void CC PackDisableVector ( bool disable )
+{
+    vec_disabled = disable;
+}
+
+static
+int VecLevel ( void )
+{
+    int level = vec_level;
+    if ( level < 0 )
+    {
+        level = vecNone;
+#if USE_VEC_KERNELS
+        __builtin_cpu_init ();
+        if ( __builtin_cpu_supports ( "avx2" ) )
+            level = vecAVX2;
+        else if ( __builtin_cpu_supports ( "sse4.1" ) )
+            level = vecSSE41;
+#endif
+        /* every thread arrives at the same answer */
+        vec_level = level;
+    }
+    return vec_disabled ? vecNone : level;
+}
+
+#if USE_VEC_KERNELS
+
+/*--------------------------------------------------------------------------
+ * unpack
+ *  a group of 8 packed elements always occupies "packed" whole bytes,
+ *  so each group starts on a byte boundary and has the same layout.
+ *
+ *  "narrow" kernels handle packed <= 8: every element lies within 2
+ *  source bytes, which are gathered big-endian into a 16-bit lane, shifted
+ *  left to drop bits of the preceding element ( by multiplication ), then
+ *  right to drop those of the following one.
+ *
+ *  "wide" kernels do the same for 8 < packed < 16 using 3 bytes in a
+ *  32-bit lane.
+ *
+ *  kernels run right to left so that the destination may overlay
+ *  the source. a 16 byte load may pick up bytes already overwritten,
+ *  but never bytes that the group itself uses.
+ */
+
+static
+void UnpackNarrowConsts ( uint32_t packed, uint8_t ctl [ 16 ], uint16_t mul [ 8 ] )
+{
+    uint32_t i;
+    for ( i = 0; i < 8; ++ i )
+    {
+        uint32_t bit = i * packed;
+        ctl [ i * 2 ] = ( uint8_t ) ( ( bit >> 3 ) + 1 );
+        ctl [ i * 2 + 1 ] = ( uint8_t ) ( bit >> 3 );
+        mul [ i ] = ( uint16_t ) ( 1U << ( bit & 7 ) );
+    }
+}
+
+static
+void UnpackWideConsts ( uint32_t packed, uint8_t ctl [ 32 ], uint32_t shl [ 8 ] )
+{
+    uint32_t i;
+    for ( i = 0; i < 8; ++ i )
+    {
+        uint32_t bit = i * packed;
+        ctl [ i * 4 ] = ( uint8_t ) ( ( bit >> 3 ) + 2 );
+        ctl [ i * 4 + 1 ] = ( uint8_t ) ( ( bit >> 3 ) + 1 );
+        ctl [ i * 4 + 2 ] = ( uint8_t ) ( bit >> 3 );
+        ctl [ i * 4 + 3 ] = 0x80;
+        shl [ i ] = 8 + ( bit & 7 );
+    }
+}
+
+__attribute__ ( ( target ( "sse4.1" ) ) )
+static
+void UnpackNarrowSSE41 ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t groups )
+{
+    uint8_t ctl_bytes [ 16 ];
+    uint16_t mul_words [ 8 ];
+    __m128i ctl, mul, shift, zero;
+
+    UnpackNarrowConsts ( packed, ctl_bytes, mul_words );
+    ctl = _mm_loadu_si128 ( ( const __m128i* ) ctl_bytes );
+    mul = _mm_loadu_si128 ( ( const __m128i* ) mul_words );
+    shift = _mm_cvtsi32_si128 ( 16 - packed );
+    zero = _mm_setzero_si128 ();
+
+    while ( groups != 0 )
+    {
+        __m128i v;
+
+        -- groups;
+        v = _mm_loadu_si128 ( ( const __m128i* )
+            & ( ( const uint8_t* ) src ) [ ( size_t ) groups * packed ] );
+        v = _mm_shuffle_epi8 ( v, ctl );
+        v = _mm_srl_epi16 ( _mm_mullo_epi16 ( v, mul ), shift );
+
+        switch ( unpacked )
+        {
+        case 8:
+            _mm_storel_epi64 ( ( __m128i* ) & ( ( uint8_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm_packus_epi16 ( v, v ) );
+            break;
+        case 16:
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint16_t* ) dst ) [ ( size_t ) groups * 8 ], v );
+            break;
+        case 32:
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 + 4 ],
+                _mm_unpackhi_epi16 ( v, zero ) );
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm_unpacklo_epi16 ( v, zero ) );
+            break;
+        }
+    }
+}
+
+__attribute__ ( ( target ( "avx2" ) ) )
+static
+void UnpackNarrowAVX2 ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t groups )
+{
+    uint8_t ctl_bytes [ 16 ];
+    uint16_t mul_words [ 8 ];
+    __m256i ctl, mul;
+    __m128i shift;
+
+    /* an odd group at the end goes through the narrower kernel */
+    if ( ( groups & 1 ) != 0 )
+    {
+        -- groups;
+        UnpackNarrowSSE41 ( packed, unpacked,
+            & ( ( uint8_t* ) dst ) [ ( size_t ) groups * unpacked ],
+            & ( ( const uint8_t* ) src ) [ ( size_t ) groups * packed ], 1 );
+    }
+
+    UnpackNarrowConsts ( packed, ctl_bytes, mul_words );
+    ctl = _mm256_broadcastsi128_si256 ( _mm_loadu_si128 ( ( const __m128i* ) ctl_bytes ) );
+    mul = _mm256_broadcastsi128_si256 ( _mm_loadu_si128 ( ( const __m128i* ) mul_words ) );
+    shift = _mm_cvtsi32_si128 ( 16 - packed );
+
+    /* one group in each 128-bit lane */
+    while ( groups != 0 )
+    {
+        const uint8_t *s;
+        __m256i v;
+
+        groups -= 2;
+        s = & ( ( const uint8_t* ) src ) [ ( size_t ) groups * packed ];
+        v = _mm256_inserti128_si256 ( _mm256_castsi128_si256 (
+                _mm_loadu_si128 ( ( const __m128i* ) s ) ),
+            _mm_loadu_si128 ( ( const __m128i* ) & s [ packed ] ), 1 );
+        v = _mm256_shuffle_epi8 ( v, ctl );
+        v = _mm256_srl_epi16 ( _mm256_mullo_epi16 ( v, mul ), shift );
+
+        switch ( unpacked )
+        {
+        case 8:
+            v = _mm256_permute4x64_epi64 ( _mm256_packus_epi16 ( v, v ), 0x08 );
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint8_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm256_castsi256_si128 ( v ) );
+            break;
+        case 16:
+            _mm256_storeu_si256 ( ( __m256i* ) & ( ( uint16_t* ) dst ) [ ( size_t ) groups * 8 ], v );
+            break;
+        case 32:
+            _mm256_storeu_si256 ( ( __m256i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 + 8 ],
+                _mm256_cvtepu16_epi32 ( _mm256_extracti128_si256 ( v, 1 ) ) );
+            _mm256_storeu_si256 ( ( __m256i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm256_cvtepu16_epi32 ( _mm256_castsi256_si128 ( v ) ) );
+            break;
+        }
+    }
+}
+
+__attribute__ ( ( target ( "sse4.1" ) ) )
+static
+void UnpackWideSSE41 ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t groups )
+{
+    uint8_t ctl_bytes [ 32 ];
+    uint32_t shl [ 8 ], mul_dwords [ 8 ];
+    __m128i ctl_lo, ctl_hi, mul_lo, mul_hi, shift;
+    uint32_t i;
+
+    UnpackWideConsts ( packed, ctl_bytes, shl );
+    for ( i = 0; i < 8; ++ i )
+        mul_dwords [ i ] = 1U << shl [ i ];
+
+    ctl_lo = _mm_loadu_si128 ( ( const __m128i* ) ctl_bytes );
+    ctl_hi = _mm_loadu_si128 ( ( const __m128i* ) & ctl_bytes [ 16 ] );
+    mul_lo = _mm_loadu_si128 ( ( const __m128i* ) mul_dwords );
+    mul_hi = _mm_loadu_si128 ( ( const __m128i* ) & mul_dwords [ 4 ] );
+    shift = _mm_cvtsi32_si128 ( 32 - packed );
+
+    while ( groups != 0 )
+    {
+        __m128i v, lo, hi;
+
+        -- groups;
+        v = _mm_loadu_si128 ( ( const __m128i* )
+            & ( ( const uint8_t* ) src ) [ ( size_t ) groups * packed ] );
+        lo = _mm_srl_epi32 ( _mm_mullo_epi32 ( _mm_shuffle_epi8 ( v, ctl_lo ), mul_lo ), shift );
+        hi = _mm_srl_epi32 ( _mm_mullo_epi32 ( _mm_shuffle_epi8 ( v, ctl_hi ), mul_hi ), shift );
+
+        if ( unpacked == 16 )
+        {
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint16_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm_packus_epi32 ( lo, hi ) );
+        }
+        else
+        {
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 + 4 ], hi );
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 ], lo );
+        }
+    }
+}
+
+__attribute__ ( ( target ( "avx2" ) ) )
+static
+void UnpackWideAVX2 ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t groups )
+{
+    uint8_t ctl_bytes [ 32 ];
+    uint32_t shl_dwords [ 8 ];
+    __m256i ctl, shl;
+    __m128i shift;
+
+    UnpackWideConsts ( packed, ctl_bytes, shl_dwords );
+    ctl = _mm256_loadu_si256 ( ( const __m256i* ) ctl_bytes );
+    shl = _mm256_loadu_si256 ( ( const __m256i* ) shl_dwords );
+    shift = _mm_cvtsi32_si128 ( 32 - packed );
+
+    /* the same group in both 128-bit lanes, 4 elements out of each */
+    while ( groups != 0 )
+    {
+        __m256i v;
+
+        -- groups;
+        v = _mm256_broadcastsi128_si256 ( _mm_loadu_si128 ( ( const __m128i* )
+            & ( ( const uint8_t* ) src ) [ ( size_t ) groups * packed ] ) );
+        v = _mm256_shuffle_epi8 ( v, ctl );
+        v = _mm256_srl_epi32 ( _mm256_sllv_epi32 ( v, shl ), shift );
+
+        if ( unpacked == 16 )
+        {
+            v = _mm256_permute4x64_epi64 ( _mm256_packus_epi32 ( v, v ), 0x08 );
+            _mm_storeu_si128 ( ( __m128i* ) & ( ( uint16_t* ) dst ) [ ( size_t ) groups * 8 ],
+                _mm256_castsi256_si128 ( v ) );
+        }
+        else
+        {
+            _mm256_storeu_si256 ( ( __m256i* ) & ( ( uint32_t* ) dst ) [ ( size_t ) groups * 8 ], v );
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------------------
+ * pack
+ *  only bytes into 1, 2 or 4 bits, where elements never straddle
+ *  a byte boundary and can be combined with multiply-add.
+ *  16 elements are taken at a time, left to right.
+ */
+
+__attribute__ ( ( target ( "sse4.1" ) ) )
+static
+void PackBytesSSE41 ( uint32_t packed, void *dst, const void *src, uint32_t chunks )
+{
+    const __m128i *s = src;
+    uint8_t *d = dst;
+    uint32_t i;
+
+    switch ( packed )
+    {
+    case 1:
+    {
+        /* put first element of each 8 in the MSB of the mask byte */
+        const __m128i rev = _mm_setr_epi8 ( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+        for ( i = 0; i < chunks; ++ i, d += 2 )
+        {
+            __m128i v = _mm_slli_epi16 ( _mm_shuffle_epi8 ( _mm_loadu_si128 ( & s [ i ] ), rev ), 7 );
+            uint32_t bits = ( uint32_t ) _mm_movemask_epi8 ( v );
+            d [ 0 ] = ( uint8_t ) bits;
+            d [ 1 ] = ( uint8_t ) ( bits >> 8 );
+        }
+        break;
+    }
+    case 2:
+    {
+        const __m128i w8 = _mm_set1_epi16 ( 0x0104 );
+        const __m128i w16 = _mm_set1_epi32 ( 0x00010010 );
+        const __m128i gather = _mm_setr_epi8 ( 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+        for ( i = 0; i < chunks; ++ i, d += 4 )
+        {
+            __m128i v = _mm_maddubs_epi16 ( _mm_loadu_si128 ( & s [ i ] ), w8 );
+            uint32_t bytes = ( uint32_t ) _mm_cvtsi128_si32 ( _mm_shuffle_epi8 ( _mm_madd_epi16 ( v, w16 ), gather ) );
+            d [ 0 ] = ( uint8_t ) bytes;
+            d [ 1 ] = ( uint8_t ) ( bytes >> 8 );
+            d [ 2 ] = ( uint8_t ) ( bytes >> 16 );
+            d [ 3 ] = ( uint8_t ) ( bytes >> 24 );
+        }
+        break;
+    }
+    case 4:
+    {
+        const __m128i w8 = _mm_set1_epi16 ( 0x0110 );
+        for ( i = 0; i < chunks; ++ i, d += 8 )
+        {
+            __m128i v = _mm_maddubs_epi16 ( _mm_loadu_si128 ( & s [ i ] ), w8 );
+            _mm_storel_epi64 ( ( __m128i* ) d, _mm_packus_epi16 ( v, v ) );
+        }
+        break;
+    }
+    }
+}
+
+__attribute__ ( ( target ( "avx2" ) ) )
+static
+void PackBytesAVX2 ( uint32_t packed, void *dst, const void *src, uint32_t chunks )
+{
+    const __m256i *s = src;
+    uint8_t *d = dst;
+    uint32_t i, pairs = chunks >> 1;
+
+    switch ( packed )
+    {
+    case 1:
+    {
+        const __m256i rev = _mm256_broadcastsi128_si256 (
+            _mm_setr_epi8 ( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 ) );
+        for ( i = 0; i < pairs; ++ i, d += 4 )
+        {
+            __m256i v = _mm256_slli_epi16 ( _mm256_shuffle_epi8 ( _mm256_loadu_si256 ( & s [ i ] ), rev ), 7 );
+            uint32_t bits = ( uint32_t ) _mm256_movemask_epi8 ( v );
+            d [ 0 ] = ( uint8_t ) bits;
+            d [ 1 ] = ( uint8_t ) ( bits >> 8 );
+            d [ 2 ] = ( uint8_t ) ( bits >> 16 );
+            d [ 3 ] = ( uint8_t ) ( bits >> 24 );
+        }
+        break;
+    }
+    case 2:
+    {
+        const __m256i w8 = _mm256_set1_epi16 ( 0x0104 );
+        const __m256i w16 = _mm256_set1_epi32 ( 0x00010010 );
+        const __m256i gather = _mm256_setr_epi32 ( 0, 4, 1, 1, 1, 1, 1, 1 );
+        for ( i = 0; i < pairs; ++ i, d += 8 )
+        {
+            __m256i v = _mm256_madd_epi16 ( _mm256_maddubs_epi16 ( _mm256_loadu_si256 ( & s [ i ] ), w8 ), w16 );
+            /* one byte per dword - narrow to words, then to bytes */
+            v = _mm256_packus_epi16 ( _mm256_packus_epi32 ( v, v ), v );
+            v = _mm256_permutevar8x32_epi32 ( v, gather );
+            _mm_storel_epi64 ( ( __m128i* ) d, _mm256_castsi256_si128 ( v ) );
+        }
+        break;
+    }
+    case 4:
+    {
+        const __m256i w8 = _mm256_set1_epi16 ( 0x0110 );
+        for ( i = 0; i < pairs; ++ i, d += 16 )
+        {
+            __m256i v = _mm256_maddubs_epi16 ( _mm256_loadu_si256 ( & s [ i ] ), w8 );
+            v = _mm256_permute4x64_epi64 ( _mm256_packus_epi16 ( v, v ), 0x08 );
+            _mm_storeu_si128 ( ( __m128i* ) d, _mm256_castsi256_si128 ( v ) );
+        }
+        break;
+    }
+    }
+
+    /* an odd chunk at the end */
+    if ( ( chunks & 1 ) != 0 )
+        PackBytesSSE41 ( packed, d, & s [ pairs ], 1 );
+}
+
+#endif /* USE_VEC_KERNELS */
+
+
+/* PackVecCount
+ */
+uint32_t PackVecCount ( uint32_t unpacked, uint32_t packed, uint32_t count )
+{
+    if ( unpacked != 8 || count < VEC_MIN_COUNT )
+        return 0;
+
+    switch ( packed )
+    {
+    case 1:
+    case 2:
+    case 4:
+        break;
+    default:
+        return 0;
+    }
+
+    if ( VecLevel () == vecNone )
+        return 0;
+
+    return count & ~ ( uint32_t ) 15;
+}
+
+/* PackVec
+ */
+void PackVec ( uint32_t unpacked, uint32_t packed,
+    void *dst, const void *src, uint32_t count )
+{
+    assert ( unpacked == 8 );
+    assert ( ( count & 15 ) == 0 );
+
+#if USE_VEC_KERNELS
+    switch ( VecLevel () )
+    {
+    case vecAVX2:
+        PackBytesAVX2 ( packed, dst, src, count >> 4 );
+        break;
+    case vecSSE41:
+        PackBytesSSE41 ( packed, dst, src, count >> 4 );
+        break;
+    }
+#endif
+}
+
+/* UnpackVecCount
+ */
+uint32_t UnpackVecCount ( uint32_t packed, uint32_t unpacked, uint32_t count )
+{
+    uint64_t bytes;
+    uint32_t groups;
+
+    if ( count < VEC_MIN_COUNT )
+        return 0;
+
+    switch ( unpacked )
+    {
+    case 8:
+        /* single bits already go through a lookup table that is faster */
+        if ( packed == 1 || packed >= 8 )
+            return 0;
+        break;
+    case 16:
+    case 32:
+        if ( packed >= 16 )
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    if ( VecLevel () == vecNone )
+        return 0;
+
+    /* every group loads 16 bytes from its start */
+    bytes = ( ( uint64_t ) count * packed ) >> 3;
+    if ( bytes < 16 )
+        return 0;
+
+    groups = ( uint32_t ) ( ( bytes - 16 ) / packed + 1 );
+    if ( groups > ( count >> 3 ) )
+        groups = count >> 3;
+
+    return groups << 3;
+}
+
+/* UnpackVec
+ */
+void UnpackVec ( uint32_t packed, uint32_t unpacked,
+    void *dst, const void *src, uint32_t count )
+{
+    assert ( ( count & 7 ) == 0 );
+
+#if USE_VEC_KERNELS
+    switch ( VecLevel () )
+    {
+    case vecAVX2:
+        if ( packed <= 8 )
+            UnpackNarrowAVX2 ( packed, unpacked, dst, src, count >> 3 );
+        else
+            UnpackWideAVX2 ( packed, unpacked, dst, src, count >> 3 );
+        break;
+    case vecSSE41:
+        if ( packed <= 8 )
+            UnpackNarrowSSE41 ( packed, unpacked, dst, src, count >> 3 );
+        else
+            UnpackWideSSE41 ( packed, unpacked, dst, src, count >> 3 );
+        break;
+    }
+#endif
+}
@@ -28,6 +28,7 @@
 #include <klib/pack.h>
 #include <klib/rc.h>
 #include <arch-impl.h>
+#include "pack-priv.h"
 #include <sysalloc.h>
 
 #include <endian.h>
@@ -497,8 +498,18 @@ LIB_EXPORT rc_t CC Pack ( uint32_t unpacked, uint32_t packed,
     switch ( unpacked )
     {
     case 8:
-        Pack8 ( packed, dst, src, ( uint32_t ) ssize );
+    {
+        /* vector kernels take whole groups from the front */
+        uint32_t vcount = PackVecCount ( unpacked, packed, ( uint32_t ) ssize );
+        if ( vcount != 0 )
+            PackVec ( unpacked, packed, dst, src, vcount );
+        if ( vcount < ( uint32_t ) ssize )
+        {
+            Pack8 ( packed, & ( ( char* ) dst ) [ ( ( size_t ) vcount * packed ) >> 3 ],
+                & ( ( const char* ) src ) [ vcount ], ( uint32_t ) ssize - vcount );
+        }
         break;
+    }
     case 16:
         Pack16 ( packed, dst, src, ( uint32_t ) ( ssize >> 1 ) );
         break;
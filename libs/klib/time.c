@@ -1,3 +1,24 @@
-#include <klib/time.h> /* KSleep */
+#include <klib/time.h> /* KSleep, KYield */
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h> /* _mm_pause */
+#endif
 
 LIB_EXPORT rc_t CC KSleep(uint32_t seconds) { return KSleepMs(seconds * 1000); }
+
+#define SPIN_PAUSE_ROUNDS 64
+
+LIB_EXPORT void CC KSpinBackoff(uint32_t round)
+{
+    if (round < SPIN_PAUSE_ROUNDS) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#endif
+    }
+    else
+        KYield();
+}
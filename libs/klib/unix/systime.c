@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <time.h>
+#include <sched.h>
 #include <sys/time.h>
 #include <errno.h>
 
@@ -58,6 +59,13 @@ LIB_EXPORT KTimeMs_t CC KTimeMsStamp ( void )
 	return ( ( tm.tv_sec * 1000 ) + ( tm.tv_usec / 1000 ) );
 }
 
+LIB_EXPORT uint64_t CC KTimeNsStamp ( void )
+{
+    struct timespec ts;
+    clock_gettime ( CLOCK_MONOTONIC, & ts );
+    return ( uint64_t ) ts . tv_sec * 1000000000 + ts . tv_nsec;
+}
+
 /*--------------------------------------------------------------------------
  * KTime
  *  simple time structure
@@ -160,3 +168,7 @@ LIB_EXPORT rc_t CC KSleepMs(uint32_t milliseconds) {
         return RC(rcRuntime, rcTimeout, rcWaiting, rcTimeout, rcInterrupted);
     }
 }
+
+LIB_EXPORT void CC KYield(void) {
+    sched_yield();
+}
@@ -28,6 +28,7 @@
 #include <klib/pack.h>
 #include <klib/rc.h>
 #include <arch-impl.h>
+#include "pack-priv.h"
 #include <sysalloc.h>
 
 #include <endian.h>
@@ -211,26 +212,32 @@ uint8_t unpack_8_from_1_arr[256][8]={
 static
 void CC Unpack8From2(uint8_t *dst,const uint8_t *src,int32_t count)
 {
+	/* right to left, in case of unpacking in place */
 	if(count > 0){
-		int i;
-		for(i=0;i<count/4;i++,dst+=4,src++){
-			memcpy(dst,unpack_8_from_2_arr[*src],4);
+		int i, n = count/4;
+		if((count&3) != 0){
+			const uint8_t *out = unpack_8_from_2_arr[src[n]];
+			for(i=(count&3)-1;i>=0;i--)
+				dst[n*4+i] = out[i];
 		}
-		for(i=0;i< (count&3);i++){
-			dst[i] = unpack_8_from_2_arr[*src][i];
+		for(i=n-1;i>=0;i--){
+			memcpy(dst+i*4,unpack_8_from_2_arr[src[i]],4);
 		}
 	}
 }
 static
 void CC Unpack8From1(uint8_t *dst,const uint8_t *src,int32_t count)
 {
+	/* right to left, in case of unpacking in place */
 	if(count > 0){
-		int i;
-		for(i=0;i<count/8;i++,dst+=8,src++){
-			memcpy(dst,unpack_8_from_1_arr[*src],8);
+		int i, n = count/8;
+		if((count&7) != 0){
+			const uint8_t *out = unpack_8_from_1_arr[src[n]];
+			for(i=(count&7)-1;i>=0;i--)
+				dst[n*8+i] = out[i];
 		}
-		for(i=0;i< (count&7);i++){
-			dst[i] = unpack_8_from_1_arr[*src][i];
+		for(i=n-1;i>=0;i--){
+			memcpy(dst+i*8,unpack_8_from_1_arr[src[i]],8);
 		}
 	}
 }
@@ -716,6 +723,33 @@ void CC Unpack64b ( uint32_t packed, uint32_t count, void *dst,
 }
 
 
+/* UnpackScalar
+ */
+static
+void CC UnpackScalar ( uint32_t packed, uint32_t unpacked, uint32_t count,
+    void *dst, const void *src, bitsz_t src_off, bitsz_t ssize )
+{
+    switch ( unpacked )
+    {
+    case 8:
+        Unpack8 ( packed, count, dst, src, src_off, ssize );
+        break;
+    case 16:
+        Unpack16 ( packed, count, dst, src, src_off, ssize );
+        break;
+    case 32:
+        Unpack32 ( packed, count, dst, src, src_off, ssize );
+        break;
+    case 64:
+        if ( packed > 32 )
+            Unpack64b ( packed, count, dst, src, src_off, ssize );
+        else
+            Unpack64a ( packed, count, dst, src, src_off, ssize );
+        break;
+    }
+}
+
+
 /* Unpack
  *  accepts a series of packed source bits
  *  produces a series of unpacked destination bits by left-padding zeros
@@ -747,7 +781,7 @@ LIB_EXPORT rc_t CC Unpack ( uint32_t packed, uint32_t unpacked,
     const void *src, bitsz_t src_off, bitsz_t ssize, bitsz_t *consumed,
     void *dst, size_t dsize, size_t *usize )
 {
-    uint32_t count;
+    uint32_t count, vcount;
 
     /* prepare for failure */
     if ( consumed != NULL )
@@ -810,24 +844,23 @@ LIB_EXPORT rc_t CC Unpack ( uint32_t packed, uint32_t unpacked,
     if ( src_off != 0 )
         return RC ( rcXF, rcBuffer, rcUnpacking, rcOffset, rcUnsupported );
 
-    switch ( unpacked )
+    /* vector kernels take whole groups from the front. since
+       unpacking may be in place, the scalar code must first finish
+       with the elements behind them, going right to left as usual */
+    vcount = 0;
+    if ( ssize == ( bitsz_t ) count * packed )
+        vcount = UnpackVecCount ( packed, unpacked, count );
+
+    if ( vcount < count )
     {
-    case 8:
-        Unpack8 ( packed, count, dst, src, src_off, ssize );
-        break;
-    case 16:
-        Unpack16 ( packed, count, dst, src, src_off, ssize );
-        break;
-    case 32:
-        Unpack32 ( packed, count, dst, src, src_off, ssize );
-        break;
-    case 64:
-        if ( packed > 32 )
-            Unpack64b ( packed, count, dst, src, src_off, ssize );
-        else
-            Unpack64a ( packed, count, dst, src, src_off, ssize );
-        break;
+        bitsz_t vbits = ( bitsz_t ) vcount * packed;
+        UnpackScalar ( packed, unpacked, count - vcount,
+            & ( ( char* ) dst ) [ ( ( size_t ) vcount * unpacked ) >> 3 ],
+            & ( ( const char* ) src ) [ vbits >> 3 ], src_off, ssize - vbits );
     }
 
+    if ( vcount != 0 )
+        UnpackVec ( packed, unpacked, dst, src, vcount );
+
     return 0;
 }
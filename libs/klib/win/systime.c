@@ -93,6 +93,15 @@ LIB_EXPORT KTimeMs_t CC KTimeMsStamp ( void )
     return FILETIME2KTimeMs ( & ft );
 }
 
+LIB_EXPORT uint64_t CC KTimeNsStamp ( void )
+{
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter ( & count );
+    QueryPerformanceFrequency ( & freq );
+    return ( uint64_t ) ( count . QuadPart / freq . QuadPart ) * 1000000000 +
+        ( uint64_t ) ( count . QuadPart % freq . QuadPart ) * 1000000000 / freq . QuadPart;
+}
+
 /*--------------------------------------------------------------------------
  * SYSTEMTIME
  */
@@ -353,3 +362,8 @@ LIB_EXPORT rc_t CC KSleepMs(uint32_t milliseconds)
     return 0;
 }
 
+LIB_EXPORT void CC KYield ( void )
+{
+    SwitchToThread ();
+}
+
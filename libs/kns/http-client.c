@@ -137,6 +137,16 @@ struct KClientHttp
     
     bool reliable;
     bool tls;
+
+    /* connection state for the manager's pool:
+       "keep_alive" - last response allows another request
+       "reusable" - and its body has been fully consumed
+       "reused" - socket came from the pool, no response on it yet
+       "supplied" - socket was given by the caller, never pooled */
+    bool keep_alive;
+    bool reusable;
+    bool reused;
+    bool supplied;
 };
 
 
@@ -151,9 +161,16 @@ struct KClientHttp
     
 void KClientHttpClose ( KClientHttp *self )
 {
+    /* a parked connection that failed before answering
+       suggests the server dropped its other idle ones too */
+    if ( self -> reused && self -> sock != NULL )
+        KNSManagerDropHttpConns ( self -> mgr, & self -> hostname, self -> port, self -> tls );
+
     KStreamRelease ( self -> sock );
     self -> sock = NULL;
 
+    self -> keep_alive = self -> reusable = self -> reused = false;
+
     KClientHttpBlockBufferReset ( self );
     KClientHttpLineBufferReset ( self );
 #if 0
@@ -178,6 +195,20 @@ rc_t KClientHttpClear ( KClientHttp *self )
 static
 rc_t KClientHttpWhack ( KClientHttp * self )
 {
+    /* park a connection that is ready for another request */
+    if ( self -> sock != NULL && self -> reusable && ! self -> supplied &&
+         KClientHttpBlockBufferIsEmpty ( self ) )
+    {
+        KHttpConn conn;
+        conn . sock = self -> sock;
+        conn . ep = self -> ep;
+        conn . proxy_ep = self -> proxy_ep;
+        conn . proxy_default_port = self -> proxy_default_port;
+
+        KNSManagerPutHttpConn ( self -> mgr, & self -> hostname, self -> port, self -> tls, & conn );
+        self -> sock = NULL;
+    }
+
     KClientHttpClear ( self );
     
     KDataBufferWhack ( & self -> block_buffer );
@@ -385,7 +416,7 @@ rc_t KClientHttpProxyConnect ( KClientHttp * self, const String * hostname, uint
 
 
 static
-rc_t KClientHttpOpen ( KClientHttp * self, const String * aHostname, uint32_t aPort )
+rc_t KClientHttpConnect ( KClientHttp * self, const String * aHostname, uint32_t aPort )
 {
     rc_t rc = 0;
     KSocket * sock = NULL;
@@ -498,6 +529,31 @@ rc_t KClientHttpOpen ( KClientHttp * self, const String * aHostname, uint32_t aP
     return rc;
 }
 
+static
+rc_t KClientHttpOpen ( KClientHttp * self, const String * aHostname, uint32_t aPort )
+{
+    KHttpConn conn;
+
+    assert ( self != NULL );
+
+    self -> keep_alive = self -> reusable = self -> reused = self -> supplied = false;
+
+    /* prefer an idle connection to the same server */
+    if ( KNSManagerTakeHttpConn ( self -> mgr, aHostname, aPort, self -> tls, & conn ) )
+    {
+        self -> sock = conn . sock;
+        self -> ep = conn . ep;
+        self -> ep_valid = true;
+        self -> proxy_ep = conn . proxy_ep;
+        self -> proxy_default_port = conn . proxy_default_port;
+        self -> port = aPort;
+        self -> reused = true;
+        return 0;
+    }
+
+    return KClientHttpConnect ( self, aHostname, aPort );
+}
+
 
 #if _DEBUGGING
 /* we need this hook to be able to test the re-connection logic */
@@ -515,6 +571,7 @@ rc_t KClientHttpReopen ( KClientHttp * self )
     if ( ClientHttpReopenCallback != NULL )
     {
         self -> sock = ClientHttpReopenCallback ();
+        self -> supplied = true;
         return 0;
     }
 #endif
@@ -542,7 +599,10 @@ rc_t KClientHttpInit ( KClientHttp * http, const KDataBuffer *hostname_buffer, K
     {
         rc = KStreamAddRef ( conn );
         if ( rc == 0 )
+        {
             http -> sock = conn;
+            http -> supplied = true;
+        }
     }
 
     if ( rc == 0 )
@@ -1362,6 +1422,7 @@ struct KClientHttpStream
 
     uint8_t state; /* keeps track of state for chunked reader */
     bool size_unknown; /* for HTTP/1.0 dynamic */
+    bool chunked;
 };
 
 enum 
@@ -1460,6 +1521,13 @@ rc_t CC KClientHttpStreamTimedRead ( const KClientHttpStream *cself,
        keep track of total bytes read within the chunk */
     self -> total_read += * num_read;
 
+    /* the whole body has been read */
+    if ( ! self -> chunked && ! self -> size_unknown &&
+         self -> total_read == self -> content_length )
+    {
+        http -> reusable = http -> keep_alive;
+    }
+
     return rc;
 }
 
@@ -1535,6 +1603,16 @@ rc_t CC KClientHttpStreamTimedReadChunked ( const KClientHttpStream *cself,
         if ( self -> content_length == 0 )
         {
             self -> state = end_stream;
+
+            /* consume any trailer up to the closing blank line
+               so that the connection may be used again */
+            do
+                rc = KClientHttpGetLine ( http, tm );
+            while ( rc == 0 && http -> line_valid != 0 );
+
+            if ( rc == 0 )
+                http -> reusable = http -> keep_alive;
+
             return 0;
         }
 
@@ -1671,6 +1749,7 @@ rc_t KClientHttpStreamMakeChunked ( KClientHttp *self, KStream **sp, const char
 
                 /* state should be new_chunk */
                 s -> state = new_chunk;
+                s -> chunked = true;
 
                 *sp = & s -> dad;
                 return 0;
@@ -1743,6 +1822,9 @@ rc_t KClientHttpSendReceiveMsg ( KClientHttp *self, KClientHttpResult **rslt,
     if ( self -> sock == NULL )
         rc = KClientHttpOpen ( self, & self -> hostname, self -> port );
 
+    /* a new exchange begins */
+    self -> keep_alive = self -> reusable = false;
+
     /* ALWAYS want to use write all when sending */
     if ( rc == 0 )
     {
@@ -1836,6 +1918,11 @@ rc_t KClientHttpSendReceiveMsg ( KClientHttp *self, KClientHttpResult **rslt,
 
                     if ( rc == 0 && status != 100 )
                     {
+                        /* the connection has answered */
+                        self -> reused = false;
+                        self -> keep_alive = ! result -> close_connection && version >= 0x01010000;
+                        self -> reusable = self -> keep_alive && result -> len_zero;
+
                         /* assign to OUT result obj */
                         * rslt = result;
                         return 0; 
@@ -3115,6 +3202,11 @@ rc_t KClientHttpRequestSendReceiveNoBodyInt ( KClientHttpRequest *self, KClientH
 
         /* look at status code */
         rslt = * _rslt;
+
+        /* a response to HEAD never has a body */
+        if ( strcmp ( method, "HEAD" ) == 0 )
+            self -> http -> reusable = self -> http -> keep_alive;
+
         switch ( rslt -> status )
         {
         case 200:
@@ -29,6 +29,11 @@
 typedef struct KHttpFile KHttpFile;
 #include <kfs/impl.h>
 
+typedef struct KHttpFileChunksTask KHttpFileChunksTask;
+#define KTASK_IMPL struct KHttpFileChunksTask
+#include <kproc/task.h>
+#include <kproc/impl.h>
+
 #include "http-priv.h"
 #include "mgr-priv.h"
 #include "stream-priv.h"
@@ -61,6 +66,7 @@ typedef struct KHttpFile KHttpFile;
 #include <klib/time.h> /* KSleep */
 #include <klib/vector.h>
 
+#include <kproc/threadpool.h>
 #include <kproc/timeout.h>
 
 #include <os-native.h>
@@ -85,6 +91,13 @@ typedef struct KHttpFile KHttpFile;
 #define USE_CACHE_CONTROL 1
 #define NO_CACHE_LIMIT ( ( uint64_t ) ( 16 * 1024 * 1024 ) )
 
+/* the range requests of a parallel read are sized so that
+   each takes about CHUNK_MS at the observed throughput */
+#define CHUNK_MIN ( ( size_t ) 256 * 1024 )
+#define CHUNK_MAX ( ( size_t ) 16 * 1024 * 1024 )
+#define CHUNK_INIT ( ( size_t ) 1024 * 1024 )
+#define CHUNK_MS 250
+
 
 /*--------------------------------------------------------------------------
  * KHttpFile
@@ -102,12 +115,20 @@ struct KHttpFile
 
     KDataBuffer url_buffer;
 
+    /* size of each range request in a parallel read,
+       guarded by "chunk_lock" */
+    KLock * chunk_lock;
+    size_t chunk_size;
+
+    ver_t vers;
+    bool reliable;
     bool no_cache;
 };
 
 static
 rc_t CC KHttpFileDestroy ( KHttpFile *self )
 {
+    KLockRelease ( self -> chunk_lock );
     KLockRelease ( self -> lock );
     KNSManagerRelease ( self -> kns );
     KClientHttpRelease ( self -> http );
@@ -147,14 +168,12 @@ rc_t CC KHttpFileSetSize ( KHttpFile *self, uint64_t size )
 }
 
 static
-rc_t KHttpFileTimedReadInt ( const KHttpFile *cself,
+rc_t KHttpFileTimedReadInt ( const KHttpFile *self, KClientHttp *http,
     uint64_t aPos, void *aBuf, size_t aBsize,
     size_t *num_read, struct timeout_t *tm, uint32_t * http_status )
 {
     uint64_t pos = aPos;
     rc_t rc = 0;
-    KHttpFile *self = ( KHttpFile * ) cself;
-    KClientHttp *http = self -> http;
     
     * http_status = 0; 
 
@@ -362,14 +381,14 @@ rc_t KHttpFileTimedReadLocked ( const KHttpFile *cself,
     rc_t rc = KLockAcquire ( cself -> lock );
     if ( rc == 0 )
     {
-        rc = KHttpFileTimedReadInt ( cself, aPos, aBuf, aBsize, num_read, tm, http_status );
+        rc = KHttpFileTimedReadInt ( cself, cself -> http, aPos, aBuf, aBsize, num_read, tm, http_status );
         KLockUnlock ( cself -> lock );
     }
     return rc;
 }
 
 static
-rc_t CC KHttpFileTimedRead ( const KHttpFile *self,
+rc_t KHttpFileTimedReadSerial ( const KHttpFile *self,
     uint64_t pos, void *buffer, size_t bsize,
     size_t *num_read, struct timeout_t *tm )
 {
@@ -420,6 +439,368 @@ rc_t CC KHttpFileTimedRead ( const KHttpFile *self,
     return rc;
 }
 
+/*--------------------------------------------------------------------------
+ * parallel reads
+ *  a large read is split into range requests of "chunk_size" bytes,
+ *  fetched over several connections at once, each into its own place
+ *  in the caller's buffer. the calling thread works on the file's own
+ *  connection, and up to "http_read_streams" - 1 tasks on the default
+ *  thread pool on connections shared through the manager's keep-alive pool.
+ *  any range that fails is fetched again on the file's connection;
+ *  if that fails too, the read returns the ranges that arrived before it.
+ */
+typedef struct KHttpFileChunks KHttpFileChunks;
+struct KHttpFileChunks
+{
+    const KHttpFile * file;
+    const struct timeout_t * tm;
+
+    uint8_t * buffer;
+    uint64_t pos;
+    size_t size;
+    size_t chunk_size;
+
+    /* guarded by "lock" */
+    KLock * lock;
+    uint8_t * done;
+    uint32_t count;
+    uint32_t next;
+    uint64_t bytes;
+    uint64_t ms;
+};
+
+/* KHttpFileMakeStream
+ *  a connection for one stream of a parallel read. opening it takes
+ *  an idle connection from the manager's pool when there is one,
+ *  and releasing it parks the connection there again
+ */
+static
+rc_t KHttpFileMakeStream ( const KHttpFile *self, KClientHttp **http )
+{
+    KDataBuffer url;
+    URLBlock block;
+
+    /* each connection gets its own copy of the url,
+       since making one briefly alters the host name */
+    rc_t rc = KDataBufferMakeBytes ( & url, self -> url_buffer . elem_count );
+    if ( rc == 0 )
+    {
+        memmove ( url . base, self -> url_buffer . base, self -> url_buffer . elem_count );
+        rc = ParseUrl ( & block, url . base, url . elem_count - 1 );
+        if ( rc == 0 )
+        {
+            rc = KNSManagerMakeClientHttpInt ( self -> kns, http, & url, NULL, self -> vers,
+                self -> kns -> http_read_timeout, self -> kns -> http_write_timeout,
+                & block . host, block . port, self -> reliable, block . tls );
+        }
+        KDataBufferWhack ( & url );
+    }
+    return rc;
+}
+
+/* KHttpFileChunksFetch
+ *  takes ranges until there are none left
+ */
+static
+void KHttpFileChunksFetch ( KHttpFileChunks *c, KClientHttp *http )
+{
+    while ( 1 )
+    {
+        uint32_t i;
+        size_t offset, size, num_read;
+        uint32_t http_status;
+        struct timeout_t tm;
+        KTimeMs_t start;
+        rc_t rc;
+
+        if ( KLockAcquire ( c -> lock ) != 0 )
+            break;
+        i = c -> next ++;
+        KLockUnlock ( c -> lock );
+        if ( i >= c -> count )
+            break;
+
+        offset = ( size_t ) i * c -> chunk_size;
+        size = c -> size - offset;
+        if ( size > c -> chunk_size )
+            size = c -> chunk_size;
+
+        if ( c -> tm != NULL )
+            tm = * c -> tm;
+        else
+            TimeoutInit ( & tm, c -> file -> kns -> http_read_timeout );
+
+        start = KTimeMsStamp ();
+        num_read = 0;
+        rc = KHttpFileTimedReadInt ( c -> file, http, c -> pos + offset,
+            c -> buffer + offset, size, & num_read, & tm, & http_status );
+        if ( rc != 0 )
+        {
+            /* leave the range for the serial pass */
+            KClientHttpReopen ( http );
+        }
+        else if ( num_read == size && KLockAcquire ( c -> lock ) == 0 )
+        {
+            c -> done [ i ] = 1;
+            c -> bytes += size;
+            c -> ms += KTimeMsStamp () - start;
+            KLockUnlock ( c -> lock );
+        }
+    }
+}
+
+/* KHttpFileChunksTask
+ *  fetches ranges on a stream of its own
+ */
+struct KHttpFileChunksTask
+{
+    KTask dad;
+    KHttpFileChunks *c;
+};
+
+static
+rc_t CC KHttpFileChunksTaskWhack ( KHttpFileChunksTask *self )
+{
+    KTaskDestroy ( & self -> dad, "KHttpFileChunksTask" );
+    free ( self );
+    return 0;
+}
+
+static
+rc_t CC KHttpFileChunksTaskExecute ( KHttpFileChunksTask *self )
+{
+    KHttpFileChunks *c = self -> c;
+    KClientHttp *http;
+    bool left;
+    rc_t rc;
+
+    /* a task that ran late, or on the waiting caller,
+       need not open a connection for nothing */
+    rc = KLockAcquire ( c -> lock );
+    if ( rc != 0 )
+        return rc;
+    left = c -> next < c -> count;
+    KLockUnlock ( c -> lock );
+    if ( ! left )
+        return 0;
+
+    rc = KHttpFileMakeStream ( c -> file, & http );
+    if ( rc == 0 )
+    {
+        KHttpFileChunksFetch ( c, http );
+        KClientHttpRelease ( http );
+    }
+    return rc;
+}
+
+static KTask_vt_v1 KHttpFileChunksTask_vt =
+{
+    1, 0,
+    KHttpFileChunksTaskWhack,
+    KHttpFileChunksTaskExecute
+};
+
+static
+rc_t KHttpFileChunksTaskSubmit ( KThreadPool *pool, KHttpFileChunks *c, KTaskFuture **future )
+{
+    rc_t rc;
+    KHttpFileChunksTask *t = malloc ( sizeof * t );
+    if ( t == NULL )
+        return RC ( rcNS, rcFile, rcReading, rcMemory, rcExhausted );
+
+    rc = KTaskInit ( & t -> dad, ( const KTask_vt* ) & KHttpFileChunksTask_vt, "KHttpFileChunksTask", "" );
+    if ( rc != 0 )
+    {
+        free ( t );
+        return rc;
+    }
+    t -> c = c;
+
+    rc = KThreadPoolSubmit ( pool, & t -> dad, future );
+    KTaskRelease ( & t -> dad );
+    return rc;
+}
+
+/* KHttpFileChunkSize
+ *  the size of range requests to use for a read of "bsize" bytes,
+ *  or 0 when the read should stay on one connection
+ */
+static
+size_t KHttpFileChunkSize ( const KHttpFile *self, uint64_t pos, size_t bsize, uint32_t streams )
+{
+    size_t chunk = self -> chunk_size;
+
+    if ( streams < 2 || pos >= self -> file_size )
+        return 0;
+    if ( bsize > self -> file_size - pos )
+        bsize = ( size_t ) ( self -> file_size - pos );
+    if ( bsize < 2 * CHUNK_MIN )
+        return 0;
+
+    /* keep every stream busy */
+    if ( chunk > ( bsize + streams - 1 ) / streams )
+    {
+        chunk = ( bsize + streams - 1 ) / streams;
+        if ( chunk < CHUNK_MIN )
+            chunk = CHUNK_MIN;
+    }
+    return chunk;
+}
+
+/* KHttpFileAdaptChunkSize
+ *  moves the chunk size halfway towards CHUNK_MS worth of
+ *  the throughput seen by each stream
+ */
+static
+void KHttpFileAdaptChunkSize ( const KHttpFile *cself, uint64_t bytes, uint64_t ms )
+{
+    KHttpFile *self = ( KHttpFile * ) cself;
+    uint64_t target;
+
+    if ( bytes == 0 )
+        return;
+
+    target = ms == 0 ? CHUNK_MAX : bytes * CHUNK_MS / ms;
+    if ( target < CHUNK_MIN )
+        target = CHUNK_MIN;
+    else if ( target > CHUNK_MAX )
+        target = CHUNK_MAX;
+
+    if ( KLockAcquire ( self -> chunk_lock ) == 0 )
+    {
+        self -> chunk_size = ( size_t ) ( ( self -> chunk_size + target ) / 2 );
+        KLockUnlock ( self -> chunk_lock );
+    }
+}
+
+static
+rc_t KHttpFileTimedReadParallel ( const KHttpFile *self,
+    uint64_t pos, void *buffer, size_t bsize, size_t chunk,
+    uint32_t streams, size_t *num_read, struct timeout_t *tm )
+{
+    KHttpFileChunks c;
+    KThreadPool * pool;
+    KTaskFuture * f [ MAX_HTTP_READ_STREAMS ];
+    size_t prefix;
+    uint32_t i, n;
+
+    rc_t rc = KThreadPoolGetDefault ( & pool );
+    if ( rc != 0 )
+        return KHttpFileTimedReadSerial ( self, pos, buffer, bsize, num_read, tm );
+
+    rc = KLockMake ( & c . lock );
+    if ( rc != 0 )
+    {
+        KThreadPoolRelease ( pool );
+        return rc;
+    }
+
+    if ( bsize > self -> file_size - pos )
+        bsize = ( size_t ) ( self -> file_size - pos );
+
+    c . file = self;
+    c . tm = tm;
+    c . buffer = buffer;
+    c . pos = pos;
+    c . size = bsize;
+    c . chunk_size = chunk;
+    c . count = ( uint32_t ) ( ( bsize + chunk - 1 ) / chunk );
+    c . next = 0;
+    c . bytes = c . ms = 0;
+    c . done = calloc ( c . count, 1 );
+    if ( c . done == NULL )
+    {
+        KLockRelease ( c . lock );
+        KThreadPoolRelease ( pool );
+        return RC ( rcNS, rcFile, rcReading, rcMemory, rcExhausted );
+    }
+
+    if ( streams > c . count )
+        streams = c . count;
+    if ( streams > KThreadPoolThreads ( pool ) + 1 )
+        streams = KThreadPoolThreads ( pool ) + 1;
+
+    /* a task that fails to submit leaves its share to the others */
+    for ( n = 0, i = 1; i < streams; ++ i )
+    {
+        if ( KHttpFileChunksTaskSubmit ( pool, & c, & f [ n ] ) == 0 )
+            ++ n;
+    }
+
+    rc = KLockAcquire ( self -> lock );
+    if ( rc == 0 )
+    {
+        KHttpFileChunksFetch ( & c, self -> http );
+        KLockUnlock ( self -> lock );
+    }
+
+    for ( i = 0; i < n; ++ i )
+    {
+        rc_t status;
+        KTaskFutureWait ( f [ i ], & status, NULL );
+        KTaskFutureRelease ( f [ i ] );
+    }
+    KThreadPoolRelease ( pool );
+
+    KHttpFileAdaptChunkSize ( self, c . bytes, c . ms );
+
+    /* pick up failed ranges in order, with retries.
+       the first one that cannot be read ends the read there */
+    for ( rc = 0, prefix = bsize, i = 0; i < c . count; ++ i )
+    {
+        size_t offset = ( size_t ) i * chunk;
+        size_t size = bsize - offset;
+        if ( size > chunk )
+            size = chunk;
+
+        while ( rc == 0 && ! c . done [ i ] )
+        {
+            size_t got = 0;
+            rc = KHttpFileTimedReadSerial ( self, pos + offset,
+                c . buffer + offset, size, & got, tm );
+            if ( rc == 0 )
+            {
+                if ( got == 0 )
+                    rc = RC ( rcNS, rcFile, rcReading, rcTransfer, rcIncomplete );
+                else if ( got == size )
+                    c . done [ i ] = 1;
+                offset += got;
+                size -= got;
+            }
+        }
+        if ( rc != 0 )
+        {
+            prefix = offset;
+            break;
+        }
+    }
+
+    free ( c . done );
+    KLockRelease ( c . lock );
+
+    /* the caller gets what arrived, and the error on its next read */
+    * num_read = prefix;
+    return prefix != 0 ? 0 : rc;
+}
+
+static
+rc_t CC KHttpFileTimedRead ( const KHttpFile *self,
+    uint64_t pos, void *buffer, size_t bsize,
+    size_t *num_read, struct timeout_t *tm )
+{
+    uint32_t streams = self -> kns -> http_read_streams;
+    size_t chunk = KHttpFileChunkSize ( self, pos, bsize, streams );
+
+    if ( chunk != 0 )
+    {
+        DBGMSG ( DBG_KNS, DBG_FLAG ( DBG_KNS_HTTP ),
+            ( "KHttpFileTimedRead(pos=%lu, size=%zu): %u streams of %zu\n", pos, bsize, streams, chunk ) );
+        return KHttpFileTimedReadParallel ( self, pos, buffer, bsize, chunk, streams, num_read, tm );
+    }
+
+    return KHttpFileTimedReadSerial ( self, pos, buffer, bsize, num_read, tm );
+}
+
 static
 rc_t CC KHttpFileRead ( const KHttpFile *self, uint64_t pos,
      void *buffer, size_t bsize, size_t *num_read )
@@ -501,6 +882,12 @@ static rc_t KNSManagerVMakeHttpFileInt ( const KNSManager *self,
                 {
                     rc = KLockMake ( & f -> lock );
                     if ( rc == 0 )
+                    {
+                        rc = KLockMake ( & f -> chunk_lock );
+                        if ( rc != 0 )
+                            KLockRelease ( f -> lock );
+                    }
+                    if ( rc == 0 )
                     {
                         KDataBuffer *buf = & f -> url_buffer;
                         buf -> elem_bits = 8;
@@ -581,6 +968,9 @@ static rc_t KNSManagerVMakeHttpFileInt ( const KNSManager *self,
                                                         f -> kns = self;
                                                         f -> file_size = size;
                                                         f -> http = http;
+                                                        f -> vers = vers;
+                                                        f -> reliable = reliable;
+                                                        f -> chunk_size = CHUNK_INIT;
                                                         f -> no_cache = size >= NO_CACHE_LIMIT;
                                                         
                                                         * file = & f -> dad;
@@ -597,6 +987,7 @@ static rc_t KNSManagerVMakeHttpFileInt ( const KNSManager *self,
                         }
 
                         KDataBufferWhack ( buf );
+                        KLockRelease ( f -> chunk_lock );
                         KLockRelease ( f -> lock );
                     }
                 }
@@ -0,0 +1,318 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ==============================================================================
+*
+*/
+
+#include <kns/extern.h>
+
+#include "http-priv.h"
+#include "mgr-priv.h"
+
+#include <kns/http.h>
+#include <kns/manager.h>
+#include <kns/stream.h>
+#include <kfg/config.h>
+#include <kproc/lock.h>
+#include <klib/container.h>
+#include <klib/debug.h> /* DBGMSG */
+#include <klib/text.h>
+#include <klib/time.h>
+#include <klib/rc.h>
+
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+/*--------------------------------------------------------------------------
+ * KHttpIdleConn
+ *  a connection parked in the manager's pool
+ */
+typedef struct KHttpIdleConn KHttpIdleConn;
+struct KHttpIdleConn
+{
+    DLNode n;
+
+    KHttpConn conn;
+    KTimeMs_t parked;
+
+    uint32_t port;
+    bool tls;
+
+    String host;
+    char host_text [ 1 ];
+};
+
+static
+void KHttpIdleConnWhack ( KHttpIdleConn * self )
+{
+    KStreamRelease ( self -> conn . sock );
+    free ( self );
+}
+
+static
+void CC KHttpIdleConnListWhack ( DLNode * n, void * ignore )
+{
+    KHttpIdleConnWhack ( ( KHttpIdleConn * ) n );
+}
+
+static
+bool KHttpIdleConnMatch ( const KHttpIdleConn * self,
+    const String * host, uint32_t port, bool tls )
+{
+    return self -> port == port && self -> tls == tls &&
+        StringCaseEqual ( & self -> host, host );
+}
+
+/* Expire
+ *  close connections idle for too long
+ *  called with lock held
+ */
+static
+void KNSManagerHttpPoolExpire ( KNSManager * self, KTimeMs_t now )
+{
+    /* the oldest are at the tail */
+    DLNode * node = DLListTail ( & self -> http_pool );
+    while ( node != NULL )
+    {
+        KHttpIdleConn * idle = ( KHttpIdleConn * ) node;
+        if ( ( uint64_t ) ( now - idle -> parked ) <= self -> http_pool_idle_ms )
+            break;
+
+        node = DLNodePrev ( node );
+        DLListUnlink ( & self -> http_pool, & idle -> n );
+        -- self -> http_pool_count;
+        KHttpIdleConnWhack ( idle );
+    }
+}
+
+bool KNSManagerTakeHttpConn ( const KNSManager * cself,
+    const String * host, uint32_t port, bool tls, KHttpConn * conn )
+{
+    KNSManager * self = ( KNSManager * ) cself;
+    KHttpIdleConn * found = NULL;
+
+    assert ( conn != NULL );
+
+    if ( self == NULL || self -> http_pool_lock == NULL )
+        return false;
+
+    if ( KLockAcquire ( self -> http_pool_lock ) == 0 )
+    {
+        DLNode * node;
+
+        KNSManagerHttpPoolExpire ( self, KTimeMsStamp () );
+
+        for ( node = DLListHead ( & self -> http_pool ); node != NULL; node = DLNodeNext ( node ) )
+        {
+            KHttpIdleConn * idle = ( KHttpIdleConn * ) node;
+            if ( KHttpIdleConnMatch ( idle, host, port, tls ) )
+            {
+                DLListUnlink ( & self -> http_pool, & idle -> n );
+                -- self -> http_pool_count;
+                found = idle;
+                break;
+            }
+        }
+
+        KLockUnlock ( self -> http_pool_lock );
+    }
+
+    if ( found == NULL )
+        return false;
+
+    DBGMSG ( DBG_KNS, DBG_FLAG ( DBG_KNS_HTTP ),
+        ( "reusing idle connection to %S:%u\n", host, port ) );
+
+    * conn = found -> conn;
+    free ( found );
+
+    return true;
+}
+
+void KNSManagerPutHttpConn ( const KNSManager * cself,
+    const String * host, uint32_t port, bool tls, const KHttpConn * conn )
+{
+    KNSManager * self = ( KNSManager * ) cself;
+    KHttpIdleConn * idle = NULL;
+
+    assert ( conn != NULL );
+    assert ( conn -> sock != NULL );
+
+    if ( self != NULL && self -> http_pool_lock != NULL && self -> http_pool_per_host != 0 )
+        idle = malloc ( sizeof * idle + host -> size );
+
+    if ( idle != NULL )
+    {
+        idle -> conn = * conn;
+        idle -> port = port;
+        idle -> tls = tls;
+        string_copy ( idle -> host_text, host -> size + 1, host -> addr, host -> size );
+        StringInit ( & idle -> host, idle -> host_text, host -> size, host -> len );
+
+        if ( KLockAcquire ( self -> http_pool_lock ) == 0 )
+        {
+            uint32_t same_host = 0;
+            DLNode * node;
+
+            idle -> parked = KTimeMsStamp ();
+            KNSManagerHttpPoolExpire ( self, idle -> parked );
+
+            DLListPushHead ( & self -> http_pool, & idle -> n );
+            ++ self -> http_pool_count;
+
+            /* enforce limits by closing the longest idle */
+            for ( node = DLNodeNext ( & idle -> n ); node != NULL; )
+            {
+                KHttpIdleConn * other = ( KHttpIdleConn * ) node;
+                node = DLNodeNext ( node );
+
+                if ( self -> http_pool_count > MAX_HTTP_POOL_CONNS ||
+                     ( KHttpIdleConnMatch ( other, host, port, tls ) &&
+                       ++ same_host >= self -> http_pool_per_host ) )
+                {
+                    DLListUnlink ( & self -> http_pool, & other -> n );
+                    -- self -> http_pool_count;
+                    KHttpIdleConnWhack ( other );
+                }
+            }
+
+            KLockUnlock ( self -> http_pool_lock );
+            return;
+        }
+
+        free ( idle );
+    }
+
+    KStreamRelease ( conn -> sock );
+}
+
+void KNSManagerDropHttpConns ( const KNSManager * cself,
+    const String * host, uint32_t port, bool tls )
+{
+    KNSManager * self = ( KNSManager * ) cself;
+
+    if ( self != NULL && self -> http_pool_lock != NULL &&
+         KLockAcquire ( self -> http_pool_lock ) == 0 )
+    {
+        DLNode * node = DLListHead ( & self -> http_pool );
+        while ( node != NULL )
+        {
+            KHttpIdleConn * idle = ( KHttpIdleConn * ) node;
+            node = DLNodeNext ( node );
+
+            if ( KHttpIdleConnMatch ( idle, host, port, tls ) )
+            {
+                DLListUnlink ( & self -> http_pool, & idle -> n );
+                -- self -> http_pool_count;
+                KHttpIdleConnWhack ( idle );
+            }
+        }
+
+        KLockUnlock ( self -> http_pool_lock );
+    }
+}
+
+
+/* SetHTTPConnectionPool
+ */
+LIB_EXPORT rc_t CC KNSManagerSetHTTPConnectionPool ( KNSManager * self,
+    uint32_t per_host, uint32_t idle_ms )
+{
+    rc_t rc;
+
+    if ( self == NULL )
+        return RC ( rcNS, rcMgr, rcUpdating, rcSelf, rcNull );
+
+    if ( per_host > MAX_HTTP_POOL_CONNS )
+        per_host = MAX_HTTP_POOL_CONNS;
+
+    rc = KLockAcquire ( self -> http_pool_lock );
+    if ( rc == 0 )
+    {
+        self -> http_pool_per_host = per_host;
+        self -> http_pool_idle_ms = idle_ms;
+
+        if ( per_host == 0 )
+        {
+            /* pool is disabled: close everything parked */
+            DLListWhack ( & self -> http_pool, KHttpIdleConnListWhack, NULL );
+            self -> http_pool_count = 0;
+        }
+        else
+        {
+            KNSManagerHttpPoolExpire ( self, KTimeMsStamp () );
+        }
+
+        KLockUnlock ( self -> http_pool_lock );
+    }
+
+    return rc;
+}
+
+/* GetHTTPConnectionPool
+ */
+LIB_EXPORT rc_t CC KNSManagerGetHTTPConnectionPool ( const KNSManager * self,
+    uint32_t * per_host, uint32_t * idle_ms )
+{
+    if ( per_host == NULL || idle_ms == NULL )
+        return RC ( rcNS, rcMgr, rcAccessing, rcParam, rcNull );
+    if ( self == NULL )
+        return RC ( rcNS, rcMgr, rcAccessing, rcSelf, rcNull );
+
+    * per_host = self -> http_pool_per_host;
+    * idle_ms = self -> http_pool_idle_ms;
+    return 0;
+}
+
+rc_t KNSManagerHttpPoolInit ( KNSManager * self, const KConfig * kfg )
+{
+    uint64_t value;
+
+    rc_t rc = KLockMake ( & self -> http_pool_lock );
+    if ( rc != 0 )
+        return rc;
+
+    DLListInit ( & self -> http_pool );
+    self -> http_pool_count = 0;
+    self -> http_pool_per_host = DEFAULT_HTTP_POOL_PER_HOST;
+    self -> http_pool_idle_ms = DEFAULT_HTTP_POOL_IDLE_MS;
+
+    if ( KConfigReadU64 ( kfg, "/http/pool/per_host", & value ) == 0 )
+        self -> http_pool_per_host = value > MAX_HTTP_POOL_CONNS ? MAX_HTTP_POOL_CONNS : ( uint32_t ) value;
+    if ( KConfigReadU64 ( kfg, "/http/pool/idle_ms", & value ) == 0 )
+        self -> http_pool_idle_ms = value > 0xFFFFFFFF ? 0xFFFFFFFF : ( uint32_t ) value;
+
+    return 0;
+}
+
+void KNSManagerHttpPoolWhack ( KNSManager * self )
+{
+    DLListWhack ( & self -> http_pool, KHttpIdleConnListWhack, NULL );
+    self -> http_pool_count = 0;
+    KLockRelease ( self -> http_pool_lock );
+    self -> http_pool_lock = NULL;
+}
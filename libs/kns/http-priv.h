@@ -43,6 +43,10 @@
 #include <klib/container.h>
 #endif
 
+#ifndef _h_kns_endpoint_
+#include <kns/endpoint.h>
+#endif
+
 #ifndef MAX_HTTP_READ_LIMIT
 #define MAX_HTTP_READ_LIMIT ( 30 * 1000 )
 #endif
@@ -51,6 +55,28 @@
 #define MAX_HTTP_WRITE_LIMIT ( 15 * 1000 )
 #endif
 
+/* connections used by one KHttpFile read */
+#ifndef DEFAULT_HTTP_READ_STREAMS
+#define DEFAULT_HTTP_READ_STREAMS 4
+#endif
+
+#ifndef MAX_HTTP_READ_STREAMS
+#define MAX_HTTP_READ_STREAMS 16
+#endif
+
+/* idle connections a KNSManager keeps for reuse */
+#ifndef DEFAULT_HTTP_POOL_PER_HOST
+#define DEFAULT_HTTP_POOL_PER_HOST MAX_HTTP_READ_STREAMS
+#endif
+
+#ifndef DEFAULT_HTTP_POOL_IDLE_MS
+#define DEFAULT_HTTP_POOL_IDLE_MS ( 10 * 1000 )
+#endif
+
+#ifndef MAX_HTTP_POOL_CONNS
+#define MAX_HTTP_POOL_CONNS 64
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -110,6 +136,40 @@ rc_t KNSManagerMakeClientHttpInt ( struct KNSManager const *self, struct KClient
 void KClientHttpForceSocketClose(const struct KClientHttp *self);
 */
 
+/*--------------------------------------------------------------------------
+ * KHttpConn
+ *  an open connection, kept idle by a KNSManager between its use by
+ *  one KClientHttp and the next to the same host, port and scheme
+ */
+typedef struct KHttpConn KHttpConn;
+struct KHttpConn
+{
+    struct KStream * sock;
+    KEndPoint ep;
+    bool proxy_ep;
+    bool proxy_default_port;
+};
+
+/* TakeHttpConn
+ *  returns true if "conn" was filled from an idle connection
+ */
+bool KNSManagerTakeHttpConn ( struct KNSManager const * self,
+    const String * host, uint32_t port, bool tls, KHttpConn * conn );
+
+/* PutHttpConn
+ *  keeps "conn" for reuse or closes it; takes over "conn -> sock"
+ */
+void KNSManagerPutHttpConn ( struct KNSManager const * self,
+    const String * host, uint32_t port, bool tls, const KHttpConn * conn );
+
+/* DropHttpConns
+ *  closes the idle connections to a host, once one of them has
+ *  turned out to be closed by the server
+ */
+void KNSManagerDropHttpConns ( struct KNSManager const * self,
+    const String * host, uint32_t port, bool tls );
+
+
 /*--------------------------------------------------------------------------
  * KClientHttpRequest
  */
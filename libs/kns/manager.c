@@ -254,6 +254,9 @@ rc_t KNSManagerWhack ( KNSManager * self )
         return 0;
 #endif
 
+    /* parked connections may hold TLS state */
+    KNSManagerHttpPoolWhack ( self );
+
     KNSManagerHttpProxyWhack ( self );
 
     if ( self -> aws_access_key_id != NULL )
@@ -619,6 +622,36 @@ LIB_EXPORT rc_t CC KNSManagerSetHTTPTimeouts ( KNSManager *self,
 }
 
 
+/* SetHTTPReadStreams
+ *  sets the number of connections a KHttpFile may use for one read
+ */
+LIB_EXPORT rc_t CC KNSManagerSetHTTPReadStreams ( KNSManager *self,
+    uint32_t streams )
+{
+    if ( self == NULL )
+        return RC ( rcNS, rcMgr, rcUpdating, rcSelf, rcNull );
+
+    if ( streams == 0 )
+        streams = 1;
+    else if ( streams > MAX_HTTP_READ_STREAMS )
+        streams = MAX_HTTP_READ_STREAMS;
+
+    self -> http_read_streams = streams;
+
+    return 0;
+}
+
+static
+void KNSManagerLoadReadStreams ( KNSManager * self, const KConfig * kfg )
+{
+    uint64_t streams;
+    rc_t rc = KConfigReadU64 ( kfg, "/http/reads/streams", & streams );
+    if ( rc == 0 )
+        KNSManagerSetHTTPReadStreams ( self, streams > MAX_HTTP_READ_STREAMS ?
+            MAX_HTTP_READ_STREAMS : ( uint32_t ) streams );
+}
+
+
 /* GetHTTPProxyPath
  *  returns path to HTTP proxy server ( if set ) or NULL.
  *  return status is 0 if the path is valid, non-zero otherwise
@@ -957,6 +990,7 @@ LIB_EXPORT rc_t CC KNSManagerMakeConfig ( KNSManager **mgrp, KConfig* kfg )
             mgr -> conn_write_timeout = MAX_CONN_WRITE_LIMIT;
             mgr -> http_read_timeout = MAX_HTTP_READ_LIMIT;
             mgr -> http_write_timeout = MAX_HTTP_WRITE_LIMIT;
+            mgr -> http_read_streams = DEFAULT_HTTP_READ_STREAMS;
             mgr -> maxTotalWaitForReliableURLs_ms = 10 * 60 * 1000; /* 10 min */
             mgr -> maxNumberOfRetriesOnFailureForReliableURLs = 10;
             mgr -> verbose = false;
@@ -977,10 +1011,17 @@ LIB_EXPORT rc_t CC KNSManagerMakeConfig ( KNSManager **mgrp, KConfig* kfg )
                     rc = KTLSGlobalsInit ( & mgr -> tlsg, kfg );
                     if ( rc == 0 )
                     {
-                        KNSManagerLoadAWS ( mgr, kfg );
-                        KNSManagerHttpProxyInit ( mgr, kfg );
-                        * mgrp = mgr;
-                        return 0;
+                        rc = KNSManagerHttpPoolInit ( mgr, kfg );
+                        if ( rc == 0 )
+                        {
+                            KNSManagerLoadAWS ( mgr, kfg );
+                            KNSManagerHttpProxyInit ( mgr, kfg );
+                            KNSManagerLoadReadStreams ( mgr, kfg );
+                            * mgrp = mgr;
+                            return 0;
+                        }
+
+                        KTLSGlobalsWhack ( & mgr -> tlsg );
                     }
                 }
             }
@@ -35,6 +35,10 @@
 #include <klib/refcount.h>
 #endif
 
+#ifndef _h_klib_container_
+#include <klib/container.h>
+#endif
+
 #ifndef _h_kns_mgr_priv_
 #include <kns/kns-mgr-priv.h>
 #endif
@@ -49,6 +53,7 @@ extern "C" {
 
 struct String;
 struct KConfig;
+struct KLock;
 struct HttpRetrySpecs;
 
 struct KNSManager
@@ -69,6 +74,15 @@ struct KNSManager
     int32_t conn_write_timeout;
     int32_t http_read_timeout;
     int32_t http_write_timeout;
+
+    uint32_t http_read_streams;
+
+    /* idle HTTP connections, most recently used first */
+    struct KLock * http_pool_lock;
+    DLList http_pool;
+    uint32_t http_pool_count;
+    uint32_t http_pool_per_host;
+    uint32_t http_pool_idle_ms;
     
     uint32_t maxTotalWaitForReliableURLs_ms;
 
@@ -81,6 +95,12 @@ struct KNSManager
     bool verbose;
 };
 
+/* HttpPool
+ *  see http-pool.c
+ */
+rc_t KNSManagerHttpPoolInit ( struct KNSManager * self, struct KConfig const * kfg );
+void KNSManagerHttpPoolWhack ( struct KNSManager * self );
+
 /* test */
 struct KStream;
 void KStreamForceSocketClose ( struct KStream const * self );
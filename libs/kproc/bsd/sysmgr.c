@@ -28,6 +28,7 @@
 #include <kproc/procmgr.h>
 
 #include <pthread.h>
+#include <unistd.h>
 
 /* OnMainThread
  *  returns true if running on main thread
@@ -36,3 +37,12 @@ LIB_EXPORT bool CC KProcMgrOnMainThread ( void )
 {
     return pthread_main_np () != 0;
 }
+
+/* GetNumProcessors
+ *  returns the number of online processors, at least 1
+ */
+LIB_EXPORT uint32_t CC KProcMgrGetNumProcessors ( void )
+{
+    long n = sysconf ( _SC_NPROCESSORS_ONLN );
+    return n > 0 ? ( uint32_t ) n : 1;
+}
@@ -33,7 +33,7 @@
 static __thread bool have_tid, on_main_thread;
 
 static
-pid_t gettid ( void )
+pid_t get_tid ( void )
 {
     return syscall ( SYS_gettid );
 }
@@ -45,8 +45,17 @@ LIB_EXPORT bool CC KProcMgrOnMainThread ( void )
 {
     if ( ! have_tid )
     {
-        on_main_thread = gettid () == getpid ();
+        on_main_thread = get_tid () == getpid ();
         have_tid = true;
     }
     return on_main_thread;
 }
+
+/* GetNumProcessors
+ *  returns the number of online processors, at least 1
+ */
+LIB_EXPORT uint32_t CC KProcMgrGetNumProcessors ( void )
+{
+    long n = sysconf ( _SC_NPROCESSORS_ONLN );
+    return n > 0 ? ( uint32_t ) n : 1;
+}
@@ -29,6 +29,7 @@
 #include <kproc/timeout.h>
 #include <kproc/lock.h>
 #include <kproc/sem.h>
+#include <kproc/cond.h>
 #include <klib/out.h>
 #include <klib/status.h>
 #include <klib/rc.h>
@@ -47,6 +48,48 @@
     ( void ) 0
 #endif
 
+/*--------------------------------------------------------------------------
+ * KQueueLF
+ *  the lock-free variant of KQueue
+ *
+ *  a bounded ring of cells, each with a sequence number telling the
+ *  position it is free for ( seq == pos ) or holding an item for
+ *  ( seq == pos + 1 ). producers and consumers claim runs of cells by
+ *  advancing "tail" and "head" with compare-and-swap, then publish the
+ *  cell by updating its sequence. no lock is taken unless a thread has
+ *  to sleep on a full or empty queue.
+ */
+#define KQUEUE_CACHE_LINE 64
+
+/* how often to retry before going to sleep */
+#define KQUEUE_SPIN 128
+
+typedef struct KQueueCell KQueueCell;
+struct KQueueCell
+{
+    atomic32_t seq;
+    void * volatile item;
+};
+
+typedef struct KQueueLF KQueueLF;
+struct KQueueLF
+{
+    atomic32_t tail;
+    uint8_t pad1 [ KQUEUE_CACHE_LINE - sizeof ( atomic32_t ) ];
+    atomic32_t head;
+    uint8_t pad2 [ KQUEUE_CACHE_LINE - sizeof ( atomic32_t ) ];
+
+    /* threads asleep on a full or empty queue */
+    atomic32_t push_waiting;
+    atomic32_t pop_waiting;
+    KLock * park;
+    KCondition * not_full;
+    KCondition * not_empty;
+
+    KQueueCell cell [ 1 ];
+};
+
+
 /*--------------------------------------------------------------------------
  * KQueue
  *  a simple thread-safe queue structure supporting push/pop operation
@@ -60,6 +103,9 @@ struct KQueue
     KLock *rl;
     KLock *wl;
 
+    /* non-NULL when made by KQueueMakeLockFree */
+    KQueueLF *lf;
+
     uint32_t capacity;
     uint32_t bmask, imask;
     volatile uint32_t read, write;
@@ -76,6 +122,16 @@ static
 rc_t KQueueWhack ( KQueue *self )
 {
     rc_t rc;
+    if ( self -> lf != NULL )
+    {
+        KConditionRelease ( self -> lf -> not_empty );
+        KConditionRelease ( self -> lf -> not_full );
+        KLockRelease ( self -> lf -> park );
+        free ( self -> lf );
+        free ( self );
+        return 0;
+    }
+
     QMSG ( "%s: releasing write semaphore\n", __func__ );
     rc = KSemaphoreRelease ( self -> wc );
     if ( rc == 0 )
@@ -151,6 +207,7 @@ LIB_EXPORT rc_t CC KQueueMake ( KQueue **qp, uint32_t capacity )
                         rc = KLockMake ( & q -> wl );
                         if ( rc == 0 )
                         {
+                            q -> lf = NULL;
                             q -> capacity = cap;
                             q -> bmask = cap - 1;
                             q -> imask = ( cap + cap ) - 1;
@@ -193,6 +250,11 @@ LIB_EXPORT rc_t CC KQueueMake ( KQueue **qp, uint32_t capacity )
  *  code indicating a timeout. when NULL and queue is full,
  *  Push will time out immediately and return status code.
  */
+static rc_t KQueueLFPush ( KQueue *self, const void * const *items,
+    uint32_t count, uint32_t *pushed, timeout_t *tm );
+static rc_t KQueueLFPop ( KQueue *self, void **items,
+    uint32_t count, uint32_t *popped, timeout_t *tm );
+
 LIB_EXPORT rc_t CC KQueuePush ( KQueue *self, const void *item, timeout_t *tm )
 {
     rc_t rc;
@@ -207,6 +269,12 @@ LIB_EXPORT rc_t CC KQueuePush ( KQueue *self, const void *item, timeout_t *tm )
     if ( item == NULL )
         return RC ( rcCont, rcQueue, rcInserting, rcParam, rcNull );
 
+    if ( self -> lf != NULL )
+    {
+        uint32_t pushed;
+        return KQueueLFPush ( self, & item, 1, & pushed, tm );
+    }
+
     QMSG ( "%s: acquiring write lock ( %p )...\n", __func__, self -> wl );
     rc = KLockAcquire ( self -> wl );
     QMSG ( "%s: ...done, rc = %R\n", __func__, rc );
@@ -300,6 +368,11 @@ LIB_EXPORT rc_t CC KQueuePop ( KQueue *self, void **item, timeout_t *tm )
 
         if ( self == NULL )
             rc = RC ( rcCont, rcQueue, rcRemoving, rcSelf, rcNull );
+        else if ( self -> lf != NULL )
+        {
+            uint32_t popped;
+            rc = KQueueLFPop ( self, item, 1, & popped, tm );
+        }
         else
         {
             QMSG ( "%s: acquiring read lock ( %p )\n", __func__, self -> rl );
@@ -399,6 +472,19 @@ LIB_EXPORT rc_t CC KQueueSeal ( KQueue *self )
 
     self -> sealed = true;
 
+    if ( self -> lf != NULL )
+    {
+        /* wake everybody asleep, to find the seal */
+        rc = KLockAcquire ( self -> lf -> park );
+        if ( rc == 0 )
+        {
+            KConditionBroadcast ( self -> lf -> not_full );
+            KConditionBroadcast ( self -> lf -> not_empty );
+            KLockUnlock ( self -> lf -> park );
+        }
+        return rc;
+    }
+
 #if 1
     QMSG ( "%s: acquiring write lock ( %p )\n", __func__, self -> wl );
     rc = KLockAcquire ( self -> wl );
@@ -426,3 +512,393 @@ LIB_EXPORT rc_t CC KQueueSeal ( KQueue *self )
 
     return rc;
 }
+
+
+/*--------------------------------------------------------------------------
+ * batches
+ */
+
+/* PushBatch
+ *  add up to "count" objects to the queue
+ */
+LIB_EXPORT rc_t CC KQueuePushBatch ( KQueue *self, const void * const *items,
+    uint32_t count, uint32_t *pushed, timeout_t *tm )
+{
+    rc_t rc;
+    uint32_t i;
+
+    if ( pushed == NULL )
+        return RC ( rcCont, rcQueue, rcInserting, rcParam, rcNull );
+    * pushed = 0;
+
+    if ( self == NULL )
+        return RC ( rcCont, rcQueue, rcInserting, rcSelf, rcNull );
+    if ( self -> sealed )
+        return RC ( rcCont, rcQueue, rcInserting, rcQueue, rcReadonly );
+    if ( items == NULL || count == 0 )
+        return RC ( rcCont, rcQueue, rcInserting, rcParam, rcNull );
+    for ( i = 0; i < count; ++ i )
+    {
+        if ( items [ i ] == NULL )
+            return RC ( rcCont, rcQueue, rcInserting, rcParam, rcNull );
+    }
+
+    if ( self -> lf != NULL )
+        return KQueueLFPush ( self, items, count, pushed, tm );
+
+    /* wait for the first one only */
+    rc = KQueuePush ( self, items [ 0 ], tm );
+    if ( rc == 0 )
+    {
+        for ( i = 1; i < count; ++ i )
+        {
+            if ( KQueuePush ( self, items [ i ], NULL ) != 0 )
+                break;
+        }
+        * pushed = i;
+    }
+    return rc;
+}
+
+/* PopBatch
+ *  pop up to "count" objects from the queue
+ */
+LIB_EXPORT rc_t CC KQueuePopBatch ( KQueue *self, void **items,
+    uint32_t count, uint32_t *popped, timeout_t *tm )
+{
+    rc_t rc;
+    uint32_t i;
+
+    if ( popped == NULL )
+        return RC ( rcCont, rcQueue, rcRemoving, rcParam, rcNull );
+    * popped = 0;
+
+    if ( items == NULL || count == 0 )
+        return RC ( rcCont, rcQueue, rcRemoving, rcParam, rcNull );
+    if ( self == NULL )
+        return RC ( rcCont, rcQueue, rcRemoving, rcSelf, rcNull );
+
+    if ( self -> lf != NULL )
+        return KQueueLFPop ( self, items, count, popped, tm );
+
+    /* wait for the first one only */
+    rc = KQueuePop ( self, & items [ 0 ], tm );
+    if ( rc == 0 )
+    {
+        for ( i = 1; i < count; ++ i )
+        {
+            if ( KQueuePop ( self, & items [ i ], NULL ) != 0 )
+                break;
+        }
+        * popped = i;
+    }
+    return rc;
+}
+
+
+/*--------------------------------------------------------------------------
+ * KQueueLF
+ */
+
+/* MakeLockFree
+ *  create an empty queue object without locks on push and pop
+ */
+LIB_EXPORT rc_t CC KQueueMakeLockFree ( KQueue **qp, uint32_t capacity )
+{
+    rc_t rc;
+    KQueue *q;
+    KQueueLF *lf;
+    uint32_t i, cap = 1;
+
+    if ( qp == NULL )
+        return RC ( rcCont, rcQueue, rcConstructing, rcParam, rcNull );
+    * qp = NULL;
+
+    /* sequence differences are taken as signed 32 bit values */
+    if ( capacity > 0x40000000 )
+        return RC ( rcCont, rcQueue, rcConstructing, rcParam, rcExcessive );
+    while ( cap < capacity )
+        cap += cap;
+
+    q = calloc ( 1, sizeof * q );
+    if ( q == NULL )
+        return RC ( rcCont, rcQueue, rcConstructing, rcMemory, rcExhausted );
+
+    lf = calloc ( 1, sizeof * lf - sizeof lf -> cell + cap * sizeof lf -> cell [ 0 ] );
+    if ( lf == NULL )
+        rc = RC ( rcCont, rcQueue, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        rc = KLockMake ( & lf -> park );
+        if ( rc == 0 )
+        {
+            rc = KConditionMake ( & lf -> not_full );
+            if ( rc == 0 )
+            {
+                rc = KConditionMake ( & lf -> not_empty );
+                if ( rc == 0 )
+                {
+                    for ( i = 0; i < cap; ++ i )
+                        atomic32_set ( & lf -> cell [ i ] . seq, ( int ) i );
+                    atomic32_set ( & lf -> tail, 0 );
+                    atomic32_set ( & lf -> head, 0 );
+                    atomic32_set ( & lf -> push_waiting, 0 );
+                    atomic32_set ( & lf -> pop_waiting, 0 );
+
+                    q -> lf = lf;
+                    q -> capacity = cap;
+                    q -> bmask = cap - 1;
+                    atomic32_set ( & q -> refcount, 1 );
+                    q -> sealed = false;
+
+                    * qp = q;
+                    return 0;
+                }
+                KConditionRelease ( lf -> not_full );
+            }
+            KLockRelease ( lf -> park );
+        }
+        free ( lf );
+    }
+    free ( q );
+    return rc;
+}
+
+#define CELL_SEQ( lf, bmask, pos ) \
+    ( ( uint32_t ) atomic32_read ( & ( lf ) -> cell [ ( pos ) & ( bmask ) ] . seq ) )
+
+/* TryPush
+ *  claims the longest run of free cells up to "count" and fills it
+ *  returns the number of items pushed, 0 if the queue is full
+ */
+static
+uint32_t KQueueLFTryPush ( KQueueLF *lf, uint32_t bmask,
+    const void * const *items, uint32_t count )
+{
+    uint32_t pos = ( uint32_t ) atomic32_read ( & lf -> tail );
+    while ( 1 )
+    {
+        uint32_t i, n, prior;
+
+        for ( n = 0; n < count; ++ n )
+        {
+            if ( CELL_SEQ ( lf, bmask, pos + n ) != pos + n )
+                break;
+        }
+
+        if ( n == 0 )
+        {
+            /* a cell still holding an item from the last lap means full,
+               anything else that "pos" is out of date */
+            if ( ( int32_t ) ( CELL_SEQ ( lf, bmask, pos ) - pos ) < 0 )
+                return 0;
+            pos = ( uint32_t ) atomic32_read ( & lf -> tail );
+            continue;
+        }
+
+        prior = ( uint32_t ) atomic32_test_and_set ( & lf -> tail, ( int ) ( pos + n ), ( int ) pos );
+        if ( prior == pos )
+        {
+            for ( i = 0; i < n; ++ i )
+            {
+                KQueueCell *c = & lf -> cell [ ( pos + i ) & bmask ];
+                c -> item = ( void* ) items [ i ];
+                atomic32_set ( & c -> seq, ( int ) ( pos + i + 1 ) );
+            }
+            return n;
+        }
+        pos = prior;
+    }
+}
+
+/* TryPop
+ *  claims the longest run of filled cells up to "count" and empties it
+ *  returns the number of items popped, 0 if the queue is empty
+ */
+static
+uint32_t KQueueLFTryPop ( KQueueLF *lf, uint32_t bmask,
+    void **items, uint32_t count )
+{
+    uint32_t pos = ( uint32_t ) atomic32_read ( & lf -> head );
+    while ( 1 )
+    {
+        uint32_t i, n, prior;
+
+        for ( n = 0; n < count; ++ n )
+        {
+            if ( CELL_SEQ ( lf, bmask, pos + n ) != pos + n + 1 )
+                break;
+        }
+
+        if ( n == 0 )
+        {
+            if ( ( int32_t ) ( CELL_SEQ ( lf, bmask, pos ) - ( pos + 1 ) ) < 0 )
+                return 0;
+            pos = ( uint32_t ) atomic32_read ( & lf -> head );
+            continue;
+        }
+
+        prior = ( uint32_t ) atomic32_test_and_set ( & lf -> head, ( int ) ( pos + n ), ( int ) pos );
+        if ( prior == pos )
+        {
+            for ( i = 0; i < n; ++ i )
+            {
+                KQueueCell *c = & lf -> cell [ ( pos + i ) & bmask ];
+                items [ i ] = c -> item;
+                c -> item = NULL;
+                atomic32_set ( & c -> seq, ( int ) ( pos + i + bmask + 1 ) );
+            }
+            return n;
+        }
+        pos = prior;
+    }
+}
+
+/* Full
+ * Empty
+ *  whether the next cell to push to still holds an item,
+ *  or the next one to pop from has none yet
+ */
+static
+bool KQueueLFFull ( KQueueLF *lf, uint32_t bmask )
+{
+    uint32_t pos = ( uint32_t ) atomic32_read ( & lf -> tail );
+    return ( int32_t ) ( CELL_SEQ ( lf, bmask, pos ) - pos ) < 0;
+}
+
+static
+bool KQueueLFEmpty ( KQueueLF *lf, uint32_t bmask )
+{
+    uint32_t pos = ( uint32_t ) atomic32_read ( & lf -> head );
+    return ( int32_t ) ( CELL_SEQ ( lf, bmask, pos ) - ( pos + 1 ) ) < 0;
+}
+
+/* Wake
+ *  wakes one sleeper per item moved, if there is any
+ *  the interlocked read orders it after the cell update, matching
+ *  a sleeper that counts itself before it looks at the cells
+ */
+static
+void KQueueLFWake ( KQueueLF *lf, atomic32_t *waiting, KCondition *cond, uint32_t moved )
+{
+    if ( atomic32_read_and_add ( waiting, 0 ) != 0 )
+    {
+        if ( KLockAcquire ( lf -> park ) == 0 )
+        {
+            if ( moved > 1 )
+                KConditionBroadcast ( cond );
+            else
+                KConditionSignal ( cond );
+            KLockUnlock ( lf -> park );
+        }
+    }
+}
+
+static
+rc_t KQueueLFPush ( KQueue *self, const void * const *items,
+    uint32_t count, uint32_t *pushed, timeout_t *tm )
+{
+    KQueueLF *lf = self -> lf;
+    uint32_t spin = 0;
+
+    * pushed = 0;
+    while ( 1 )
+    {
+        rc_t rc = 0;
+        uint32_t n = KQueueLFTryPush ( lf, self -> bmask, items, count );
+        if ( n != 0 )
+        {
+            * pushed = n;
+            KQueueLFWake ( lf, & lf -> pop_waiting, lf -> not_empty, n );
+            return 0;
+        }
+
+        if ( self -> sealed )
+            return RC ( rcCont, rcQueue, rcInserting, rcQueue, rcReadonly );
+        if ( tm == NULL )
+            return RC ( rcCont, rcQueue, rcInserting, rcTimeout, rcExhausted );
+        if ( ++ spin < KQUEUE_SPIN )
+            continue;
+
+        rc = KLockAcquire ( lf -> park );
+        if ( rc != 0 )
+            return rc;
+        atomic32_inc ( & lf -> push_waiting );
+        if ( ! self -> sealed && KQueueLFFull ( lf, self -> bmask ) )
+        {
+            rc = KConditionTimedWait ( lf -> not_full, lf -> park, tm );
+        }
+        atomic32_dec ( & lf -> push_waiting );
+        KLockUnlock ( lf -> park );
+
+        if ( rc != 0 )
+        {
+            if ( self -> sealed )
+                return RC ( rcCont, rcQueue, rcInserting, rcQueue, rcReadonly );
+            if ( GetRCObject ( rc ) == ( enum RCObject ) rcTimeout )
+                return RC ( rcCont, rcQueue, rcInserting, rcTimeout, rcExhausted );
+            return rc;
+        }
+        spin = 0;
+    }
+}
+
+static
+rc_t KQueueLFPop ( KQueue *self, void **items,
+    uint32_t count, uint32_t *popped, timeout_t *tm )
+{
+    KQueueLF *lf = self -> lf;
+    uint32_t spin = 0;
+
+    * popped = 0;
+    while ( 1 )
+    {
+        rc_t rc = 0;
+        uint32_t n = KQueueLFTryPop ( lf, self -> bmask, items, count );
+        if ( n != 0 )
+        {
+            * popped = n;
+            KQueueLFWake ( lf, & lf -> push_waiting, lf -> not_full, n );
+            return 0;
+        }
+
+        /* try once more after seeing the seal, for pushes that
+           completed in between */
+        if ( self -> sealed )
+        {
+            n = KQueueLFTryPop ( lf, self -> bmask, items, count );
+            if ( n == 0 )
+                return RC ( rcCont, rcQueue, rcRemoving, rcData, rcDone );
+            * popped = n;
+            KQueueLFWake ( lf, & lf -> push_waiting, lf -> not_full, n );
+            return 0;
+        }
+        if ( tm == NULL )
+            return RC ( rcCont, rcQueue, rcRemoving, rcTimeout, rcExhausted );
+        if ( ++ spin < KQUEUE_SPIN )
+            continue;
+
+        rc = KLockAcquire ( lf -> park );
+        if ( rc != 0 )
+            return rc;
+        atomic32_inc ( & lf -> pop_waiting );
+        if ( ! self -> sealed && KQueueLFEmpty ( lf, self -> bmask ) )
+        {
+            rc = KConditionTimedWait ( lf -> not_empty, lf -> park, tm );
+        }
+        atomic32_dec ( & lf -> pop_waiting );
+        KLockUnlock ( lf -> park );
+
+        if ( rc != 0 )
+        {
+            if ( GetRCObject ( rc ) == ( enum RCObject ) rcTimeout )
+            {
+                if ( self -> sealed )
+                    continue;
+                return RC ( rcCont, rcQueue, rcRemoving, rcTimeout, rcExhausted );
+            }
+            return rc;
+        }
+        spin = 0;
+    }
+}
@@ -0,0 +1,236 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <kproc/extern.h>
+
+#include <kproc/threadpool.h>
+#include <kproc/task.h>
+#include <klib/refcount.h>
+#include <klib/rc.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+
+#define rcTask rcCmd
+
+
+/*--------------------------------------------------------------------------
+ * KTaskFuture
+ *  without threads, tasks run as they are submitted
+ */
+struct KTaskFuture
+{
+    KRefcount refcount;
+    rc_t status;
+};
+
+
+/* AddRef
+ * Release
+ */
+LIB_EXPORT rc_t CC KTaskFutureAddRef ( const KTaskFuture *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountAdd ( & self -> refcount, "KTaskFuture" ) )
+        {
+        case krefLimit:
+            return RC ( rcPS, rcTask, rcAttaching, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+LIB_EXPORT rc_t CC KTaskFutureRelease ( const KTaskFuture *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountDrop ( & self -> refcount, "KTaskFuture" ) )
+        {
+        case krefWhack:
+            KRefcountWhack ( & ( ( KTaskFuture* ) self ) -> refcount, "KTaskFuture" );
+            free ( ( KTaskFuture* ) self );
+            break;
+        case krefNegative:
+            return RC ( rcPS, rcTask, rcReleasing, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+
+/* Wait
+ */
+LIB_EXPORT rc_t CC KTaskFutureWait ( KTaskFuture *self,
+    rc_t *status, struct timeout_t *tm )
+{
+    if ( status == NULL )
+        return RC ( rcPS, rcTask, rcWaiting, rcParam, rcNull );
+    * status = 0;
+    if ( self == NULL )
+        return RC ( rcPS, rcTask, rcWaiting, rcSelf, rcNull );
+    * status = self -> status;
+    return 0;
+}
+
+
+/* Done
+ */
+LIB_EXPORT bool CC KTaskFutureDone ( const KTaskFuture *self )
+{
+    return self != NULL;
+}
+
+
+/*--------------------------------------------------------------------------
+ * KThreadPool
+ *  a pool without workers
+ */
+struct KThreadPool
+{
+    KRefcount refcount;
+};
+
+static KThreadPool s_default_pool;
+static bool s_default_made;
+
+
+/* Make
+ */
+LIB_EXPORT rc_t CC KThreadPoolMake ( KThreadPool **pool, uint32_t threads )
+{
+    KThreadPool * self;
+
+    if ( pool == NULL )
+        return RC ( rcPS, rcThread, rcConstructing, rcParam, rcNull );
+
+    self = malloc ( sizeof * self );
+    if ( self == NULL )
+    {
+        * pool = NULL;
+        return RC ( rcPS, rcThread, rcConstructing, rcMemory, rcExhausted );
+    }
+
+    KRefcountInit ( & self -> refcount, 1, "KThreadPool", "make", "pool" );
+    * pool = self;
+    return 0;
+}
+
+
+/* AddRef
+ * Release
+ */
+LIB_EXPORT rc_t CC KThreadPoolAddRef ( const KThreadPool *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountAdd ( & self -> refcount, "KThreadPool" ) )
+        {
+        case krefLimit:
+            return RC ( rcPS, rcThread, rcAttaching, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+LIB_EXPORT rc_t CC KThreadPoolRelease ( const KThreadPool *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountDrop ( & self -> refcount, "KThreadPool" ) )
+        {
+        case krefWhack:
+            KRefcountWhack ( & ( ( KThreadPool* ) self ) -> refcount, "KThreadPool" );
+            if ( self != & s_default_pool )
+                free ( ( KThreadPool* ) self );
+            break;
+        case krefNegative:
+            return RC ( rcPS, rcThread, rcReleasing, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+
+/* Submit
+ *  runs the task on the calling thread
+ */
+LIB_EXPORT rc_t CC KThreadPoolSubmit ( KThreadPool *self,
+    KTask *task, KTaskFuture **future )
+{
+    rc_t status;
+
+    if ( future != NULL )
+        * future = NULL;
+    if ( self == NULL )
+        return RC ( rcPS, rcThread, rcInserting, rcSelf, rcNull );
+    if ( task == NULL )
+        return RC ( rcPS, rcThread, rcInserting, rcParam, rcNull );
+
+    status = KTaskExecute ( task );
+
+    if ( future != NULL )
+    {
+        KTaskFuture * f = malloc ( sizeof * f );
+        if ( f == NULL )
+            return RC ( rcPS, rcThread, rcInserting, rcMemory, rcExhausted );
+        KRefcountInit ( & f -> refcount, 1, "KTaskFuture", "make", "future" );
+        f -> status = status;
+        * future = f;
+    }
+    return 0;
+}
+
+
+/* Threads
+ */
+LIB_EXPORT uint32_t CC KThreadPoolThreads ( const KThreadPool *self )
+{
+    return 0;
+}
+
+
+/* GetDefault
+ * SetDefaultThreads
+ */
+LIB_EXPORT rc_t CC KThreadPoolGetDefault ( KThreadPool **pool )
+{
+    if ( pool == NULL )
+        return RC ( rcPS, rcThread, rcAccessing, rcParam, rcNull );
+
+    if ( ! s_default_made )
+    {
+        KRefcountInit ( & s_default_pool . refcount, 1, "KThreadPool", "make", "default" );
+        s_default_made = true;
+    }
+
+    * pool = & s_default_pool;
+    return KThreadPoolAddRef ( & s_default_pool );
+}
+
+LIB_EXPORT void CC KThreadPoolSetDefaultThreads ( uint32_t threads )
+{
+}
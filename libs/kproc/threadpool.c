@@ -0,0 +1,687 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <kproc/extern.h>
+
+#include <kproc/threadpool.h>
+#include <kproc/task.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <kproc/procmgr.h>
+#include <kfg/config.h>
+#include <klib/refcount.h>
+#include <klib/rc.h>
+#include <atomic32.h>
+#include <atomic.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define rcTask rcCmd
+
+
+/*--------------------------------------------------------------------------
+ * KTaskFuture
+ *  the outcome of a task submitted to a KThreadPool
+ *
+ *  a future is queued by the pool and handed out to the submitter.
+ *  whoever moves it from queued to running executes the task,
+ *  be it a worker or a thread waiting for the result.
+ */
+enum
+{
+    ktfQueued,
+    ktfRunning,
+    ktfDone
+};
+
+struct KTaskFuture
+{
+    KTask * task;
+    KLock * lock;
+    KCondition * done;
+    KRefcount refcount;
+    atomic32_t state;
+    rc_t status;
+};
+
+static
+rc_t KTaskFutureWhack ( KTaskFuture * self )
+{
+    KRefcountWhack ( & self -> refcount, "KTaskFuture" );
+    KTaskRelease ( self -> task );
+    KConditionRelease ( self -> done );
+    KLockRelease ( self -> lock );
+    free ( self );
+    return 0;
+}
+
+static
+rc_t KTaskFutureMake ( KTaskFuture ** future, KTask * task )
+{
+    rc_t rc;
+    KTaskFuture * f = calloc ( 1, sizeof * f );
+    if ( f == NULL )
+        return RC ( rcPS, rcTask, rcCreating, rcMemory, rcExhausted );
+
+    rc = KLockMake ( & f -> lock );
+    if ( rc == 0 )
+    {
+        rc = KConditionMake ( & f -> done );
+        if ( rc == 0 )
+        {
+            rc = KTaskAddRef ( task );
+            if ( rc == 0 )
+            {
+                f -> task = task;
+                atomic32_set ( & f -> state, ktfQueued );
+                KRefcountInit ( & f -> refcount, 1, "KTaskFuture", "make", "future" );
+                * future = f;
+                return 0;
+            }
+            KConditionRelease ( f -> done );
+        }
+        KLockRelease ( f -> lock );
+    }
+    free ( f );
+    return rc;
+}
+
+/* Claim
+ *  returns true if the caller is to run the task
+ */
+static
+bool KTaskFutureClaim ( KTaskFuture * self )
+{
+    return atomic32_test_and_set ( & self -> state, ktfRunning, ktfQueued ) == ktfQueued;
+}
+
+static
+void KTaskFutureRun ( KTaskFuture * self )
+{
+    rc_t status = KTaskExecute ( self -> task );
+    KTaskRelease ( self -> task );
+    self -> task = NULL;
+
+    KLockAcquire ( self -> lock );
+    self -> status = status;
+    atomic32_set ( & self -> state, ktfDone );
+    KConditionBroadcast ( self -> done );
+    KLockUnlock ( self -> lock );
+}
+
+
+/* AddRef
+ * Release
+ */
+LIB_EXPORT rc_t CC KTaskFutureAddRef ( const KTaskFuture *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountAdd ( & self -> refcount, "KTaskFuture" ) )
+        {
+        case krefLimit:
+            return RC ( rcPS, rcTask, rcAttaching, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+LIB_EXPORT rc_t CC KTaskFutureRelease ( const KTaskFuture *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountDrop ( & self -> refcount, "KTaskFuture" ) )
+        {
+        case krefWhack:
+            return KTaskFutureWhack ( ( KTaskFuture* ) self );
+        case krefNegative:
+            return RC ( rcPS, rcTask, rcReleasing, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+
+/* Wait
+ *  waits for the task to complete and returns its status
+ */
+LIB_EXPORT rc_t CC KTaskFutureWait ( KTaskFuture *self,
+    rc_t *status, struct timeout_t *tm )
+{
+    rc_t rc;
+
+    if ( status == NULL )
+        return RC ( rcPS, rcTask, rcWaiting, rcParam, rcNull );
+    * status = 0;
+    if ( self == NULL )
+        return RC ( rcPS, rcTask, rcWaiting, rcSelf, rcNull );
+
+    /* nobody has started it - do it here rather than wait for a worker */
+    if ( KTaskFutureClaim ( self ) )
+        KTaskFutureRun ( self );
+
+    rc = KLockAcquire ( self -> lock );
+    if ( rc == 0 )
+    {
+        while ( rc == 0 && atomic32_read ( & self -> state ) != ktfDone )
+        {
+            if ( tm == NULL )
+                rc = KConditionWait ( self -> done, self -> lock );
+            else
+                rc = KConditionTimedWait ( self -> done, self -> lock, tm );
+        }
+        if ( rc == 0 )
+            * status = self -> status;
+        KLockUnlock ( self -> lock );
+    }
+    return rc;
+}
+
+
+/* Done
+ *  returns true once the task has completed
+ */
+LIB_EXPORT bool CC KTaskFutureDone ( const KTaskFuture *self )
+{
+    return self != NULL && atomic32_read ( & self -> state ) == ktfDone;
+}
+
+
+/*--------------------------------------------------------------------------
+ * KThreadPoolDeque
+ *  a growable ring of futures, newest at the back
+ *  the owning worker pops from the back, thieves from the front
+ */
+#define DEQUE_INIT_CAPACITY 64
+
+typedef struct KThreadPoolDeque KThreadPoolDeque;
+struct KThreadPoolDeque
+{
+    KLock * lock;
+    KTaskFuture ** item;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;  /* a power of 2 */
+};
+
+static
+rc_t KThreadPoolDequeInit ( KThreadPoolDeque * self )
+{
+    rc_t rc;
+    self -> item = malloc ( DEQUE_INIT_CAPACITY * sizeof * self -> item );
+    if ( self -> item == NULL )
+        return RC ( rcPS, rcQueue, rcConstructing, rcMemory, rcExhausted );
+
+    rc = KLockMake ( & self -> lock );
+    if ( rc != 0 )
+    {
+        free ( self -> item );
+        self -> item = NULL;
+        return rc;
+    }
+
+    self -> head = 0;
+    self -> count = 0;
+    self -> capacity = DEQUE_INIT_CAPACITY;
+    return 0;
+}
+
+static
+void KThreadPoolDequeWhack ( KThreadPoolDeque * self )
+{
+    /* the pool runs all tasks before tearing down the queues */
+    assert ( self -> count == 0 );
+    KLockRelease ( self -> lock );
+    free ( self -> item );
+}
+
+static
+rc_t KThreadPoolDequePush ( KThreadPoolDeque * self, KTaskFuture * f )
+{
+    rc_t rc = KLockAcquire ( self -> lock );
+    if ( rc == 0 )
+    {
+        if ( self -> count == self -> capacity )
+        {
+            uint32_t i;
+            KTaskFuture ** item = malloc ( 2 * self -> capacity * sizeof * item );
+            if ( item == NULL )
+                rc = RC ( rcPS, rcQueue, rcInserting, rcMemory, rcExhausted );
+            else
+            {
+                for ( i = 0; i < self -> count; ++ i )
+                    item [ i ] = self -> item [ ( self -> head + i ) & ( self -> capacity - 1 ) ];
+                free ( self -> item );
+                self -> item = item;
+                self -> head = 0;
+                self -> capacity *= 2;
+            }
+        }
+        if ( rc == 0 )
+        {
+            self -> item [ ( self -> head + self -> count ) & ( self -> capacity - 1 ) ] = f;
+            ++ self -> count;
+        }
+        KLockUnlock ( self -> lock );
+    }
+    return rc;
+}
+
+static
+KTaskFuture * KThreadPoolDequePopBack ( KThreadPoolDeque * self )
+{
+    KTaskFuture * f = NULL;
+    if ( KLockAcquire ( self -> lock ) == 0 )
+    {
+        if ( self -> count != 0 )
+        {
+            -- self -> count;
+            f = self -> item [ ( self -> head + self -> count ) & ( self -> capacity - 1 ) ];
+        }
+        KLockUnlock ( self -> lock );
+    }
+    return f;
+}
+
+static
+KTaskFuture * KThreadPoolDequePopFront ( KThreadPoolDeque * self )
+{
+    KTaskFuture * f = NULL;
+    if ( KLockAcquire ( self -> lock ) == 0 )
+    {
+        if ( self -> count != 0 )
+        {
+            f = self -> item [ self -> head ];
+            self -> head = ( self -> head + 1 ) & ( self -> capacity - 1 );
+            -- self -> count;
+        }
+        KLockUnlock ( self -> lock );
+    }
+    return f;
+}
+
+
+/*--------------------------------------------------------------------------
+ * KThreadPool
+ */
+typedef struct KThreadPoolWorker KThreadPoolWorker;
+struct KThreadPoolWorker
+{
+    KThreadPoolDeque deque;
+    struct KThreadPool * pool;
+    KThread * thread;
+    uint32_t idx;
+};
+
+struct KThreadPool
+{
+    KThreadPoolWorker * worker;
+
+    /* idle workers sleep on "wake" */
+    KLock * lock;
+    KCondition * wake;
+    atomic32_t sleeping;
+
+    atomic32_t pending;     /* futures in all queues */
+    atomic32_t next;        /* queue for the next submission */
+
+    KRefcount refcount;
+    uint32_t threads;
+    bool shutdown;
+};
+
+/* Take
+ *  the newest future of the worker's own queue,
+ *  or else the oldest of the first other non-empty queue
+ */
+static
+KTaskFuture * KThreadPoolTake ( KThreadPool * self, KThreadPoolWorker * w )
+{
+    uint32_t i;
+    KTaskFuture * f = KThreadPoolDequePopBack ( & w -> deque );
+    for ( i = 1; f == NULL && i < self -> threads; ++ i )
+    {
+        KThreadPoolWorker * victim = & self -> worker [ ( w -> idx + i ) % self -> threads ];
+        f = KThreadPoolDequePopFront ( & victim -> deque );
+    }
+    if ( f != NULL )
+        atomic32_dec ( & self -> pending );
+    return f;
+}
+
+static
+rc_t CC KThreadPoolWorkerRun ( const KThread * t, void * data )
+{
+    KThreadPoolWorker * w = data;
+    KThreadPool * self = w -> pool;
+
+    while ( 1 )
+    {
+        bool quit;
+        KTaskFuture * f = KThreadPoolTake ( self, w );
+        if ( f != NULL )
+        {
+            /* a waiter may have run it already */
+            if ( KTaskFutureClaim ( f ) )
+                KTaskFutureRun ( f );
+            KTaskFutureRelease ( f );
+            continue;
+        }
+
+        KLockAcquire ( self -> lock );
+        atomic32_inc ( & self -> sleeping );
+        while ( atomic32_read ( & self -> pending ) == 0 && ! self -> shutdown )
+            KConditionWait ( self -> wake, self -> lock );
+        atomic32_dec ( & self -> sleeping );
+        quit = self -> shutdown && atomic32_read ( & self -> pending ) == 0;
+        KLockUnlock ( self -> lock );
+
+        if ( quit )
+            break;
+    }
+    return 0;
+}
+
+/* Stop
+ *  lets the first "started" workers finish the queued tasks and joins them
+ */
+static
+void KThreadPoolStop ( KThreadPool * self, uint32_t started )
+{
+    uint32_t i;
+
+    KLockAcquire ( self -> lock );
+    self -> shutdown = true;
+    KConditionBroadcast ( self -> wake );
+    KLockUnlock ( self -> lock );
+
+    for ( i = 0; i < started; ++ i )
+    {
+        rc_t status;
+        KThreadWait ( self -> worker [ i ] . thread, & status );
+        KThreadRelease ( self -> worker [ i ] . thread );
+    }
+}
+
+static
+void KThreadPoolFree ( KThreadPool * self, uint32_t deques )
+{
+    uint32_t i;
+    for ( i = 0; i < deques; ++ i )
+        KThreadPoolDequeWhack ( & self -> worker [ i ] . deque );
+    free ( self -> worker );
+    KConditionRelease ( self -> wake );
+    KLockRelease ( self -> lock );
+    free ( self );
+}
+
+static
+rc_t KThreadPoolWhack ( KThreadPool * self )
+{
+    KRefcountWhack ( & self -> refcount, "KThreadPool" );
+    KThreadPoolStop ( self, self -> threads );
+    KThreadPoolFree ( self, self -> threads );
+    return 0;
+}
+
+
+/* Make
+ *  create a pool
+ */
+LIB_EXPORT rc_t CC KThreadPoolMake ( KThreadPool **pool, uint32_t threads )
+{
+    rc_t rc;
+    KThreadPool * self;
+    uint32_t i;
+
+    if ( pool == NULL )
+        return RC ( rcPS, rcThread, rcConstructing, rcParam, rcNull );
+    * pool = NULL;
+
+    if ( threads == 0 )
+        threads = KProcMgrGetNumProcessors ();
+
+    self = calloc ( 1, sizeof * self );
+    if ( self == NULL )
+        return RC ( rcPS, rcThread, rcConstructing, rcMemory, rcExhausted );
+
+    self -> worker = calloc ( threads, sizeof * self -> worker );
+    if ( self -> worker == NULL )
+    {
+        free ( self );
+        return RC ( rcPS, rcThread, rcConstructing, rcMemory, rcExhausted );
+    }
+
+    i = 0;
+    rc = KLockMake ( & self -> lock );
+    if ( rc == 0 )
+        rc = KConditionMake ( & self -> wake );
+    while ( rc == 0 && i < threads )
+    {
+        rc = KThreadPoolDequeInit ( & self -> worker [ i ] . deque );
+        if ( rc == 0 )
+            ++ i;
+    }
+    if ( rc != 0 )
+    {
+        KThreadPoolFree ( self, i );
+        return rc;
+    }
+
+    self -> threads = threads;
+    atomic32_set ( & self -> sleeping, 0 );
+    atomic32_set ( & self -> pending, 0 );
+    atomic32_set ( & self -> next, 0 );
+    KRefcountInit ( & self -> refcount, 1, "KThreadPool", "make", "pool" );
+
+    for ( i = 0; i < threads; ++ i )
+    {
+        KThreadPoolWorker * w = & self -> worker [ i ];
+        w -> pool = self;
+        w -> idx = i;
+        rc = KThreadMake ( & w -> thread, KThreadPoolWorkerRun, w );
+        if ( rc != 0 )
+        {
+            KThreadPoolStop ( self, i );
+            KRefcountWhack ( & self -> refcount, "KThreadPool" );
+            KThreadPoolFree ( self, threads );
+            return rc;
+        }
+    }
+
+    * pool = self;
+    return 0;
+}
+
+
+/* AddRef
+ * Release
+ */
+LIB_EXPORT rc_t CC KThreadPoolAddRef ( const KThreadPool *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountAdd ( & self -> refcount, "KThreadPool" ) )
+        {
+        case krefLimit:
+            return RC ( rcPS, rcThread, rcAttaching, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+LIB_EXPORT rc_t CC KThreadPoolRelease ( const KThreadPool *self )
+{
+    if ( self != NULL )
+    {
+        switch ( KRefcountDrop ( & self -> refcount, "KThreadPool" ) )
+        {
+        case krefWhack:
+            return KThreadPoolWhack ( ( KThreadPool* ) self );
+        case krefNegative:
+            return RC ( rcPS, rcThread, rcReleasing, rcRange, rcExcessive );
+        }
+    }
+    return 0;
+}
+
+
+/* Submit
+ *  queue a task for execution on one of the workers
+ */
+LIB_EXPORT rc_t CC KThreadPoolSubmit ( KThreadPool *self,
+    KTask *task, KTaskFuture **future )
+{
+    rc_t rc;
+    KTaskFuture * f;
+    KThreadPoolWorker * w;
+
+    if ( future != NULL )
+        * future = NULL;
+    if ( self == NULL )
+        return RC ( rcPS, rcThread, rcInserting, rcSelf, rcNull );
+    if ( task == NULL )
+        return RC ( rcPS, rcThread, rcInserting, rcParam, rcNull );
+
+    rc = KTaskFutureMake ( & f, task );
+    if ( rc != 0 )
+        return rc;
+
+    if ( future != NULL )
+    {
+        rc = KTaskFutureAddRef ( f );
+        if ( rc != 0 )
+        {
+            KTaskFutureRelease ( f );
+            return rc;
+        }
+    }
+
+    w = & self -> worker [ ( uint32_t ) atomic32_read_and_add ( & self -> next, 1 ) % self -> threads ];
+    rc = KThreadPoolDequePush ( & w -> deque, f );
+    if ( rc != 0 )
+    {
+        if ( future != NULL )
+            KTaskFutureRelease ( f );
+        KTaskFutureRelease ( f );
+        return rc;
+    }
+
+    /* a worker going to sleep counts itself before it looks at "pending",
+       so one of the two sees the other */
+    atomic32_inc ( & self -> pending );
+    if ( atomic32_read ( & self -> sleeping ) != 0 )
+    {
+        KLockAcquire ( self -> lock );
+        KConditionSignal ( self -> wake );
+        KLockUnlock ( self -> lock );
+    }
+
+    if ( future != NULL )
+        * future = f;
+    return 0;
+}
+
+
+/* Threads
+ *  returns the number of workers
+ */
+LIB_EXPORT uint32_t CC KThreadPoolThreads ( const KThreadPool *self )
+{
+    return self == NULL ? 0 : self -> threads;
+}
+
+
+/*--------------------------------------------------------------------------
+ * the process-wide pool
+ */
+static atomic_ptr_t s_default_pool;
+static uint32_t s_default_threads;
+
+#define MAX_DEFAULT_THREADS 1024
+
+/* a size set by the application wins over "/kproc/threads",
+   which is read only when the pool is first needed */
+static
+uint32_t KThreadPoolDefaultThreads ( void )
+{
+    KConfig * kfg;
+    uint32_t threads = s_default_threads;
+
+    if ( threads == 0 && KConfigMake ( & kfg, NULL ) == 0 )
+    {
+        uint64_t value;
+        if ( KConfigReadU64 ( kfg, "/kproc/threads", & value ) == 0
+             && value <= MAX_DEFAULT_THREADS )
+        {
+            threads = ( uint32_t ) value;
+        }
+        KConfigRelease ( kfg );
+    }
+    return threads;
+}
+
+LIB_EXPORT rc_t CC KThreadPoolGetDefault ( KThreadPool **pool )
+{
+    rc_t rc;
+    KThreadPool * self;
+
+    if ( pool == NULL )
+        return RC ( rcPS, rcThread, rcAccessing, rcParam, rcNull );
+
+    self = s_default_pool . ptr;
+    if ( self == NULL )
+    {
+        KThreadPool * prior;
+        rc = KThreadPoolMake ( & self, KThreadPoolDefaultThreads () );
+        if ( rc != 0 )
+        {
+            * pool = NULL;
+            return rc;
+        }
+
+        /* lost a race with another thread */
+        prior = atomic_test_and_set_ptr ( & s_default_pool, self, NULL );
+        if ( prior != NULL )
+        {
+            KThreadPoolRelease ( self );
+            self = prior;
+        }
+    }
+
+    rc = KThreadPoolAddRef ( self );
+    * pool = rc == 0 ? self : NULL;
+    return rc;
+}
+
+LIB_EXPORT void CC KThreadPoolSetDefaultThreads ( uint32_t threads )
+{
+    s_default_threads = threads;
+}
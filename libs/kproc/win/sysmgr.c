@@ -26,6 +26,7 @@
 
 #include <kproc/extern.h>
 #include <kproc/procmgr.h>
+#include <os-native.h>
 
 /* OnMainThread
  *  returns true if running on main thread
@@ -35,3 +36,13 @@ LIB_EXPORT bool CC KProcMgrOnMainThread ( void )
     /* don't know how to do this on Winders */
     return false;
 }
+
+/* GetNumProcessors
+ *  returns the number of online processors, at least 1
+ */
+LIB_EXPORT uint32_t CC KProcMgrGetNumProcessors ( void )
+{
+    SYSTEM_INFO sinfo;
+    GetSystemInfo ( & sinfo );
+    return sinfo . dwNumberOfProcessors > 0 ? ( uint32_t ) sinfo . dwNumberOfProcessors : 1;
+}
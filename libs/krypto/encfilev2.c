@@ -42,6 +42,11 @@
 /* #include <klib/status.h> */
 #include <kfs/file.h>
 #include <kfs/sra.h>
+typedef struct KEncFileDecryptTask KEncFileDecryptTask;
+#define KTASK_IMPL KEncFileDecryptTask
+#include <kproc/task.h>
+#include <kproc/impl.h>
+#include <kproc/threadpool.h>
 #include <sysalloc.h>
 
 #include <byteswap.h>
@@ -73,6 +78,8 @@ struct KEncFileCiphers
 
 typedef struct KEncFileIVec { uint8_t ivec [16]; } KEncFileIVec;
 
+typedef struct KEncFileReader KEncFileReader;
+
 /* -----
  */
 struct KEncFile
@@ -80,6 +87,7 @@ struct KEncFile
     KFile dad;                  /* base class */
     KFile * encrypted;          /* encrypted file as a KFile */
     KEncFileCiphers ciphers;    /* file and block ciphers */
+    KEncFileReader * reader;    /* windowed parallel decryption for read only */
     KEncFileBlock block;        /* current data block */
     KEncFileFooter foot;        /* contains crc checksum and block count */
     uint64_t dec_size;          /* size of decrypted file */
@@ -789,8 +797,9 @@ rc_t KEncFileBlockEncrypt (KEncFile * self, KEncFileBlock * d,
  * the body of this function at a time it could be made thread safe.
  */
 static
-rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
-                           const KEncFileBlock * e, KEncFileBlock * d)
+rc_t KEncFileBlockDecryptCiphers (const KEncFileCiphers * ciphers, bool bswap,
+                                  KEncFileBlockId bid,
+                                  const KEncFileBlock * e, KEncFileBlock * d)
 {
     KEncFileIVec ivec;
     rc_t rc;
@@ -803,11 +812,11 @@ rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
     /*
      * set the ivec for both the master and data block ciphers
      */
-    rc = KCipherSetDecryptIVec (self->ciphers.master, &ivec);
+    rc = KCipherSetDecryptIVec (ciphers->master, &ivec);
     if (rc)
         return rc;
 
-    rc = KCipherSetDecryptIVec (self->ciphers.block, &ivec);
+    rc = KCipherSetDecryptIVec (ciphers->block, &ivec);
     if (rc)
         return rc;
 
@@ -815,7 +824,7 @@ rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
      * decrypt the block key and initial vector using the user key and 
      * the computer ivec
      */
-    rc = KCipherDecryptCBC (self->ciphers.master, e->key, d->key,
+    rc = KCipherDecryptCBC (ciphers->master, e->key, d->key,
                             (sizeof e->key) / sizeof ivec);
     if (rc)
         return rc;
@@ -824,17 +833,17 @@ rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
      * now create the AES key for the block from the newly decrypted 
      * block key
      */
-    rc = KCipherSetDecryptKey (self->ciphers.block, d->key,
+    rc = KCipherSetDecryptKey (ciphers->block, d->key,
                                sizeof d->key);
     if (rc)
         return rc;
 
-    rc = KCipherDecryptCBC (self->ciphers.block, e->data, d->data,
+    rc = KCipherDecryptCBC (ciphers->block, e->data, d->data,
                             (sizeof e->data + sizeof e->u) / sizeof ivec);
     if (rc)
         return rc;
 
-    if (self->bswap)
+    if (bswap)
     {
         assert (sizeof d->u.valid == 2);
         d->u.valid = bswap_16 (d->u.valid);
@@ -848,6 +857,13 @@ rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
     return rc;
 }
 
+static
+rc_t KEncFileBlockDecrypt (KEncFile * self, KEncFileBlockId bid,
+                           const KEncFileBlock * e, KEncFileBlock * d)
+{
+    return KEncFileBlockDecryptCiphers (&self->ciphers, self->bswap, bid, e, d);
+}
+
 
 /*
  * if not decrypting block can be NULL
@@ -1113,6 +1129,505 @@ rc_t KEncFileBlockRead (KEncFile * self, KEncFileBlock * block,
 }
 
 
+/* ----------
+ * CiphersMake
+ *    make the file and block ciphers for a key
+ */
+static
+rc_t KEncFileCiphersMake (KEncFileCiphers * ciphers, const KKey * key)
+{
+    KCipherManager * mgr;
+    size_t z;
+    rc_t rc;
+
+    switch ( key->type)
+    {
+    default:
+        return RC (rcKrypto, rcEncryptionKey, rcConstructing, rcParam, rcInvalid);
+
+    case kkeyNone:
+        return RC (rcKrypto, rcEncryptionKey, rcConstructing, rcParam, rcIncorrect);
+
+    case kkeyAES128:
+        z = 128/8; break;
+
+    case kkeyAES192:
+        z = 192/8; break;
+
+    case kkeyAES256:
+        z = 256/8; break;
+    }
+    rc = KCipherManagerMake (&mgr);
+    if (rc == 0)
+    {
+        rc = KCipherManagerMakeCipher (mgr, &ciphers->master, kcipher_AES);
+        if (rc == 0)
+        {
+            rc = KCipherManagerMakeCipher (mgr, &ciphers->block, kcipher_AES);
+            if (rc == 0)
+            {
+                rc = KCipherSetDecryptKey (ciphers->master, key->text, z);
+                if (rc == 0)
+                {
+                    rc = KCipherSetEncryptKey (ciphers->master, key->text, z);
+                    if (rc == 0)
+                        goto keep_ciphers;
+                }
+                KCipherRelease (ciphers->block);
+                ciphers->block = NULL;
+            }
+            KCipherRelease (ciphers->master);
+            ciphers->master = NULL;
+        }
+    keep_ciphers:
+        KCipherManagerRelease (mgr);
+    }
+    return rc;
+}
+
+static
+void KEncFileCiphersWhack (KEncFileCiphers * ciphers)
+{
+    KCipherRelease (ciphers->master);
+    KCipherRelease (ciphers->block);
+    ciphers->master = ciphers->block = NULL;
+}
+
+
+/* ----------------------------------------------------------------------
+ * KEncFileReader
+ *    serves reads of a read-only, seekable file of known size
+ *
+ *    the ciphertext of a window of blocks is read with one request to
+ *    the encrypted file and split into contiguous parts.  the reading
+ *    thread decrypts the first part while the others are submitted to
+ *    the default thread pool, each with its own ciphers.
+ *    decrypted blocks are kept in a small cache.  sequential reads
+ *    fetch a whole window ahead of the caller.
+ */
+#define ENC_READ_WINDOW     16  /* blocks fetched and decrypted at once */
+#define ENC_READ_CACHE      ( 2 * ENC_READ_WINDOW )
+#define ENC_READ_PARTS      8   /* including the reading thread's */
+
+typedef struct KEncFileCacheEntry KEncFileCacheEntry;
+struct KEncFileCacheEntry
+{
+    KEncFileBlock block;        /* decrypted block */
+    KEncFileBlockId id;
+    uint64_t used;              /* last use for replacement */
+    bool valid;
+};
+
+struct KEncFileReader
+{
+    /* kept until the part ciphers are made on the first window */
+    KKey key;
+
+    /* ciphers of parts 1 and up - part 0 uses those of the file */
+    KEncFileCiphers ciphers [ ENC_READ_PARTS - 1 ];
+    uint32_t num_ciphers;
+    bool started;
+    bool bswap;
+
+    /* the window being decrypted */
+    KEncFileBlock * enc;        /* ENC_READ_WINDOW ciphertext blocks */
+    KEncFileCacheEntry * dec [ ENC_READ_WINDOW ];
+    KEncFileBlockId first;
+
+    /* block following the previous read */
+    KEncFileBlockId next_seq;
+
+    uint64_t clock;
+    KEncFileCacheEntry cache [ ENC_READ_CACHE ];
+};
+
+/* decrypt blocks [ start, end ) of the current window */
+static
+rc_t KEncFileReaderDecrypt (const KEncFileReader * self,
+                            const KEncFileCiphers * ciphers,
+                            uint32_t start, uint32_t end)
+{
+    uint32_t idx;
+
+    for (idx = start; idx < end; ++ idx)
+    {
+        KEncFileBlock * e = & self->enc [idx];
+        rc_t rc;
+
+        /* a block of zeroes was never written */
+        if (BufferAllZero (e, sizeof * e))
+            return RC (rcKrypto, rcFile, rcReading, rcData, rcIncomplete);
+
+        if (self->bswap)
+        {
+            e->crc = bswap_32 (e->crc);
+            e->crc_copy = bswap_32 (e->crc_copy);
+            e->id = bswap_64 (e->id);
+        }
+
+        rc = KEncFileBlockDecryptCiphers (ciphers, self->bswap,
+                                          self->first + idx, e,
+                                          & self->dec [idx]->block);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------
+ * KEncFileDecryptTask
+ *    one part of a window, decrypted on the default thread pool
+ */
+struct KEncFileDecryptTask
+{
+    KTask dad;
+    const KEncFileReader * reader;
+    const KEncFileCiphers * ciphers;
+    uint32_t start;
+    uint32_t end;
+};
+
+static
+rc_t CC KEncFileDecryptTaskWhack (KEncFileDecryptTask * self)
+{
+    KTaskDestroy (& self->dad, "KEncFileDecryptTask");
+    free (self);
+    return 0;
+}
+
+static
+rc_t CC KEncFileDecryptTaskExecute (KEncFileDecryptTask * self)
+{
+    return KEncFileReaderDecrypt (self->reader, self->ciphers,
+                                  self->start, self->end);
+}
+
+static KTask_vt_v1 KEncFileDecryptTask_vt =
+{
+    1, 0,
+    KEncFileDecryptTaskWhack,
+    KEncFileDecryptTaskExecute
+};
+
+static
+rc_t KEncFileDecryptTaskSubmit (KThreadPool * pool, const KEncFileReader * reader,
+                                const KEncFileCiphers * ciphers,
+                                uint32_t start, uint32_t end,
+                                KTaskFuture ** future)
+{
+    rc_t rc;
+    KEncFileDecryptTask * t = malloc (sizeof * t);
+    if (t == NULL)
+        return RC (rcKrypto, rcFile, rcReading, rcMemory, rcExhausted);
+
+    rc = KTaskInit (& t->dad, (const KTask_vt *) & KEncFileDecryptTask_vt,
+                    "KEncFileDecryptTask", "");
+    if (rc)
+    {
+        free (t);
+        return rc;
+    }
+    t->reader = reader;
+    t->ciphers = ciphers;
+    t->start = start;
+    t->end = end;
+
+    rc = KThreadPoolSubmit (pool, & t->dad, future);
+    KTaskRelease (& t->dad);
+    return rc;
+}
+
+/* make the part ciphers on first need, one per pool thread
+ * failures only leave the reading thread with fewer parts */
+static
+void KEncFileReaderStart (KEncFileReader * self)
+{
+    KThreadPool * pool;
+    uint32_t num_parts = 1;
+
+    if (KThreadPoolGetDefault (& pool) == 0)
+    {
+        num_parts += KThreadPoolThreads (pool);
+        KThreadPoolRelease (pool);
+    }
+    if (num_parts > ENC_READ_PARTS)
+        num_parts = ENC_READ_PARTS;
+
+    while (self->num_ciphers + 1 < num_parts)
+    {
+        if (KEncFileCiphersMake (& self->ciphers [self->num_ciphers],
+                                 & self->key) != 0)
+            break;
+        ++ self->num_ciphers;
+    }
+
+    memset (& self->key, 0, sizeof self->key);
+    self->started = true;
+}
+
+static
+void KEncFileReaderWhack (KEncFileReader * self)
+{
+    uint32_t i;
+
+    if (self == NULL)
+        return;
+
+    for (i = 0; i < self->num_ciphers; ++ i)
+        KEncFileCiphersWhack (& self->ciphers [i]);
+
+    free (self->enc);
+    memset (self, 0, sizeof * self);
+    free (self);
+}
+
+static
+rc_t KEncFileReaderMake (KEncFileReader ** pself, const KEncFile * file,
+                         const KKey * key)
+{
+    KEncFileReader * self = calloc (1, sizeof * self);
+    if (self == NULL)
+        return RC (rcKrypto, rcFile, rcConstructing, rcMemory, rcExhausted);
+
+    self->enc = malloc (ENC_READ_WINDOW * sizeof * self->enc);
+    if (self->enc == NULL)
+    {
+        free (self);
+        return RC (rcKrypto, rcFile, rcConstructing, rcMemory, rcExhausted);
+    }
+
+    self->key = * key;
+    self->bswap = file->bswap;
+    * pself = self;
+    return 0;
+}
+
+static
+KEncFileCacheEntry * KEncFileReaderFind (KEncFileReader * self,
+                                         KEncFileBlockId bid)
+{
+    uint32_t i;
+
+    for (i = 0; i < ENC_READ_CACHE; ++ i)
+    {
+        KEncFileCacheEntry * entry = & self->cache [i];
+        if (entry->valid && entry->id == bid)
+        {
+            entry->used = ++ self->clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* entries taken for the window being fetched are the most recent,
+ * so they are never chosen again for the same window */
+static
+KEncFileCacheEntry * KEncFileReaderEvict (KEncFileReader * self)
+{
+    uint32_t i;
+    KEncFileCacheEntry * lru = & self->cache [0];
+
+    for (i = 1; i < ENC_READ_CACHE; ++ i)
+    {
+        if (self->cache [i].used < lru->used)
+            lru = & self->cache [i];
+    }
+
+    lru->valid = false;
+    lru->used = ++ self->clock;
+    return lru;
+}
+
+/* Fetch
+ *    read and decrypt up to "count" blocks starting with "first",
+ *    stopping short of any block already in the cache
+ */
+static
+rc_t KEncFileReaderFetch (KEncFile * file, KEncFileBlockId first, uint32_t count)
+{
+    KEncFileReader * self = file->reader;
+    KTaskFuture * futures [ ENC_READ_PARTS ];
+    KThreadPool * pool;
+    size_t num_read;
+    uint32_t i, num_parts, per_part;
+    rc_t rc;
+
+    assert (count > 0 && count <= ENC_READ_WINDOW);
+
+    for (i = 1; i < count; ++ i)
+    {
+        uint32_t j;
+        for (j = 0; j < ENC_READ_CACHE; ++ j)
+        {
+            if (self->cache [j].valid && self->cache [j].id == first + i)
+                break;
+        }
+        if (j < ENC_READ_CACHE)
+            break;
+    }
+    count = i;
+
+    /* one read for the whole window */
+    rc = KEncFileBufferRead (file, BlockId_to_CiphertextOffset (first),
+                             self->enc, count * sizeof * self->enc, &num_read);
+    if (rc)
+        return rc;
+    if (num_read != count * sizeof * self->enc)
+    {
+        rc = RC (rcKrypto, rcFile, rcReading, rcBuffer, rcInsufficient);
+        PLOGERR (klogErr, (klogErr, rc, "Failure to read full blocks '$(B)' "
+                           "through '$(L)' in encrypted file",
+                           "B=%lu,L=%lu", first, first + count - 1));
+        return rc;
+    }
+
+    for (i = 0; i < count; ++ i)
+    {
+        self->dec [i] = KEncFileReaderEvict (self);
+        self->dec [i]->id = first + i;
+    }
+    self->first = first;
+
+    num_parts = 1;
+    if (count > 1)
+    {
+        if (! self->started)
+            KEncFileReaderStart (self);
+        num_parts = self->num_ciphers + 1;
+        if (num_parts > count)
+            num_parts = count;
+    }
+    per_part = (count + num_parts - 1) / num_parts;
+    num_parts = (count + per_part - 1) / per_part;
+
+    memset (futures, 0, sizeof futures);
+    if (num_parts > 1 && KThreadPoolGetDefault (& pool) == 0)
+    {
+        for (i = 1; i < num_parts; ++ i)
+        {
+            uint32_t end = (i + 1) * per_part;
+            if (end > count)
+                end = count;
+            if (KEncFileDecryptTaskSubmit (pool, self, & self->ciphers [i - 1],
+                                           i * per_part, end, & futures [i]) != 0)
+                futures [i] = NULL;
+        }
+        KThreadPoolRelease (pool);
+    }
+
+    rc = KEncFileReaderDecrypt (self, & file->ciphers, 0, per_part);
+
+    /* every part is waited for, since they all use the window buffers */
+    for (i = 1; i < num_parts; ++ i)
+    {
+        rc_t status;
+
+        if (futures [i] != NULL)
+        {
+            rc_t wrc = KTaskFutureWait (futures [i], & status, NULL);
+            if (wrc != 0)
+                status = wrc;
+            KTaskFutureRelease (futures [i]);
+        }
+        else
+        {
+            uint32_t end = (i + 1) * per_part;
+            if (end > count)
+                end = count;
+            status = KEncFileReaderDecrypt (self, & self->ciphers [i - 1],
+                                            i * per_part, end);
+        }
+
+        if (rc == 0)
+            rc = status;
+    }
+
+    if (rc == 0)
+    {
+        for (i = 0; i < count; ++ i)
+            self->dec [i]->valid = true;
+
+        if (first == 0)
+        {
+            const KEncFileBlock * b = & self->dec [0]->block;
+            file->sra = KFileIsSRA ((const char *)b->data, b->u.valid) == 0;
+        }
+    }
+    return rc;
+}
+
+/* Read
+ *    copy out of as many consecutive blocks as the request covers
+ */
+static
+rc_t KEncFileReaderRead (KEncFile * file, uint64_t pos, void * buffer,
+                         size_t bsize, size_t * num_read)
+{
+    KEncFileReader * self = file->reader;
+    KEncFileBlockId bid, last_bid, end_bid;
+    uint32_t offset;
+    size_t total = 0;
+    rc_t rc = 0;
+
+    assert (file->size_known);
+
+    bid = PlaintextOffset_to_BlockId (pos, &offset);
+    last_bid = PlaintextOffset_to_BlockId (pos + bsize - 1, NULL);
+    end_bid = PlaintextSize_to_BlockCount (file->dec_size, NULL);
+
+    while (total < bsize && bid < end_bid)
+    {
+        size_t to_copy;
+        const KEncFileCacheEntry * entry = KEncFileReaderFind (self, bid);
+
+        if (entry == NULL)
+        {
+            uint64_t count = last_bid + 1 - bid;
+
+            /* read ahead when continuing from the previous read */
+            if (bid == self->next_seq && count < ENC_READ_WINDOW)
+                count = ENC_READ_WINDOW;
+
+            if (count > ENC_READ_WINDOW)
+                count = ENC_READ_WINDOW;
+            if (count > end_bid - bid)
+                count = end_bid - bid;
+
+            rc = KEncFileReaderFetch (file, bid, (uint32_t)count);
+            if (rc)
+                break;
+
+            entry = KEncFileReaderFind (self, bid);
+            assert (entry != NULL);
+        }
+
+        if (offset >= entry->block.u.valid)
+            break;
+
+        to_copy = entry->block.u.valid - offset;
+        if (to_copy > bsize - total)
+            to_copy = bsize - total;
+
+        memmove ((uint8_t *)buffer + total, entry->block.data + offset, to_copy);
+        total += to_copy;
+
+        /* a short block ends the data */
+        if (entry->block.u.valid < sizeof entry->block.data)
+            break;
+
+        offset = 0;
+        ++ bid;
+    }
+
+    self->next_seq = PlaintextOffset_to_BlockId (pos + total, NULL);
+
+    /* a failure after some data only shortens the read */
+    * num_read = total;
+    return total != 0 ? 0 : rc;
+}
+
+
 /*
  * Take a dirty block, encrypt it and write it to the backing file
  */
@@ -1234,6 +1749,8 @@ rc_t CC KEncFileDestroy (KEncFile *self)
         if (self->changed)
             rc3 = KEncFileFooterWrite (self);
     }
+    KEncFileReaderWhack (self->reader);
+
     rc4 = KFileRelease (self->encrypted);
     rc5 = KCipherRelease (self->ciphers.master);
     rc6 = KCipherRelease (self->ciphers.block);
@@ -1661,6 +2178,9 @@ rc_t CC KEncFileRead (const KEncFile *cself,
         break;
     }
 
+    if (self->reader != NULL)
+        return KEncFileReaderRead (self, pos, buffer, bsize, num_read);
+
     /*
      * are we on the wrong block?
      * Or are do we need to read the first block?
@@ -1884,53 +2404,7 @@ uint32_t CC KEncFileType (const KEncFile *self)
 static
 rc_t KEncFileCiphersInit (KEncFile * self, const KKey * key, bool read, bool write)
 {
-    KCipherManager * mgr;
-    size_t z;
-    rc_t rc;
-
-    switch ( key->type)
-    {
-    default:
-        return RC (rcKrypto, rcEncryptionKey, rcConstructing, rcParam, rcInvalid);
-
-    case kkeyNone:
-        return RC (rcKrypto, rcEncryptionKey, rcConstructing, rcParam, rcIncorrect);
-
-    case kkeyAES128:
-        z = 128/8; break;
-
-    case kkeyAES192:
-        z = 192/8; break;
-
-    case kkeyAES256:
-        z = 256/8; break;
-    }
-    rc = KCipherManagerMake (&mgr);
-    if (rc == 0)
-    {
-        rc = KCipherManagerMakeCipher (mgr, &self->ciphers.master, kcipher_AES);
-        if (rc == 0)
-        {
-            rc = KCipherManagerMakeCipher (mgr, &self->ciphers.block, kcipher_AES);
-            if (rc == 0)
-            {
-                rc = KCipherSetDecryptKey (self->ciphers.master, key->text, z);
-                if (rc == 0)
-                {
-                    rc = KCipherSetEncryptKey (self->ciphers.master, key->text, z);
-                    if (rc == 0)
-                        goto keep_ciphers;
-                }
-                KCipherRelease (self->ciphers.block);
-                self->ciphers.block = NULL;
-            }
-            KCipherRelease (self->ciphers.master);
-            self->ciphers.master = NULL;
-        }
-    keep_ciphers:
-        KCipherManagerRelease (mgr);
-    }
-    return rc;
+    return KEncFileCiphersMake (&self->ciphers, key);
 }
 
 
@@ -2278,7 +2752,20 @@ LIB_EXPORT rc_t CC KEncFileMakeRead_v2 (const KFile ** pself,
         LOGERR (klogErr, rc, "error constructing decryptor");
 
     else
+    {
+        /* random access can be served a window of blocks at a time */
+        if (self->seekable && self->size_known)
+        {
+            rc = KEncFileReaderMake (&self->reader, self, key);
+            if (rc)
+            {
+                LOGERR (klogErr, rc, "error constructing decryptor");
+                KFileRelease (&self->dad);
+                return rc;
+            }
+        }
         *pself = &self->dad;
+    }
 
     return rc;
 }
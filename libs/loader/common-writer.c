@@ -35,12 +35,12 @@
 #include <klib/printf.h>
 #include <klib/status.h>
 
-#include <kdb/btree.h>
-
 #include <kfs/pmem.h>
 #include <kfs/file.h>
 #include <kfs/pagefile.h>
 
+#include <kfg/config.h>
+
 #include <kapp/progressbar.h>
 #include <kapp/main.h>
 
@@ -51,6 +51,7 @@
 #include <loader/alignment-writer.h>
 #include <loader/reference-writer.h>
 #include <loader/common-writer.h>
+#include <loader/keyidmap.h>
 #include <loader/common-reader-priv.h>
 
 /*--------------------------------------------------------------------------
@@ -90,57 +91,35 @@ typedef struct FragmentInfo {
 } FragmentInfo;
 
 
-rc_t OpenKBTree(const CommonWriterSettings* settings, struct KBTree **const rslt, size_t const n, size_t const max)
+static rc_t OpenKeyIdMap(const CommonWriterSettings* settings, SpotAssembler *const ctx)
 {
-    size_t const cacheSize = (((settings->cache_size - (settings->cache_size / 2) - (settings->cache_size / 8)) / max)
-                            + 0xFFFFF) & ~((size_t)0xFFFFF);
-    KFile *file = NULL;
-    KDirectory *dir;
+    /* spill past the share of the cache the key trees used to get */
+    size_t const memLimit = settings->cache_size - (settings->cache_size / 2) - (settings->cache_size / 8);
     char fname[4096];
-    rc_t rc;
+    rc_t rc = string_printf(fname, sizeof(fname), NULL, "%s/key2id.%u", settings->tmpfs, settings->pid);
 
-    rc = KDirectoryNativeDir(&dir);
     if (rc)
         return rc;
-    
-    rc = string_printf(fname, sizeof(fname), NULL, "%s/key2id.%u.%u", settings->tmpfs, settings->pid, n); if (rc) return rc;
-    STSMSG(1, ("Path for scratch files: %s\n", fname));
-    rc = KDirectoryCreateFile(dir, &file, true, 0600, kcmInit, "%s", fname);
-    KDirectoryRemove(dir, 0, "%s", fname);
-    KDirectoryRelease(dir);
-    if (rc == 0) {
-        rc = KBTreeMakeUpdate(rslt, file, cacheSize,
-                              false, kbtOpaqueKey,
-                              1, 255, sizeof ( uint32_t ),
-                              NULL
-                              );
-        KFileRelease(file);
-#if PERF
-        if (rc == 0) {
-            static unsigned treecount = 0;
-
-            (void)PLOGMSG(klogInfo, (klogInfo, "Number of trees: $(cnt)", "cnt=%u", ++treecount));
-        }
-#endif
-    }
-    return rc;
+    STSMSG(1, ("Path for scratch files: %s.*\n", fname));
+    return KeyIdMapMake(&ctx->key2id, fname, memLimit);
 }
 
 rc_t GetKeyIDOld(const CommonWriterSettings* settings, SpotAssembler* const ctx, uint64_t *const rslt, bool *const wasInserted, char const key[], char const name[], size_t const namelen)
 {
     size_t const keylen = strlen(key);
     rc_t rc;
-    uint64_t tmpKey;
+    uint32_t tmpKey;
 
     if (ctx->key2id_count == 0) {
-        rc = OpenKBTree(settings, &ctx->key2id[0], 1, 1);
-        if (rc) return rc;
+        if (ctx->key2id == NULL) {
+            rc = OpenKeyIdMap(settings, ctx);
+            if (rc) return rc;
+        }
         ctx->key2id_count = 1;
     }
     if (keylen == 0 || memcmp(key, name, keylen) == 0) {
         /* qname starts with read group; no append */
-        tmpKey = ctx->idCount[0];
-        rc = KBTreeEntry(ctx->key2id[0], &tmpKey, wasInserted, name, namelen);
+        rc = KeyIdMapEntry(ctx->key2id, &tmpKey, wasInserted, 0, name, namelen);
     }
     else {
         char sbuf[4096];
@@ -157,15 +136,15 @@ rc_t GetKeyIDOld(const CommonWriterSettings* settings, SpotAssembler* const ctx,
         }
         rc = string_printf(buf, bsize, &actsize, "%s\t%.*s", key, (int)namelen, name);
         
-        tmpKey = ctx->idCount[0];
-        rc = KBTreeEntry(ctx->key2id[0], &tmpKey, wasInserted, buf, actsize);
+        if (rc == 0)
+            rc = KeyIdMapEntry(ctx->key2id, &tmpKey, wasInserted, 0, buf, actsize);
         if (hbuf)
             free(hbuf);
     }
     if (rc == 0) {
         *rslt = tmpKey;
         if (*wasInserted)
-            ++ctx->idCount[0];
+            ctx->idCount[0] = KeyIdMapCount(ctx->key2id, 0);
     }
     return rc;
 }
@@ -286,6 +265,10 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
 {
     size_t const namelen = GetFixedNameLength(name, o_namelen);
 
+    if (ctx->key2id == NULL) {
+        rc_t const rc = OpenKeyIdMap(settings, ctx);
+        if (rc) return rc;
+    }
     if (ctx->key2id_max == 1)
         return GetKeyIDOld(settings, ctx, rslt, wasInserted, key, name, namelen);
     else {
@@ -293,7 +276,7 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
         unsigned const h = HashKey(key, keylen);
         size_t f;
         size_t e = ctx->key2id_count;
-        uint64_t tmpKey;
+        uint32_t tmpKey;
         
         *rslt = 0;
         {{
@@ -338,10 +321,7 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
         }
         if (ctx->key2id_count < ctx->key2id_max) {
             size_t const name_max = ctx->key2id_name_max + keylen + 1;
-            KBTree *tree;
-            rc_t rc = OpenKBTree(settings, &tree, ctx->key2id_count + 1, 1); /* ctx->key2id_max); */
-            
-            if (rc) return rc;
+            rc_t rc;
             
             if (ctx->key2id_name_alloc < name_max) {
                 size_t alloc = ctx->key2id_name_alloc;
@@ -367,7 +347,6 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
             ctx->key2id_name_max = name_max;
 
             memcpy(&ctx->key2id_names[ctx->key2id_name[f]], key, keylen + 1);
-            ctx->key2id[f] = tree;
             ctx->idCount[f] = 0;
             if ((uint8_t)ctx->key2id_hash[h] < 3) {
                 unsigned const n = (uint8_t)ctx->key2id_hash[h] + 1;
@@ -381,12 +360,11 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
                 ctx->key2id_hash[h] = (uint32_t)((((ctx->key2id_hash[h] & ~(0xFFu)) | f) << 8) | 3);
             }
         GET_ID:
-            tmpKey = ctx->idCount[f];
-            rc = KBTreeEntry(ctx->key2id[f], &tmpKey, wasInserted, name, namelen);
+            rc = KeyIdMapEntry(ctx->key2id, &tmpKey, wasInserted, (unsigned)f, name, namelen);
             if (rc == 0) {
                 *rslt = (((uint64_t)f) << 32) | tmpKey;
                 if (*wasInserted)
-                    ++ctx->idCount[f];
+                    ctx->idCount[f] = KeyIdMapCount(ctx->key2id, (unsigned)f);
                 assert(tmpKey < ctx->idCount[f]);
             }
             return rc;
@@ -395,6 +373,30 @@ rc_t GetKeyID(CommonWriterSettings *const settings,
     }
 }
 
+/* settings left at their defaults may be given in the configuration */
+static void SetupMMArray(const CommonWriterSettings* settings, struct MMArray *const id2value)
+{
+    uint64_t memLimit = settings->id2valueMemLimit;
+    uint64_t growth = settings->id2valueGrowth;
+    bool populate = settings->id2valuePopulate;
+    KConfig *kfg;
+
+    if (KConfigMake(&kfg, NULL) == 0) {
+        if (memLimit == 0)
+            KConfigReadU64(kfg, "/loader/id2value/mem_limit", &memLimit);
+        if (growth == 0)
+            KConfigReadU64(kfg, "/loader/id2value/growth", &growth);
+        if (!populate)
+            KConfigReadBool(kfg, "/loader/id2value/populate", &populate);
+        KConfigRelease(kfg);
+    }
+    if (memLimit != 0)
+        MMArraySetMemoryLimit(id2value, memLimit);
+    if (growth != 0)
+        MMArraySetGrowth(id2value, growth < UINT32_MAX ? (uint32_t)growth : UINT32_MAX);
+    MMArraySetPopulate(id2value, populate);
+}
+
 static rc_t OpenMMapFile(const CommonWriterSettings* settings, SpotAssembler *const ctx, KDirectory *const dir)
 {
     KFile *file = NULL;
@@ -408,6 +410,8 @@ static rc_t OpenMMapFile(const CommonWriterSettings* settings, SpotAssembler *co
     KDirectoryRemove(dir, 0, "%s", fname);
     if (rc == 0)
         rc = MMArrayMake(&ctx->id2value, file, sizeof(ctx_value_t));
+    if (rc == 0)
+        SetupMMArray(settings, ctx->id2value);
     KFileRelease(file);
     return rc;
 }
@@ -473,6 +477,14 @@ void ContextRelease(SpotAssembler *ctx)
     KLoadProgressbar_Release(ctx->progress[1], true);
     KLoadProgressbar_Release(ctx->progress[2], true);
     KLoadProgressbar_Release(ctx->progress[3], true);
+    if (ctx->id2value) {
+        MMArrayStats stats;
+
+        MMArrayGetStats(ctx->id2value, &stats);
+        STSMSG(1, ("Spot assembly: %lu chunks, %lu file maps (%luM), %lu memory maps (%luM), %lu minor/%lu major faults\n",
+                   stats.subchunks, stats.fileMaps, stats.fileBytes >> 20, stats.anonMaps, stats.anonBytes >> 20,
+                   stats.minorFaults, stats.majorFaults));
+    }
     MMArrayWhack(ctx->id2value);
 }
 
@@ -994,10 +1006,10 @@ rc_t ArchiveFile(const struct ReaderFile *const reader,
             unsigned rgi;
             
             ReferenceInfoGetReadGroupCount(header, &rgcount);
-            if (rgcount > (sizeof(ctx->key2id)/sizeof(ctx->key2id[0]) - 1))
+            if (rgcount > NUM_ID_SPACES - 1)
                 ctx->key2id_max = 1;
             else
-                ctx->key2id_max = sizeof(ctx->key2id)/sizeof(ctx->key2id[0]);
+                ctx->key2id_max = NUM_ID_SPACES;
             
             for (rgi = 0; rgi != rgcount; ++rgi) {
                 ReadGroup rg;
@@ -1374,7 +1386,7 @@ rc_t ArchiveFile(const struct ReaderFile *const reader,
         
         rc = GetKeyID(G, ctx, &keyId, &wasInserted, spotGroup, name, namelen);
         if (rc) {
-            (void)PLOGERR(klogErr, (klogErr, rc, "KBTreeEntry: failed on key '$(key)'", "key=%.*s", namelen, name));
+            (void)PLOGERR(klogErr, (klogErr, rc, "GetKeyID: failed on key '$(key)'", "key=%.*s", namelen, name));
             goto LOOP_END;
         }
         rc = MMArrayGet(ctx->id2value, (void **)&value, keyId);
@@ -2003,11 +2015,9 @@ rc_t CommonWriterComplete(CommonWriter* self, bool quitting, uint64_t maxDistanc
 {
     rc_t rc=0;
     /*** No longer need memory for key2id ***/
-    size_t i;
-    for (i = 0; i != self->ctx.key2id_count; ++i) {
-        KBTreeDropBacking(self->ctx.key2id[i]);
-        KBTreeRelease(self->ctx.key2id[i]);
-        self->ctx.key2id[i] = NULL;
+    if (self->ctx.key2id) {
+        KeyIdMapWhack(self->ctx.key2id);
+        self->ctx.key2id = NULL;
     }
     free(self->ctx.key2id_names);
     self->ctx.key2id_names = NULL;
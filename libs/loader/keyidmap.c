@@ -0,0 +1,674 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <loader/keyidmap.h>
+
+#include <sysalloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <klib/rc.h>
+#include <klib/log.h>
+#include <klib/printf.h>
+#include <klib/status.h>
+
+#include <kfs/directory.h>
+#include <kfs/file.h>
+#include <kfs/mmap.h>
+
+#include <kproc/lock.h>
+
+#include <atomic32.h>
+
+#define KIM_ID_SPACES (256u)
+#define KIM_SHARD_BITS (6u)
+#define KIM_SHARDS (1u << KIM_SHARD_BITS)
+#define KIM_MIN_SLOTS (1024u)
+#define KIM_ARENA_CHUNK (64u * 1024u)
+#define KIM_MIN_SPILL (256u * 1024u)
+#define KIM_MAX_RUNS (8u)
+#define KIM_MERGE_RECORDS (4096u)
+#define KIM_MERGE_KEYBYTES (64u * 1024u)
+#define KIM_BLOOM_BITS_PER_KEY (10u)
+#define KIM_BLOOM_PROBES (3u)
+
+/* keys are stored with their id space as the first byte */
+typedef struct kim_entry_s {
+    uint64_t hash;
+    uint8_t const *key; /* NULL if the slot is empty */
+    uint32_t keylen;
+    uint32_t id;
+} kim_entry_t;
+
+/* a spilled run is an array of these sorted by hash followed by the keys */
+typedef struct kim_record_s {
+    uint64_t hash;
+    uint64_t keyoff;
+    uint32_t keylen;
+    uint32_t id;
+} kim_record_t;
+
+/* the bloom filter spares looking into runs that can't hold the key */
+typedef struct kim_run_s {
+    struct kim_run_s *next;
+    KMMap const *mmap;
+    uint8_t const *base;
+    size_t count;
+    size_t keybytes;
+    uint64_t *bloom;
+    uint64_t bloomMask;
+} kim_run_t;
+
+typedef struct kim_chunk_s {
+    struct kim_chunk_s *next;
+    size_t used;
+    size_t size;
+} kim_chunk_t;
+
+typedef struct kim_shard_s {
+    KLock *lock;
+    kim_entry_t *slot;
+    size_t mask;
+    size_t count;
+    size_t bytes;       /* table and keys held in memory */
+    kim_chunk_t *arena; /* most recent first */
+    kim_run_t *runs;    /* most recent first */
+    unsigned nruns;
+    unsigned serial;    /* names the run files */
+} kim_shard_t;
+
+typedef struct KeyIdMap {
+    char *spillBase;
+    size_t shardLimit;
+    kim_shard_t shard[KIM_SHARDS];
+    atomic32_t count[KIM_ID_SPACES];
+} KeyIdMap;
+
+static uint64_t HashKey(uint8_t const space, void const *const key, size_t const keylen)
+{
+    /* FNV-1a with a final mix so that both ends of the hash are usable */
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t i;
+
+    h = (h ^ space) * 0x100000001b3ull;
+    for (i = 0; i != keylen; ++i)
+        h = (h ^ ((uint8_t const *)key)[i]) * 0x100000001b3ull;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+static bool KeyEqual(uint8_t const *const stored, size_t const storedlen,
+                     uint8_t const space, void const *const key, size_t const keylen)
+{
+    return storedlen == keylen + 1 && stored[0] == space && memcmp(stored + 1, key, keylen) == 0;
+}
+
+rc_t KeyIdMapMake(struct KeyIdMap **rslt, char const *spillBase, size_t memLimit)
+{
+    KeyIdMap *const self = calloc(1, sizeof(*self));
+    rc_t rc = 0;
+    unsigned i;
+
+    if (self == NULL)
+        return RC(rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted);
+    if (spillBase != NULL && memLimit != 0) {
+        size_t const len = strlen(spillBase);
+
+        self->spillBase = malloc(len + 1);
+        if (self->spillBase == NULL) {
+            free(self);
+            return RC(rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted);
+        }
+        memcpy(self->spillBase, spillBase, len + 1);
+        self->shardLimit = memLimit / KIM_SHARDS;
+        if (self->shardLimit < KIM_MIN_SPILL)
+            self->shardLimit = KIM_MIN_SPILL;
+    }
+    for (i = 0; i != KIM_SHARDS && rc == 0; ++i)
+        rc = KLockMake(&self->shard[i].lock);
+    if (rc) {
+        KeyIdMapWhack(self);
+        return rc;
+    }
+    *rslt = self;
+    return 0;
+}
+
+static void ShardFreeMemory(kim_shard_t *const shard)
+{
+    while (shard->arena) {
+        kim_chunk_t *const chunk = shard->arena;
+
+        shard->arena = chunk->next;
+        free(chunk);
+    }
+    free(shard->slot);
+    shard->slot = NULL;
+    shard->mask = 0;
+    shard->count = 0;
+    shard->bytes = 0;
+}
+
+static void ShardFreeRuns(kim_shard_t *const shard)
+{
+    while (shard->runs) {
+        kim_run_t *const run = shard->runs;
+
+        shard->runs = run->next;
+        KMMapRelease(run->mmap);
+        free(run->bloom);
+        free(run);
+    }
+    shard->nruns = 0;
+}
+
+void KeyIdMapWhack(struct KeyIdMap *self)
+{
+    unsigned i;
+
+    for (i = 0; i != KIM_SHARDS; ++i) {
+        kim_shard_t *const shard = &self->shard[i];
+
+        ShardFreeMemory(shard);
+        ShardFreeRuns(shard);
+        KLockRelease(shard->lock);
+    }
+    free(self->spillBase);
+    free(self);
+}
+
+uint32_t KeyIdMapCount(struct KeyIdMap const *self, unsigned space)
+{
+    return space < KIM_ID_SPACES ? (uint32_t)atomic32_read(&self->count[space]) : 0;
+}
+
+static kim_entry_t *ShardFind(kim_shard_t const *const shard, uint64_t const hash,
+                              uint8_t const space, void const *const key, size_t const keylen)
+{
+    size_t i = (size_t)hash & shard->mask;
+
+    for ( ; ; i = (i + 1) & shard->mask) {
+        kim_entry_t *const e = &shard->slot[i];
+
+        if (e->key == NULL || (e->hash == hash && KeyEqual(e->key, e->keylen, space, key, keylen)))
+            return e;
+    }
+}
+
+static void BloomAdd(kim_run_t *const run, uint64_t const hash)
+{
+    uint64_t const h2 = (hash >> 32) | 1;
+    uint64_t h = hash;
+    unsigned i;
+
+    for (i = 0; i != KIM_BLOOM_PROBES; ++i, h += h2) {
+        uint64_t const bit = h & run->bloomMask;
+        run->bloom[bit >> 6] |= ((uint64_t)1) << (bit & 63);
+    }
+}
+
+static kim_run_t *RunMake(size_t const count)
+{
+    kim_run_t *const run = calloc(1, sizeof(*run));
+    uint64_t bits = 64;
+
+    if (run == NULL)
+        return NULL;
+    while (bits < count * KIM_BLOOM_BITS_PER_KEY)
+        bits <<= 1;
+    run->bloomMask = bits - 1;
+    run->bloom = calloc(bits / 64, sizeof(run->bloom[0]));
+    if (run->bloom == NULL) {
+        free(run);
+        return NULL;
+    }
+    return run;
+}
+
+static void RunFree(kim_run_t *const run)
+{
+    free(run->bloom);
+    free(run);
+}
+
+static bool BloomTest(kim_run_t const *const run, uint64_t const hash)
+{
+    uint64_t const h2 = (hash >> 32) | 1;
+    uint64_t h = hash;
+    unsigned i;
+
+    for (i = 0; i != KIM_BLOOM_PROBES; ++i, h += h2) {
+        uint64_t const bit = h & run->bloomMask;
+        if ((run->bloom[bit >> 6] & (((uint64_t)1) << (bit & 63))) == 0)
+            return false;
+    }
+    return true;
+}
+
+static bool RunFind(kim_run_t const *const run, uint32_t *const id, uint64_t const hash,
+                    uint8_t const space, void const *const key, size_t const keylen)
+{
+    kim_record_t const *const rec = (kim_record_t const *)run->base;
+    size_t f = 0;
+    size_t e = run->count;
+
+    if (!BloomTest(run, hash))
+        return false;
+
+    while (f < e) {
+        size_t const m = (f + e) / 2;
+
+        if (rec[m].hash < hash)
+            f = m + 1;
+        else
+            e = m;
+    }
+    for ( ; f < run->count && rec[f].hash == hash; ++f) {
+        if (KeyEqual(run->base + rec[f].keyoff, rec[f].keylen, space, key, keylen)) {
+            *id = rec[f].id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static rc_t ShardGrow(kim_shard_t *const shard)
+{
+    size_t const slots = shard->slot ? (shard->mask + 1) * 2 : KIM_MIN_SLOTS;
+    kim_entry_t *const slot = calloc(slots, sizeof(slot[0]));
+    kim_entry_t *const old = shard->slot;
+    size_t const oldslots = old ? shard->mask + 1 : 0;
+    size_t i;
+
+    if (slot == NULL)
+        return RC(rcExe, rcIndex, rcResizing, rcMemory, rcExhausted);
+    shard->slot = slot;
+    shard->mask = slots - 1;
+    for (i = 0; i != oldslots; ++i) {
+        if (old[i].key) {
+            size_t j = (size_t)old[i].hash & shard->mask;
+
+            while (slot[j].key)
+                j = (j + 1) & shard->mask;
+            slot[j] = old[i];
+        }
+    }
+    free(old);
+    shard->bytes += (slots - oldslots) * sizeof(slot[0]);
+    return 0;
+}
+
+static uint8_t *ShardAllocKey(kim_shard_t *const shard, size_t const size)
+{
+    kim_chunk_t *chunk = shard->arena;
+
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t const alloc = size > KIM_ARENA_CHUNK ? size : KIM_ARENA_CHUNK;
+
+        chunk = malloc(sizeof(*chunk) + alloc);
+        if (chunk == NULL)
+            return NULL;
+        chunk->used = 0;
+        chunk->size = alloc;
+        chunk->next = shard->arena;
+        shard->arena = chunk;
+        shard->bytes += sizeof(*chunk) + alloc;
+    }
+    chunk->used += size;
+    return (uint8_t *)(chunk + 1) + chunk->used - size;
+}
+
+static int CC CompareRecordHash(void const *const A, void const *const B)
+{
+    uint64_t const a = ((kim_record_t const *)A)->hash;
+    uint64_t const b = ((kim_record_t const *)B)->hash;
+
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/* the file is removed at once and lives on only as long as it is open or mapped */
+static rc_t CreateRunFile(KeyIdMap const *const self, KFile **const file,
+                          unsigned const shardNo, unsigned const runNo)
+{
+    KDirectory *dir;
+    char fname[4096];
+    rc_t rc = string_printf(fname, sizeof(fname), NULL, "%s.%u.%u", self->spillBase, shardNo, runNo);
+
+    if (rc)
+        return rc;
+    rc = KDirectoryNativeDir(&dir);
+    if (rc)
+        return rc;
+    rc = KDirectoryCreateFile(dir, file, true, 0600, kcmInit, "%s", fname);
+    KDirectoryRemove(dir, 0, "%s", fname);
+    KDirectoryRelease(dir);
+    return rc;
+}
+
+static rc_t MapRun(kim_run_t *const run, KFile const *const file)
+{
+    void const *base;
+    rc_t rc = KMMapMakeRead(&run->mmap, file);
+
+    if (rc)
+        return rc;
+    rc = KMMapAddrRead(run->mmap, &base);
+    if (rc == 0)
+        run->base = base;
+    else {
+        KMMapRelease(run->mmap);
+        run->mmap = NULL;
+    }
+    return rc;
+}
+
+static rc_t WriteAt(KFile *const file, uint64_t *const pos, void const *const data, size_t const size)
+{
+    size_t num_writ;
+    rc_t rc = KFileWriteAll(file, *pos, data, size, &num_writ);
+
+    if (rc == 0 && num_writ != size)
+        rc = RC(rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete);
+    *pos += size;
+    return rc;
+}
+
+static rc_t WriteRun(KeyIdMap const *const self, kim_run_t *const run, unsigned const shardNo,
+                     unsigned const runNo, void const *const data, size_t const size)
+{
+    KFile *file = NULL;
+    rc_t rc = CreateRunFile(self, &file, shardNo, runNo);
+
+    if (rc == 0) {
+        uint64_t pos = 0;
+
+        rc = WriteAt(file, &pos, data, size);
+        if (rc == 0)
+            rc = MapRun(run, file);
+        KFileRelease(file);
+    }
+    return rc;
+}
+
+/* write the shard's keys out as a sorted run and start over in memory */
+static rc_t ShardSpill(KeyIdMap const *const self, kim_shard_t *const shard, unsigned const shardNo)
+{
+    size_t const count = shard->count;
+    size_t size = count * sizeof(kim_record_t);
+    kim_entry_t const *const slot = shard->slot;
+    kim_run_t *run;
+    uint8_t *data;
+    rc_t rc;
+    size_t i;
+
+    for (i = 0; i <= shard->mask; ++i)
+        size += slot[i].keylen;
+
+    run = RunMake(count);
+    data = malloc(size);
+    if (run == NULL || data == NULL) {
+        if (run)
+            RunFree(run);
+        free(data);
+        return RC(rcExe, rcIndex, rcWriting, rcMemory, rcExhausted);
+    }
+    {
+        kim_record_t *const rec = (kim_record_t *)data;
+        size_t keyoff = count * sizeof(rec[0]);
+        size_t j;
+
+        for (i = j = 0; i <= shard->mask; ++i) {
+            if (slot[i].key) {
+                rec[j].hash = slot[i].hash;
+                rec[j].keyoff = keyoff;
+                rec[j].keylen = slot[i].keylen;
+                rec[j].id = slot[i].id;
+                BloomAdd(run, slot[i].hash);
+                memcpy(data + keyoff, slot[i].key, slot[i].keylen);
+                keyoff += slot[i].keylen;
+                ++j;
+            }
+        }
+        qsort(rec, count, sizeof(rec[0]), CompareRecordHash);
+    }
+    rc = WriteRun(self, run, shardNo, shard->serial++, data, size);
+    free(data);
+    if (rc) {
+        RunFree(run);
+        return rc;
+    }
+    run->count = count;
+    run->keybytes = size - count * sizeof(kim_record_t);
+    run->next = shard->runs;
+    shard->runs = run;
+    ++shard->nruns;
+    ShardFreeMemory(shard);
+    STSMSG(2, ("key map shard %u: spilled run %u of %lu keys\n", shardNo, shard->nruns, count));
+    return 0;
+}
+
+/* records and keys of a merged run are staged here and written at their offsets */
+typedef struct kim_merge_s {
+    KFile *file;
+    uint64_t recpos; /* where the staged records go */
+    uint64_t keypos; /* where the staged keys go */
+    size_t nrec;
+    size_t nkey;
+    kim_record_t rec[KIM_MERGE_RECORDS];
+    uint8_t key[KIM_MERGE_KEYBYTES];
+} kim_merge_t;
+
+static rc_t MergeFlush(kim_merge_t *const m)
+{
+    rc_t rc = WriteAt(m->file, &m->recpos, m->rec, m->nrec * sizeof(m->rec[0]));
+
+    if (rc == 0)
+        rc = WriteAt(m->file, &m->keypos, m->key, m->nkey);
+    m->nrec = m->nkey = 0;
+    return rc;
+}
+
+static rc_t MergeAdd(kim_merge_t *const m, kim_record_t const *const rec, uint8_t const *const key)
+{
+    kim_record_t *dst;
+    rc_t rc = 0;
+
+    if (m->nrec == KIM_MERGE_RECORDS || m->nkey + rec->keylen > KIM_MERGE_KEYBYTES) {
+        rc = MergeFlush(m);
+        if (rc)
+            return rc;
+    }
+    dst = &m->rec[m->nrec++];
+    *dst = *rec;
+    dst->keyoff = m->keypos + m->nkey;
+    if (rec->keylen > KIM_MERGE_KEYBYTES)
+        rc = WriteAt(m->file, &m->keypos, key, rec->keylen);
+    else {
+        memcpy(m->key + m->nkey, key, rec->keylen);
+        m->nkey += rec->keylen;
+    }
+    return rc;
+}
+
+/* merge all of the shard's runs into one, so that a lookup never has
+ * to search more than KIM_MAX_RUNS of them */
+static rc_t ShardMergeRuns(KeyIdMap const *const self, kim_shard_t *const shard, unsigned const shardNo)
+{
+    kim_run_t const *src[KIM_MAX_RUNS + 1];
+    size_t at[KIM_MAX_RUNS + 1];
+    size_t count = 0;
+    size_t keybytes = 0;
+    unsigned n = 0;
+    unsigned i;
+    kim_run_t const *r;
+    kim_run_t *run;
+    kim_merge_t *m;
+    rc_t rc;
+
+    for (r = shard->runs; r && n != KIM_MAX_RUNS + 1; r = r->next, ++n) {
+        src[n] = r;
+        at[n] = 0;
+        count += r->count;
+        keybytes += r->keybytes;
+    }
+    if (r != NULL)
+        return RC(rcExe, rcIndex, rcWriting, rcData, rcExcessive);
+
+    run = RunMake(count);
+    m = malloc(sizeof(*m));
+    if (run == NULL || m == NULL) {
+        if (run)
+            RunFree(run);
+        free(m);
+        return RC(rcExe, rcIndex, rcWriting, rcMemory, rcExhausted);
+    }
+    rc = CreateRunFile(self, &m->file, shardNo, shard->serial++);
+    if (rc == 0) {
+        m->recpos = 0;
+        m->keypos = count * sizeof(kim_record_t);
+        m->nrec = m->nkey = 0;
+        for ( ; ; ) {
+            kim_record_t const *best = NULL;
+            unsigned b = 0;
+
+            for (i = 0; i != n; ++i) {
+                if (at[i] < src[i]->count) {
+                    kim_record_t const *const rec = (kim_record_t const *)src[i]->base + at[i];
+
+                    if (best == NULL || rec->hash < best->hash) {
+                        best = rec;
+                        b = i;
+                    }
+                }
+            }
+            if (best == NULL)
+                break;
+            BloomAdd(run, best->hash);
+            rc = MergeAdd(m, best, src[b]->base + best->keyoff);
+            if (rc)
+                break;
+            ++at[b];
+        }
+        if (rc == 0)
+            rc = MergeFlush(m);
+        if (rc == 0)
+            rc = MapRun(run, m->file);
+        KFileRelease(m->file);
+    }
+    free(m);
+    if (rc) {
+        RunFree(run);
+        return rc;
+    }
+    run->count = count;
+    run->keybytes = keybytes;
+    ShardFreeRuns(shard);
+    shard->runs = run;
+    shard->nruns = 1;
+    STSMSG(2, ("key map shard %u: merged %u runs of %lu keys\n", shardNo, n, count));
+    return 0;
+}
+
+static rc_t ShardEntry(KeyIdMap *const self, kim_shard_t *const shard, unsigned const shardNo,
+                       uint32_t *const id, bool *const wasInserted, uint64_t const hash,
+                       uint8_t const space, void const *const key, size_t const keylen)
+{
+    kim_entry_t *e = NULL;
+    kim_run_t const *run;
+    uint8_t *stored;
+    rc_t rc;
+
+    if (shard->slot) {
+        e = ShardFind(shard, hash, space, key, keylen);
+        if (e->key) {
+            *id = e->id;
+            return 0;
+        }
+    }
+    for (run = shard->runs; run; run = run->next) {
+        if (RunFind(run, id, hash, space, key, keylen))
+            return 0;
+    }
+    if (e == NULL || (shard->count + 1) * 2 > shard->mask + 1) {
+        rc = ShardGrow(shard);
+        if (rc)
+            return rc;
+        e = ShardFind(shard, hash, space, key, keylen);
+    }
+    stored = ShardAllocKey(shard, keylen + 1);
+    if (stored == NULL)
+        return RC(rcExe, rcIndex, rcInserting, rcMemory, rcExhausted);
+    stored[0] = space;
+    memcpy(stored + 1, key, keylen);
+
+    e->hash = hash;
+    e->key = stored;
+    e->keylen = (uint32_t)(keylen + 1);
+    e->id = *id = (uint32_t)atomic32_read_and_add(&self->count[space], 1);
+    ++shard->count;
+    *wasInserted = true;
+
+    if (self->spillBase != NULL && shard->bytes > self->shardLimit) {
+        /* the new key is already in place; keep going in memory if this fails */
+        rc = ShardSpill(self, shard, shardNo);
+        if (rc)
+            (void)LOGERR(klogWarn, rc, "failed to spill key map to disk");
+        else if (shard->nruns > KIM_MAX_RUNS) {
+            /* lookups keep working on the unmerged runs if this fails */
+            rc = ShardMergeRuns(self, shard, shardNo);
+            if (rc)
+                (void)LOGERR(klogWarn, rc, "failed to merge key map runs");
+        }
+    }
+    return 0;
+}
+
+rc_t KeyIdMapEntry(struct KeyIdMap *self, uint32_t *id, bool *wasInserted,
+                   unsigned space, void const *key, size_t keylen)
+{
+    uint64_t hash;
+    unsigned shardNo;
+    kim_shard_t *shard;
+    rc_t rc;
+
+    if (space >= KIM_ID_SPACES || keylen >= UINT32_MAX)
+        return RC(rcExe, rcIndex, rcInserting, rcParam, rcExcessive);
+
+    hash = HashKey((uint8_t)space, key, keylen);
+    shardNo = (unsigned)(hash >> (64 - KIM_SHARD_BITS));
+    shard = &self->shard[shardNo];
+    *wasInserted = false;
+
+    rc = KLockAcquire(shard->lock);
+    if (rc == 0) {
+        rc = ShardEntry(self, shard, shardNo, id, wasInserted, hash, (uint8_t)space, key, keylen);
+        KLockUnlock(shard->lock);
+    }
+    return rc;
+}
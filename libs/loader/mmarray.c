@@ -34,23 +34,61 @@
 #include <kfs/mmap.h>
 #include <kfs/file.h>
 
+#if LINUX
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
 #define MMA_NUM_CHUNKS_BITS (24u)
 #define MMA_NUM_SUBCHUNKS_BITS ((32u)-(MMA_NUM_CHUNKS_BITS))
 #define MMA_SUBCHUNK_SIZE (1u << MMA_NUM_CHUNKS_BITS)
 #define MMA_SUBCHUNK_COUNT (1u << MMA_NUM_SUBCHUNKS_BITS)
 
+#define MMA_DEFAULT_GROWTH (16u)
+#define MMA_PAGE_SIZE (4096u)
+
+/* sub-chunks are carved in order of first touch out of regions,
+ * each region being twice the size of the previous one up to
+ * maxGrowth sub-chunks, so that the file is extended and mapped
+ * once per region rather than once per sub-chunk */
+typedef struct mma_region_s {
+    struct mma_region_s *next;
+    KMMap *mmap; /* NULL for anonymous memory */
+    uint8_t *base;
+    size_t size;
+} mma_region_t;
+
 typedef struct MMArray {
     KFile *fp;
     size_t elemSize;
     uint64_t fsize;
+    mma_region_t *regions; /* most recent first */
+    uint8_t *avail;        /* unused part of the most recent region */
+    size_t availSize;
+    uint64_t anonLimit;
+    uint32_t maxGrowth;
+    uint32_t nextGrowth;
+    bool populate;
+    MMArrayStats stats;
     struct mma_map_s {
-        struct mma_submap_s {
-            uint8_t *base;
-            KMMap *mmap;
-        } submap[MMA_SUBCHUNK_COUNT];
+        uint8_t *submap[MMA_SUBCHUNK_COUNT];
     } map[NUM_ID_SPACES];
 } MMArray;
 
+static void GetFaults(uint64_t *minor, uint64_t *major)
+{
+#if LINUX
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        *minor = ru.ru_minflt;
+        *major = ru.ru_majflt;
+        return;
+    }
+#endif
+    *minor = *major = 0;
+}
+
 rc_t MMArrayMake(struct MMArray **rslt, KFile *fp, uint32_t elemSize)
 {
     MMArray *const self = calloc(1, sizeof(*self));
@@ -59,12 +97,149 @@ rc_t MMArrayMake(struct MMArray **rslt, KFile *fp, uint32_t elemSize)
         return RC(rcExe, rcMemMap, rcConstructing, rcMemory, rcExhausted);
     self->elemSize = (elemSize + 3) & ~(3u); /** align to 4 byte **/
     self->fp = fp;
+    self->maxGrowth = MMA_DEFAULT_GROWTH;
+    self->nextGrowth = 1;
+    GetFaults(&self->stats.minorFaults, &self->stats.majorFaults);
     KFileAddRef(fp);
     *rslt = self;
     return 0;
 }
 
-#define PERF 0
+void MMArraySetGrowth(struct MMArray *self, uint32_t maxSubchunks)
+{
+    self->maxGrowth = maxSubchunks == 0 ? 1 : maxSubchunks;
+    if (self->nextGrowth > self->maxGrowth)
+        self->nextGrowth = self->maxGrowth;
+}
+
+void MMArraySetMemoryLimit(struct MMArray *self, uint64_t maxBytes)
+{
+    self->anonLimit = maxBytes;
+}
+
+void MMArraySetPopulate(struct MMArray *self, bool populate)
+{
+    self->populate = populate;
+}
+
+void MMArrayGetStats(struct MMArray const *self, MMArrayStats *stats)
+{
+    uint64_t minor, major;
+
+    GetFaults(&minor, &major);
+    *stats = self->stats;
+    stats->minorFaults = minor - self->stats.minorFaults;
+    stats->majorFaults = major - self->stats.majorFaults;
+}
+
+static uint8_t *AnonAlloc(size_t size)
+{
+#if LINUX
+    void *const base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+#else
+    return calloc(1, size);
+#endif
+}
+
+static void AnonFree(uint8_t *base, size_t size)
+{
+#if LINUX
+    munmap(base, size);
+#else
+    free(base);
+#endif
+}
+
+/* ask for huge pages and, if wanted, fault the region in now */
+static void Advise(MMArray const *self, mma_region_t const *rgn)
+{
+#if LINUX && defined(MADV_HUGEPAGE)
+    madvise(rgn->base, rgn->size, MADV_HUGEPAGE);
+#endif
+    if (self->populate) {
+#if LINUX && defined(MADV_POPULATE_WRITE)
+        if (madvise(rgn->base, rgn->size, MADV_POPULATE_WRITE) == 0)
+            return;
+#endif
+        {
+            volatile uint8_t *const base = rgn->base;
+            size_t i;
+
+            for (i = 0; i < rgn->size; i += MMA_PAGE_SIZE)
+                base[i] = 0;
+        }
+    }
+}
+
+static rc_t MapRegion(MMArray *const self, mma_region_t *const rgn, size_t const size)
+{
+    if (self->fp == NULL || self->stats.anonBytes + size <= self->anonLimit) {
+        rgn->base = AnonAlloc(size);
+        if (rgn->base != NULL) {
+            ++self->stats.anonMaps;
+            self->stats.anonBytes += size;
+            return 0;
+        }
+        if (self->fp == NULL)
+            return RC(rcExe, rcMemMap, rcAllocating, rcMemory, rcExhausted);
+        /* spill to the file */
+    }
+    {
+        uint64_t const fsize = self->fsize + size;
+        rc_t rc = KFileSetSize(self->fp, fsize);
+
+        if (rc == 0) {
+            rc = KMMapMakeRgnUpdate(&rgn->mmap, self->fp, self->fsize, size);
+            if (rc == 0) {
+                void *base;
+
+                rc = KMMapAddrUpdate(rgn->mmap, &base);
+                if (rc == 0) {
+                    rgn->base = base;
+                    self->fsize = fsize;
+                    ++self->stats.fileMaps;
+                    self->stats.fileBytes += size;
+                    return 0;
+                }
+                KMMapRelease(rgn->mmap);
+                rgn->mmap = NULL;
+            }
+            KFileSetSize(self->fp, self->fsize);
+        }
+        return rc;
+    }
+}
+
+static rc_t NewRegion(MMArray *const self)
+{
+    size_t const chunk = MMA_SUBCHUNK_SIZE * self->elemSize;
+    mma_region_t *const rgn = calloc(1, sizeof(*rgn));
+    rc_t rc;
+
+    if (rgn == NULL)
+        return RC(rcExe, rcMemMap, rcAllocating, rcMemory, rcExhausted);
+
+    /* a large region may not fit; settle for smaller ones */
+    while ((rc = MapRegion(self, rgn, chunk * self->nextGrowth)) != 0 && self->nextGrowth > 1) {
+        self->nextGrowth /= 2;
+        self->maxGrowth = self->nextGrowth;
+    }
+    if (rc) {
+        free(rgn);
+        return rc;
+    }
+    rgn->size = chunk * self->nextGrowth;
+    rgn->next = self->regions;
+    self->regions = rgn;
+    self->avail = rgn->base;
+    self->availSize = rgn->size;
+    Advise(self, rgn);
+
+    if (self->nextGrowth < self->maxGrowth)
+        self->nextGrowth = self->nextGrowth * 2 < self->maxGrowth ? self->nextGrowth * 2 : self->maxGrowth;
+    return 0;
+}
 
 rc_t MMArrayGet(struct MMArray *const self, void **const value, uint64_t const element)
 {
@@ -75,57 +250,35 @@ rc_t MMArrayGet(struct MMArray *const self, void **const value, uint64_t const e
     if (bin_no >= sizeof(self->map)/sizeof(self->map[0]))
         return RC(rcExe, rcMemMap, rcConstructing, rcId, rcExcessive);
     
-    if (self->map[bin_no].submap[subbin].base == NULL) {
+    if (self->map[bin_no].submap[subbin] == NULL) {
         size_t const chunk = MMA_SUBCHUNK_SIZE * self->elemSize;
-        size_t const fsize = self->fsize + chunk;
-        rc_t rc = KFileSetSize(self->fp, fsize);
-        
-        if (rc == 0) {
-            KMMap *mmap;
-            
-            self->fsize = fsize;
-            rc = KMMapMakeRgnUpdate(&mmap, self->fp, self->fsize, chunk);
-            if (rc == 0) {
-                void *base;
-                
-                rc = KMMapAddrUpdate(mmap, &base);
-                if (rc == 0) {
-#if PERF
-                    static unsigned mapcount = 0;
 
-                    (void)PLOGMSG(klogInfo, (klogInfo, "Number of mmaps: $(cnt)", "cnt=%u", ++mapcount));
-#endif
-                    self->map[bin_no].submap[subbin].mmap = mmap;
-                    self->map[bin_no].submap[subbin].base = base;
-
-                    goto GET_MAP;
-                }
-                KMMapRelease(mmap);
-            }
+        if (self->availSize < chunk) {
+            rc_t const rc = NewRegion(self);
+            if (rc)
+                return rc;
         }
-        return rc;
+        self->map[bin_no].submap[subbin] = self->avail;
+        self->avail += chunk;
+        self->availSize -= chunk;
+        ++self->stats.subchunks;
     }
-GET_MAP:
-    *value = &self->map[bin_no].submap[subbin].base[(size_t)in_bin * self->elemSize];
+    *value = &self->map[bin_no].submap[subbin][(size_t)in_bin * self->elemSize];
     return 0;
 }
 
 void MMArrayWhack(struct MMArray *self)
 {
-    unsigned i;
-
-    for (i = 0; i != sizeof(self->map)/sizeof(self->map[0]); ++i) {
-        unsigned j;
-        
-        for (j = 0; j != sizeof(self->map[0].submap)/sizeof(self->map[0].submap[0]); ++j) {
-            if (self->map[i].submap[j].mmap)
-                KMMapRelease(self->map[i].submap[j].mmap);
-            self->map[i].submap[j].mmap = NULL;
-            self->map[i].submap[j].base = NULL;
-        }
+    while (self->regions) {
+        mma_region_t *const rgn = self->regions;
+
+        self->regions = rgn->next;
+        if (rgn->mmap)
+            KMMapRelease(rgn->mmap);
+        else
+            AnonFree(rgn->base, rgn->size);
+        free(rgn);
     }
     KFileRelease(self->fp);
     free(self);
 }
-
-
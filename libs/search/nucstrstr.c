@@ -57,6 +57,15 @@
 #include <malloc.h>
 #endif
 
+/* AVX2 kernels are compiled by function attribute
+   and chosen at run time */
+#if ( defined __GNUC__ || defined __clang__ ) && defined __x86_64__
+#include <immintrin.h>
+#define USE_AVX2 1
+#else
+#define USE_AVX2 0
+#endif
+
 #define RELOAD_BUFFER 1
 #define NA2_LIMIT 61
 #define NA4_LIMIT 29
@@ -4506,6 +4515,334 @@ int eval_4na_pos ( const NucStrFastaExpr *self,
 }
 
 
+/*--------------------------------------------------------------------------
+ * AVX2 evaluation
+ *  the fixed-width 2na and 4na queries are also evaluated 32 buffer
+ *  bytes at a time, where the processor allows. instead of shifting the
+ *  buffer a byte at a time ( AVX2 byte shifts do not cross the middle
+ *  of the register ), each byte alignment within a lane gets its own
+ *  unaligned load.
+ *
+ *  several queries may be evaluated in one pass over the sequence,
+ *  sharing the loads. each query keeps its own stopping point.
+ */
+#if USE_AVX2
+
+#define AVX2_BATCH 8
+
+typedef struct NucStrAVX2Eval NucStrAVX2Eval;
+struct NucStrAVX2Eval
+{
+    const NucStrFastaExpr *expr;
+
+    /* stop testing when position passes this point */
+    unsigned int stop;
+
+    int found;
+};
+
+static int nss_avx2 = -1;
+static int nss_vec_disabled;
+
+static
+int avx2_enabled ( void )
+{
+    if ( nss_avx2 < 0 )
+    {
+        __builtin_cpu_init ();
+        nss_avx2 = __builtin_cpu_supports ( "avx2" ) ? 1 : 0;
+    }
+    return nss_avx2 && ! nss_vec_disabled;
+}
+
+/* the fixed-width types are given slots 0 .. AVX2_TYPES - 1,
+   other types return -1 */
+#define AVX2_TYPES 7
+
+static
+int avx2_slot ( int32_t type )
+{
+    switch ( type )
+    {
+    case type_2na_8:
+        return 0;
+    case type_2na_16:
+        return 1;
+    case type_2na_32:
+        return 2;
+    case type_2na_64:
+        return 3;
+    case type_4na_16:
+        return 4;
+    case type_4na_32:
+        return 5;
+    case type_4na_64:
+        return 6;
+    }
+    return -1;
+}
+
+__attribute__ ( ( target ( "avx2" ), always_inline ) )
+static __inline__
+__m256i avx2_cmpeq ( __m256i a, __m256i b, unsigned int qbytes )
+{
+    switch ( qbytes )
+    {
+    case 1:
+        return _mm256_cmpeq_epi8 ( a, b );
+    case 2:
+        return _mm256_cmpeq_epi16 ( a, b );
+    case 4:
+        return _mm256_cmpeq_epi32 ( a, b );
+    }
+    return _mm256_cmpeq_epi64 ( a, b );
+}
+
+/* avx2_load_2na
+ *  "limit" is the end of readable memory, which may lie beyond the sequence
+ */
+__attribute__ ( ( target ( "avx2" ), always_inline ) )
+static __inline__
+__m256i avx2_load_2na ( const uint8_t *src, const uint8_t *limit )
+{
+    uint8_t tmp [ 32 ];
+
+    if ( src + 32 <= limit )
+        return _mm256_loadu_si256 ( ( const __m256i* ) src );
+
+    memset ( tmp, 0, sizeof tmp );
+    if ( src < limit )
+        memcpy ( tmp, src, limit - src );
+    return _mm256_loadu_si256 ( ( const __m256i* ) tmp );
+}
+
+/* avx2_load_4na
+ *  expands 16 bytes of 2na into 32 bytes laid out as by expand_2na,
+ *  looking up each nibble of 2 bases in a register. the first 2 bases
+ *  ( high nibble ) land in the first byte.
+ */
+__attribute__ ( ( target ( "avx2" ), always_inline ) )
+static __inline__
+__m256i avx2_load_4na ( const uint8_t *src, const uint8_t *limit )
+{
+    const __m128i onehot = _mm_setr_epi8 (
+        0x11, 0x12, 0x14, 0x18, 0x21, 0x22, 0x24, 0x28,
+        0x41, 0x42, 0x44, 0x48, 0x81, 0x82, 0x84, 0x88 );
+    const __m128i nibble = _mm_set1_epi8 ( 0x0F );
+    __m128i s, lo, hi;
+
+    if ( src + 16 <= limit )
+        s = _mm_loadu_si128 ( ( const __m128i* ) src );
+    else
+    {
+        uint8_t tmp [ 16 ];
+        memset ( tmp, 0, sizeof tmp );
+        if ( src < limit )
+            memcpy ( tmp, src, limit - src );
+        s = _mm_loadu_si128 ( ( const __m128i* ) tmp );
+    }
+
+    lo = _mm_shuffle_epi8 ( onehot, _mm_and_si128 ( s, nibble ) );
+    hi = _mm_shuffle_epi8 ( onehot, _mm_and_si128 ( _mm_srli_epi16 ( s, 4 ), nibble ) );
+
+    return _mm256_inserti128_si256 ( _mm256_castsi128_si256 (
+        _mm_unpacklo_epi8 ( hi, lo ) ), _mm_unpackhi_epi8 ( hi, lo ), 1 );
+}
+
+/* eval_avx2
+ *  "na4" selects between 2na and 4na, and "qbytes" gives the lane width
+ *  in buffer bytes. both are constant in each caller, and shared by all
+ *  of the queries. returns the number of queries found
+ */
+__attribute__ ( ( target ( "avx2" ), always_inline ) )
+static __inline__
+unsigned int eval_avx2 ( NucStrAVX2Eval *ev, unsigned int count,
+    const void *ncbi2na, unsigned int pos, unsigned int len,
+    const int na4, const unsigned int qbytes )
+{
+    __m256i p [ AVX2_BATCH ] [ 4 ], m [ AVX2_BATCH ] [ 4 ];
+    unsigned int i, k, ph, found, max_stop;
+
+    const uint8_t *seq = ncbi2na;
+    const uint8_t *limit;
+
+    /* 32 bytes of buffer hold 32 bytes of 2na, or 16 bytes expanded to 4na */
+    const unsigned int stride = na4 ? 16 : 32;
+
+    /* one pass per sequence byte within a lane */
+    const unsigned int passes = na4 ? qbytes / 2 : qbytes;
+
+    /* movemask bits of the first byte in each lane */
+    const uint32_t lanes = qbytes == 1 ? 0xFFFFFFFF : qbytes == 2 ? 0x55555555 :
+        qbytes == 4 ? 0x11111111 : 0x01010101;
+
+    assert ( count <= AVX2_BATCH );
+
+    /* the effective length of the sequence,
+       including leading bases we'll ignore */
+    len += pos;
+
+#if ENDLESS_BUFFER
+    limit = seq + ( ( ( ( len + 3 ) >> 2 ) + 15 ) & ~ ( size_t ) 15 );
+#else
+    limit = seq + ( ( len + 3 ) >> 2 );
+#endif
+
+    for ( max_stop = 0, i = 0; i < count; ++ i )
+    {
+        const NucStrFastaExpr *e = ev [ i ] . expr;
+        for ( ph = 0; ph < 4; ++ ph )
+        {
+            p [ i ] [ ph ] = _mm256_broadcastsi128_si256 (
+                _mm_load_si128 ( ( const __m128i* ) e -> query [ ph ] . pattern . b ) );
+            m [ i ] [ ph ] = _mm256_broadcastsi128_si256 (
+                _mm_load_si128 ( ( const __m128i* ) e -> query [ ph ] . mask . b ) );
+        }
+
+        ev [ i ] . found = 0;
+        ev [ i ] . stop = len - e -> size;
+        if ( ev [ i ] . stop > max_stop )
+            max_stop = ev [ i ] . stop;
+    }
+
+    for ( found = 0, seq += pos >> 2; found < count; seq += stride )
+    {
+        /* base position of the first byte of the block */
+        unsigned int base = ( unsigned int ) ( seq - ( const uint8_t* ) ncbi2na ) << 2;
+        if ( base > max_stop )
+            break;
+
+        for ( k = 0; k < passes; ++ k )
+        {
+            __m256i buffer = na4 ?
+                avx2_load_4na ( seq + k, limit ) : avx2_load_2na ( seq + k, limit );
+
+            for ( i = 0; i < count; ++ i )
+            {
+                __m256i r [ 4 ];
+                uint32_t any;
+
+                if ( ev [ i ] . found || base > ev [ i ] . stop )
+                    continue;
+
+                for ( ph = 0; ph < 4; ++ ph )
+                {
+                    if ( na4 )
+                    {
+                        r [ ph ] = avx2_cmpeq ( _mm256_and_si256 ( buffer, p [ i ] [ ph ] ),
+                            _mm256_and_si256 ( buffer, m [ i ] [ ph ] ), qbytes );
+                    }
+                    else
+                    {
+                        r [ ph ] = avx2_cmpeq ( _mm256_and_si256 ( buffer, m [ i ] [ ph ] ),
+                            p [ i ] [ ph ], qbytes );
+                    }
+                }
+
+                /* the usual case is no hit in any phase */
+                any = ( uint32_t ) _mm256_movemask_epi8 ( _mm256_or_si256 (
+                    _mm256_or_si256 ( r [ 0 ], r [ 1 ] ), _mm256_or_si256 ( r [ 2 ], r [ 3 ] ) ) );
+                if ( ( any & lanes ) == 0 )
+                    continue;
+
+                for ( ph = 0; ph < 4 && ! ev [ i ] . found; ++ ph )
+                {
+                    uint32_t bits;
+
+                    /* lanes in increasing position order */
+                    for ( bits = ( uint32_t ) _mm256_movemask_epi8 ( r [ ph ] ) & lanes;
+                          bits != 0; bits &= bits - 1 )
+                    {
+                        unsigned int lane = ( unsigned int ) __builtin_ctz ( bits );
+                        unsigned int at = base + ( ( k + ( na4 ? lane >> 1 : lane ) ) << 2 ) + ph;
+                        if ( at > ev [ i ] . stop )
+                            break;
+                        if ( at >= pos )
+                        {
+                            ev [ i ] . found = 1;
+                            ++ found;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+/* the entry points, one for each query type,
+   with the single query case unrolled */
+#define AVX2_EVAL( name, na4, qbytes )                                  \
+    __attribute__ ( ( target ( "avx2" ) ) )                             \
+    static                                                              \
+    unsigned int name ( NucStrAVX2Eval *ev, unsigned int count,         \
+        const void *ncbi2na, unsigned int pos, unsigned int len )       \
+    {                                                                   \
+        if ( count == 1 )                                               \
+            return eval_avx2 ( ev, 1, ncbi2na, pos, len, na4, qbytes ); \
+        return eval_avx2 ( ev, count, ncbi2na, pos, len, na4, qbytes ); \
+    }
+
+AVX2_EVAL ( eval_2na_8_avx2, 0, 1 )
+AVX2_EVAL ( eval_2na_16_avx2, 0, 2 )
+AVX2_EVAL ( eval_2na_32_avx2, 0, 4 )
+AVX2_EVAL ( eval_2na_64_avx2, 0, 8 )
+AVX2_EVAL ( eval_4na_16_avx2, 1, 2 )
+AVX2_EVAL ( eval_4na_32_avx2, 1, 4 )
+AVX2_EVAL ( eval_4na_64_avx2, 1, 8 )
+
+#undef AVX2_EVAL
+
+static
+void avx2_eval_init ( NucStrAVX2Eval *ev, const NucStrFastaExpr *e )
+{
+    ev -> expr = e;
+    ev -> found = 0;
+}
+
+/* avx2_eval
+ *  evaluates up to AVX2_BATCH queries, all of the type in "slot"
+ */
+static
+unsigned int avx2_eval ( int slot, NucStrAVX2Eval *ev, unsigned int count,
+    const void *ncbi2na, unsigned int pos, unsigned int len )
+{
+    switch ( slot )
+    {
+    case 0:
+        return eval_2na_8_avx2 ( ev, count, ncbi2na, pos, len );
+    case 1:
+        return eval_2na_16_avx2 ( ev, count, ncbi2na, pos, len );
+    case 2:
+        return eval_2na_32_avx2 ( ev, count, ncbi2na, pos, len );
+    case 3:
+        return eval_2na_64_avx2 ( ev, count, ncbi2na, pos, len );
+    case 4:
+        return eval_4na_16_avx2 ( ev, count, ncbi2na, pos, len );
+    case 5:
+        return eval_4na_32_avx2 ( ev, count, ncbi2na, pos, len );
+    case 6:
+        return eval_4na_64_avx2 ( ev, count, ncbi2na, pos, len );
+    }
+    return 0;
+}
+
+#endif /* USE_AVX2 */
+
+/* NucStrstrDisableVector
+ */
+LIB_EXPORT void CC NucStrstrDisableVector ( int disable )
+{
+#if USE_AVX2
+    nss_vec_disabled = disable;
+#else
+    ( void ) disable;
+#endif
+}
+
+
 /* NucStrstrSearch
  *  search buffer from starting position
  *
@@ -4528,6 +4865,18 @@ LIB_EXPORT int CC NucStrstrSearch ( const NucStrstr *self,
         int found;
         unsigned int fasta_len;
 
+#if USE_AVX2
+        int slot = avx2_slot ( self -> fasta . type );
+        if ( slot >= 0 && avx2_enabled () )
+        {
+            NucStrAVX2Eval ev;
+            if ( len < self -> fasta . size ) return 0;
+            if ( selflen ) * selflen = self -> fasta . size;
+            avx2_eval_init ( & ev, & self -> fasta );
+            return ( int ) avx2_eval ( slot, & ev, 1, ncbi2na, pos, len );
+        }
+#endif
+
         switch ( self -> fasta . type )
         {
         case type_2na_64:
@@ -4619,3 +4968,83 @@ LIB_EXPORT int CC NucStrstrSearch ( const NucStrstr *self,
     }
     return 0;
 }
+
+
+/* NucStrstrSearchMany
+ *  evaluate several searches against the same sequence
+ */
+#if USE_AVX2
+static
+unsigned int avx2_flush ( int slot, NucStrAVX2Eval *ev, const unsigned int *idx,
+    unsigned int n, const void *ncbi2na, unsigned int pos, unsigned int len, int *found )
+{
+    unsigned int i, total;
+
+    if ( n == 0 )
+        return 0;
+
+    total = avx2_eval ( slot, ev, n, ncbi2na, pos, len );
+    for ( i = 0; i < n; ++ i )
+        found [ idx [ i ] ] = ev [ i ] . found;
+
+    return total;
+}
+#endif
+
+LIB_EXPORT unsigned int CC NucStrstrSearchMany ( const NucStrstr *const *self,
+    unsigned int count, const void *ncbi2na, unsigned int pos, unsigned int len, int *found )
+{
+    unsigned int i, total = 0;
+#if USE_AVX2
+    NucStrAVX2Eval ev [ AVX2_TYPES ] [ AVX2_BATCH ];
+    unsigned int idx [ AVX2_TYPES ] [ AVX2_BATCH ];
+    unsigned int n [ AVX2_TYPES ];
+    int slot, avx2 = avx2_enabled ();
+#endif
+
+    if ( self == NULL || found == NULL )
+        return 0;
+
+#if USE_AVX2
+    memset ( n, 0, sizeof n );
+#endif
+
+    for ( i = 0; i < count; ++ i )
+    {
+        const NucStrstr *q = self [ i ];
+
+        found [ i ] = 0;
+        if ( q == NULL || ncbi2na == NULL || len == 0 )
+            continue;
+
+#if USE_AVX2
+        /* queue fixed-width queries by type to share loads */
+        slot = avx2 ? avx2_slot ( q -> fasta . type ) : -1;
+        if ( slot >= 0 )
+        {
+            if ( len < q -> fasta . size )
+                continue;
+
+            avx2_eval_init ( & ev [ slot ] [ n [ slot ] ], & q -> fasta );
+            idx [ slot ] [ n [ slot ] ] = i;
+            if ( ++ n [ slot ] == AVX2_BATCH )
+            {
+                total += avx2_flush ( slot, ev [ slot ], idx [ slot ], n [ slot ], ncbi2na, pos, len, found );
+                n [ slot ] = 0;
+            }
+            continue;
+        }
+#endif
+
+        found [ i ] = NucStrstrSearch ( q, ncbi2na, pos, len, NULL );
+        if ( found [ i ] != 0 )
+            ++ total;
+    }
+
+#if USE_AVX2
+    for ( slot = 0; slot < AVX2_TYPES; ++ slot )
+        total += avx2_flush ( slot, ev [ slot ], idx [ slot ], n [ slot ], ncbi2na, pos, len, found );
+#endif
+
+    return total;
+}
@@ -0,0 +1,470 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <vdb/extern.h>
+
+#include "page-map.h"
+#include "blob-priv.h"
+
+#include <klib/rc.h>
+#include <klib/container.h>
+#include <klib/vector.h>
+#include <kproc/lock.h>
+#include <atomic32.h>
+#include <atomic.h>
+#include <sysalloc.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*--------------------------------------------------------------------------
+ * VBlobSharedCache
+ *  read-only blob cache owned by a VTable and shared by all of its
+ *  read cursors, possibly running on different threads
+ *
+ *  the cache is split into shards, each guarded by its own KRWLock.
+ *  a blob lives in the shard selected by its column key and the span of
+ *  SHARED_BLOB_CACHE_SPAN rows holding its start_id, so that consecutive
+ *  blobs of one hot column fall into different shards. lookups only ever
+ *  take the shared side of the lock: recency is recorded with a per-entry
+ *  "referenced" flag ( CLOCK ) rather than by relinking the LRU list, so
+ *  concurrent readers never serialize. insertion and eviction take the
+ *  exclusive side. the capacity is a single budget for all shards.
+ */
+
+#define SHARED_BLOB_CACHE_SHARDS 16
+#define SHARED_BLOB_CACHE_SPAN_BITS 14
+#define SHARED_BLOB_CACHE_SPAN ( ( int64_t ) 1 << SHARED_BLOB_CACHE_SPAN_BITS )
+
+typedef struct VBlobSharedEntry VBlobSharedEntry;
+struct VBlobSharedEntry
+{
+    DLNode ln;
+    const VBlob *blob;
+    struct VBlobSharedColumn *col;
+    size_t size;
+    atomic32_t referenced;
+};
+
+typedef struct VBlobSharedColumn VBlobSharedColumn;
+struct VBlobSharedColumn
+{
+    BSTNode n;
+    uint64_t col_key;
+    KVector *blobs;
+};
+
+typedef struct VBlobSharedShard VBlobSharedShard;
+struct VBlobSharedShard
+{
+    KRWLock *lock;
+    BSTree cols;
+    DLList lru;
+};
+
+struct VBlobSharedCache
+{
+    VBlobSharedShard shard [ SHARED_BLOB_CACHE_SHARDS ];
+    atomic_t contents;
+    size_t capacity;
+};
+
+
+static
+size_t VBlobSharedCacheBlobSize ( const VBlob *blob )
+{
+    size_t blob_size = sizeof ( VBlobSharedEntry ) + sizeof ( VBlob ) + KDataBufferBytes ( & blob -> data );
+    if ( blob -> pm != NULL )
+    {
+        blob_size += KDataBufferBytes ( & blob -> pm -> cstorage )
+                   + KDataBufferBytes ( & blob -> pm -> dstorage )
+                   + KDataBufferBytes ( & blob -> pm -> istorage )
+                   + PageMapRowIndexBytes ( blob -> pm );
+    }
+    return blob_size;
+}
+
+/* GetShard
+ *  consecutive spans of a column map onto consecutive shards
+ */
+static
+VBlobSharedShard * VBlobSharedCacheGetShard ( const VBlobSharedCache *cself, uint64_t col_key, int64_t id )
+{
+    VBlobSharedCache *self = ( VBlobSharedCache* ) cself;
+    uint64_t h = col_key ^ ( col_key >> 29 ) ^ ( col_key >> 47 );
+    h += ( uint64_t ) id >> SHARED_BLOB_CACHE_SPAN_BITS;
+    return & self -> shard [ h & ( SHARED_BLOB_CACHE_SHARDS - 1 ) ];
+}
+
+static
+int64_t CC VBlobSharedColumnCmp ( const void *item, const BSTNode *n )
+{
+    uint64_t key = * ( const uint64_t* ) item;
+    const VBlobSharedColumn *col = ( const VBlobSharedColumn* ) n;
+    if ( key < col -> col_key )
+        return -1;
+    return key > col -> col_key;
+}
+
+static
+int64_t CC VBlobSharedColumnSort ( const BSTNode *item, const BSTNode *n )
+{
+    return VBlobSharedColumnCmp ( & ( ( const VBlobSharedColumn* ) item ) -> col_key, n );
+}
+
+static
+void CC VBlobSharedEntryWhack ( DLNode *n, void *ignore )
+{
+    VBlobSharedEntry *self = ( VBlobSharedEntry* ) n;
+    VBlobRelease ( ( VBlob* ) self -> blob );
+    free ( self );
+}
+
+static
+void CC VBlobSharedColumnWhack ( BSTNode *n, void *ignore )
+{
+    VBlobSharedColumn *self = ( VBlobSharedColumn* ) n;
+    KVectorRelease ( self -> blobs );
+    free ( self );
+}
+
+static
+void VBlobSharedShardDropEntry ( VBlobSharedCache *cache, VBlobSharedShard *self, VBlobSharedEntry *entry )
+{
+    DLListUnlink ( & self -> lru, & entry -> ln );
+    KVectorUnset ( entry -> col -> blobs, entry -> blob -> start_id );
+    atomic_add ( & cache -> contents, - ( long int ) entry -> size );
+    VBlobSharedEntryWhack ( & entry -> ln, NULL );
+}
+
+/* Evict
+ *  CLOCK sweep from the tail until the whole cache fits its capacity
+ *  or this shard is empty: referenced entries get a second chance.
+ *  called with the shard lock held exclusively.
+ */
+static
+void VBlobSharedShardEvict ( VBlobSharedCache *cache, VBlobSharedShard *self )
+{
+    while ( ( size_t ) atomic_read ( & cache -> contents ) > cache -> capacity )
+    {
+        VBlobSharedEntry *victim = ( VBlobSharedEntry* ) DLListTail ( & self -> lru );
+        if ( victim == NULL )
+            break;
+        if ( atomic32_read ( & victim -> referenced ) != 0 )
+        {
+            atomic32_set ( & victim -> referenced, 0 );
+            DLListUnlink ( & self -> lru, & victim -> ln );
+            DLListPushHead ( & self -> lru, & victim -> ln );
+        }
+        else
+        {
+            VBlobSharedShardDropEntry ( cache, self, victim );
+        }
+    }
+}
+
+/* FindInShard
+ *  "span_start" [ IN ] - first row of the span this shard is probed for
+ *
+ *  "done" [ OUT ] - set when no other shard can hold the blob:
+ *  the closest blob before "row_id" in this shard starts within the
+ *  probed span, so the one holding "row_id" would start in it too
+ */
+static
+const VBlob * VBlobSharedShardFind ( VBlobSharedShard *self, uint64_t col_key,
+    int64_t row_id, int64_t span_start, bool *done )
+{
+    const VBlob *blob = NULL;
+
+    if ( KRWLockAcquireShared ( self -> lock ) == 0 )
+    {
+        const VBlobSharedColumn *col = ( const VBlobSharedColumn* )
+            BSTreeFind ( & self -> cols, & col_key, VBlobSharedColumnCmp );
+        if ( col != NULL )
+        {
+            int64_t start_id;
+            VBlobSharedEntry *entry;
+            rc_t rc = KVectorGetPrevPtr ( col -> blobs, ( uint64_t* ) & start_id,
+                ( uint64_t ) row_id + 1, ( void** ) & entry );
+            if ( rc == 0 && entry != NULL )
+            {
+                if ( row_id >= entry -> blob -> start_id && row_id <= entry -> blob -> stop_id )
+                {
+                    atomic32_set ( & entry -> referenced, 1 );
+                    blob = entry -> blob;
+                    VBlobAddRef ( ( VBlob* ) blob );
+                }
+                else if ( entry -> blob -> start_id >= span_start )
+                {
+                    * done = true;
+                }
+            }
+        }
+        KRWLockUnlock ( self -> lock );
+    }
+
+    return blob;
+}
+
+/* Make
+ *  "capacity" [ IN ] - total bytes across all shards
+ */
+rc_t VBlobSharedCacheMake ( VBlobSharedCache **cachep, size_t capacity )
+{
+    rc_t rc = 0;
+    uint32_t i;
+    VBlobSharedCache *self;
+
+    assert ( cachep != NULL );
+
+    self = calloc ( 1, sizeof * self );
+    if ( self == NULL )
+        return RC ( rcVDB, rcBlob, rcConstructing, rcMemory, rcExhausted );
+
+    self -> capacity = capacity;
+    for ( i = 0; i < SHARED_BLOB_CACHE_SHARDS; ++ i )
+    {
+        VBlobSharedShard *shard = & self -> shard [ i ];
+        BSTreeInit ( & shard -> cols );
+        DLListInit ( & shard -> lru );
+        if ( rc == 0 )
+            rc = KRWLockMake ( & shard -> lock );
+    }
+
+    if ( rc != 0 )
+    {
+        VBlobSharedCacheDestroy ( self );
+        self = NULL;
+    }
+
+    * cachep = self;
+    return rc;
+}
+
+void VBlobSharedCacheDestroy ( VBlobSharedCache *self )
+{
+    if ( self != NULL )
+    {
+        uint32_t i;
+        for ( i = 0; i < SHARED_BLOB_CACHE_SHARDS; ++ i )
+        {
+            VBlobSharedShard *shard = & self -> shard [ i ];
+            DLListWhack ( & shard -> lru, VBlobSharedEntryWhack, NULL );
+            BSTreeWhack ( & shard -> cols, VBlobSharedColumnWhack, NULL );
+            KRWLockRelease ( shard -> lock );
+        }
+        free ( self );
+    }
+}
+
+/* SetCapacity
+ *  takes effect on next insertion
+ */
+void VBlobSharedCacheSetCapacity ( VBlobSharedCache *self, size_t capacity )
+{
+    if ( self != NULL )
+        self -> capacity = capacity;
+}
+
+/* Find
+ *  returns a NEW REFERENCE to a blob containing "row_id" or NULL
+ *
+ *  the blob lives in the shard of the span holding its start_id,
+ *  which is the span of "row_id" or an earlier one: probe backwards
+ */
+const VBlob * VBlobSharedCacheFind ( const VBlobSharedCache *self, uint64_t col_key, int64_t row_id )
+{
+    const VBlob *blob = NULL;
+
+    if ( self != NULL )
+    {
+        uint32_t i;
+        bool done = false;
+        int64_t span_start = row_id & ~ ( SHARED_BLOB_CACHE_SPAN - 1 );
+        for ( i = 0; blob == NULL && ! done && i < SHARED_BLOB_CACHE_SHARDS; ++ i, span_start -= SHARED_BLOB_CACHE_SPAN )
+        {
+            VBlobSharedShard *shard = VBlobSharedCacheGetShard ( self, col_key, span_start );
+            blob = VBlobSharedShardFind ( shard, col_key, row_id, span_start, & done );
+        }
+    }
+
+    return blob;
+}
+
+/* Save
+ *  inserts blob, evicting by CLOCK order until the cache fits its capacity:
+ *  first from the blob's own shard, then from the others one at a time
+ *
+ *  the page map is fully expanded before publication, since lazy
+ *  expansion on first row access would otherwise modify a blob
+ *  visible to other threads.
+ */
+rc_t VBlobSharedCacheSave ( const VBlobSharedCache *self, uint64_t col_key, const VBlob *blob )
+{
+    rc_t rc;
+    size_t blob_size;
+    VBlobSharedCache *cache = ( VBlobSharedCache* ) self;
+    VBlobSharedShard *shard;
+    VBlobSharedColumn *col;
+    VBlobSharedEntry *entry, *existing;
+
+    if ( self == NULL || blob == NULL || blob -> no_cache )
+        return 0;
+
+    shard = VBlobSharedCacheGetShard ( self, col_key, blob -> start_id );
+    blob_size = VBlobSharedCacheBlobSize ( blob );
+    if ( blob_size > self -> capacity )
+        return 0;
+
+    if ( blob -> pm != NULL )
+    {
+        rc = PageMapExpandAll ( blob -> pm );
+        if ( rc != 0 )
+            return rc;
+        /* account for index just built */
+        blob_size = VBlobSharedCacheBlobSize ( blob );
+    }
+
+    entry = malloc ( sizeof * entry );
+    if ( entry == NULL )
+        return RC ( rcVDB, rcBlob, rcInserting, rcMemory, rcExhausted );
+
+    rc = KRWLockAcquireExcl ( shard -> lock );
+    if ( rc != 0 )
+    {
+        free ( entry );
+        return rc;
+    }
+
+    col = ( VBlobSharedColumn* ) BSTreeFind ( & shard -> cols, & col_key, VBlobSharedColumnCmp );
+    if ( col == NULL )
+    {
+        col = malloc ( sizeof * col );
+        if ( col == NULL )
+            rc = RC ( rcVDB, rcBlob, rcInserting, rcMemory, rcExhausted );
+        else
+        {
+            col -> col_key = col_key;
+            rc = KVectorMake ( & col -> blobs );
+            if ( rc != 0 )
+            {
+                free ( col );
+                col = NULL;
+            }
+            else
+            {
+                BSTreeInsert ( & shard -> cols, & col -> n, VBlobSharedColumnSort );
+            }
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        /* another cursor may have gotten here first */
+        if ( KVectorGetPtr ( col -> blobs, blob -> start_id, ( void** ) & existing ) == 0 && existing != NULL )
+        {
+            if ( existing -> blob -> stop_id >= blob -> stop_id )
+                rc = RC ( rcVDB, rcBlob, rcInserting, rcBlob, rcExists );
+            else
+                VBlobSharedShardDropEntry ( cache, shard, existing );
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        entry -> blob = blob;
+        entry -> col = col;
+        entry -> size = blob_size;
+        atomic32_set ( & entry -> referenced, 0 );
+
+        rc = KVectorSetPtr ( col -> blobs, blob -> start_id, entry );
+        if ( rc == 0 )
+        {
+            VBlobAddRef ( ( VBlob* ) blob );
+            atomic_add ( & cache -> contents, ( long int ) blob_size );
+
+            /* the new entry is not yet on the list, so it is never its own victim */
+            VBlobSharedShardEvict ( cache, shard );
+
+            DLListPushHead ( & shard -> lru, & entry -> ln );
+            entry = NULL;
+        }
+    }
+
+    KRWLockUnlock ( shard -> lock );
+
+    free ( entry );
+
+    if ( rc == 0 )
+    {
+        /* never holding two shard locks at once */
+        uint32_t i;
+        for ( i = 0; i < SHARED_BLOB_CACHE_SHARDS &&
+                  ( size_t ) atomic_read ( & cache -> contents ) > cache -> capacity; ++ i )
+        {
+            VBlobSharedShard *other = & cache -> shard [ i ];
+            if ( other != shard && KRWLockAcquireExcl ( other -> lock ) == 0 )
+            {
+                VBlobSharedShardEvict ( cache, other );
+                KRWLockUnlock ( other -> lock );
+            }
+        }
+    }
+
+    if ( GetRCState ( rc ) == rcExists )
+        rc = 0;
+
+    return rc;
+}
+
+/* MakeKey
+ *  column keys are computed from schema column name and type
+ *  so that the same column opened on different cursors
+ *  ( each with its own schema clone ) maps onto the same key
+ */
+uint64_t VBlobSharedCacheMakeKey ( const char *name, size_t size, const VTypedecl *td )
+{
+    size_t i;
+    uint64_t h = 14695981039346656037ULL;
+
+    for ( i = 0; i < size; ++ i )
+    {
+        h ^= ( uint8_t ) name [ i ];
+        h *= 1099511628211ULL;
+    }
+
+    if ( td != NULL )
+    {
+        h ^= td -> type_id;
+        h *= 1099511628211ULL;
+        h ^= td -> dim;
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
@@ -129,6 +129,9 @@ struct VBlobPageMapCache {
 
 rc_t VBlobNew( VBlob **lhs, int64_t start_id, int64_t stop_id, const char *name );
 
+/* number of blobs allocated by malloc and reused from the free list */
+void VBlobGetAllocStats ( uint64_t *allocs, uint64_t *reuses );
+
 /* use inline-able addref and release on blobs
    within the library for efficiency */
 #if 1
@@ -196,6 +199,23 @@ uint64_t VBlobMRUCacheSetCapacity(VBlobMRUCache *self,uint64_t capacity );
 void VBlobMRUCacheSuspendFlush(VBlobMRUCache *self);
 void VBlobMRUCacheResumeFlush (VBlobMRUCache *self);
 
+/*--------------------------------------------------------------------------
+ * VBlobSharedCache
+ *  table-level blob cache shared by cursors across threads
+ *  keyed by column key ( see VBlobSharedCacheMakeKey ) and blob start_id
+ */
+typedef struct VBlobSharedCache VBlobSharedCache;
+
+rc_t VBlobSharedCacheMake ( VBlobSharedCache **cache, size_t capacity );
+void VBlobSharedCacheDestroy ( VBlobSharedCache *self );
+void VBlobSharedCacheSetCapacity ( VBlobSharedCache *self, size_t capacity );
+
+/* Find returns a new reference or NULL */
+const VBlob * VBlobSharedCacheFind ( const VBlobSharedCache *self, uint64_t col_key, int64_t row_id );
+rc_t VBlobSharedCacheSave ( const VBlobSharedCache *self, uint64_t col_key, const VBlob *blob );
+
+uint64_t VBlobSharedCacheMakeKey ( const char *name, size_t size, const VTypedecl *td );
+
 
 rc_t PageMapProcessGetPagemap(const PageMapProcessRequest *self,struct PageMap **pm);
 
@@ -32,6 +32,7 @@
 #include "blob-headers.h"
 #include "blob.h"
 #include "blob-priv.h"
+#include "free-list.h"
 #include <klib/rc.h>
 #include <klib/defs.h>
 #include <byteswap.h>
@@ -71,15 +72,28 @@ void VBlobCheckIntegrity ( const VBlob *self )
 }
 #endif
 
+/* blobs whose name fits into VBlob.name are recycled */
+static VFreeList blob_free_list = { 1024 };
+
+void VBlobGetAllocStats ( uint64_t *allocs, uint64_t *reuses )
+{
+    VFreeListStats ( & blob_free_list, allocs, reuses );
+}
+
 rc_t VBlobNew ( VBlob **lhs, int64_t start_id, int64_t stop_id, const char *name ) {
     VBlob *y;
     
     if ( name == NULL )
         name = "";
 #if VBLOG_HAS_NAME
-    *lhs = y = malloc(sizeof(*y) + strlen(name));
+    if ( strlen ( name ) < sizeof y -> name )
+        *lhs = y = VFreeListAlloc ( & blob_free_list, sizeof(*y) );
+    else
+        *lhs = y = malloc(sizeof(*y) + strlen(name));
 #else
-    *lhs = y = calloc(1, sizeof(*y));
+    *lhs = y = VFreeListAlloc ( & blob_free_list, sizeof(*y) );
+    if (y)
+        memset(y, 0, sizeof(*y));
 #endif
     if (y) {
         KRefcountInit(&y->refcount, 1, "VBlob", "new", name);
@@ -119,6 +133,16 @@ rc_t VBlobNewAsArray(struct VBlob **lhs, int64_t start_id, int64_t stop_id, uint
 	return rc;
 }
 
+static void VBlobFree( VBlob *that ) {
+#if VBLOG_HAS_NAME
+    if ( strlen ( that -> name ) >= sizeof that -> name ) {
+        free(that);
+        return;
+    }
+#endif
+    VFreeListFree ( & blob_free_list, that );
+}
+
 static rc_t VBlobDestroy( VBlob *that ) {
     if (that->spmc) {
         int i;
@@ -130,7 +154,7 @@ static rc_t VBlobDestroy( VBlob *that ) {
     KDataBufferWhack(&that->data);
     BlobHeadersRelease(that->headers);
     PageMapRelease(that->pm);
-    free(that);
+    VBlobFree(that);
     return 0;
 }
 
@@ -610,7 +634,7 @@ rc_t VBlobCreateFromData_v1(
         }
         /* like a call to VBlobRelease (y); */
         TRACK_BLOB (VBlobRelease-free, y);
-        free(y);
+        VBlobFree(y);
     }
     return rc;
 }
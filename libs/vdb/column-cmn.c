@@ -41,6 +41,7 @@
 
 #include <vdb/manager.h>
 #include <kdb/column.h>
+#include <klib/symbol.h>
 #include <klib/log.h>
 #include <klib/rc.h>
 #include <sysalloc.h>
@@ -175,6 +176,8 @@ rc_t VColumnInit ( VColumn *self, const VSchema *schema, const SColumn *scol )
         self -> scol = scol;
         self -> td = scol -> td;
         self -> read_only = scol -> read_only;
+        self -> blob_key = VBlobSharedCacheMakeKey ( scol -> name -> name . addr,
+            scol -> name -> name . size, & scol -> td );
     }
     return rc;
 }
@@ -215,9 +218,12 @@ rc_t VColumnReadCachedBlob ( const VColumn *self, const VBlob *vblob, int64_t ro
     uint32_t *elem_bits, const void **base, uint32_t *boff, uint32_t *row_len, uint32_t *repeat_count )
 {
     uint64_t start;
+    pm_size_t expanded = vblob -> pm -> exp_rgn_cnt;
 
     * elem_bits = VTypedescSizeof ( & self -> desc );
     * row_len = PageMapGetIdxRowInfo ( vblob -> pm, ( uint32_t ) ( row_id - vblob -> start_id ), boff, repeat_count );
+    if ( vblob -> pm -> exp_rgn_cnt > expanded )
+        ( ( VColumn* ) self ) -> pagemap_expands += vblob -> pm -> exp_rgn_cnt - expanded;
     start = ( uint64_t ) boff [ 0 ] * elem_bits [ 0 ];
     * base = ( uint8_t* ) vblob -> data . base + ( start >> 3 );
     * boff = ( uint32_t ) start & 7;
@@ -91,6 +91,16 @@ struct VColumn
     VTypedecl td;
     VTypedesc desc;
 
+    /* key into table-level shared blob cache */
+    uint64_t blob_key;
+
+    /* read statistics, see VCursorGetStats */
+    uint64_t cache_hits;
+    uint64_t prefetch_hits;
+    uint64_t shared_hits;
+    uint64_t cache_misses;
+    uint64_t pagemap_expands;
+
     /* vector ids */
     uint32_t ord;
 
@@ -85,6 +85,10 @@
 #define DISABLE_READ_CACHE 0
 #endif
 
+/* blobs of this many rows or fewer are cheaper to read again
+   than to keep: caching them mostly evicts larger blobs */
+#define MAX_UNCACHED_BLOB_ROWS 5
+
 /* normally false
    can be set for certain applications using VDBManagerDisablePagemapThread
 */
@@ -261,6 +265,7 @@ static void CC VCursorVColumnWhack_checked( void *item, void *data )
 rc_t VCursorDestroy ( VCursor *self )
 {
     KRefcountWhack ( & self -> refcount, "VCursor" );
+    VCursorReadAheadRelease ( self );
     if(self->cache_curs) VCursorDestroy((VCursor*)self->cache_curs);
     VBlobMRUCacheDestroy ( self->blob_mru_cache);
 
@@ -1443,6 +1448,84 @@ rc_t VCursorCloseRowRead ( VCursor *self )
 }
 
 
+/* SoleInput
+ *  the production feeding "prod" when it has exactly one input, or NULL
+ */
+static
+const VProduction *VProductionSoleInput ( const VProduction *prod )
+{
+    switch ( prod -> var )
+    {
+    case prodSimple:
+        return ( ( const VSimpleProd* ) prod ) -> in;
+    case prodFunc:
+    {
+        const VFunctionProd *fprod = ( const VFunctionProd* ) prod;
+        if ( VectorLength ( & fprod -> parms ) == 1 )
+            return VectorGet ( & fprod -> parms, 0 );
+        break;
+    }
+    }
+    return NULL;
+}
+
+#define BLOB_CACHED_MAX_DEPTH 8
+
+/* BlobCached
+ */
+bool VCursorBlobCached ( const VCursor *self, const VProduction *prod, int64_t id )
+{
+    uint32_t i, end, depth;
+    const VProduction *p;
+
+    if ( prod == NULL || prod == FAILED_PRODUCTION )
+        return false;
+
+    /* decoded output of a physical column is kept in the MRU cache
+       under the index of the production that produced it */
+    for ( p = prod, depth = 0; p != NULL && p != FAILED_PRODUCTION && depth < BLOB_CACHED_MAX_DEPTH;
+          p = VProductionSoleInput ( p ), ++ depth )
+    {
+        if ( p -> cctx . cache != NULL && VBlobMRUCacheFind ( p -> cctx . cache, p -> cctx . col_idx, id ) != NULL )
+            return true;
+    }
+
+    if ( self -> blob_mru_cache == NULL && self -> tbl -> blob_cache == NULL )
+        return false;
+
+    /* a column reading "prod" through a chain of single-input productions
+       will not ask it for blobs it finds in the cursor or table caches */
+    end = VectorStart ( & self -> row ) + VectorLength ( & self -> row );
+    for ( i = VectorStart ( & self -> row ); i < end; ++ i )
+    {
+        const VColumn *col = VectorGet ( & self -> row, i );
+        if ( col == NULL )
+            continue;
+
+        p = col -> in;
+        for ( depth = 0; p != prod && p != NULL && p != FAILED_PRODUCTION && depth < BLOB_CACHED_MAX_DEPTH; ++ depth )
+            p = VProductionSoleInput ( p );
+
+        if ( p == prod )
+        {
+            const VBlob *blob;
+
+            if ( self -> blob_mru_cache != NULL && VBlobMRUCacheFind ( self -> blob_mru_cache, i, id ) != NULL )
+                return true;
+
+            blob = VBlobSharedCacheFind ( self -> tbl -> blob_cache, col -> blob_key, id );
+            if ( blob != NULL )
+            {
+                VBlobRelease ( ( VBlob* ) blob );
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
 /* Read
  *  read entire single row of byte-aligned data into a buffer
  *
@@ -1477,30 +1560,51 @@ rc_t VCursorReadColumnDirectInt ( const VCursor *cself, int64_t row_id, uint32_t
         return RC ( rcVDB, rcCursor, rcReading, rcColumn, rcInvalid );
 
     /* 2.0 behavior if not caching */
-    if ( cself -> blob_mru_cache == NULL )
+    if ( cself -> blob_mru_cache == NULL && cself -> tbl -> blob_cache == NULL )
         return VColumnRead ( col, row_id, elem_bits, base, boff, row_len, (VBlob**) rslt );
 
     /* check MRU blob */
-    blob = VBlobMRUCacheFind(cself->blob_mru_cache,col_idx,row_id);
+    blob = NULL;
+    if ( cself -> blob_mru_cache != NULL )
+        blob = VBlobMRUCacheFind(cself->blob_mru_cache,col_idx,row_id);
     if(blob){
         assert(row_id >= blob->start_id && row_id <= blob->stop_id);
+        ( ( VColumn* ) col ) -> cache_hits ++;
         /* if the caller wants the blob back... */
         if ( rslt != NULL )
                 * rslt = blob;
         /* ask column to read from blob */
         return VColumnReadCachedBlob ( col, blob, row_id, elem_bits, base, boff, row_len, repeat_count);
     }
+    /* check blobs prefetched in background, then those decoded
+       by other cursors on the same table */
+    blob = VCursorReadAheadFind ( cself -> read_ahead, col_idx, row_id );
+    if ( blob != NULL )
+        ( ( VColumn* ) col ) -> prefetch_hits ++;
+    else
+    {
+        blob = VBlobSharedCacheFind ( cself -> tbl -> blob_cache, col -> blob_key, row_id );
+        if ( blob != NULL )
+            ( ( VColumn* ) col ) -> shared_hits ++;
+    }
+    if ( blob != NULL )
+        rc = VColumnReadCachedBlob ( col, blob, row_id, elem_bits, base, boff, row_len, repeat_count );
+    else
     { /* ask column to produce a blob to be cached */
 	VBlobMRUCacheCursorContext cctx;
+	( ( VColumn* ) col ) -> cache_misses ++;
 	cctx.cache=cself -> blob_mru_cache;
 	cctx.col_idx = col_idx;
 	rc = VColumnReadBlob(col,&blob,row_id,elem_bits,base,boff,row_len,repeat_count,&cctx);
+	if ( rc == 0 && blob != NULL && cself -> tbl -> blob_cache != NULL && blob->stop_id - blob->start_id + 1 > MAX_UNCACHED_BLOB_ROWS )
+	    VBlobSharedCacheSave ( cself -> tbl -> blob_cache, col -> blob_key, blob );
     }
     if ( rc != 0 || blob == NULL ){
         if(rslt) *rslt = NULL;
         return rc;
     }
-    if(blob->stop_id > blob->start_id + 4)
+    VCursorReadAheadAdvance ( cself -> read_ahead, col_idx, blob );
+    if(cself->blob_mru_cache != NULL && blob->stop_id - blob->start_id + 1 > MAX_UNCACHED_BLOB_ROWS)
 	    rc_cache=VBlobMRUCacheSave(cself->blob_mru_cache, col_idx, blob);
     if(rslt==NULL){ /** user does not care about the blob ***/
         if( rc_cache == 0){
@@ -1859,6 +1963,218 @@ LIB_EXPORT rc_t CC VCursorReadDirect ( const VCursor *self, int64_t row_id, uint
 }
 
 
+/* RangeBlob
+ *  locate blob holding "row_id" and position an iterator
+ *  on it covering at most "max_rows" rows
+ */
+static
+rc_t VCursorRangeBlob ( const VCursor *self, int64_t row_id, uint32_t col_idx, uint32_t max_rows,
+    const VBlob **blob, uint32_t *elem_size, PageMapIterator *iter, uint32_t *num_rows )
+{
+    uint64_t avail;
+    const VColumn *col;
+    rc_t rc = VCursorGetBlobDirect ( self, blob, row_id, col_idx );
+    if ( rc != 0 )
+        return rc;
+
+    col = ( const void* ) VectorGet ( & self -> row, col_idx );
+    assert ( col != NULL );
+    * elem_size = VTypedescSizeof ( & col -> desc );
+
+    avail = ( uint64_t ) ( ( * blob ) -> stop_id - row_id ) + 1;
+    * num_rows = avail < max_rows ? ( uint32_t ) avail : max_rows;
+
+    if ( ( * blob ) -> pm == NULL )
+        rc = RC ( rcVDB, rcPagemap, rcAccessing, rcSelf, rcNull );
+    else
+        rc = PageMapNewIterator ( ( * blob ) -> pm, iter, row_id - ( * blob ) -> start_id, * num_rows );
+    if ( rc != 0 )
+    {
+        VBlobRelease ( ( VBlob* ) * blob );
+        * blob = NULL;
+    }
+    return rc;
+}
+
+/* ReadRange
+ *  read consecutive rows of byte-aligned data into a buffer
+ *  in a single call, walking each blob's page map linearly
+ *  rather than looking every row up individually
+ *
+ *  "first_row" [ IN ] - id of first row to read
+ *
+ *  "col_idx" [ IN ] - index of column to be read, returned by "AddColumn"
+ *
+ *  "elem_bits" [ IN ] - as in ReadDirect
+ *
+ *  "buffer" [ OUT ] and "blen" [ IN ] - return buffer for row data
+ *  where "blen" gives buffer capacity in elements. rows are packed
+ *  back to back.
+ *
+ *  "row_lens" [ OUT ] and "row_count" [ IN ] - number of rows to read
+ *  and return parameter for the length in elements of each row read
+ *
+ *  "rows_read" [ OUT ] - number of complete rows read, which may be
+ *  less than "row_count" when the buffer fills or the column ends.
+ *  if not even the first row fits, the return code indicates that
+ *  the buffer is too small and "row_lens[0]" gives the required length.
+ */
+LIB_EXPORT rc_t CC VCursorReadRange ( const VCursor *self, int64_t first_row, uint32_t col_idx,
+    uint32_t elem_bits, void *buffer, uint32_t blen, uint32_t *row_lens, uint32_t row_count,
+    uint32_t *rows_read )
+{
+    rc_t rc = 0;
+    uint32_t total = 0;
+    uint64_t bsize, bused = 0;
+
+    if ( rows_read == NULL )
+        return RC ( rcVDB, rcCursor, rcReading, rcParam, rcNull );
+    * rows_read = 0;
+
+    if ( self == NULL )
+        return RC ( rcVDB, rcCursor, rcReading, rcSelf, rcNull );
+    if ( elem_bits == 0 || ( elem_bits & 7 ) != 0 )
+        return RC ( rcVDB, rcCursor, rcReading, rcParam, rcInvalid );
+    if ( row_lens == NULL || ( buffer == NULL && blen != 0 ) )
+        return RC ( rcVDB, rcCursor, rcReading, rcParam, rcNull );
+
+    bsize = ( uint64_t ) blen * elem_bits;
+
+    /* the per-column cache cursors can only be consulted row by row */
+    if ( self -> cache_curs != NULL )
+    {
+        for ( ; total < row_count; ++ total )
+        {
+            uint32_t len;
+            rc = VCursorReadDirect ( self, first_row + total, col_idx, elem_bits,
+                ( uint8_t* ) buffer + ( bused >> 3 ), ( uint32_t ) ( ( bsize - bused ) / elem_bits ), & len );
+            row_lens [ total ] = len;
+            if ( rc != 0 )
+                break;
+            bused += ( uint64_t ) len * elem_bits;
+        }
+    }
+    else while ( total < row_count )
+    {
+        const VBlob *blob;
+        PageMapIterator iter;
+        uint32_t elem_size, num_rows, i;
+
+        rc = VCursorRangeBlob ( self, first_row + total, col_idx, row_count - total,
+            & blob, & elem_size, & iter, & num_rows );
+        if ( rc != 0 )
+            break;
+
+        if ( bad_elem_bits ( elem_size, elem_bits ) )
+            rc = RC ( rcVDB, rcCursor, rcReading, rcType, rcInconsistent );
+        else for ( i = 0; i < num_rows; ++ i )
+        {
+            uint64_t to_read = ( uint64_t ) PageMapIteratorDataLength ( & iter ) * elem_size;
+            uint64_t start = ( uint64_t ) PageMapIteratorDataOffset ( & iter ) * elem_size;
+
+            row_lens [ total ] = ( uint32_t ) ( to_read / elem_bits );
+            if ( bused + to_read > bsize )
+            {
+                rc = RC ( rcVDB, rcCursor, rcReading, rcBuffer, rcInsufficient );
+                break;
+            }
+
+            assert ( ( start & 7 ) == 0 );
+            memmove ( ( uint8_t* ) buffer + ( bused >> 3 ),
+                ( const uint8_t* ) blob -> data . base + ( start >> 3 ), ( size_t ) ( to_read >> 3 ) );
+            bused += to_read;
+            ++ total;
+
+            PageMapIteratorNext ( & iter );
+        }
+
+        VBlobRelease ( ( VBlob* ) blob );
+        if ( rc != 0 )
+            break;
+    }
+
+    * rows_read = total;
+
+    /* running out of rows or buffer is not an error once something was read */
+    if ( total != 0 )
+    {
+        if ( GetRCObject ( rc ) == ( enum RCObject ) rcRow && GetRCState ( rc ) == rcNotFound )
+            return 0;
+        if ( GetRCObject ( rc ) == ( enum RCObject ) rcBuffer && GetRCState ( rc ) == rcInsufficient )
+            return 0;
+    }
+    return rc;
+}
+
+/* CellRangeDirect
+ *  zero-copy access to consecutive rows of a column within one blob
+ *
+ *  "first_row" [ IN ] - id of first row to access
+ *
+ *  "col_idx" [ IN ] - index of column to be read, returned by "AddColumn"
+ *
+ *  "blob" [ OUT ] - new reference to blob holding the data;
+ *  must be released via VBlobRelease when no longer needed
+ *
+ *  "elem_bits" [ OUT, NULL OKAY ] - element size in bits
+ *
+ *  "base" [ OUT ] - start of blob data. row i starts at bit
+ *  "offsets[i] * elem_bits" from "base"
+ *
+ *  "offsets" [ OUT ], "row_lens" [ OUT ] and "row_count" [ IN ] -
+ *  offset and length in elements of up to "row_count" rows
+ *
+ *  "rows_read" [ OUT ] - number of rows returned, limited to
+ *  the rows remaining in the blob holding "first_row"
+ */
+LIB_EXPORT rc_t CC VCursorCellRangeDirect ( const VCursor *self, int64_t first_row,
+    uint32_t col_idx, const VBlob **blob, uint32_t *elem_bits, const void **base,
+    uint32_t *offsets, uint32_t *row_lens, uint32_t row_count, uint32_t *rows_read )
+{
+    rc_t rc;
+    uint32_t dummy;
+
+    if ( elem_bits == NULL )
+        elem_bits = & dummy;
+
+    if ( blob == NULL || base == NULL || offsets == NULL || row_lens == NULL || rows_read == NULL )
+        rc = RC ( rcVDB, rcCursor, rcReading, rcParam, rcNull );
+    else if ( self == NULL )
+        rc = RC ( rcVDB, rcCursor, rcReading, rcSelf, rcNull );
+    else if ( row_count == 0 )
+        rc = RC ( rcVDB, rcCursor, rcReading, rcParam, rcInvalid );
+    else
+    {
+        PageMapIterator iter;
+        rc = VCursorRangeBlob ( self, first_row, col_idx, row_count,
+            blob, elem_bits, & iter, rows_read );
+        if ( rc == 0 )
+        {
+            uint32_t i;
+            for ( i = 0; i < * rows_read; ++ i )
+            {
+                offsets [ i ] = PageMapIteratorDataOffset ( & iter );
+                row_lens [ i ] = PageMapIteratorDataLength ( & iter );
+                PageMapIteratorNext ( & iter );
+            }
+
+            * base = ( * blob ) -> data . base;
+            return 0;
+        }
+    }
+
+    if ( blob != NULL )
+        * blob = NULL;
+    if ( base != NULL )
+        * base = NULL;
+    if ( rows_read != NULL )
+        * rows_read = 0;
+    * elem_bits = 0;
+
+    return rc;
+}
+
+
 /* ReadBits
  *  read single row of potentially bit-aligned column data into a buffer
  *
@@ -2760,6 +3076,137 @@ LIB_EXPORT uint64_t CC VCursorGetCacheCapacity(const VCursor *self)
 }
 
 
+/* GetStats
+ * ListFunctionStats
+ *  the column keeps its own cache counters, the rest is
+ *  gathered from the productions and physical columns feeding it
+ */
+static
+rc_t VCursorGatherColumnStats ( const VCursor *self, uint32_t col_idx, VCursorColumnStats *stats,
+    void ( CC * f ) ( const char *name, uint64_t calls, uint64_t decode_ns, void *data ),
+    void *data )
+{
+    Vector visited;
+    const VColumn *col = ( const void* ) VectorGet ( & self -> row, col_idx );
+
+    memset ( stats, 0, sizeof * stats );
+    if ( col == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcColumn, rcInvalid );
+
+    stats -> cache_hits = col -> cache_hits;
+    stats -> prefetch_hits = col -> prefetch_hits;
+    stats -> shared_hits = col -> shared_hits;
+    stats -> cache_misses = col -> cache_misses;
+    stats -> pagemap_expands = col -> pagemap_expands;
+
+    VectorInit ( & visited, 0, 16 );
+    VProductionGatherStats ( col -> in, & visited, stats, f, data );
+    VectorWhack ( & visited, NULL, NULL );
+
+    return 0;
+}
+
+LIB_EXPORT rc_t CC VCursorGetStats ( const VCursor *self,
+    uint32_t col_idx, VCursorColumnStats *stats )
+{
+    if ( stats == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcParam, rcNull );
+    if ( self == NULL )
+    {
+        memset ( stats, 0, sizeof * stats );
+        return RC ( rcVDB, rcCursor, rcAccessing, rcSelf, rcNull );
+    }
+
+    return VCursorGatherColumnStats ( self, col_idx, stats, NULL, NULL );
+}
+
+LIB_EXPORT rc_t CC VCursorListFunctionStats ( const VCursor *self, uint32_t col_idx,
+    void ( CC * f ) ( const char *name, uint64_t calls, uint64_t decode_ns, void *data ),
+    void *data )
+{
+    VCursorColumnStats stats;
+
+    if ( f == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcFunction, rcNull );
+    if ( self == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcSelf, rcNull );
+
+    return VCursorGatherColumnStats ( self, col_idx, & stats, f, data );
+}
+
+/* DumpStats
+ */
+typedef struct VCursorDumpStatsData VCursorDumpStatsData;
+struct VCursorDumpStatsData
+{
+    rc_t ( CC * flush ) ( void *dst, const void *buffer, size_t bsize );
+    void *dst;
+    rc_t rc;
+};
+
+static
+void VCursorDumpStatsLine ( VCursorDumpStatsData *pb, const char *fmt, ... )
+{
+    if ( pb -> rc == 0 )
+    {
+        char buffer [ 512 ];
+        size_t num_writ;
+        va_list args;
+
+        va_start ( args, fmt );
+        pb -> rc = string_vprintf ( buffer, sizeof buffer, & num_writ, fmt, args );
+        va_end ( args );
+
+        if ( pb -> rc == 0 )
+            pb -> rc = ( * pb -> flush ) ( pb -> dst, buffer, num_writ );
+    }
+}
+
+static
+void CC VCursorDumpFunctionStats ( const char *name, uint64_t calls, uint64_t decode_ns, void *data )
+{
+    VCursorDumpStatsLine ( data, "    %s: calls %lu, time %lu us\n",
+        name, calls, decode_ns / 1000 );
+}
+
+LIB_EXPORT rc_t CC VCursorDumpStats ( const VCursor *self,
+    rc_t ( CC * flush ) ( void *dst, const void *buffer, size_t bsize ), void *dst )
+{
+    uint32_t i, end;
+    VCursorDumpStatsData pb;
+
+    if ( flush == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcFunction, rcNull );
+    if ( self == NULL )
+        return RC ( rcVDB, rcCursor, rcAccessing, rcSelf, rcNull );
+
+    pb . flush = flush;
+    pb . dst = dst;
+    pb . rc = 0;
+
+    end = VectorStart ( & self -> row ) + VectorLength ( & self -> row );
+    for ( i = VectorStart ( & self -> row ); pb . rc == 0 && i < end; ++ i )
+    {
+        VCursorColumnStats stats;
+        const VColumn *col = ( const void* ) VectorGet ( & self -> row, i );
+        if ( col == NULL )
+            continue;
+
+        VCursorGatherColumnStats ( self, i, & stats, NULL, NULL );
+        VCursorDumpStatsLine ( & pb,
+            "%S: blobs %lu, raw %lu bytes, decoded %lu bytes, decode %lu us, "
+            "cache hits %lu, prefetch hits %lu, shared hits %lu, misses %lu, page-map expands %lu\n",
+            & col -> scol -> name -> name, stats . blobs_read, stats . raw_bytes,
+            stats . decoded_bytes, stats . decode_ns / 1000, stats . cache_hits,
+            stats . prefetch_hits, stats . shared_hits, stats . cache_misses, stats . pagemap_expands );
+        if ( pb . rc == 0 )
+            VCursorGatherColumnStats ( self, i, & stats, VCursorDumpFunctionStats, & pb );
+    }
+
+    return pb . rc;
+}
+
+
 /* FindNextRowId
  *  finds the id of the next row having valid ( non-null ) cell data
  *  "*next" may contain any row id > "VCursorRowId()".
@@ -84,6 +84,7 @@ struct VSchema;
 struct SColumn;
 struct VColumn;
 struct VPhysical;
+struct VBlob;
 
 
 /*--------------------------------------------------------------------------
@@ -176,6 +177,9 @@ struct VCursor
     struct KThread *pagemap_thread;
     PageMapProcessRequest pmpr;
 
+    /* background blob read-ahead - NULL unless enabled */
+    struct VCursorReadAhead *read_ahead;
+
     /* user data */
     void *user;
     void ( CC * user_whack ) ( void *data );
@@ -309,11 +313,25 @@ rc_t VCursorPostOpenAddRead ( struct VCursor *self, struct VColumn *col );
 rc_t VCursorOpenRowRead ( struct VCursor *self );
 rc_t VCursorCloseRowRead ( struct VCursor *self );
 
+/* BlobCached
+ *  true if the cursor caches already hold the blob containing "id"
+ *  of production "prod", or of a column fed by it alone,
+ *  so that the blob will not be read from "prod" again
+ */
+struct VProduction;
+bool VCursorBlobCached ( const struct VCursor *self, const struct VProduction *prod, int64_t id );
+
 
 /** pagemap supporting thread **/
 rc_t VCursorLaunchPagemapThread(struct VCursor *self);
 rc_t VCursorTerminatePagemapThread(struct VCursor *self);
 
+/** blob read-ahead thread **/
+typedef struct VCursorReadAhead VCursorReadAhead;
+void VCursorReadAheadRelease ( struct VCursor *self );
+struct VBlob const * VCursorReadAheadFind ( VCursorReadAhead *self, uint32_t col_idx, int64_t row_id );
+void VCursorReadAheadAdvance ( VCursorReadAhead *self, uint32_t col_idx, struct VBlob const *blob );
+
 
 #ifdef __cplusplus
 }
@@ -38,6 +38,7 @@
 
 #include "schema-priv.h"
 #include "linker-priv.h"
+#include "schema-cache.h"
 
 #include <vdb/manager.h>
 #include <vdb/database.h>
@@ -79,8 +80,23 @@ rc_t VDatabaseLoadSchema ( VDatabase *self )
         /* add in schema text. it is not mandatory, but it is
            the design of the system to store object schema with
            the object so that it is capable of standing alone */
-        rc = VSchemaParseTextCallback ( self -> schema,
-            "VDatabaseLoadSchema", KMDataNodeFillSchema, & pb );
+        if ( self -> read_only )
+        {
+            /* share a schema parsed by an earlier open, see VTableLoadSchema */
+            const VSchema *parsed;
+            rc = VSchemaCacheParseNode ( self -> mgr -> schema_cache,
+                & parsed, self -> schema -> dad, node, "VDatabaseLoadSchema" );
+            if ( rc == 0 )
+            {
+                VSchemaRelease ( self -> schema );
+                self -> schema = ( VSchema* ) parsed;
+            }
+        }
+        else
+        {
+            rc = VSchemaParseTextCallback ( self -> schema,
+                "VDatabaseLoadSchema", KMDataNodeFillSchema, & pb );
+        }
         if ( rc == 0 )
         {
             /* determine database type */
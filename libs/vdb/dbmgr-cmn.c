@@ -35,6 +35,8 @@
 
 #include "schema-priv.h"
 #include "linker-priv.h"
+#include "decode-pool.h"
+#include "schema-cache.h"
 
 #include <vdb/manager.h>
 #include <vdb/database.h>
@@ -94,6 +96,8 @@ rc_t VDBManagerWhack ( VDBManager *self )
             self -> user_whack = NULL;
         }
 
+        VBlobDecodePoolRelease ( self -> decode_pool );
+        VSchemaCacheWhack ( self -> schema_cache );
         VSchemaRelease ( self -> schema );
         VLinkerRelease ( self -> linker );
         free ( self );
@@ -352,6 +356,30 @@ rc_t VDBManagerConfigFromKfg ( VDBManager *self, bool update )
             }
         }
 
+        /* look for number of pool workers decoding blobs ahead */
+        if ( rc == 0 )
+        {
+            uint64_t num_threads;
+            if ( KConfigReadU64 ( kfg, "vdb/decode/threads", & num_threads ) == 0 && num_threads != 0 )
+            {
+                rc = VDBManagerSetDecodeThreads ( self, num_threads > 256 ? 256 : ( uint32_t ) num_threads );
+                if ( rc != 0 )
+                {
+                    LOGERR ( klogWarn, rc, "failed to enable blob decoding ahead" );
+                    rc = 0;
+                }
+            }
+        }
+
+        /* look for size of parsed schema cache */
+        if ( rc == 0 )
+        {
+            uint64_t max_entries;
+            if ( KConfigReadU64 ( kfg, "vdb/schema/cache/entries", & max_entries ) == 0 )
+                VSchemaCacheSetMaxEntries ( self -> schema_cache,
+                    max_entries > 0x10000 ? 0x10000 : ( uint32_t ) max_entries );
+        }
+
         KConfigRelease ( kfg );
     }
 
@@ -802,6 +830,64 @@ LIB_EXPORT rc_t CC VDBManagerListExternalSchemaModules ( const VDBManager *self,
 }
 
 
+/* SetDecodeThreads
+ */
+LIB_EXPORT rc_t CC VDBManagerSetDecodeThreads ( const VDBManager *cself, uint32_t num_threads )
+{
+    VDBManager *self = ( VDBManager* ) cself;
+    VBlobDecodePool *pool = NULL;
+
+    if ( self == NULL )
+        return RC ( rcVDB, rcMgr, rcUpdating, rcSelf, rcNull );
+
+    if ( num_threads == VBlobDecodePoolThreads ( self -> decode_pool ) )
+        return 0;
+
+    if ( num_threads != 0 )
+    {
+        rc_t rc = VBlobDecodePoolMake ( & pool, num_threads );
+        if ( rc != 0 )
+            return rc;
+    }
+
+    /* productions already using the old pool keep it alive */
+    VBlobDecodePoolRelease ( self -> decode_pool );
+    self -> decode_pool = pool;
+
+    return 0;
+}
+
+
+/* SetSchemaCacheEntries
+ */
+LIB_EXPORT rc_t CC VDBManagerSetSchemaCacheEntries ( const VDBManager *self, uint32_t max_entries )
+{
+    if ( self == NULL )
+        return RC ( rcVDB, rcMgr, rcUpdating, rcSelf, rcNull );
+
+    VSchemaCacheSetMaxEntries ( self -> schema_cache, max_entries );
+    return 0;
+}
+
+
+/* GetSchemaCacheStats
+ */
+LIB_EXPORT rc_t CC VDBManagerGetSchemaCacheStats ( const VDBManager *self,
+    VDBManagerSchemaCacheStats *stats )
+{
+    if ( stats == NULL )
+        return RC ( rcVDB, rcMgr, rcAccessing, rcParam, rcNull );
+    if ( self == NULL )
+    {
+        memset ( stats, 0, sizeof * stats );
+        return RC ( rcVDB, rcMgr, rcAccessing, rcSelf, rcNull );
+    }
+
+    VSchemaCacheGetStats ( self -> schema_cache, stats );
+    return 0;
+}
+
+
 /* PathType
  *  check the path type of an object/directory path.
  *
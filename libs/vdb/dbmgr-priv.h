@@ -59,6 +59,7 @@ extern "C" {
 struct KDBManager;
 struct VSchema;
 struct VLinker;
+struct VBlobDecodePool;
 
 
 /*--------------------------------------------------------------------------
@@ -76,6 +77,13 @@ struct VDBManager
     /* intrinsic functions */
     struct VLinker *linker;
 
+    /* worker threads for decoding blobs ahead of readers
+       NULL when disabled */
+    struct VBlobDecodePool *decode_pool;
+
+    /* schemas parsed when opening objects for read */
+    struct VSchemaCache *schema_cache;
+
     /* user data */
     void *user;
     void ( CC * user_whack ) ( void *data );
@@ -36,10 +36,12 @@
 #undef KONST
 
 #include "schema-priv.h"
+#include "schema-cache.h"
 #include "linker-priv.h"
 
 #include <vdb/manager.h>
 #include <vdb/schema.h>
+#include <vdb/vdb-priv.h> /* VDBManagerSetDecodeThreads */
 #include <kdb/kdb-priv.h> /* KDBManagerMakeReadWithVFSManager */
 #include <kdb/manager.h>
 #include <kfs/directory.h>
@@ -93,7 +95,11 @@ LIB_EXPORT rc_t CC VDBManagerMakeReadWithVFSManager ( const VDBManager ** mgrp,
                     rc = VLinkerMakeIntrinsic ( & mgr -> linker );
                     if ( rc == 0 )
                     {
-                        rc = VDBManagerConfigPaths ( mgr, false );
+                        mgr -> decode_pool = NULL;
+                        rc = VSchemaCacheMake ( & mgr -> schema_cache,
+                            mgr -> schema, DFLT_SCHEMA_CACHE_ENTRIES );
+                        if ( rc == 0 )
+                            rc = VDBManagerConfigPaths ( mgr, false );
                         if ( rc == 0 )
                         {
                             mgr -> user = NULL;
@@ -103,6 +109,8 @@ LIB_EXPORT rc_t CC VDBManagerMakeReadWithVFSManager ( const VDBManager ** mgrp,
                             return 0;
                         }
 
+                        VDBManagerSetDecodeThreads ( mgr, 0 );
+                        VSchemaCacheWhack ( mgr -> schema_cache );
                         VLinkerRelease ( mgr -> linker );
                     }
 
@@ -0,0 +1,239 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <vdb/extern.h>
+
+typedef struct VBlobDecodeTask VBlobDecodeTask;
+#define KTASK_IMPL struct VBlobDecodeTask
+
+#include "decode-pool.h"
+#include "blob-priv.h"
+
+#include <kproc/task.h>
+#include <kproc/impl.h>
+#include <kproc/threadpool.h>
+#include <klib/rc.h>
+#include <klib/time.h>
+#include <atomic32.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <assert.h>
+
+enum
+{
+    djQueued,
+    djRunning,
+    djDone
+};
+
+
+/*--------------------------------------------------------------------------
+ * VBlobDecodeJob
+ */
+
+rc_t VBlobDecodeJobMake ( VBlobDecodeJob **jobp,
+    VBlobDecodeFunc run, void *data, VBlob *src )
+{
+    VBlobDecodeJob *job = calloc ( 1, sizeof * job );
+    if ( job == NULL )
+        return RC ( rcVDB, rcBlob, rcConstructing, rcMemory, rcExhausted );
+
+    job -> run = run;
+    job -> data = data;
+    job -> src = src;
+    atomic32_set ( & job -> state, djQueued );
+
+    * jobp = job;
+    return 0;
+}
+
+void VBlobDecodeJobWhack ( VBlobDecodeJob *self )
+{
+    if ( self != NULL )
+    {
+        assert ( atomic32_read ( & self -> state ) != djRunning );
+        KTaskFutureRelease ( self -> future );
+        VBlobRelease ( self -> src );
+        VBlobRelease ( self -> rslt );
+        free ( self );
+    }
+}
+
+
+/*--------------------------------------------------------------------------
+ * VBlobDecodeTask
+ *  runs a job on the process-wide thread pool, unless
+ *  it was cancelled before any worker got to it
+ */
+struct VBlobDecodeTask
+{
+    KTask dad;
+    VBlobDecodeJob *job;
+};
+
+static
+rc_t CC VBlobDecodeTaskWhack ( VBlobDecodeTask *self )
+{
+    KTaskDestroy ( & self -> dad, "VBlobDecodeTask" );
+    free ( self );
+    return 0;
+}
+
+static
+rc_t CC VBlobDecodeTaskExecute ( VBlobDecodeTask *self )
+{
+    VBlobDecodeJob *job = self -> job;
+
+    if ( atomic32_test_and_set ( & job -> state, djRunning, djQueued ) == djQueued )
+    {
+        uint64_t start = KTimeNsStamp ();
+        job -> rc = ( * job -> run ) ( job -> data, job -> src, & job -> rslt );
+        job -> decode_ns = KTimeNsStamp () - start;
+        atomic32_set ( & job -> state, djDone );
+    }
+    return 0;
+}
+
+static KTask_vt_v1 VBlobDecodeTask_vt =
+{
+    1, 0,
+    VBlobDecodeTaskWhack,
+    VBlobDecodeTaskExecute
+};
+
+
+/*--------------------------------------------------------------------------
+ * VBlobDecodePool
+ *  a manager's share of the process-wide thread pool:
+ *  the number of workers a reader may keep busy decoding ahead
+ */
+struct VBlobDecodePool
+{
+    KThreadPool *pool;
+    uint32_t num_threads;
+    atomic32_t refcount;
+};
+
+rc_t VBlobDecodePoolMake ( VBlobDecodePool **poolp, uint32_t num_threads )
+{
+    rc_t rc;
+    VBlobDecodePool *self;
+
+    if ( num_threads == 0 )
+        return RC ( rcVDB, rcThread, rcConstructing, rcParam, rcInvalid );
+
+    self = calloc ( 1, sizeof * self );
+    if ( self == NULL )
+        return RC ( rcVDB, rcThread, rcConstructing, rcMemory, rcExhausted );
+
+    rc = KThreadPoolGetDefault ( & self -> pool );
+    if ( rc != 0 )
+    {
+        free ( self );
+        self = NULL;
+    }
+    else
+    {
+        uint32_t workers = KThreadPoolThreads ( self -> pool );
+        self -> num_threads = num_threads < workers ? num_threads : workers;
+        atomic32_set ( & self -> refcount, 1 );
+    }
+
+    * poolp = self;
+    return rc;
+}
+
+rc_t VBlobDecodePoolAddRef ( const VBlobDecodePool *self )
+{
+    if ( self != NULL )
+        atomic32_inc ( & ( ( VBlobDecodePool* ) self ) -> refcount );
+    return 0;
+}
+
+rc_t VBlobDecodePoolRelease ( const VBlobDecodePool *cself )
+{
+    VBlobDecodePool *self = ( VBlobDecodePool* ) cself;
+    if ( self != NULL && atomic32_dec_and_test ( & self -> refcount ) )
+    {
+        KThreadPoolRelease ( self -> pool );
+        free ( self );
+    }
+    return 0;
+}
+
+uint32_t VBlobDecodePoolThreads ( const VBlobDecodePool *self )
+{
+    return self == NULL ? 0 : self -> num_threads;
+}
+
+rc_t VBlobDecodePoolSubmit ( VBlobDecodePool *self, VBlobDecodeJob *job )
+{
+    rc_t rc;
+    VBlobDecodeTask *t;
+
+    assert ( self != NULL );
+    assert ( job != NULL && job -> future == NULL );
+
+    t = malloc ( sizeof * t );
+    if ( t == NULL )
+        return RC ( rcVDB, rcThread, rcExecuting, rcMemory, rcExhausted );
+
+    rc = KTaskInit ( & t -> dad, ( const KTask_vt* ) & VBlobDecodeTask_vt, "VBlobDecodeTask", "" );
+    if ( rc != 0 )
+    {
+        free ( t );
+        return rc;
+    }
+    t -> job = job;
+
+    rc = KThreadPoolSubmit ( self -> pool, & t -> dad, & job -> future );
+    KTaskRelease ( & t -> dad );
+    return rc;
+}
+
+void VBlobDecodePoolWait ( VBlobDecodePool *self, VBlobDecodeJob *job )
+{
+    rc_t status;
+
+    assert ( self != NULL && job != NULL && job -> future != NULL );
+
+    /* a task no worker has started yet is run right here */
+    KTaskFutureWait ( job -> future, & status, NULL );
+    assert ( atomic32_read ( & job -> state ) == djDone );
+}
+
+void VBlobDecodePoolCancel ( VBlobDecodePool *self, VBlobDecodeJob *job )
+{
+    rc_t status;
+
+    assert ( self != NULL && job != NULL );
+
+    /* a job that has not started never will; one that has is waited for */
+    atomic32_test_and_set ( & job -> state, djDone, djQueued );
+    if ( job -> future != NULL )
+        KTaskFutureWait ( job -> future, & status, NULL );
+}
@@ -0,0 +1,131 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_decode_pool_
+#define _h_decode_pool_
+
+#ifndef _h_vdb_extern_
+#include <vdb/extern.h>
+#endif
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+#ifndef _h_atomic32_
+#include <atomic32.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * forwards
+ */
+struct VBlob;
+struct KTaskFuture;
+
+
+/*--------------------------------------------------------------------------
+ * VBlobDecodeJob
+ *  decoding of a single input blob, queued on a VBlobDecodePool
+ *  the input blob range is known up front, the output is not
+ *  available until the job has been waited upon
+ */
+typedef struct VBlobDecodeJob VBlobDecodeJob;
+
+typedef rc_t ( CC * VBlobDecodeFunc ) ( void *data,
+    struct VBlob *src, struct VBlob **rslt );
+
+struct VBlobDecodeJob
+{
+    struct KTaskFuture *future;
+
+    VBlobDecodeFunc run;
+    void *data;
+
+    /* owned references */
+    struct VBlob *src;
+    struct VBlob *rslt;
+
+    /* time spent in "run" */
+    uint64_t decode_ns;
+
+    rc_t rc;
+    atomic32_t state;
+};
+
+/* Make
+ *  takes over the reference to "src"
+ */
+rc_t VBlobDecodeJobMake ( VBlobDecodeJob **job,
+    VBlobDecodeFunc run, void *data, struct VBlob *src );
+
+/* Whack
+ *  releases any blobs still held
+ */
+void VBlobDecodeJobWhack ( VBlobDecodeJob *self );
+
+
+/*--------------------------------------------------------------------------
+ * VBlobDecodePool
+ *  decodes jobs as tasks on the process-wide KThreadPool,
+ *  keeping up to "num_threads" of its workers busy per reader
+ */
+typedef struct VBlobDecodePool VBlobDecodePool;
+
+rc_t VBlobDecodePoolMake ( VBlobDecodePool **pool, uint32_t num_threads );
+rc_t VBlobDecodePoolAddRef ( const VBlobDecodePool *self );
+rc_t VBlobDecodePoolRelease ( const VBlobDecodePool *self );
+
+uint32_t VBlobDecodePoolThreads ( const VBlobDecodePool *self );
+
+/* Submit
+ *  queue job for background decoding on the default thread pool
+ */
+rc_t VBlobDecodePoolSubmit ( VBlobDecodePool *self, VBlobDecodeJob *job );
+
+/* Wait
+ *  wait for job to complete. a job still waiting in the queue
+ *  is taken back and run on the calling thread instead.
+ *  on return, "job -> rc" and "job -> rslt" are valid
+ */
+void VBlobDecodePoolWait ( VBlobDecodePool *self, VBlobDecodeJob *job );
+
+/* Cancel
+ *  keep a queued job from running, or wait for a running one,
+ *  so that it may be whacked
+ */
+void VBlobDecodePoolCancel ( VBlobDecodePool *self, VBlobDecodeJob *job );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_decode_pool_ */
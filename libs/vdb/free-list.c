@@ -0,0 +1,141 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <vdb/extern.h>
+
+#include "free-list.h"
+
+#include <atomic32.h>
+#include <atomic.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+
+
+/*--------------------------------------------------------------------------
+ * VFreeList
+ */
+
+/* threads run on stacks far apart, so the address of a local
+   tells them apart without thread-local storage */
+static
+uint32_t VFreeListShardHint ( void )
+{
+    int local;
+    uint32_t h = ( uint32_t ) ( ( size_t ) & local >> 16 ) * 2654435761u;
+    return h >> 29;
+}
+
+static
+bool VFreeListShardTryLock ( VFreeListShard *self )
+{
+    return atomic32_test_and_set ( & self -> lock, 1, 0 ) == 0;
+}
+
+static
+void VFreeListShardUnlock ( VFreeListShard *self )
+{
+    atomic32_test_and_set ( & self -> lock, 0, 1 );
+}
+
+void *VFreeListAlloc ( VFreeList *self, size_t size )
+{
+    uint32_t i;
+    uint32_t hint = VFreeListShardHint ();
+
+    for ( i = 0; i < VFREE_LIST_SHARDS; ++ i )
+    {
+        VFreeListShard *shard = & self -> shard [ ( hint + i ) % VFREE_LIST_SHARDS ];
+        if ( VFreeListShardTryLock ( shard ) )
+        {
+            void *obj = shard -> head;
+            if ( obj != NULL )
+            {
+                shard -> head = * ( void** ) obj;
+                -- shard -> count;
+            }
+            VFreeListShardUnlock ( shard );
+
+            if ( obj != NULL )
+            {
+                atomic_inc ( & self -> shard [ hint ] . reuses );
+                return obj;
+            }
+        }
+    }
+
+    atomic_inc ( & self -> shard [ hint ] . allocs );
+    return malloc ( size );
+}
+
+void VFreeListFree ( VFreeList *self, void *obj )
+{
+    if ( obj != NULL )
+    {
+        uint32_t i;
+        uint32_t hint = VFreeListShardHint ();
+        uint32_t max = self -> max / VFREE_LIST_SHARDS;
+        if ( max == 0 )
+            max = 1;
+
+        for ( i = 0; i < VFREE_LIST_SHARDS; ++ i )
+        {
+            VFreeListShard *shard = & self -> shard [ ( hint + i ) % VFREE_LIST_SHARDS ];
+            if ( VFreeListShardTryLock ( shard ) )
+            {
+                bool kept = shard -> count < max;
+                if ( kept )
+                {
+                    * ( void** ) obj = shard -> head;
+                    shard -> head = obj;
+                    ++ shard -> count;
+                }
+                VFreeListShardUnlock ( shard );
+
+                if ( kept )
+                    return;
+            }
+        }
+
+        free ( obj );
+    }
+}
+
+void VFreeListStats ( VFreeList *self, uint64_t *allocs, uint64_t *reuses )
+{
+    uint32_t i;
+    uint64_t a = 0, r = 0;
+
+    for ( i = 0; i < VFREE_LIST_SHARDS; ++ i )
+    {
+        a += atomic_read ( & self -> shard [ i ] . allocs );
+        r += atomic_read ( & self -> shard [ i ] . reuses );
+    }
+    if ( allocs != NULL )
+        * allocs = a;
+    if ( reuses != NULL )
+        * reuses = r;
+}
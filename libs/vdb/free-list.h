@@ -0,0 +1,96 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_free_list_
+#define _h_free_list_
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+#include <atomic32.h>
+#include <atomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * VFreeList
+ *  recycles released objects of a single size,
+ *  keeping at most "max" of them for reuse
+ *
+ *  the list is split into VFREE_LIST_SHARDS shards of "max" / VFREE_LIST_SHARDS
+ *  objects each. a thread starts at the shard picked by its stack address
+ *  and skips a busy shard for the next one rather than wait for it.
+ *
+ *  a VFreeList is a statically initialized global,
+ *  e.g. "static VFreeList blobs = { 1024 };"
+ */
+#define VFREE_LIST_SHARDS 8
+
+typedef struct VFreeListShard VFreeListShard;
+struct VFreeListShard
+{
+    atomic32_t lock;
+    uint32_t count;
+
+    void *head;
+
+    /* number of allocations that went to malloc,
+       and that were served from the list */
+    atomic_t allocs;
+    atomic_t reuses;
+};
+
+typedef struct VFreeList VFreeList;
+struct VFreeList
+{
+    uint32_t max;
+    VFreeListShard shard [ VFREE_LIST_SHARDS ];
+};
+
+/* Alloc
+ *  returns uninitialized memory of "size" bytes, or NULL
+ */
+void *VFreeListAlloc ( VFreeList *self, size_t size );
+
+/* Free
+ *  returns an object obtained from VFreeListAlloc
+ */
+void VFreeListFree ( VFreeList *self, void *obj );
+
+/* Stats
+ */
+void VFreeListStats ( VFreeList *self, uint64_t *allocs, uint64_t *reuses );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_free_list_ */
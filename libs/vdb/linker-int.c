@@ -216,6 +216,7 @@ extern VTRANSFACT_DECL ( vdb_trunc );
 extern VTRANSFACT_DECL ( vdb_undelta );
 extern VTRANSFACT_DECL ( vdb_unpack );
 extern VTRANSFACT_DECL ( vdb_unzip );
+extern VTRANSFACT_DECL ( vdb_unzstd );
 extern VTRANSFACT_DECL ( vdb_vec_sum );
 
 struct KTable;
@@ -605,6 +606,7 @@ rc_t VLinkerInitFactoriesRead ( VLinker *self,  KSymTable *tbl, const SchemaEnv
         { vdb_undelta, "vdb:undelta" },
         { vdb_unpack, "vdb:unpack" },
         { vdb_unzip, "vdb:unzip" },
+        { vdb_unzstd, "vdb:unzstd" },
         { vdb_vec_sum, "vdb:vec_sum" },
 
         { vdb_hello, "vdb:hello" }
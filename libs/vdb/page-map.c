@@ -36,6 +36,7 @@
 #include <klib/vlen-encode.h>
 #include <sysalloc.h>
 #include "page-map.h"
+#include "free-list.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -69,6 +70,7 @@ static struct {
     unsigned expands;
     unsigned expandCalls;
     unsigned appends;
+    unsigned rowIndexes;
 } pm_stats;
 #endif
 
@@ -328,48 +330,137 @@ rc_t PageMapExpand(const PageMap *cself, row_count_t upto)
 	return 0;
 }
 
-static rc_t PageMapFindRegion(const PageMap *cself,uint64_t row,PageMapRegion **pmr)
+/*** row index:
+     the region of every (1 << ridx_shift)-th row, so that a random lookup
+     starts at most a sample away from its region instead of binary searching;
+     the sampling is chosen so that there are no more samples than regions,
+     and the index never exceeds PM_ROW_INDEX_MAX_BYTES ***/
+#define PM_ROW_INDEX_MIN_REGIONS 64
+#define PM_ROW_INDEX_TRIGGER 16
+#define PM_ROW_INDEX_MAX_BYTES ( 256 * 1024 )
+
+static rc_t PageMapBuildRowIndex(PageMap *self)
+{
+	rc_t	rc;
+	uint32_t shift;
+	pm_size_t i, n, i_rgn;
+	pm_size_t *ridx;
+	const PageMapRegion *rgn;
+
+	if(self->rstorage.elem_count > 0 || self->exp_rgn_cnt < PM_ROW_INDEX_MIN_REGIONS || self->row_count == 0)
+		return 0;
+	if(self->exp_row_last < self->row_count){
+		rc = PageMapExpand(self, self->row_count - 1);
+		if(rc) return rc;
+	}
+	for(shift = 0;
+	       ((self->row_count - 1) >> shift) + 1 > self->exp_rgn_cnt
+	    || (((self->row_count - 1) >> shift) + 1) * sizeof(pm_size_t) > PM_ROW_INDEX_MAX_BYTES;
+	    shift++){}
+	n = ((self->row_count - 1) >> shift) + 1;
+
+	self->rstorage.elem_bits = sizeof(pm_size_t)*8;
+	rc = KDataBufferResize(&self->rstorage, n);
+	if(rc) return rc;
+
+	ridx = self->rstorage.base;
+	rgn = self->istorage.base;
+	for(i = 0, i_rgn = 0; i < n; i++){
+		row_count_t row = (row_count_t)i << shift;
+		while(i_rgn + 1 < self->exp_rgn_cnt && row >= rgn[i_rgn].start_row + rgn[i_rgn].numrows)
+			i_rgn++;
+		ridx[i] = i_rgn;
+	}
+	self->ridx_shift = shift;
+#if PAGEMAP_STATISTICS
+	++pm_stats.rowIndexes;
+	pm_stats.currentFootprint += KDataBufferBytes(&self->rstorage);
+	if (pm_stats.maxFootprint < pm_stats.currentFootprint)
+		pm_stats.maxFootprint = pm_stats.currentFootprint;
+#endif
+	return 0;
+}
+
+size_t PageMapRowIndexBytes(const PageMap *cself)
+{
+	return KDataBufferBytes(&cself->rstorage);
+}
+
+rc_t PageMapExpandAll(const PageMap *cself)
+{
+	if(cself->data_recs > 1 && cself->row_count > 0 && cself->exp_row_last < cself->row_count){
+		rc_t rc = PageMapExpand(cself, cself->row_count - 1);
+		if(rc) return rc;
+	}
+	if(cself->data_recs > 1){
+		rc_t rc = PageMapBuildRowIndex((PageMap *)cself);
+		if(rc) return rc;
+	}
+	((PageMap *)cself)->published = true;
+	return 0;
+}
+
+/*** a published map may be searched by several threads at once:
+     it is fully expanded, so only the last search hint and the miss count
+     would be written - it keeps neither and binary searches from the middle ***/
+static rc_t PageMapFindRegion(const PageMap *cself,uint64_t row,pm_size_t *pi_rgn)
 {
 	/*** in PageMap rows are 0-based **/
 	rc_t	rc;
 	pm_size_t left,right,i_rgn;
 	if(row >= cself->row_count )
 		return  RC (rcVDB, rcPagemap, rcSearching, rcRow, rcNotFound );
-	if(cself -> exp_row_last <= row){
-		rc=PageMapExpand(cself,row);
+	if(!cself->published && cself->ridx_misses >= PM_ROW_INDEX_TRIGGER && cself->rstorage.elem_count == 0){
+		rc=PageMapBuildRowIndex((PageMap *)cself);
 		if(rc) return rc;
 	}
 
-	if(cself->exp_rgn_cnt > 1){
-		i_rgn = cself->i_rgn_last;
-		left = 0;
-		right = cself->exp_rgn_cnt - 1;
-		while(right > left){
-			PageMapRegion*  rgn=  (PageMapRegion*)cself->istorage.base + i_rgn;
-			assert(i_rgn < cself->exp_rgn_cnt);
-			if(row < rgn->start_row){
-				right = i_rgn-1;
-				i_rgn  = (left + right) / 2;
-			} else if(row == rgn->start_row + rgn->numrows){ /*** special case for positive sequentual scans ***/
-				i_rgn++;
-			} else if(row > rgn->start_row + rgn->numrows){
-				left = i_rgn+1;
-				i_rgn =  (left + right + 1) / 2;
-			} else {
-				break;
+	if((row >> cself->ridx_shift) < cself->rstorage.elem_count && row < cself->exp_row_last){
+		const PageMapRegion *rgn = cself->istorage.base;
+		i_rgn = ((const pm_size_t *)cself->rstorage.base)[row >> cself->ridx_shift];
+		while(row >= rgn[i_rgn].start_row + rgn[i_rgn].numrows)
+			i_rgn++;
+	} else {
+		if(cself -> exp_row_last <= row){
+			assert(!cself->published);
+			rc=PageMapExpand(cself,row);
+			if(rc) return rc;
+		}
+		if(cself->exp_rgn_cnt > 1){
+			left = 0;
+			right = cself->exp_rgn_cnt - 1;
+			if(cself->published)
+				i_rgn = right / 2;
+			else {
+				const PageMapRegion *prev = (const PageMapRegion*)cself->istorage.base + cself->i_rgn_last;
+				if(row < prev->start_row || row > prev->start_row + prev->numrows)
+					((PageMap *)cself)->ridx_misses++; /*** not a sequential scan ***/
+				i_rgn = cself->i_rgn_last;
+			}
+			while(right > left){
+				PageMapRegion*  rgn=  (PageMapRegion*)cself->istorage.base + i_rgn;
+				assert(i_rgn < cself->exp_rgn_cnt);
+				if(row < rgn->start_row){
+					right = i_rgn-1;
+					i_rgn  = (left + right) / 2;
+				} else if(row == rgn->start_row + rgn->numrows){ /*** special case for positive sequentual scans ***/
+					i_rgn++;
+				} else if(row > rgn->start_row + rgn->numrows){
+					left = i_rgn+1;
+					i_rgn =  (left + right + 1) / 2;
+				} else {
+					break;
+				}
 			}
+		} else {
+			i_rgn = 0;
 		}
-	} else {
-		i_rgn = 0;
 	}
-	{
-		PageMap *self = (PageMap *)cself;
-		self->i_rgn_last = i_rgn;
-		self->rgn_last = (PageMapRegion*)self->istorage.base+cself->i_rgn_last;
-	}
-	assert(cself->rgn_last->start_row <= row);
-	assert(cself->rgn_last->start_row + cself->rgn_last->numrows > row);
-	if(pmr) *pmr=(PageMapRegion*)cself->istorage.base + i_rgn;
+	if(!cself->published)
+		((PageMap *)cself)->i_rgn_last = i_rgn;
+	assert(((const PageMapRegion*)cself->istorage.base)[i_rgn].start_row <= row);
+	assert(((const PageMapRegion*)cself->istorage.base)[i_rgn].start_row + ((const PageMapRegion*)cself->istorage.base)[i_rgn].numrows > row);
+	*pi_rgn = i_rgn;
 	return 0;
 }
 
@@ -479,6 +570,7 @@ static int DEBUG_PageMapPrintSum(const PageMap *pm, uint32_t row)
 rc_t PageMapFindRow(const PageMap *cself,uint64_t row,uint32_t * data_offset,uint32_t * data_length,uint32_t * repeat_count)
 {
 	rc_t	rc=0;
+	pm_size_t i_rgn;
 	PageMapRegion *pmr;
 
 	if(cself->data_recs == 1){ /** static **/
@@ -499,8 +591,9 @@ rc_t PageMapFindRow(const PageMap *cself,uint64_t row,uint32_t * data_offset,uin
 		return 0;
 	}
 
-	rc = PageMapFindRegion(cself,row,&pmr);
+	rc = PageMapFindRegion(cself,row,&i_rgn);
 	if(rc) return rc;
+	pmr = (PageMapRegion*)cself->istorage.base + i_rgn;
 
         rc = PageMapRegionGetData(pmr,cself->dstorage.base,row,data_offset,data_length,repeat_count);
 	if(rc) return rc;
@@ -521,6 +614,7 @@ rc_t PageMapFindRow(const PageMap *cself,uint64_t row,uint32_t * data_offset,uin
 LIB_EXPORT rc_t PageMapNewIterator(const PageMap *self, PageMapIterator *lhs, uint64_t first_row, uint64_t num_rows)
 {
     rc_t rc;
+    pm_size_t i_rgn;
 
     if (first_row + num_rows > self->row_count)
         num_rows = self->row_count - first_row;
@@ -556,22 +650,43 @@ LIB_EXPORT rc_t PageMapNewIterator(const PageMap *self, PageMapIterator *lhs, ui
 	    rc = PageMapExpand(self,lhs->last_row-1);
 	    if(rc) return rc;
     }
-    rc = PageMapFindRow(self,first_row,NULL,NULL,NULL);
+    rc = PageMapFindRegion(self,first_row,&i_rgn);
     if(rc) return rc;
     lhs->rgns    = (PageMapRegion**) &self->istorage.base;
     lhs->exp_base = (elem_count_t**) &self->dstorage.base;
-    lhs->cur_rgn  = self->i_rgn_last;
-    lhs->cur_rgn_row = lhs->cur_row - (*lhs->rgns)[self->i_rgn_last].start_row;
-    assert(lhs->cur_rgn_row < (*lhs->rgns)[self->i_rgn_last].numrows);
+    lhs->cur_rgn  = i_rgn;
+    lhs->cur_rgn_row = lhs->cur_row - (*lhs->rgns)[i_rgn].start_row;
+    assert(lhs->cur_rgn_row < (*lhs->rgns)[i_rgn].numrows);
     return  0;
 }
 
+/* page maps with up to PM_POOLED_RECS length and data records in line
+   are recycled through a free list */
+#define PM_POOLED_RECS 16
+#define PM_POOLED_BYTES (sizeof(PageMap) + PM_POOLED_RECS * (sizeof(elem_count_t) + 2 * sizeof(row_count_t)))
+
+static VFreeList pm_free_list = { 1024 };
+
+void PageMapGetAllocStats(uint64_t *allocs, uint64_t *reuses)
+{
+    VFreeListStats(&pm_free_list, allocs, reuses);
+}
+
+static void PageMapFree(PageMap *that)
+{
+    if (that->pooled)
+        VFreeListFree(&pm_free_list, that);
+    else
+        free(that);
+}
+
 static PageMap *new_PageMap(void) {
 
     PageMap *y;
-    y = malloc(sizeof(*y));
+    y = VFreeListAlloc(&pm_free_list, PM_POOLED_BYTES);
     if (y) {
 	memset(y,0,sizeof(*y));
+	y->pooled = true;
         KRefcountInit(&y->refcount, 1, "PageMap", "new", "");
 	y->istorage.elem_bits = sizeof(PageMapRegion)*8;
 	y->dstorage.elem_bits = sizeof(elem_count_t)*8;
@@ -589,8 +704,9 @@ static PageMap *new_StaticPageMap(unsigned length, unsigned data) {
                     + sizeof(y->pm.length[0]) * length
                     + sizeof(y->pm.leng_run[0]) * length
                     + sizeof(y->pm.data_run[0]) * data;
+    bool const pooled = sz <= PM_POOLED_BYTES;
     
-    y = malloc(sz);
+    y = pooled ? VFreeListAlloc(&pm_free_list, PM_POOLED_BYTES) : malloc(sz);
     if (y) {
 #if PAGEMAP_STATISTICS
         ++pm_stats.createStatic;
@@ -602,6 +718,7 @@ static PageMap *new_StaticPageMap(unsigned length, unsigned data) {
             pm_stats.maxFootprint = pm_stats.currentFootprint;
 #endif
         memset(&y->pm, 0, sizeof(y->pm));
+        y->pm.pooled = pooled;
         KRefcountInit(&y->pm.refcount, 1, "PageMap", "new_Static", "");
         y->pm.length = (elem_count_t *)&y[1];
         y->pm.leng_run = (row_count_t *)&y->pm.length[length];
@@ -691,7 +808,7 @@ rc_t PageMapNew(PageMap **lhs, uint32_t reserve) {
     if (reserve > 0) {
         rc_t rc = PageMapGrow(y, reserve, reserve);
         if (rc) {
-            free(y);
+            PageMapFree(y);
             return rc;
         }
 #if PAGEMAP_STATISTICS
@@ -1550,7 +1667,8 @@ rc_t PageMapDestroy(PageMap *that)
                 "Created (static/fixed/single/total): %u/%u/%u/%u\n"
                 "Grows: %u\n"
                 "Expands (act/calls): %u/%u\n"
-                "Appends: %u\n\n",
+                "Appends: %u\n"
+                "Row indexes: %u\n\n",
                 (unsigned)pm_stats.currentFootprint,
                 (unsigned)pm_stats.maxFootprint,
                 (unsigned)pm_stats.currentWaste,
@@ -1564,14 +1682,16 @@ rc_t PageMapDestroy(PageMap *that)
                 pm_stats.grows,
                 pm_stats.expands,
                 pm_stats.expandCalls,
-                pm_stats.appends
+                pm_stats.appends,
+                pm_stats.rowIndexes
                 );
     }
 #endif
     KDataBufferWhack(&that->istorage);
     KDataBufferWhack(&that->dstorage);
     KDataBufferWhack(&that->cstorage);
-    free(that);
+    KDataBufferWhack(&that->rstorage);
+    PageMapFree(that);
     return 0;
 }
 
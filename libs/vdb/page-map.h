@@ -80,6 +80,8 @@ typedef struct PageMap {
      * == storage.base
      */
     bool   random_access;
+    bool   pooled;        /* allocated from the page map free list */
+    bool   published;     /* fully expanded and indexed, lookups no longer write */
     enum { eBlobPageMapOptimizedNone, eBlobPageMapOptimizedSucceeded, eBlobPageMapOptimizedFailed}  optimized;
     elem_count_t *length;
 
@@ -113,9 +115,13 @@ typedef struct PageMap {
 
     KDataBuffer			istorage;	/* binary searchable storage for expansion regions */
     KDataBuffer			dstorage;	/* storage for expanded data */
-/** LAST SEARCH CONTROL *****/
+/** LAST SEARCH CONTROL - not maintained once published *****/
     pm_size_t			i_rgn_last; 	/* region index found in previous lookup **/
-    PageMapRegion*		rgn_last; 	/* redundant - region found in previous lookup **/
+
+/** ROW INDEX - built lazily for random access *****/
+    KDataBuffer			rstorage;	/* region index of every (1 << ridx_shift)-th row */
+    uint32_t			ridx_shift;
+    uint32_t			ridx_misses;	/* lookups resolved by binary search */
 
 /****************************/
 
@@ -382,5 +388,12 @@ bool PageMapHasRows(const PageMap *self);
 rc_t PageMapExpand(const PageMap *cself, row_count_t upto);
 rc_t PageMapExpandFull(const PageMap *cself);
 rc_t PageMapPreExpandFull(const PageMap *cself, row_count_t upto);
+/*** builds the whole region index and marks the map published:
+     later lookups never modify it, so it may be shared between threads ***/
+rc_t PageMapExpandAll(const PageMap *cself);
+/*** bytes used by the row index, 0 if it has not been built ***/
+size_t PageMapRowIndexBytes(const PageMap *cself);
+/*** number of page maps allocated by malloc and reused from the free list ***/
+void PageMapGetAllocStats(uint64_t *allocs, uint64_t *reuses);
 
 #endif /* _h_page_map_ */
@@ -87,6 +87,8 @@ void VPhysicalDestroy ( VPhysical *self )
 #endif
 
     KDataBufferWhack ( & self -> srow );
+    KDataBufferWhack ( & self -> kstage_data );
+    KColumnBlobRelease ( self -> kstage );
 
     SExpressionWhack ( self -> enc );
 
@@ -109,6 +111,7 @@ rc_t VPhysicalMake ( VPhysical **physp, const VCursor *curs, const SPhysMember *
 
     phys -> curs = curs;
     phys -> smbr = smbr;
+    phys -> kread_start = 1;
 
     * physp = phys;
     return 0;
@@ -350,6 +353,215 @@ rc_t VPhysicalOpenRead ( VPhysical *self, VSchema *schema, const VTable *tbl )
     return rc;
 }
 
+/* Unstage
+ *  drop a staged blob
+ */
+static
+void VPhysicalUnstage ( VPhysical *self )
+{
+    KDataBufferWhack ( & self -> kstage_data );
+    KColumnBlobRelease ( self -> kstage );
+    self -> kstage = NULL;
+}
+
+/* NeedsStage
+ *  true if a column being read by the cursor will want the blob holding "id"
+ *  and has neither read, staged nor cached it yet
+ */
+static
+bool VPhysicalNeedsStage ( VPhysical *self, int64_t id )
+{
+    if ( self == NULL || self == FAILED_PHYSICAL || self -> kcol == NULL )
+        return false;
+
+    /* columns that were never read are left alone.
+       a column that has read up to or beyond "id" either holds
+       the blob or has it queued for decoding ahead */
+    if ( self -> kread_stop < self -> kread_start )
+        return false;
+    if ( id <= self -> kread_stop )
+        return false;
+
+    /* a staged blob is kept until the column reads past it */
+    if ( self -> kstage != NULL && self -> kread_stop < self -> kstage_stop )
+        return false;
+
+    if ( VPhysicalLazySetRange ( self ) != 0 )
+        return false;
+    if ( id < self -> kstart_id || id > self -> kstop_id )
+        return false;
+
+    return ! VCursorBlobCached ( self -> curs, self -> out, id );
+}
+
+/* StageKColumns
+ *  read the blob holding "id" of every physical column of the cursor
+ *  that is about to need it in one call, so that blobs lying close
+ *  together in the underlying file are fetched together.
+ *  columns holding the blob already, in a cache or queued
+ *  for decoding, are skipped.
+ *  failures are not reported; columns just read their own blobs.
+ */
+static
+void VPhysicalStageKColumns ( VPhysical *self, int64_t id )
+{
+    void *mem;
+    VPhysical **phys;
+    const KColumnBlob **blobs;
+    KDataBuffer *buffers;
+    KColumnBlobCSData *cs;
+    uint32_t i, j, count, total;
+    const Vector *cache = & self -> curs -> phys . cache;
+    uint32_t start = VectorStart ( cache );
+    uint32_t end = start + VectorLength ( cache );
+    bool validate = self -> curs -> tbl -> blob_validation;
+
+    if ( ! self -> curs -> read_only )
+        return;
+
+    /* count columns, including "self" */
+    for ( count = 0, i = start; i < end; ++ i )
+    {
+        const Vector *ctx = VectorGet ( cache, i );
+        if ( ctx != NULL )
+            count += VectorLength ( ctx );
+    }
+    if ( count < 2 )
+        return;
+
+    mem = malloc ( count * ( sizeof * phys + sizeof * blobs + sizeof * buffers + sizeof * cs ) );
+    if ( mem == NULL )
+        return;
+    buffers = mem;
+    cs = ( KColumnBlobCSData* ) & buffers [ count ];
+    phys = ( VPhysical** ) & cs [ count ];
+    blobs = ( const KColumnBlob** ) & phys [ count ];
+
+    /* find columns to share the read with */
+    phys [ 0 ] = self;
+    for ( total = 1, i = start; i < end; ++ i )
+    {
+        const Vector *ctx = VectorGet ( cache, i );
+        if ( ctx != NULL )
+        {
+            uint32_t ctx_end = VectorStart ( ctx ) + VectorLength ( ctx );
+            for ( j = VectorStart ( ctx ); j < ctx_end; ++ j )
+            {
+                VPhysical *sib = VectorGet ( ctx, j );
+                if ( sib != self && VPhysicalNeedsStage ( sib, id ) )
+                    phys [ total ++ ] = sib;
+            }
+        }
+    }
+
+    /* nobody to share the read with */
+    if ( total < 2 )
+    {
+        free ( mem );
+        return;
+    }
+
+    for ( count = total, total = 0; total < count; ++ total )
+    {
+        if ( KColumnOpenBlobRead ( phys [ total ] -> kcol, & blobs [ total ], id ) != 0 )
+            break;
+    }
+
+    if ( total == count )
+    {
+        if ( KColumnBlobReadAllV ( blobs, total, buffers,
+                 validate ? cs : NULL, validate ? sizeof cs [ 0 ] : 0 ) == 0 )
+        {
+            for ( i = 0; i < total; ++ i )
+            {
+                uint32_t row_count;
+                VPhysical *p = phys [ i ];
+
+                VPhysicalUnstage ( p );
+                if ( KColumnBlobIdRange ( blobs [ i ], & p -> kstage_start, & row_count ) != 0 )
+                    KDataBufferWhack ( & buffers [ i ] );
+                else
+                {
+                    p -> kstage = blobs [ i ];
+                    p -> kstage_data = buffers [ i ];
+                    if ( validate )
+                        p -> kstage_cs = cs [ i ];
+                    p -> kstage_stop = p -> kstage_start + row_count - 1;
+                    blobs [ i ] = NULL;
+
+                    /* counted when read, whether or not it is used */
+                    p -> blobs_read ++;
+                    p -> raw_bytes += KDataBufferBytes ( & p -> kstage_data );
+                }
+            }
+        }
+    }
+
+    for ( i = 0; i < total; ++ i )
+        KColumnBlobRelease ( blobs [ i ] );
+
+    free ( mem );
+}
+
+/* ReadStaged
+ *  turn a staged raw blob into a VBlob
+ */
+static
+rc_t VPhysicalReadStaged ( VPhysical *self, VBlob **vblob )
+{
+    rc_t rc = 0;
+    KDataBuffer buffer = self -> kstage_data;
+    const KColumnBlob *kblob = self -> kstage;
+    int64_t start_id = self -> kstage_start;
+    int64_t stop_id = self -> kstage_stop;
+
+    memset ( & self -> kstage_data, 0, sizeof self -> kstage_data );
+    self -> kstage = NULL;
+
+#if BLOB_VALIDATION
+    if ( self -> curs -> tbl -> blob_validation )
+        rc = KColumnBlobValidateBuffer ( kblob, & buffer, & self -> kstage_cs, sizeof self -> kstage_cs );
+#endif
+
+    if ( rc == 0 && self -> no_hdr )
+    {
+        /* synthesize fake v1 header as when reading blob alone */
+        KDataBuffer hdr;
+        size_t bytes = KDataBufferBytes ( & buffer );
+        rc = KDataBufferMakeBytes ( & hdr, bytes + 2 );
+        if ( rc == 0 )
+        {
+            uint8_t *p = hdr . base;
+            p [ 0 ] = ( uint8_t ) vboLittleEndian;
+            p [ 1 ] = 0;
+            if ( bytes != 0 )
+                memmove ( & p [ 2 ], buffer . base, bytes );
+
+            KDataBufferWhack ( & buffer );
+            buffer = hdr;
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        rc = VBlobNew ( vblob, start_id, stop_id, "readkcolumn" );
+        TRACK_BLOB (VBlobNew, *vblob);
+        if ( rc == 0 )
+        {
+            rc = KDataBufferSub ( & buffer, & ( * vblob ) -> data, 0, UINT64_MAX );
+            assert ( rc == 0 );
+
+            self -> kread_start = start_id;
+            self -> kread_stop = stop_id;
+        }
+    }
+
+    KDataBufferWhack ( & buffer );
+    KColumnBlobRelease ( kblob );
+
+    return rc;
+}
+
 /* ReadKColumn
  *  read a raw blob from kcolumn
  */
@@ -404,6 +616,16 @@ rc_t VPhysicalReadKColumn ( VPhysical *self, VBlob **vblob, int64_t id, uint32_t
     }
 #endif
 
+    /* use a blob staged by a batched read, or try
+       staging it together with the other columns.
+       a blob staged ahead of "id" is kept for later */
+    if ( self -> kstage != NULL && id > self -> kstage_stop )
+        VPhysicalUnstage ( self );
+    if ( self -> kstage == NULL )
+        VPhysicalStageKColumns ( self, id );
+    if ( self -> kstage != NULL && id >= self -> kstage_start )
+        return VPhysicalReadStaged ( self, vblob );
+
     /* find blob in KColumn
        TBD - handle potential merge/update later */
     rc = KColumnOpenBlobRead ( self -> kcol, & kblob, id );
@@ -498,6 +720,12 @@ rc_t VPhysicalReadKColumn ( VPhysical *self, VBlob **vblob, int64_t id, uint32_t
                         {
                             rc = KDataBufferSub ( & buffer, & ( * vblob ) -> data, 0, UINT64_MAX );
                             assert ( rc == 0 );
+
+                            self -> kread_start = start_id;
+                            self -> kread_stop = stop_id;
+
+                            self -> blobs_read ++;
+                            self -> raw_bytes += KDataBufferBytes ( & buffer );
                         }
                     }
 
@@ -622,6 +850,7 @@ rc_t VPhysicalReadBlob ( VPhysical *self, VBlob **vblob, int64_t id, uint32_t el
     rc = VProductionReadBlob ( self -> b2p, vblob, id , 1, NULL);
 	if ( rc == 0 )
     {
+        self -> decoded_bytes += KDataBufferBytes ( & ( * vblob ) -> data );
 	    if((*vblob)->pm==NULL)
         {
             rc = PageMapProcessGetPagemap(&self->curs->pmpr,&(*vblob)->pm);
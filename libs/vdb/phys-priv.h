@@ -39,6 +39,10 @@
 #include <klib/data-buffer.h>
 #endif
 
+#ifndef _h_kdb_column_
+#include <kdb/column.h>
+#endif
+
 #ifndef KONST
 #define KONST
 #endif
@@ -114,6 +118,21 @@ struct VPhysical
     /* cached static row data */
     KDataBuffer srow;
 
+    /* raw blob staged by a batched read of the cursor's columns */
+    struct KColumnBlob const *kstage;
+    KDataBuffer kstage_data;
+    KColumnBlobCSData kstage_cs;
+    int64_t kstage_start, kstage_stop;
+
+    /* read statistics, see VCursorGetStats */
+    uint64_t blobs_read;
+    uint64_t raw_bytes;
+    uint64_t decoded_bytes;
+
+    /* id range of the last blob read from kcol,
+       "kread_stop" < "kread_start" until the first read */
+    int64_t kread_start, kread_stop;
+
     /* id */
     uint32_t id;
 
@@ -176,6 +195,15 @@ rc_t VPhysicalRead ( VPhysical *self,
 rc_t VPhysicalReadBlob ( VPhysical *self,
     struct VBlob **vblob, int64_t id, uint32_t elem_bits );
 
+/* ReadInput
+ * Encode
+ *  split the write of a page so that encoding
+ *  may run apart from the cursor's flush
+ */
+rc_t VPhysicalReadInput ( VPhysical *self,
+    struct VBlob **vblob, int64_t id, uint32_t cnt );
+rc_t VPhysicalEncode ( VPhysical *self, int64_t id, uint32_t cnt );
+
 /* IsStatic
  *  is this a static column
  */
@@ -46,15 +46,19 @@
 #include "blob.h"
 #include "page-map.h"
 #include "blob-headers.h"
+#include "decode-pool.h"
+#include "dbmgr-priv.h"
 #undef KONST
 
 #include <vdb/schema.h>
 #include <vdb/cursor.h>
 #include <vdb/xform.h>
+#include <vdb/vdb-priv.h>
 #include <klib/symbol.h>
 #include <klib/log.h>
 #include <klib/debug.h>
 #include <klib/rc.h>
+#include <klib/time.h>
 #include <sysalloc.h>
 
 #include <ctype.h>
@@ -361,6 +365,9 @@ rc_t VFunctionProdMake ( VFunctionProd **prodp, Vector *owned,
     {
         prod = * prodp;
         prod -> curs = curs;
+        VectorInit ( & prod -> decode_jobs, 0, 4 );
+        prod -> decode_stop = INT64_MAX;
+        prod -> decode_next = INT64_MIN;
 
         if ( sub != prodFuncByteswap )
             VectorInit ( & prod -> parms, 0, 4 );
@@ -375,8 +382,16 @@ rc_t VFunctionProdMake ( VFunctionProd **prodp, Vector *owned,
     return rc;
 }
 
+static void VFunctionProdDropDecodeJob ( VFunctionProd *self );
+
 void VFunctionProdDestroy ( VFunctionProd *self )
 {
+    /* stop decoding ahead */
+    while ( VectorLength ( & self -> decode_jobs ) != 0 )
+        VFunctionProdDropDecodeJob ( self );
+    VectorWhack ( & self -> decode_jobs, NULL, NULL );
+    VBlobDecodePoolRelease ( self -> decode_pool );
+
     /* release input parameters */
     VectorWhack ( & self -> parms, NULL, NULL );
     if ( self -> whack != NULL )
@@ -1799,6 +1814,211 @@ rc_t VFunctionProdSelect ( VFunctionProd *self, VBlob **vblob, int64_t id, uint3
     return pb.rc;
 }
 
+/* fill out information for function to use */
+static
+void VFunctionProdInitInfo ( const VFunctionProd *self, VXformInfo *info )
+{
+    const VCursor *curs = self -> curs;
+
+#if VMGR_PASSED_TO_XFORM
+    info -> mgr = curs -> tbl -> mgr;
+#endif
+#if VSCHEMA_PASSED_TO_XFORM
+    info -> schema = curs -> schema;
+#endif
+#if VTABLE_PASSED_TO_XFORM
+    info -> tbl = curs -> tbl;
+#endif
+#if VPRODUCTION_PASSED_TO_XFORM
+    info -> prod = & self -> dad;
+#endif
+    info -> fdesc . fd = self -> dad . fd;
+    info -> fdesc . desc = self -> dad . desc;
+}
+
+
+/* DecodeAhead
+ *  blob decoding functions ( unzip, iunzip, bunzip... ) keep no state,
+ *  so they may run on the manager's decode pool. while the reader
+ *  consumes one blob, the input blobs that follow are fetched here,
+ *  on the reader's thread, and decoded in the background. results
+ *  are handed back strictly in id order.
+ */
+static
+bool VFunctionProdCanDecodeAhead ( VFunctionProd *self, uint32_t cnt )
+{
+    const VDBManager *mgr;
+
+    if ( self -> decode_pool != NULL )
+        return cnt == 1;
+
+    if ( self -> dad . sub != vftBlob || self -> dad . chain != chainDecoding ||
+         self -> whack != NULL || cnt != 1 || VectorLength ( & self -> parms ) != 1 )
+        return false;
+
+    mgr = self -> curs -> tbl -> mgr;
+    if ( mgr -> decode_pool == NULL )
+        return false;
+
+    VBlobDecodePoolAddRef ( mgr -> decode_pool );
+    self -> decode_pool = mgr -> decode_pool;
+    return true;
+}
+
+static
+rc_t CC VFunctionProdDecodeBlob ( void *data, VBlob *src, VBlob **rslt )
+{
+    rc_t rc;
+    Vector inputs;
+    VXformInfo info;
+    VFunctionProd *self = data;
+
+    VFunctionProdInitInfo ( self, & info );
+
+    VectorInit ( & inputs, 0, 1 );
+    rc = VectorAppend ( & inputs, NULL, src );
+    if ( rc == 0 )
+        rc = VFunctionProdCallBlobFunc ( self, rslt, src -> start_id, & info, & inputs );
+    VectorWhack ( & inputs, NULL, NULL );
+
+    if ( rc == 0 )
+        ( * rslt ) -> no_cache |= src -> no_cache;
+
+    return rc;
+}
+
+static
+void VFunctionProdDropDecodeJob ( VFunctionProd *self )
+{
+    VBlobDecodeJob *job;
+    if ( VectorRemove ( & self -> decode_jobs, 0, ( void** ) & job ) == 0 )
+    {
+        VBlobDecodePoolCancel ( self -> decode_pool, job );
+        VBlobDecodeJobWhack ( job );
+    }
+}
+
+static
+void VFunctionProdQueueDecode ( VFunctionProd *self, int64_t next )
+{
+    VProduction *input = VectorGet ( & self -> parms, 0 );
+    uint32_t count = VectorLength ( & self -> decode_jobs );
+    uint32_t window = 2 * VBlobDecodePoolThreads ( self -> decode_pool );
+
+    if ( count != 0 )
+    {
+        const VBlobDecodeJob *last = VectorLast ( & self -> decode_jobs );
+        next = last -> src -> stop_id + 1;
+    }
+
+    for ( ; count < window && next < self -> decode_stop; ++ count )
+    {
+        VBlob *src;
+        VBlobDecodeJob *job;
+
+        rc_t rc = VProductionReadBlob ( input, & src, next, 1, NULL );
+        if ( rc != 0 )
+        {
+            /* most likely the end of the column */
+            self -> decode_stop = next;
+            break;
+        }
+        if ( src -> stop_id < next )
+        {
+            vblob_release ( src, NULL );
+            break;
+        }
+        next = src -> stop_id + 1;
+
+        rc = VBlobDecodeJobMake ( & job, VFunctionProdDecodeBlob, self, src );
+        if ( rc != 0 )
+        {
+            vblob_release ( src, NULL );
+            break;
+        }
+        rc = VBlobDecodePoolSubmit ( self -> decode_pool, job );
+        if ( rc == 0 )
+        {
+            rc = VectorAppend ( & self -> decode_jobs, NULL, job );
+            if ( rc != 0 )
+                VBlobDecodePoolCancel ( self -> decode_pool, job );
+        }
+        if ( rc != 0 )
+        {
+            VBlobDecodeJobWhack ( job );
+            break;
+        }
+    }
+}
+
+static
+rc_t VFunctionProdReadAhead ( VFunctionProd *self, VBlob **vblob, int64_t id )
+{
+    rc_t rc;
+    VBlobDecodeJob *job;
+    bool sequential = id == self -> decode_next;
+
+    /* drop whatever the reader has moved past */
+    while ( ( job = VectorFirst ( & self -> decode_jobs ) ) != NULL && job -> src -> stop_id < id )
+        VFunctionProdDropDecodeJob ( self );
+
+    if ( job != NULL && job -> src -> start_id <= id )
+    {
+        VectorRemove ( & self -> decode_jobs, 0, ( void** ) & job );
+        VBlobDecodePoolWait ( self -> decode_pool, job );
+        self -> calls ++;
+        self -> decode_ns += job -> decode_ns;
+        rc = job -> rc;
+        if ( rc == 0 )
+        {
+            * vblob = job -> rslt;
+            job -> rslt = NULL;
+        }
+        VBlobDecodeJobWhack ( job );
+    }
+    else
+    {
+        VBlob *src;
+
+        /* reader went backwards or skipped beyond the window */
+        while ( VectorLength ( & self -> decode_jobs ) != 0 )
+            VFunctionProdDropDecodeJob ( self );
+
+        /* decode inline as before */
+        rc = VProductionReadBlob ( VectorGet ( & self -> parms, 0 ), & src, id, 1, NULL );
+        if ( rc == 0 )
+        {
+            uint64_t start = KTimeNsStamp ();
+
+            if ( id >= self -> decode_stop )
+                self -> decode_stop = INT64_MAX;
+
+            rc = VFunctionProdDecodeBlob ( self, src, vblob );
+            vblob_release ( src, NULL );
+
+            self -> calls ++;
+            self -> decode_ns += KTimeNsStamp () - start;
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        if ( ( * vblob ) -> start_id > id || ( * vblob ) -> stop_id < id )
+        {
+            vblob_release ( * vblob, NULL );
+            * vblob = NULL;
+            return RC ( rcVDB, rcBlob, rcReading, rcRange, rcInsufficient );
+        }
+
+        /* only read ahead of a reader walking consecutive blobs */
+        self -> decode_next = ( * vblob ) -> stop_id + 1;
+        if ( sequential )
+            VFunctionProdQueueDecode ( self, self -> decode_next );
+    }
+
+    return rc;
+}
+
 static rc_t VFunctionProdReadNormal ( VFunctionProd *self, VBlob **vblob, int64_t id ,uint32_t cnt)
 {
     rc_t rc;
@@ -1807,29 +2027,16 @@ static rc_t VFunctionProdReadNormal ( VFunctionProd *self, VBlob **vblob, int64_
     VBlob *vb=NULL;
     int64_t	id_run;
     int64_t     cnt_run;
-
-    /* fill out information for function to use */
-    const VCursor *curs = self -> curs;
     VXformInfo info;
 
     if(cnt == 0) cnt = 1;
 
-#if VMGR_PASSED_TO_XFORM
-    info . mgr = curs -> tbl -> mgr;
-#endif
-#if VSCHEMA_PASSED_TO_XFORM
-    info . schema = curs -> schema;
-#endif
-#if VTABLE_PASSED_TO_XFORM
-    info . tbl = curs -> tbl;
-#endif
-#if VPRODUCTION_PASSED_TO_XFORM
-    info . prod = & self -> dad;
-#endif
-    info . fdesc . fd = self -> dad . fd;
-    info . fdesc . desc = self -> dad . desc;
+    VFunctionProdInitInfo ( self, & info );
     *vblob = NULL;
 
+    if ( VFunctionProdCanDecodeAhead ( self, cnt ) )
+        return VFunctionProdReadAhead ( self, vblob, id );
+
     if (self->dad.sub == prodFuncBuiltInCompare) {
         rc = VFunctionProdCallCompare(self, vblob, id, cnt);
 #if _DEBUGGING
@@ -1846,6 +2053,7 @@ static rc_t VFunctionProdReadNormal ( VFunctionProd *self, VBlob **vblob, int64_
         rc = pb . rc;
     else for( id_run=id, cnt_run=cnt, rc=0; cnt_run > 0 && rc==0;) 
     {
+        uint64_t start = KTimeNsStamp ();
         switch ( self -> dad . sub )
         {
         case vftLegacyBlob:
@@ -1877,6 +2085,8 @@ static rc_t VFunctionProdReadNormal ( VFunctionProd *self, VBlob **vblob, int64_
         default:
             rc = RC ( rcVDB, rcFunction, rcReading, rcProduction, rcCorrupt );
         }
+        self -> calls ++;
+        self -> decode_ns += KTimeNsStamp () - start;
         if (rc == 0) {
             if (vb == NULL) {
                 rc = RC ( rcVDB, rcFunction, rcReading, rcProduction, rcNull );
@@ -2515,6 +2725,72 @@ rc_t VProductionIsStatic ( const VProduction *self, bool *is_static )
     return rc;
 }
 
+/* GatherStats
+ */
+static
+bool VProductionStatsFirstVisit ( Vector *visited, const void *obj )
+{
+    uint32_t i, end = VectorStart ( visited ) + VectorLength ( visited );
+    for ( i = VectorStart ( visited ); i < end; ++ i )
+    {
+        if ( VectorGet ( visited, i ) == obj )
+            return false;
+    }
+    return VectorAppend ( visited, NULL, obj ) == 0;
+}
+
+void VProductionGatherStats ( const VProduction *self, Vector *visited,
+    VCursorColumnStats *stats,
+    void ( CC * f ) ( const char *name, uint64_t calls, uint64_t decode_ns, void *data ),
+    void *data )
+{
+    while ( self > FAILED_PRODUCTION && VProductionStatsFirstVisit ( visited, self ) )
+    {
+        switch ( self -> var )
+        {
+        case prodSimple:
+            self = ( ( const VSimpleProd* ) self ) -> in;
+            break;
+        case prodFunc:
+        {
+            const VFunctionProd *fp = ( const VFunctionProd* ) self;
+            uint32_t i, end = VectorStart ( & fp -> parms ) + VectorLength ( & fp -> parms );
+
+            stats -> decode_ns += fp -> decode_ns;
+            if ( f != NULL && fp -> fname != NULL )
+                ( * f ) ( fp -> fname, fp -> calls, fp -> decode_ns, data );
+
+            for ( i = VectorStart ( & fp -> parms ); i < end; ++ i )
+                VProductionGatherStats ( VectorGet ( & fp -> parms, i ), visited, stats, f, data );
+            return;
+        }
+        case prodScript:
+            self = ( ( const VScriptProd* ) self ) -> rtn;
+            break;
+        case prodPhysical:
+        {
+            const VPhysical *phys = ( ( const VPhysicalProd* ) self ) -> phys;
+            if ( phys <= FAILED_PHYSICAL || ! VProductionStatsFirstVisit ( visited, phys ) )
+                return;
+
+            stats -> blobs_read += phys -> blobs_read;
+            stats -> raw_bytes += phys -> raw_bytes;
+            stats -> decoded_bytes += phys -> decoded_bytes;
+            self = phys -> b2p;
+            break;
+        }
+        case prodColumn:
+        {
+            const VColumn *col = ( ( const VColumnProd* ) self ) -> col;
+            self = ( col != NULL ) ? col -> in : NULL;
+            break;
+        }
+        default:
+            return;
+        }
+    }
+}
+
 /* GetKColumn
  *  drills down to physical production to get a KColumn,
  *  and if that fails, indicate whether the column is static
@@ -719,6 +719,8 @@ rc_t VProdResolveFuncExpr ( const VProdResolve *self,
                 & info . fdesc . desc, self -> chain );
             if ( rc == 0 )
             {
+                fprod -> fname = name;
+
                 /* check for a validation function
                    these functions are generally compiler-generated */
                 if ( sfunc -> validate )
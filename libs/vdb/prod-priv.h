@@ -87,6 +87,8 @@ struct VColumn;
 struct VPhysical;
 struct VProdResolve;
 struct VBlobMRUCacheCursorContext;
+struct VBlobDecodePool;
+struct VCursorColumnStats;
 
 
 /*--------------------------------------------------------------------------
@@ -245,6 +247,21 @@ rc_t VProductionIsStatic ( const VProduction *self, bool *is_static );
 rc_t VProductionGetKColumn ( const VProduction * self, struct KColumn ** kcol, bool * is_static );
 
 
+/* GatherStats
+ *  add the read statistics of every function production and physical
+ *  column feeding "self" to "stats", visiting each of them only once
+ *
+ *  "visited" [ IN/OUT ] - objects seen so far
+ *
+ *  "f" [ IN, NULL OKAY ] and "data" [ IN, OPAQUE ] - called for
+ *  every function production naming an external function
+ */
+void VProductionGatherStats ( const VProduction *self, Vector *visited,
+    struct VCursorColumnStats *stats,
+    void ( CC * f ) ( const char *name, uint64_t calls, uint64_t decode_ns, void *data ),
+    void *data );
+
+
 /*--------------------------------------------------------------------------
  * VSimpleProd
  *  single input param
@@ -338,6 +355,24 @@ struct VFunctionProd
     /* adaptive prefetch parameters */
    int64_t start_id;
    int64_t stop_id;
+
+    /* blobs being decoded ahead of the reader by the manager's
+       decode pool, in ascending id order */
+    struct VBlobDecodePool *decode_pool;
+    Vector decode_jobs;
+
+    /* first id known not to have an input blob */
+    int64_t decode_stop;
+
+    /* id following the last blob returned; decoding ahead
+       starts only once the reader asks for it */
+    int64_t decode_next;
+
+    /* schema name of an external function, NULL otherwise,
+       and the time spent calling it */
+    const char *fname;
+    uint64_t calls;
+    uint64_t decode_ns;
 };
 
 
@@ -0,0 +1,416 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <vdb/extern.h>
+
+#define KONST const
+#define SKONST
+#include "cursor-priv.h"
+#include "table-priv.h"
+#include "column-priv.h"
+#include "schema-priv.h"
+#undef KONST
+#undef SKONST
+#include "blob-priv.h"
+#include "page-map.h"
+
+#include <vdb/cursor.h>
+#include <vdb/table.h>
+#include <vdb/schema.h>
+#include <vdb/vdb-priv.h>
+#include <klib/symbol.h>
+#include <klib/debug.h>
+#include <klib/rc.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+/*--------------------------------------------------------------------------
+ * VCursorReadAhead
+ *  background prefetch of the next blobs of every column a read cursor
+ *  is consuming. productions are not thread-safe, so the worker thread
+ *  drives a private "shadow" cursor on the same table with the same
+ *  columns and hands finished blobs over under a lock.
+ */
+#define READ_AHEAD_MAX_BLOBS 64
+
+typedef struct VCursorReadAheadCol VCursorReadAheadCol;
+struct VCursorReadAheadCol
+{
+    /* next row to fetch; 0 while column is inactive */
+    int64_t next;
+
+    /* start of blob being decoded by worker, 0 if none */
+    int64_t in_flight;
+
+    /* rows in the last blob prefetched, to guess the extent of the next */
+    uint64_t last_rows;
+
+    /* column index on shadow cursor */
+    uint32_t shadow_idx;
+
+    /* prefetched blobs, ordered by start_id */
+    uint32_t count;
+    bool exhausted;
+    const VBlob *blob [ 1 ];
+};
+
+struct VCursorReadAhead
+{
+    const VCursor *shadow;
+
+    KThread *thread;
+    KLock *lock;
+    KCondition *cond;
+
+    /* VCursorReadAheadCol* by consumer col_idx */
+    Vector cols;
+
+    uint32_t window;
+    bool done;
+};
+
+
+static
+void CC VCursorReadAheadColWhack ( void *item, void *ignore )
+{
+    VCursorReadAheadCol *self = item;
+    if ( self != NULL )
+    {
+        uint32_t i;
+        for ( i = 0; i < self -> count; ++ i )
+            VBlobRelease ( ( VBlob* ) self -> blob [ i ] );
+        free ( self );
+    }
+}
+
+/* pick the column that is furthest from a full window */
+static
+VCursorReadAheadCol * VCursorReadAheadNextJob ( VCursorReadAhead *self )
+{
+    uint32_t i, start = VectorStart ( & self -> cols );
+    uint32_t end = start + VectorLength ( & self -> cols );
+    VCursorReadAheadCol *best = NULL;
+
+    for ( i = start; i < end; ++ i )
+    {
+        VCursorReadAheadCol *col = VectorGet ( & self -> cols, i );
+        if ( col != NULL && col -> next != 0 && ! col -> exhausted &&
+             col -> in_flight == 0 && col -> count < self -> window )
+        {
+            if ( best == NULL || col -> count < best -> count )
+                best = col;
+        }
+    }
+    return best;
+}
+
+static
+rc_t CC run_read_ahead_thread ( const KThread *t, void *data )
+{
+    VCursorReadAhead *self = data;
+    rc_t rc = KLockAcquire ( self -> lock );
+    if ( rc != 0 )
+        return rc;
+
+    MTCURSOR_DBG (( "run_read_ahead_thread: started\n" ));
+    while ( ! self -> done )
+    {
+        const VBlob *blob;
+        int64_t id;
+        VCursorReadAheadCol *col = VCursorReadAheadNextJob ( self );
+        if ( col == NULL )
+        {
+            rc = KConditionWait ( self -> cond, self -> lock );
+            if ( rc != 0 )
+                break;
+            continue;
+        }
+
+        id = col -> in_flight = col -> next;
+        KLockUnlock ( self -> lock );
+
+        /* fetch, decompress and index the blob outside of the lock */
+        rc = VCursorGetBlobDirect ( self -> shadow, & blob, id, col -> shadow_idx );
+        if ( rc == 0 && blob -> pm != NULL )
+            rc = PageMapExpandAll ( blob -> pm );
+
+        KLockAcquire ( self -> lock );
+        col -> in_flight = 0;
+        if ( rc != 0 )
+        {
+            /* most likely end of column; wait for consumer to move */
+            col -> exhausted = true;
+            rc = 0;
+        }
+        else if ( col -> next != id || col -> count == self -> window )
+        {
+            /* consumer jumped elsewhere while we were busy */
+            VBlobRelease ( ( VBlob* ) blob );
+        }
+        else
+        {
+            col -> blob [ col -> count ++ ] = blob;
+            col -> next = blob -> stop_id + 1;
+            col -> last_rows = blob -> stop_id - blob -> start_id + 1;
+        }
+        KConditionBroadcast ( self -> cond );
+    }
+    MTCURSOR_DBG (( "run_read_ahead_thread: exit\n" ));
+
+    KLockUnlock ( self -> lock );
+    return rc;
+}
+
+/* AddShadowColumns
+ *  mirror every column of the consumer onto the shadow cursor
+ */
+static
+rc_t VCursorReadAheadAddColumns ( VCursorReadAhead *self, const VCursor *curs )
+{
+    rc_t rc = 0;
+    uint32_t i, start = VectorStart ( & curs -> row );
+    uint32_t end = start + VectorLength ( & curs -> row );
+
+    for ( i = start; rc == 0 && i < end; ++ i )
+    {
+        const VColumn *vcol = VectorGet ( & curs -> row, i );
+        if ( vcol != NULL )
+        {
+            char typedecl [ 256 ];
+            rc = VTypedeclToText ( & vcol -> td, curs -> schema, typedecl, sizeof typedecl );
+            if ( rc == 0 )
+            {
+                VCursorReadAheadCol *col = calloc ( 1, sizeof * col + ( self -> window - 1 ) * sizeof col -> blob [ 0 ] );
+                if ( col == NULL )
+                    rc = RC ( rcVDB, rcCursor, rcConstructing, rcMemory, rcExhausted );
+                else
+                {
+                    const String *name = & vcol -> scol -> name -> name;
+                    rc = VCursorAddColumn ( self -> shadow, & col -> shadow_idx,
+                        "(%s)%.*s", typedecl, ( int ) name -> size, name -> addr );
+                    if ( rc == 0 )
+                        rc = VectorSet ( & self -> cols, i, col );
+                    if ( rc != 0 )
+                        free ( col );
+                }
+            }
+        }
+    }
+
+    if ( rc == 0 )
+        rc = VCursorOpen ( self -> shadow );
+
+    return rc;
+}
+
+static
+void VCursorReadAheadDestroy ( VCursorReadAhead *self )
+{
+    if ( self -> thread != NULL )
+    {
+        if ( KLockAcquire ( self -> lock ) == 0 )
+        {
+            self -> done = true;
+            KConditionBroadcast ( self -> cond );
+            KLockUnlock ( self -> lock );
+        }
+        KThreadWait ( self -> thread, NULL );
+        KThreadRelease ( self -> thread );
+    }
+
+    VectorWhack ( & self -> cols, VCursorReadAheadColWhack, NULL );
+    VCursorRelease ( self -> shadow );
+    KConditionRelease ( self -> cond );
+    KLockRelease ( self -> lock );
+    free ( self );
+}
+
+static
+rc_t VCursorReadAheadMake ( VCursorReadAhead **rap, const VCursor *curs, uint32_t window )
+{
+    rc_t rc;
+    VCursorReadAhead *self = calloc ( 1, sizeof * self );
+    if ( self == NULL )
+        return RC ( rcVDB, rcCursor, rcConstructing, rcMemory, rcExhausted );
+
+    self -> window = window;
+    VectorInit ( & self -> cols, VectorStart ( & curs -> row ), VectorLength ( & curs -> row ) );
+
+    /* the shadow needs a cache of its own to hand out blobs at all;
+       capacity is raised automatically to the largest blob */
+    rc = VTableCreateCachedCursorRead ( curs -> tbl, & self -> shadow, 1 );
+    if ( rc == 0 )
+        rc = VCursorReadAheadAddColumns ( self, curs );
+    if ( rc == 0 )
+        rc = KLockMake ( & self -> lock );
+    if ( rc == 0 )
+        rc = KConditionMake ( & self -> cond );
+    if ( rc == 0 )
+        rc = KThreadMake ( & self -> thread, run_read_ahead_thread, self );
+
+    if ( rc != 0 )
+    {
+        VCursorReadAheadDestroy ( self );
+        self = NULL;
+    }
+
+    * rap = self;
+    return rc;
+}
+
+void VCursorReadAheadRelease ( VCursor *self )
+{
+    if ( self -> read_ahead != NULL )
+    {
+        VCursorReadAheadDestroy ( self -> read_ahead );
+        self -> read_ahead = NULL;
+    }
+}
+
+/* Find
+ *  returns a NEW REFERENCE to a prefetched blob containing "row_id"
+ *  or NULL. blobs before "row_id" are dropped from the window.
+ */
+const VBlob * VCursorReadAheadFind ( VCursorReadAhead *self, uint32_t col_idx, int64_t row_id )
+{
+    const VBlob *blob = NULL;
+    VCursorReadAheadCol *col;
+
+    if ( self == NULL )
+        return NULL;
+
+    col = VectorGet ( & self -> cols, col_idx );
+    if ( col == NULL )
+        return NULL;
+
+    if ( KLockAcquire ( self -> lock ) != 0 )
+        return NULL;
+
+    /* if the worker is decoding the blob we need, wait for it
+       rather than decoding it twice. a blob the reader has jumped
+       past is stale: the worker is told to drop it when done, and
+       it is not waited for */
+    while ( col -> in_flight != 0 && col -> count == 0 && row_id >= col -> in_flight )
+    {
+        if ( ( uint64_t ) ( row_id - col -> in_flight ) >= col -> last_rows &&
+             row_id != col -> in_flight )
+        {
+            col -> next = 0;
+            break;
+        }
+        if ( KConditionWait ( self -> cond, self -> lock ) != 0 )
+            break;
+    }
+
+    while ( col -> count != 0 && col -> blob [ 0 ] -> stop_id < row_id )
+    {
+        VBlobRelease ( ( VBlob* ) col -> blob [ 0 ] );
+        memmove ( & col -> blob [ 0 ], & col -> blob [ 1 ], -- col -> count * sizeof col -> blob [ 0 ] );
+    }
+
+    if ( col -> count != 0 && col -> blob [ 0 ] -> start_id <= row_id )
+    {
+        /* pass worker's reference on to the caller */
+        blob = col -> blob [ 0 ];
+        memmove ( & col -> blob [ 0 ], & col -> blob [ 1 ], -- col -> count * sizeof col -> blob [ 0 ] );
+        KConditionBroadcast ( self -> cond );
+    }
+
+    KLockUnlock ( self -> lock );
+    return blob;
+}
+
+/* Advance
+ *  tell worker that consumer produced "blob" itself,
+ *  so that prefetch continues right after it
+ */
+void VCursorReadAheadAdvance ( VCursorReadAhead *self, uint32_t col_idx, const VBlob *blob )
+{
+    VCursorReadAheadCol *col;
+
+    if ( self == NULL || blob == NULL )
+        return;
+
+    col = VectorGet ( & self -> cols, col_idx );
+    if ( col == NULL )
+        return;
+
+    if ( KLockAcquire ( self -> lock ) == 0 )
+    {
+        uint32_t i;
+        int64_t next = blob -> stop_id + 1;
+
+        /* window no longer contiguous with consumer position */
+        if ( col -> count == 0 || col -> blob [ 0 ] -> start_id != next )
+        {
+            for ( i = 0; i < col -> count; ++ i )
+                VBlobRelease ( ( VBlob* ) col -> blob [ i ] );
+            col -> count = 0;
+            col -> next = next;
+            col -> exhausted = false;
+            KConditionBroadcast ( self -> cond );
+        }
+        KLockUnlock ( self -> lock );
+    }
+}
+
+
+/* SetReadAhead
+ *  enable or disable background read-ahead on an open read cursor
+ *
+ *  "n_blobs" [ IN ] - number of blobs to keep decoded ahead of
+ *  the consumer for every column being read; 0 disables
+ */
+LIB_EXPORT rc_t CC VCursorSetReadAhead ( const VCursor *cself, uint32_t n_blobs )
+{
+    rc_t rc = 0;
+    VCursor *self = ( VCursor* ) cself;
+
+    if ( self == NULL )
+        return RC ( rcVDB, rcCursor, rcUpdating, rcSelf, rcNull );
+    if ( ! self -> read_only )
+        return RC ( rcVDB, rcCursor, rcUpdating, rcCursor, rcWriteonly );
+    if ( self -> state != vcReady && self -> state != vcRowOpen )
+        return RC ( rcVDB, rcCursor, rcUpdating, rcCursor, rcNotOpen );
+    if ( self -> blob_mru_cache == NULL && n_blobs != 0 )
+        return RC ( rcVDB, rcCursor, rcUpdating, rcCursor, rcUnsupported );
+
+    VCursorReadAheadRelease ( self );
+
+    if ( n_blobs > READ_AHEAD_MAX_BLOBS )
+        n_blobs = READ_AHEAD_MAX_BLOBS;
+    if ( n_blobs != 0 )
+        rc = VCursorReadAheadMake ( & self -> read_ahead, self, n_blobs );
+
+    return rc;
+}
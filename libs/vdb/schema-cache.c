@@ -0,0 +1,339 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <vdb/extern.h>
+
+#include "schema-cache.h"
+#include "schema-priv.h"
+
+#include <vdb/schema.h>
+#include <vdb/vdb-priv.h>
+#include <kdb/meta.h>
+#include <kproc/lock.h>
+#include <klib/container.h>
+#include <klib/checksum.h>
+#include <klib/data-buffer.h>
+#include <klib/time.h>
+#include <klib/rc.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+/*--------------------------------------------------------------------------
+ * VSchemaCacheEntry
+ */
+typedef struct VSchemaCacheEntry VSchemaCacheEntry;
+struct VSchemaCacheEntry
+{
+    BSTNode n;
+    DLNode lru;
+
+    /* key */
+    const VSchema *dad;
+    uint64_t bytes;
+    uint8_t digest [ 16 ];
+
+    /* owned reference, a child of "dad" */
+    const VSchema *schema;
+
+    /* time it took to parse */
+    uint64_t parse_ns;
+};
+
+static
+int VSchemaCacheEntryCmpKey ( const VSchemaCacheEntry *a, const VSchemaCacheEntry *b )
+{
+    if ( a -> dad != b -> dad )
+        return a -> dad < b -> dad ? -1 : 1;
+    if ( a -> bytes != b -> bytes )
+        return a -> bytes < b -> bytes ? -1 : 1;
+    return memcmp ( a -> digest, b -> digest, sizeof a -> digest );
+}
+
+static
+int64_t CC VSchemaCacheEntryCmp ( const void *item, const BSTNode *n )
+{
+    return VSchemaCacheEntryCmpKey ( item, ( const VSchemaCacheEntry* ) n );
+}
+
+static
+int64_t CC VSchemaCacheEntrySort ( const BSTNode *item, const BSTNode *n )
+{
+    return VSchemaCacheEntryCmpKey ( ( const VSchemaCacheEntry* ) item,
+        ( const VSchemaCacheEntry* ) n );
+}
+
+static
+void CC VSchemaCacheEntryWhack ( BSTNode *n, void *ignore )
+{
+    VSchemaCacheEntry *self = ( VSchemaCacheEntry* ) n;
+    VSchemaRelease ( self -> schema );
+    free ( self );
+}
+
+
+/*--------------------------------------------------------------------------
+ * VSchemaCache
+ */
+struct VSchemaCache
+{
+    KLock *lock;
+
+    /* entries by key, and most recently used first */
+    BSTree entries;
+    DLList lru;
+
+    const VSchema *root;
+
+    uint32_t count;
+    uint32_t max_entries;
+
+    VDBManagerSchemaCacheStats stats;
+};
+
+#define LRU_ENTRY( node ) \
+    ( ( VSchemaCacheEntry* ) ( ( char* ) ( node ) - offsetof ( VSchemaCacheEntry, lru ) ) )
+
+
+rc_t VSchemaCacheMake ( VSchemaCache **cachep, const VSchema *root, uint32_t max_entries )
+{
+    rc_t rc;
+    VSchemaCache *cache = calloc ( 1, sizeof * cache );
+    if ( cache == NULL )
+        rc = RC ( rcVDB, rcSchema, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        rc = KLockMake ( & cache -> lock );
+        if ( rc == 0 )
+        {
+            BSTreeInit ( & cache -> entries );
+            DLListInit ( & cache -> lru );
+
+            /* not attached, the manager outlives its cache */
+            cache -> root = root;
+            cache -> max_entries = max_entries;
+
+            * cachep = cache;
+            return 0;
+        }
+
+        free ( cache );
+    }
+
+    * cachep = NULL;
+    return rc;
+}
+
+void VSchemaCacheWhack ( VSchemaCache *self )
+{
+    if ( self != NULL )
+    {
+        BSTreeWhack ( & self -> entries, VSchemaCacheEntryWhack, NULL );
+        KLockRelease ( self -> lock );
+        free ( self );
+    }
+}
+
+/* drop least recently used entries beyond "limit"
+ *  called with lock held
+ */
+static
+void VSchemaCacheTrim ( VSchemaCache *self, uint32_t limit )
+{
+    while ( self -> count > limit )
+    {
+        VSchemaCacheEntry *entry = LRU_ENTRY ( DLListPopTail ( & self -> lru ) );
+        BSTreeUnlink ( & self -> entries, & entry -> n );
+        VSchemaCacheEntryWhack ( & entry -> n, NULL );
+        -- self -> count;
+        ++ self -> stats . evictions;
+    }
+}
+
+void VSchemaCacheSetMaxEntries ( VSchemaCache *self, uint32_t max_entries )
+{
+    if ( self != NULL && KLockAcquire ( self -> lock ) == 0 )
+    {
+        self -> max_entries = max_entries;
+        VSchemaCacheTrim ( self, max_entries );
+        KLockUnlock ( self -> lock );
+    }
+}
+
+/* Cacheable
+ *  text parsed against the root or a cached entry may be cached,
+ *  any other parent could still be changed by its owner
+ *  called with lock held
+ */
+static
+bool VSchemaCacheCacheable ( const VSchemaCache *self, const VSchema *dad )
+{
+    DLNode *node;
+
+    if ( self -> max_entries == 0 )
+        return false;
+    if ( dad == self -> root )
+        return true;
+
+    for ( node = DLListHead ( & self -> lru ); node != NULL; node = DLNodeNext ( node ) )
+    {
+        if ( LRU_ENTRY ( node ) -> schema == dad )
+            return true;
+    }
+
+    return false;
+}
+
+static
+rc_t VSchemaCacheParse ( const VSchema **schema, const VSchema *dad,
+    const char *name, const KDataBuffer *text, uint64_t *parse_ns )
+{
+    VSchema *parsed;
+    uint64_t start = KTimeNsStamp ();
+    rc_t rc = VSchemaMake ( & parsed, dad );
+    if ( rc == 0 )
+    {
+        rc = VSchemaParseText ( parsed, name, text -> base, ( size_t ) text -> elem_count );
+        if ( rc == 0 )
+        {
+            * parse_ns = KTimeNsStamp () - start;
+            * schema = parsed;
+            return 0;
+        }
+
+        VSchemaRelease ( parsed );
+    }
+
+    * schema = NULL;
+    return rc;
+}
+
+rc_t VSchemaCacheParseNode ( VSchemaCache *self, const VSchema **schema,
+    const VSchema *dad, const KMDataNode *node, const char *name )
+{
+    rc_t rc;
+    size_t num_read, remaining;
+    KDataBuffer text;
+    VSchemaCacheEntry key, *entry;
+    uint64_t parse_ns;
+    bool cacheable;
+
+    assert ( self != NULL );
+    assert ( schema != NULL );
+
+    * schema = NULL;
+
+    /* read the whole text, rather than filling as the parser
+       goes, since it has to be digested before parsing */
+    rc = KMDataNodeRead ( node, 0, NULL, 0, & num_read, & remaining );
+    if ( rc != 0 )
+        return rc;
+    rc = KDataBufferMakeBytes ( & text, remaining );
+    if ( rc != 0 )
+        return rc;
+    rc = KMDataNodeRead ( node, 0, text . base, remaining, & num_read, NULL );
+    if ( rc == 0 )
+    {
+        MD5State md5;
+        MD5StateInit ( & md5 );
+        MD5StateAppend ( & md5, text . base, num_read );
+        MD5StateFinish ( & md5, key . digest );
+        key . dad = dad;
+        key . bytes = num_read;
+        text . elem_count = num_read;
+
+        rc = KLockAcquire ( self -> lock );
+        if ( rc == 0 )
+        {
+            cacheable = VSchemaCacheCacheable ( self, dad );
+            entry = cacheable ? ( VSchemaCacheEntry* )
+                BSTreeFind ( & self -> entries, & key, VSchemaCacheEntryCmp ) : NULL;
+            if ( entry != NULL )
+            {
+                DLListUnlink ( & self -> lru, & entry -> lru );
+                DLListPushHead ( & self -> lru, & entry -> lru );
+                ++ self -> stats . hits;
+                self -> stats . saved_ns += entry -> parse_ns;
+                if ( VSchemaAddRef ( entry -> schema ) == 0 )
+                    * schema = entry -> schema;
+            }
+            KLockUnlock ( self -> lock );
+
+            if ( * schema == NULL )
+            {
+                /* parse outside of the lock */
+                rc = VSchemaCacheParse ( schema, dad, name, & text, & parse_ns );
+                if ( rc == 0 && KLockAcquire ( self -> lock ) == 0 )
+                {
+                    if ( cacheable )
+                        ++ self -> stats . misses;
+                    else
+                        ++ self -> stats . uncached;
+                    self -> stats . parse_ns += parse_ns;
+
+                    /* another thread may have parsed the same text meanwhile,
+                       or the entry holding "dad" may have been dropped */
+                    if ( cacheable && VSchemaCacheCacheable ( self, dad ) &&
+                         BSTreeFind ( & self -> entries, & key, VSchemaCacheEntryCmp ) == NULL )
+                    {
+                        entry = malloc ( sizeof * entry );
+                        if ( entry != NULL )
+                        {
+                            * entry = key;
+                            entry -> schema = * schema;
+                            VSchemaAddRef ( entry -> schema );
+                            entry -> parse_ns = parse_ns;
+                            BSTreeInsert ( & self -> entries, & entry -> n, VSchemaCacheEntrySort );
+                            DLListPushHead ( & self -> lru, & entry -> lru );
+                            ++ self -> count;
+                            VSchemaCacheTrim ( self, self -> max_entries );
+                        }
+                    }
+                    KLockUnlock ( self -> lock );
+                }
+            }
+        }
+    }
+
+    KDataBufferWhack ( & text );
+    return rc;
+}
+
+void VSchemaCacheGetStats ( const VSchemaCache *self, VDBManagerSchemaCacheStats *stats )
+{
+    assert ( stats != NULL );
+    memset ( stats, 0, sizeof * stats );
+
+    if ( self != NULL && KLockAcquire ( self -> lock ) == 0 )
+    {
+        * stats = self -> stats;
+        stats -> entries = self -> count;
+        KLockUnlock ( self -> lock );
+    }
+}
@@ -0,0 +1,106 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_schema_cache_
+#define _h_schema_cache_
+
+#ifndef _h_vdb_extern_
+#include <vdb/extern.h>
+#endif
+
+#ifndef _h_klib_defs_
+#include <klib/defs.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * forwards
+ */
+struct VSchema;
+struct KMDataNode;
+struct VDBManagerSchemaCacheStats;
+
+
+/*--------------------------------------------------------------------------
+ * VSchemaCache
+ *  schemas parsed from the text stored in object metadata,
+ *  shared by all read-only tables and databases of a manager
+ *
+ *  an entry is a child of the schema the text was parsed against
+ *  and is keyed by that parent and a digest of the text. entries
+ *  are never modified once cached; anything that needs to extend
+ *  one makes a child of it, as cursors already do.
+ */
+typedef struct VSchemaCache VSchemaCache;
+
+/* unless configured by "vdb/schema/cache/entries" */
+#define DFLT_SCHEMA_CACHE_ENTRIES 64
+
+/* Make
+ *  "root" [ IN ] - the manager's intrinsic schema,
+ *  the only parent other than cached entries that text
+ *  may be parsed against and still be cached
+ *
+ *  "max_entries" [ IN ] - 0 disables the cache
+ */
+rc_t VSchemaCacheMake ( VSchemaCache **cache,
+    struct VSchema const *root, uint32_t max_entries );
+
+/* Whack
+ */
+void VSchemaCacheWhack ( VSchemaCache *self );
+
+/* SetMaxEntries
+ *  least recently used entries are dropped to fit
+ */
+void VSchemaCacheSetMaxEntries ( VSchemaCache *self, uint32_t max_entries );
+
+/* ParseNode
+ *  return a schema with the text of "node" parsed against "dad"
+ *
+ *  "schema" [ OUT ] - a new reference, which is a cached entry
+ *  when "dad" is cacheable and a private schema otherwise
+ *
+ *  "name" [ IN ] - source name for error messages
+ */
+rc_t VSchemaCacheParseNode ( VSchemaCache *self, struct VSchema const **schema,
+    struct VSchema const *dad, struct KMDataNode const *node, const char *name );
+
+/* GetStats
+ */
+void VSchemaCacheGetStats ( const VSchemaCache *self,
+    struct VDBManagerSchemaCacheStats *stats );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_schema_cache_ */
@@ -38,6 +38,7 @@
 #include "schema-priv.h"
 #include "schema-dump.h"
 #include "linker-priv.h"
+#include "blob-priv.h"
 
 #include <vdb/vdb-priv.h>
 #include <vdb/cursor.h>
@@ -77,6 +78,7 @@ rc_t VTableWhack ( VTable *self )
     BSTreeWhack ( & self -> read_col_cache, VColumnRefWhack, NULL );
     BSTreeWhack ( & self -> write_col_cache, VColumnRefWhack, NULL );
     VTableRelease(self -> cache_tbl);
+    VBlobSharedCacheDestroy ( self -> blob_cache );
 
     KMDataNodeRelease ( self -> col_node );
     KMetadataRelease ( self -> meta );
@@ -943,6 +945,34 @@ LIB_EXPORT rc_t CC VTableSetUserData ( const VTable *cself,
 }
 
 
+/* SetSharedBlobCacheCapacity
+ *  enable a blob cache shared by all read cursors on this table
+ *
+ *  "capacity" [ IN ] - total bytes; 0 stops further caching
+ *  but does not drop the cache while cursors may use it.
+ *
+ *  NB - the cache is created on first call, which must happen
+ *  before any cursors are created on other threads.
+ */
+LIB_EXPORT rc_t CC VTableSetSharedBlobCacheCapacity ( const VTable *cself, size_t capacity )
+{
+    VTable *self = ( VTable* ) cself;
+    if ( cself == NULL )
+        return RC ( rcVDB, rcTable, rcUpdating, rcSelf, rcNull );
+
+    if ( self -> blob_cache != NULL )
+    {
+        VBlobSharedCacheSetCapacity ( self -> blob_cache, capacity );
+        return 0;
+    }
+
+    if ( capacity == 0 )
+        return 0;
+
+    return VBlobSharedCacheMake ( & self -> blob_cache, capacity );
+}
+
+
 /* GetKTable
  *  returns a new reference to underlying KTable
  */
@@ -34,6 +34,7 @@
 #include "schema-priv.h"
 #include "schema-parse.h"
 #include "linker-priv.h"
+#include "schema-cache.h"
 
 #undef KONST
 #undef SKONST
@@ -146,8 +147,25 @@ rc_t VTableLoadSchemaNode ( VTable *self, const KMDataNode *node )
     /* add in schema text. it is not mandatory, but it is
      the design of the system to store object schema with
      the object so that it is capable of standing alone */
-    rc = VSchemaParseTextCallback ( self -> schema,
-        "VTableLoadSchema", KMDataNodeFillSchema, & pb );
+    if ( self -> read_only )
+    {
+        /* a read-only table never extends its schema, so
+           it can share one parsed by an earlier open of the
+           same text in place of the empty one it was made with */
+        const VSchema *parsed;
+        rc = VSchemaCacheParseNode ( self -> mgr -> schema_cache,
+            & parsed, self -> schema -> dad, node, "VTableLoadSchema" );
+        if ( rc == 0 )
+        {
+            VSchemaRelease ( self -> schema );
+            self -> schema = ( VSchema* ) parsed;
+        }
+    }
+    else
+    {
+        rc = VSchemaParseTextCallback ( self -> schema,
+            "VTableLoadSchema", KMDataNodeFillSchema, & pb );
+    }
     if ( rc == 0 )
     {
         /* determine table type */
@@ -145,6 +145,9 @@ struct VTable
 
    /* cache table for cached virtual columns if any */
     const VTable *cache_tbl;
+
+    /* blob cache shared by read cursors - NULL unless enabled */
+    struct VBlobSharedCache *blob_cache;
 };
 
 
@@ -28,6 +28,7 @@
 #include "table-priv.h"
 #undef KONST
 
+#include <vdb/vdb-priv.h>
 #include <klib/namelist.h>
 #include <klib/rc.h>
 #include <sysalloc.h>
@@ -107,3 +108,12 @@ LIB_EXPORT rc_t CC VTableListWritableDatatypes ( struct VTable *self,
 
     return rc;
 }
+
+
+/* SharesKColumns
+ *  the read-only library opens a new KColumn for every cursor
+ */
+LIB_EXPORT bool CC VTableSharesKColumns ( const VTable *self )
+{
+    return false;
+}
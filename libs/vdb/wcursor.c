@@ -28,6 +28,9 @@
 
 #define TRACK_REFERENCES 0
 
+#define KTASK_IMPL struct VPhysicalEncodeTask
+typedef struct VPhysicalEncodeTask VPhysicalEncodeTask;
+
 #include "cursor-priv.h"
 #include "dbmgr-priv.h"
 #include "linker-priv.h"
@@ -47,6 +50,9 @@
 #include <klib/log.h>
 #include <klib/debug.h>
 #include <klib/rc.h>
+#include <kproc/task.h>
+#include <kproc/impl.h>
+#include <kproc/threadpool.h>
 #include <sysalloc.h>
 
 #if VCURSOR_FLUSH_THREAD
@@ -69,6 +75,7 @@
 #include <assert.h>
 
 static bool s_disable_flush_thread = false;
+static bool s_disable_parallel_encoding = false;
 
 /*--------------------------------------------------------------------------
  * VCursor
@@ -81,6 +88,12 @@ LIB_EXPORT rc_t CC VDBManagerDisableFlushThread(VDBManager *self)
     return 0;
 }
 
+LIB_EXPORT rc_t CC VDBManagerDisableParallelEncoding(VDBManager *self)
+{
+    s_disable_parallel_encoding = true;
+    return 0;
+}
+
 /* forward
  *  to avoid reordering whole page
  */
@@ -868,6 +881,185 @@ bool CC run_trigger_prods ( void *item, void *data )
     return false;
 }
 
+/* EncodePage
+ *  run the page of every physical column through its encoding
+ *  on the default thread pool, ahead of the trigger productions.
+ *  these then find the encoded blobs cached and write them out
+ *  in their usual order.
+ *
+ *  columns whose input is shared with another column are left
+ *  to the triggers, as is any column that fails here.
+ */
+struct VPhysicalEncodeTask
+{
+    KTask dad;
+    VPhysical *phys;
+    int64_t id;
+    uint32_t cnt;
+};
+
+static
+rc_t CC VPhysicalEncodeTaskWhack ( VPhysicalEncodeTask *self )
+{
+    KTaskDestroy ( & self -> dad, "VPhysicalEncodeTask" );
+    free ( self );
+    return 0;
+}
+
+static
+rc_t CC VPhysicalEncodeTaskExecute ( VPhysicalEncodeTask *self )
+{
+    return VPhysicalEncode ( self -> phys, self -> id, self -> cnt );
+}
+
+static
+KTask_vt_v1 VPhysicalEncodeTask_vt =
+{
+    1, 0,
+    VPhysicalEncodeTaskWhack,
+    VPhysicalEncodeTaskExecute
+};
+
+static
+rc_t VPhysicalEncodeTaskSubmit ( KThreadPool *pool, VPhysical *phys,
+    int64_t id, uint32_t cnt, KTaskFuture **future )
+{
+    rc_t rc;
+    VPhysicalEncodeTask *t = malloc ( sizeof * t );
+    if ( t == NULL )
+        return RC ( rcVDB, rcCursor, rcFlushing, rcMemory, rcExhausted );
+
+    rc = KTaskInit ( & t -> dad, ( const KTask_vt* ) & VPhysicalEncodeTask_vt, "VPhysicalEncodeTask", "" );
+    if ( rc != 0 )
+    {
+        free ( t );
+        return rc;
+    }
+
+    t -> phys = phys;
+    t -> id = id;
+    t -> cnt = cnt;
+
+    rc = KThreadPoolSubmit ( pool, & t -> dad, future );
+    KTaskRelease ( & t -> dad );
+    return rc;
+}
+
+static
+bool VCursorInputShared ( VBlob *const *inputs, uint32_t count, const VBlob *blob )
+{
+    uint32_t i;
+    for ( i = 0; i < count; ++ i )
+    {
+        if ( inputs [ i ] == blob || inputs [ i ] -> pm == blob -> pm )
+            return true;
+    }
+    return false;
+}
+
+static
+void VCursorEncodePage ( VCursor *self, int64_t id, uint32_t cnt )
+{
+    void *mem;
+    KThreadPool *pool;
+    VPhysical **phys;
+    VBlob **inputs;
+    KTaskFuture **futures;
+    uint32_t i, j, count, total;
+    const Vector *cache = & self -> phys . cache;
+    uint32_t start = VectorStart ( cache );
+    uint32_t end = start + VectorLength ( cache );
+
+    if ( s_disable_parallel_encoding )
+        return;
+
+    for ( count = 0, i = start; i < end; ++ i )
+    {
+        const Vector *ctx = VectorGet ( cache, i );
+        if ( ctx != NULL )
+            count += VectorLength ( ctx );
+    }
+    if ( count < 2 )
+        return;
+
+    if ( KThreadPoolGetDefault ( & pool ) != 0 )
+        return;
+    if ( KThreadPoolThreads ( pool ) < 2 )
+    {
+        KThreadPoolRelease ( pool );
+        return;
+    }
+
+    mem = malloc ( count * ( sizeof * phys + sizeof * inputs + sizeof * futures ) );
+    if ( mem == NULL )
+    {
+        KThreadPoolRelease ( pool );
+        return;
+    }
+    phys = mem;
+    inputs = ( VBlob** ) & phys [ count ];
+    futures = ( KTaskFuture** ) & inputs [ count ];
+
+    /* read inputs here, since productions ahead of
+       the encoding may be shared between columns */
+    for ( total = 0, i = start; i < end; ++ i )
+    {
+        const Vector *ctx = VectorGet ( cache, i );
+        if ( ctx != NULL )
+        {
+            uint32_t ctx_end = VectorStart ( ctx ) + VectorLength ( ctx );
+            for ( j = VectorStart ( ctx ); j < ctx_end; ++ j )
+            {
+                VBlob *blob;
+                VPhysical *p = VectorGet ( ctx, j );
+                if ( p == NULL || p == FAILED_PHYSICAL )
+                    continue;
+                if ( VPhysicalReadInput ( p, & blob, id, cnt ) != 0 || blob == NULL )
+                    continue;
+                if ( VCursorInputShared ( inputs, total, blob ) )
+                {
+                    TRACK_BLOB ( VBlobRelease, blob );
+                    ( void ) VBlobRelease ( blob );
+                    continue;
+                }
+                phys [ total ] = p;
+                inputs [ total ] = blob;
+                ++ total;
+            }
+        }
+    }
+
+    if ( total > 1 )
+    {
+        for ( i = 0; i < total; ++ i )
+        {
+            if ( VPhysicalEncodeTaskSubmit ( pool, phys [ i ], id, cnt, & futures [ i ] ) != 0 )
+                futures [ i ] = NULL;
+        }
+
+        /* outcome is of no interest: the triggers
+           encode again whatever did not make it */
+        for ( i = 0; i < total; ++ i )
+        {
+            if ( futures [ i ] != NULL )
+            {
+                rc_t status;
+                KTaskFutureWait ( futures [ i ], & status, NULL );
+                KTaskFutureRelease ( futures [ i ] );
+            }
+        }
+    }
+
+    for ( i = 0; i < total; ++ i )
+    {
+        TRACK_BLOB ( VBlobRelease, inputs [ i ] );
+        ( void ) VBlobRelease ( inputs [ i ] );
+    }
+
+    free ( mem );
+    KThreadPoolRelease ( pool );
+}
+
 #if VCURSOR_FLUSH_THREAD
 static
 rc_t CC run_flush_thread ( const KThread *t, void *data )
@@ -909,7 +1101,8 @@ rc_t CC run_flush_thread ( const KThread *t, void *data )
             MTCURSOR_DBG (( "run_flush_thread: unlocking and running\n" ));
             KLockUnlock ( self -> flush_lock );
 
-            /* run productions from trigger roots */
+            /* encode columns in parallel, then run productions from trigger roots */
+            VCursorEncodePage ( self, pb . id, pb . cnt );
             failed = VectorDoUntil ( & self -> trig, false, run_trigger_prods, & pb );
 
             /* drop page buffers */
@@ -985,6 +1178,7 @@ rc_t VCursorFlushPageNoThread ( VCursor *self )
         pb . id = self -> start_id;
         pb . cnt = self -> end_id - self -> start_id;
         pb . rc = 0;
+        VCursorEncodePage ( self, pb . id, pb . cnt );
         if ( ! VectorDoUntil ( & self -> trig, false, run_trigger_prods, & pb ) )
         {
             self -> start_id = self -> end_id;
@@ -33,6 +33,7 @@
 
 #include "dbmgr-priv.h"
 #include "schema-priv.h"
+#include "schema-cache.h"
 #include "linker-priv.h"
 
 #include <vdb/manager.h>
@@ -88,7 +89,11 @@ LIB_EXPORT rc_t CC VDBManagerMakeUpdateWithVFSManager ( VDBManager ** mgrp,
                     rc = VLinkerMakeIntrinsic ( & mgr -> linker );
                     if ( rc == 0 )
                     {
-                        rc = VDBManagerConfigPaths ( mgr, true );
+                        mgr -> decode_pool = NULL;
+                        rc = VSchemaCacheMake ( & mgr -> schema_cache,
+                            mgr -> schema, DFLT_SCHEMA_CACHE_ENTRIES );
+                        if ( rc == 0 )
+                            rc = VDBManagerConfigPaths ( mgr, true );
                         if ( rc == 0 )
                         {
                             mgr -> user = NULL;
@@ -98,6 +103,8 @@ LIB_EXPORT rc_t CC VDBManagerMakeUpdateWithVFSManager ( VDBManager ** mgrp,
                             return 0;
                         }
 
+                        VDBManagerSetDecodeThreads ( mgr, 0 );
+                        VSchemaCacheWhack ( mgr -> schema_cache );
                         VLinkerRelease ( mgr -> linker );
                     }
 
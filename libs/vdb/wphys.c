@@ -891,6 +891,59 @@ rc_t VPhysicalWrite ( VPhysical *self, int64_t id, uint32_t cnt )
     return rc;
 }
 
+/* ReadInput
+ *  read from page space ahead of Write
+ *  returns the input blob only when Write is going to send it
+ *  through encoding, NULL when it becomes or extends a static column
+ */
+rc_t VPhysicalReadInput ( VPhysical *self, VBlob **vblob, int64_t id, uint32_t cnt )
+{
+    rc_t rc;
+    VBlob *blob;
+
+    * vblob = NULL;
+
+    if ( self -> in == NULL || self -> b2s == NULL || self -> knode != NULL )
+        return 0;
+
+    rc = VProductionReadBlob ( self -> in, & blob, id, cnt, NULL );
+    if ( rc == 0 )
+    {
+        assert ( blob != NULL );
+        if ( self -> kcol == NULL && VBlobIsSingleRow ( blob ) )
+        {
+            TRACK_BLOB ( VBlobRelease, blob );
+            ( void ) VBlobRelease ( blob );
+        }
+        else
+        {
+            * vblob = blob;
+        }
+    }
+
+    return rc;
+}
+
+/* Encode
+ *  pull input through encoding, leaving the result
+ *  in the cache of "b2s" where Write will find it
+ *
+ *  the encoding chain belongs to this physical alone, so
+ *  distinct physicals may be encoded concurrently once
+ *  their input has been read by ReadInput
+ */
+rc_t VPhysicalEncode ( VPhysical *self, int64_t id, uint32_t cnt )
+{
+    VBlob *vblob;
+    rc_t rc = VProductionReadBlob ( self -> b2s, & vblob, id, cnt, NULL );
+    if ( rc == 0 )
+    {
+        TRACK_BLOB ( VBlobRelease, vblob );
+        ( void ) VBlobRelease ( vblob );
+    }
+    return rc;
+}
+
 /* Read
  *  get the blob
  */
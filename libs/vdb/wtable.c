@@ -1053,3 +1053,12 @@ LIB_EXPORT rc_t CC VTableRenameColumn ( struct VTable *self, bool force,
     return rc;
 }
 
+
+/* SharesKColumns
+ *  the update library opens each read-only column once per manager
+ *  and hands the same KColumn to every cursor
+ */
+LIB_EXPORT bool CC VTableSharesKColumns ( const VTable *self )
+{
+    return true;
+}
@@ -0,0 +1,207 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <vdb/extern.h>
+#include <klib/defs.h>
+#include <klib/rc.h>
+#include <vdb/xform.h>
+#include <vdb/schema.h>
+#include <vdb/table.h>
+#include <kdb/meta.h>
+#include <klib/data-buffer.h>
+#include <sysalloc.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+#include <assert.h>
+
+#include "zstd-dict.h"
+
+/* LoadDict
+ *  read a dictionary from a node of the table metadata
+ */
+rc_t VXfZstdLoadDict ( const VTable *tbl, const char *node, uint32_t node_size, KDataBuffer *dict )
+{
+    const KMetadata *meta;
+    rc_t rc = VTableOpenMetadataRead ( tbl, & meta );
+    if ( rc == 0 )
+    {
+        const KMDataNode *dnode;
+        rc = KMetadataOpenNodeRead ( meta, & dnode, "%.*s", ( int ) node_size, node );
+        if ( rc == 0 )
+        {
+            size_t num_read, remaining;
+            rc = KMDataNodeRead ( dnode, 0, NULL, 0, & num_read, & remaining );
+            if ( rc == 0 )
+            {
+                if ( remaining == 0 )
+                    rc = RC ( rcXF, rcFunction, rcConstructing, rcData, rcEmpty );
+                else
+                {
+                    rc = KDataBufferMakeBytes ( dict, remaining );
+                    if ( rc == 0 )
+                    {
+                        rc = KMDataNodeRead ( dnode, 0, dict -> base, remaining, & num_read, NULL );
+                        if ( rc == 0 && num_read != remaining )
+                            rc = RC ( rcXF, rcFunction, rcConstructing, rcData, rcInsufficient );
+                        if ( rc != 0 )
+                            KDataBufferWhack ( dict );
+                    }
+                }
+            }
+
+            KMDataNodeRelease ( dnode );
+        }
+
+        KMetadataRelease ( meta );
+    }
+
+    return rc;
+}
+
+static
+rc_t invoke_zstd ( const ZSTD_DDict *ddict, void *dst, size_t dsize, const void *src, size_t ssize )
+{
+    size_t zr;
+    ZSTD_DCtx *ctx;
+
+    /* a dictionary-encoded frame needs the dictionary */
+    unsigned dict_id = ZSTD_getDictID_fromFrame ( src, ssize );
+    if ( dict_id != 0 && ( ddict == NULL || ZSTD_getDictID_fromDDict ( ddict ) != dict_id ) )
+        return RC ( rcXF, rcFunction, rcExecuting, rcData, rcUnsupported );
+
+    /* decoding runs concurrently on the decode pool,
+       so every call gets a context of its own */
+    ctx = ZSTD_createDCtx ();
+    if ( ctx == NULL )
+        return RC ( rcXF, rcFunction, rcExecuting, rcMemory, rcExhausted );
+
+    if ( ddict != NULL )
+        zr = ZSTD_decompress_usingDDict ( ctx, dst, dsize, src, ssize, ddict );
+    else
+        zr = ZSTD_decompressDCtx ( ctx, dst, dsize, src, ssize );
+
+    ZSTD_freeDCtx ( ctx );
+
+    if ( ZSTD_isError ( zr ) )
+    {
+        switch ( ZSTD_getErrorCode ( zr ) )
+        {
+        case ZSTD_error_dstSize_tooSmall:
+            return RC ( rcXF, rcFunction, rcExecuting, rcBuffer, rcInsufficient );
+        case ZSTD_error_memory_allocation:
+            return RC ( rcXF, rcFunction, rcExecuting, rcMemory, rcExhausted );
+        default:
+            return RC ( rcXF, rcFunction, rcExecuting, rcData, rcCorrupt );
+        }
+    }
+
+    /* the blob gives the size of the output */
+    if ( zr != dsize )
+        return RC ( rcXF, rcFunction, rcExecuting, rcData, rcCorrupt );
+
+    return 0;
+}
+
+static
+rc_t CC unzstd_func (
+    void *self,
+    const VXformInfo *info,
+    VBlobResult *dst,
+    const VBlobData *src,
+    VBlobHeader *hdr
+) {
+    rc_t rc = 0;
+    int64_t trailing = 0;
+
+    switch ( VBlobHeaderVersion ( hdr ) )
+    {
+    case 1:
+        break;
+    case 2:
+        rc = VBlobHeaderArgPopHead ( hdr, & trailing );
+        break;
+    default:
+        return RC ( rcXF, rcFunction, rcExecuting, rcParam, rcBadVersion );
+    }
+
+    if ( rc == 0 )
+    {
+        dst -> elem_count *= dst -> elem_bits;
+        dst -> byte_order = src -> byte_order;
+        dst -> elem_bits = 1;
+
+        /* like zlib, the output is byte aligned */
+        assert ( ( dst -> elem_count & 7 ) == 0 );
+        rc = invoke_zstd ( self, dst -> data, ( size_t ) ( dst -> elem_count >> 3 ),
+            src -> data, ( size_t ) ( ( ( uint64_t ) src -> elem_count * src -> elem_bits + 7 ) >> 3 ) );
+
+        /* back off to the original bit count */
+        if ( rc == 0 && trailing != 0 )
+            dst -> elem_count -= 8 - trailing;
+    }
+
+    return rc;
+}
+
+static
+void CC vxf_unzstd_wrapper ( void *ptr )
+{
+    ZSTD_freeDDict ( ptr );
+}
+
+/* unzstd
+ *  function any unzstd #1.0 < * ascii dict > ( zstd_fmt in );
+ *
+ *  "dict" [ CONST, OPTIONAL ] - path to the metadata node
+ *  holding the dictionary the data were encoded with
+ */
+VTRANSFACT_IMPL ( vdb_unzstd, 1, 0, 0 ) ( const void *self, const VXfactInfo *info,
+    VFuncDesc *rslt, const VFactoryParams *cp, const VFunctionParams *dp )
+{
+    if ( cp -> argc > 0 && cp -> argv [ 0 ] . count != 0 )
+    {
+        KDataBuffer dict;
+        rc_t rc = VXfZstdLoadDict ( info -> tbl,
+            cp -> argv [ 0 ] . data . ascii, cp -> argv [ 0 ] . count, & dict );
+        if ( rc != 0 )
+            return rc;
+
+        rslt -> self = ZSTD_createDDict ( dict . base, KDataBufferBytes ( & dict ) );
+        KDataBufferWhack ( & dict );
+        if ( rslt -> self == NULL )
+            return RC ( rcXF, rcFunction, rcConstructing, rcMemory, rcExhausted );
+
+        rslt -> whack = vxf_unzstd_wrapper;
+    }
+
+    rslt -> variant = vftBlob;
+    rslt -> u . bf = unzstd_func;
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <vdb/extern.h>
+
+#include <klib/defs.h>
+#include <klib/rc.h>
+#include <vdb/xform.h>
+#include <vdb/schema.h>
+#include <klib/data-buffer.h>
+#include <sysalloc.h>
+
+#include <string.h>
+#include <zstd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "zstd-dict.h"
+
+struct self_t {
+    int32_t level;
+    ZSTD_CDict *cdict;
+};
+
+static rc_t invoke_zstd(void *dst, uint32_t *dsize, const void *src, uint32_t ssize, const struct self_t *self) {
+    size_t zr;
+    ZSTD_CCtx *ctx = ZSTD_createCCtx();
+    if (ctx == NULL)
+        return RC(rcXF, rcFunction, rcExecuting, rcMemory, rcExhausted);
+
+    if (self->cdict != NULL)
+        zr = ZSTD_compress_usingCDict(ctx, dst, *dsize, src, ssize, self->cdict);
+    else
+        zr = ZSTD_compressCCtx(ctx, dst, *dsize, src, ssize, self->level);
+
+    ZSTD_freeCCtx(ctx);
+
+    *dsize = 0;
+    if (ZSTD_isError(zr)) {
+        switch (ZSTD_getErrorCode(zr)) {
+        case ZSTD_error_dstSize_tooSmall:
+            /* did not compress: leave it to the caller */
+            return 0;
+        case ZSTD_error_memory_allocation:
+            return RC(rcXF, rcFunction, rcExecuting, rcMemory, rcExhausted);
+        default:
+            return RC(rcXF, rcFunction, rcExecuting, rcSelf, rcUnexpected);
+        }
+    }
+
+    assert(zr <= UINT32_MAX);
+    *dsize = (uint32_t)zr;
+    return 0;
+}
+
+static
+rc_t CC zstd_func(
+              void *Self,
+              const VXformInfo *info,
+              VBlobResult *dst,
+              const VBlobData *src,
+              VBlobHeader *hdr
+) {
+    rc_t rc;
+    const struct self_t *self = Self;
+
+    /* input bits */
+    uint64_t sbits = ( uint64_t) src -> elem_count * src -> elem_bits;
+
+    /* input bytes */
+    uint32_t ssize = ( uint32_t ) ( ( sbits + 7 ) >> 3 );
+
+    /* required output size */
+    uint32_t dsize = ( uint32_t ) ( ( ( size_t ) dst -> elem_count * dst->elem_bits + 7 ) >> 3 );
+
+    if ( ( sbits & 7 ) == 0 )
+        /* version 1 is byte-aligned */
+        VBlobHeaderSetVersion ( hdr, 1 );
+    else
+    {
+        VBlobHeaderSetVersion ( hdr, 2 );
+        VBlobHeaderArgPushTail ( hdr, ( int64_t ) ( sbits & 7 ) );
+    }
+
+    rc = invoke_zstd ( dst -> data, & dsize, src -> data, ssize, self );
+    if (rc == 0) {
+        dst->elem_bits = 1;
+        dst->byte_order = src->byte_order;
+        if (dsize)
+            dst->elem_count = dsize << 3;
+        else
+            rc = RC(rcXF, rcFunction, rcExecuting, rcBuffer, rcInsufficient);
+    }
+    return rc;
+}
+
+static
+void CC vxf_zstd_wrapper( void *ptr )
+{
+    struct self_t *self = ptr;
+    ZSTD_freeCDict( self->cdict );
+    free( self );
+}
+
+/* zstd
+ * function zstd_fmt zstd #1.0 < * I32 level, ascii dict > ( any in );
+ *
+ *  "level" [ CONST, OPTIONAL ] - compression level, negative
+ *  levels trade ratio for speed. decoding speed hardly depends on it
+ *
+ *  "dict" [ CONST, OPTIONAL ] - path to a metadata node of the
+ *  table holding a dictionary, e.g. one trained with "zstd --train"
+ */
+VTRANSFACT_IMPL(vdb_zstd, 1, 0, 0) (const void *self, const VXfactInfo *info, VFuncDesc *rslt, const VFactoryParams *cp, const VFunctionParams *dp )
+{
+    rc_t rc = 0;
+    struct self_t *ctx;
+
+    int level = ZSTD_CLEVEL_DEFAULT;
+
+    if ( cp -> argc > 0 )
+    {
+        level = cp -> argv [ 0 ] . data . i32 [ 0 ];
+        if ( level < ZSTD_minCLevel () || level > ZSTD_maxCLevel () )
+            return RC(rcXF, rcFunction, rcConstructing, rcRange, rcInvalid);
+    }
+
+    ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL)
+        return RC(rcXF, rcFunction, rcConstructing, rcMemory, rcExhausted);
+
+    ctx->level = level;
+    ctx->cdict = NULL;
+
+    if ( cp -> argc > 1 && cp -> argv [ 1 ] . count != 0 )
+    {
+        KDataBuffer dict;
+        rc = VXfZstdLoadDict ( info -> tbl,
+            cp -> argv [ 1 ] . data . ascii, cp -> argv [ 1 ] . count, & dict );
+        if ( rc == 0 )
+        {
+            ctx->cdict = ZSTD_createCDict ( dict . base, KDataBufferBytes ( & dict ), level );
+            KDataBufferWhack ( & dict );
+            if ( ctx->cdict == NULL )
+                rc = RC(rcXF, rcFunction, rcConstructing, rcMemory, rcExhausted);
+        }
+    }
+
+    if (rc == 0) {
+        rslt->self = ctx;
+        rslt->whack = vxf_zstd_wrapper;
+        rslt->variant = vftBlob;
+        rslt->u.bf = zstd_func;
+
+        return 0;
+    }
+
+    free(ctx);
+    return rc;
+}
@@ -0,0 +1,309 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Unit tests for reading BAM files
+*/
+#include <ktst/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+extern "C" {
+#include <klib/rc.h>
+#include <kfs/directory.h>
+#include <kfs/file.h>
+#include <kproc/threadpool.h>
+#include <align/bam.h>
+#include <zlib.h>
+}
+
+using namespace std;
+
+TEST_SUITE(BAMTestSuite);
+
+/* writes a BAM file of "records" unplaced alignments, the i-th at position i
+ * and named "r<i>", compressed into BGZF blocks of about "blockSize" bytes
+ */
+class BAMWriter
+{
+public:
+    BAMWriter ( unsigned blockSize )
+    : m_blockSize ( blockSize )
+    {
+    }
+
+    void Header ( const string & text, const string & refName, uint32_t refLen )
+    {
+        m_data . append ( "BAM\1", 4 );
+        PutI32 ( ( int32_t ) text . size () );
+        m_data . append ( text );
+        PutI32 ( 1 );
+        PutI32 ( ( int32_t ) refName . size () + 1 );
+        m_data . append ( refName . c_str (), refName . size () + 1 );
+        PutI32 ( ( int32_t ) refLen );
+    }
+
+    void Record ( unsigned i )
+    {
+        char name [ 32 ];
+        unsigned const nameLen = sprintf ( name, "r%u", i ) + 1;
+        unsigned const readLen = 100;
+        unsigned const size = 32 + nameLen + 4 + ( readLen + 1 ) / 2 + readLen;
+
+        PutI32 ( ( int32_t ) size );
+        PutI32 ( 0 );                               /* refID */
+        PutI32 ( ( int32_t ) i );                   /* pos */
+        m_data . push_back ( ( char ) nameLen );
+        m_data . push_back ( ( char ) 30 );         /* mapq */
+        PutI16 ( 4680 );                            /* bin */
+        PutI16 ( 1 );                               /* n_cigar */
+        PutI16 ( 0 );                               /* flag */
+        PutI32 ( ( int32_t ) readLen );
+        PutI32 ( -1 );                              /* next refID */
+        PutI32 ( -1 );                              /* next pos */
+        PutI32 ( 0 );                               /* tlen */
+        m_data . append ( name, nameLen );
+        PutI32 ( ( int32_t ) ( readLen << 4 ) );    /* 100M */
+        for ( unsigned j = 0; j < ( readLen + 1 ) / 2; ++ j )
+            m_data . push_back ( ( char ) ( 0x12 + ( ( i + j ) & 3 ) * 0x22 ) );
+        for ( unsigned j = 0; j < readLen; ++ j )
+            m_data . push_back ( ( char ) ( ( i * 7 + j ) % 41 ) );
+    }
+
+    void Write ( const string & path )
+    {
+        string bgzf;
+        for ( size_t i = 0; i < m_data . size (); i += m_blockSize )
+        {
+            size_t const len = m_data . size () - i < m_blockSize ? m_data . size () - i : m_blockSize;
+            Compress ( bgzf, m_data . data () + i, len );
+        }
+        Compress ( bgzf, "", 0 ); /* eof marker */
+
+        KDirectory * dir;
+        if ( KDirectoryNativeDir ( & dir ) != 0 )
+            throw logic_error ( "KDirectoryNativeDir failed" );
+        KFile * file;
+        rc_t rc = KDirectoryCreateFile ( dir, & file, false, 0664, kcmInit, "%s", path . c_str () );
+        if ( rc == 0 )
+        {
+            rc = KFileWriteAll ( file, 0, bgzf . data (), bgzf . size (), NULL );
+            KFileRelease ( file );
+        }
+        KDirectoryRelease ( dir );
+        if ( rc != 0 )
+            throw logic_error ( "writing BAM file failed" );
+    }
+
+private:
+    void PutI16 ( int16_t v )
+    {
+        m_data . push_back ( ( char ) ( v & 0xFF ) );
+        m_data . push_back ( ( char ) ( ( v >> 8 ) & 0xFF ) );
+    }
+    void PutI32 ( int32_t v )
+    {
+        PutI16 ( ( int16_t ) ( v & 0xFFFF ) );
+        PutI16 ( ( int16_t ) ( ( v >> 16 ) & 0xFFFF ) );
+    }
+
+    static void Compress ( string & out, const char * data, size_t len )
+    {
+        unsigned char header [ 18 ] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0 };
+        unsigned char cdata [ 0x10000 ];
+        z_stream zs;
+
+        memset ( & zs, 0, sizeof zs );
+        if ( deflateInit2 ( & zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+            throw logic_error ( "deflateInit2 failed" );
+        zs . next_in = ( Bytef * ) data;
+        zs . avail_in = ( uInt ) len;
+        zs . next_out = cdata;
+        zs . avail_out = sizeof cdata - sizeof header - 8;
+        int const zr = deflate ( & zs, Z_FINISH );
+        size_t const clen = zs . total_out;
+        deflateEnd ( & zs );
+        if ( zr != Z_STREAM_END )
+            throw logic_error ( "deflate failed" );
+
+        uint32_t const bsize = ( uint32_t ) ( sizeof header + clen + 8 - 1 );
+        header [ 16 ] = ( unsigned char ) ( bsize & 0xFF );
+        header [ 17 ] = ( unsigned char ) ( bsize >> 8 );
+        uint32_t const crc = ( uint32_t ) crc32 ( crc32 ( 0, NULL, 0 ), ( const Bytef * ) data, ( uInt ) len );
+        unsigned char trailer [ 8 ];
+        for ( int i = 0; i < 4; ++ i )
+        {
+            trailer [ i ] = ( unsigned char ) ( crc >> ( 8 * i ) );
+            trailer [ 4 + i ] = ( unsigned char ) ( ( uint32_t ) len >> ( 8 * i ) );
+        }
+        out . append ( ( const char * ) header, sizeof header );
+        out . append ( ( const char * ) cdata, clen );
+        out . append ( ( const char * ) trailer, sizeof trailer );
+    }
+
+    string m_data;
+    size_t m_blockSize;
+};
+
+class BAMFixture
+{
+public:
+    static const unsigned Records = 20000;
+
+    BAMFixture ()
+    : bam ( 0 )
+    {
+    }
+    ~BAMFixture ()
+    {
+        if ( bam != 0 )
+            BAMFileRelease ( bam );
+        KDirectory * dir;
+        if ( KDirectoryNativeDir ( & dir ) == 0 )
+        {
+            KDirectoryRemove ( dir, true, "%s", m_path . c_str () );
+            KDirectoryRelease ( dir );
+        }
+    }
+
+    void Make ( const string & path, unsigned blockSize )
+    {
+        m_path = path;
+        BAMWriter w ( blockSize );
+        w . Header ( "@HD\tVN:1.4\n@SQ\tSN:chr1\tLN:100000\n", "chr1", 100000 );
+        for ( unsigned i = 0; i < Records; ++ i )
+            w . Record ( i );
+        w . Write ( path );
+
+        if ( BAMFileMake ( & bam, "%s", path . c_str () ) != 0 )
+            throw logic_error ( "BAMFileMake failed" );
+    }
+
+    /* reads the next record and returns its position, -1 at end of file */
+    int64_t Next ()
+    {
+        const BAMAlignment * rec;
+        rc_t rc = BAMFileRead2 ( bam, & rec );
+        if ( rc != 0 )
+        {
+            if ( GetRCObject ( rc ) == ( enum RCObject ) rcRow && GetRCState ( rc ) == rcNotFound )
+                return -1;
+            throw logic_error ( "BAMFileRead2 failed" );
+        }
+        int64_t pos;
+        const char * name;
+        if ( BAMAlignmentGetPosition ( rec, & pos ) != 0 || BAMAlignmentGetReadName ( rec, & name ) != 0 )
+            throw logic_error ( "BAMAlignment accessor failed" );
+        char expected [ 32 ];
+        sprintf ( expected, "r%u", ( unsigned ) pos );
+        if ( strcmp ( name, expected ) != 0 )
+            throw logic_error ( "read name does not match position" );
+        BAMAlignmentRelease ( rec );
+        return pos;
+    }
+
+    const BAMFile * bam;
+
+private:
+    string m_path;
+};
+
+FIXTURE_TEST_CASE ( ReadAll, BAMFixture )
+{
+    Make ( GetName (), 0xff00 );
+    for ( unsigned i = 0; i < Records; ++ i )
+        REQUIRE_EQ ( ( int64_t ) i, Next () );
+    REQUIRE_EQ ( ( int64_t ) -1, Next () );
+}
+
+FIXTURE_TEST_CASE ( SetPosition, BAMFixture )
+{
+    /* small blocks, so that records span several of them */
+    Make ( GetName (), 1000 );
+
+    vector < BAMFilePosition > marks;
+    for ( unsigned i = 0; i < Records; ++ i )
+    {
+        if ( i % 997 == 0 )
+        {
+            BAMFilePosition pos;
+            REQUIRE_RC ( BAMFileGetPosition ( bam, & pos ) );
+            marks . push_back ( pos );
+        }
+        REQUIRE_EQ ( ( int64_t ) i, Next () );
+    }
+    REQUIRE_EQ ( ( int64_t ) -1, Next () );
+
+    /* backwards, reading a few records after each seek */
+    for ( size_t m = marks . size (); m != 0; -- m )
+    {
+        REQUIRE_RC ( BAMFileSetPosition ( bam, & marks [ m - 1 ] ) );
+        for ( unsigned i = 0; i < 10; ++ i )
+            REQUIRE_EQ ( ( int64_t ) ( ( m - 1 ) * 997 + i ), Next () );
+    }
+
+    /* and once more from the top to the end */
+    REQUIRE_RC ( BAMFileRewind ( bam ) );
+    for ( unsigned i = 0; i < Records; ++ i )
+        REQUIRE_EQ ( ( int64_t ) i, Next () );
+    REQUIRE_EQ ( ( int64_t ) -1, Next () );
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+
+rc_t CC UsageSummary ( const char * progname )
+{
+    return 0;
+}
+
+rc_t CC Usage( const Args* args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-bam";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    /* BGZF blocks are inflated on the thread pool when it has workers to spare */
+    KThreadPoolSetDefaultThreads ( 4 );
+    return BAMTestSuite(argc, argv);
+}
+
+}
@@ -0,0 +1,226 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Unit tests for RefSeqMgr
+*/
+#include <ktst/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+extern "C" {
+#include <klib/rc.h>
+#include <kfs/directory.h>
+#include <insdc/insdc.h>
+#include <vdb/manager.h>
+#include <align/writer-refseq.h>
+#include <align/refseq-mgr.h>
+}
+
+using namespace std;
+
+TEST_SUITE(RefSeqMgrTestSuite);
+
+class RefSeqFixture
+{
+public:
+    static const unsigned Length = 12345;
+
+    RefSeqFixture ()
+    : vmgr ( 0 )
+    , mgr ( 0 )
+    , seq ( 0 )
+    {
+        THROW_ON_RC ( KDirectoryNativeDir ( & m_dir ) );
+        for ( unsigned i = 0; i < Length; ++ i )
+            bases . push_back ( "ACGTN" [ ( i * 7 + i / 13 ) % 5 ] );
+    }
+    ~RefSeqFixture ()
+    {
+        RefSeqMgr_Release ( mgr );
+        VDBManagerRelease ( vmgr );
+        if ( ! m_name . empty () )
+        {
+            KDirectoryRemove ( m_dir, true, "%s", m_name . c_str () );
+            KDirectoryRemove ( m_dir, true, "%s", m_cache . c_str () );
+        }
+        KDirectoryRelease ( m_dir );
+    }
+
+    void MakeTable ( const string & name, bool circular )
+    {
+        m_name = name;
+        m_cache = name + ".cache";
+        KDirectoryRemove ( m_dir, true, "%s", m_name . c_str () );
+        KDirectoryRemove ( m_dir, true, "%s", m_cache . c_str () );
+
+        VDBManager * wmgr;
+        THROW_ON_RC ( VDBManagerMakeUpdate ( & wmgr, NULL ) );
+        THROW_ON_RC ( VDBManagerAddSchemaIncludePath ( wmgr, "%s", "../../interfaces" ) );
+
+        const TableWriterRefSeq * writer;
+        THROW_ON_RC ( TableWriterRefSeq_Make ( & writer, wmgr, "align/refseq.vschema", m_name . c_str (), 0 ) );
+
+        TableWriterData data;
+        data . buffer = m_name . c_str ();
+        data . elements = m_name . size ();
+        THROW_ON_RC ( TableWriterRefSeq_WriteDefault ( writer, ewrefseq_cn_SEQ_ID, & data ) );
+        data . buffer = "test";
+        data . elements = 4;
+        THROW_ON_RC ( TableWriterRefSeq_WriteDefault ( writer, ewrefseq_cn_DEF_LINE, & data ) );
+        data . buffer = & circular;
+        data . elements = 1;
+        THROW_ON_RC ( TableWriterRefSeq_WriteDefault ( writer, ewrefseq_cn_CIRCULAR, & data ) );
+
+        for ( unsigned i = 0; i < Length; i += TableWriterRefSeq_MAX_SEQ_LEN )
+        {
+            TableWriterRefSeqData row;
+            memset ( & row, 0, sizeof row );
+            row . read . buffer = bases . data () + i;
+            row . read . elements = Length - i < TableWriterRefSeq_MAX_SEQ_LEN ? Length - i : TableWriterRefSeq_MAX_SEQ_LEN;
+            THROW_ON_RC ( TableWriterRefSeq_Write ( writer, & row, NULL ) );
+        }
+        THROW_ON_RC ( TableWriterRefSeq_Whack ( writer, true, NULL, "test-refseq-mgr", 0x1000000, __DATE__, "test-refseq-mgr", 0x1000000 ) );
+        vmgr = wmgr;
+    }
+
+    void OpenSeq ( bool disk_cache )
+    {
+        if ( mgr != 0 )
+            RefSeqMgr_Release ( mgr );
+        THROW_ON_RC ( RefSeqMgr_Make ( & mgr, vmgr, 0, 0, 0 ) );
+        THROW_ON_RC ( RefSeqMgr_SetDiskCache ( mgr, disk_cache ? m_cache . c_str () : NULL ) );
+        THROW_ON_RC ( RefSeqMgr_GetSeq ( mgr, & seq, m_name . c_str (), ( uint32_t ) m_name . size () ) );
+    }
+
+    string Read ( INSDC_coord_zero offset, INSDC_coord_len len )
+    {
+        string buffer ( len, '\0' );
+        INSDC_coord_len written = 0;
+        THROW_ON_RC ( RefSeq_Read ( seq, offset, len, ( uint8_t * ) & buffer [ 0 ], & written ) );
+        buffer . resize ( written );
+        return buffer;
+    }
+
+    /* the cache file is named by accession and MD5 */
+    bool CacheFileExists ()
+    {
+        const uint8_t * md5;
+        THROW_ON_RC ( RefSeq_MD5 ( seq, & md5 ) );
+        if ( md5 == 0 )
+            throw logic_error ( "no MD5" );
+        string path = m_cache + "/" + m_name + ".";
+        for ( unsigned i = 0; i < 16; ++ i )
+        {
+            char hex [ 3 ];
+            sprintf ( hex, "%02x", md5 [ i ] );
+            path += hex;
+        }
+        path += ".txt";
+        return KDirectoryPathType ( m_dir, "%s", path . c_str () ) == kptFile;
+    }
+
+    string bases;
+    const VDBManager * vmgr;
+    const RefSeqMgr * mgr;
+    const RefSeq * seq;
+
+private:
+    KDirectory * m_dir;
+    string m_name;
+    string m_cache;
+};
+
+FIXTURE_TEST_CASE ( DiskCache, RefSeqFixture )
+{
+    MakeTable ( GetName (), false );
+
+    OpenSeq ( false );
+    REQUIRE_EQ ( bases, Read ( 0, Length ) );
+    REQUIRE ( ! CacheFileExists () );
+
+    /* first use builds the cache file, later ones map it */
+    for ( int pass = 0; pass < 2; ++ pass )
+    {
+        OpenSeq ( true );
+        REQUIRE ( CacheFileExists () );
+        REQUIRE_EQ ( bases, Read ( 0, Length ) );
+        REQUIRE_EQ ( bases . substr ( 4990, 20 ), Read ( 4990, 20 ) );
+        REQUIRE_EQ ( bases . substr ( Length - 10 ), Read ( Length - 10, 100 ) );
+    }
+
+    INSDC_coord_len written;
+    uint8_t buffer [ 10 ];
+    REQUIRE_RC_FAIL ( RefSeq_Read ( seq, Length, 10, buffer, & written ) );
+}
+
+FIXTURE_TEST_CASE ( DiskCache_Circular, RefSeqFixture )
+{
+    MakeTable ( GetName (), true );
+
+    OpenSeq ( false );
+    string const decoded = Read ( Length - 10, 100 );
+    REQUIRE_EQ ( bases . substr ( Length - 10 ) + bases . substr ( 0, 90 ), decoded );
+
+    OpenSeq ( true );
+    REQUIRE ( CacheFileExists () );
+    REQUIRE_EQ ( decoded, Read ( Length - 10, 100 ) );
+    REQUIRE_EQ ( Read ( 100, 50 ), Read ( 100 + Length, 50 ) );
+    REQUIRE_EQ ( Read ( Length - 5, 5 ), Read ( -5, 5 ) );
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+
+rc_t CC UsageSummary ( const char * progname )
+{
+    return 0;
+}
+
+rc_t CC Usage( const Args* args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-refseq-mgr";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    return RefSeqMgrTestSuite(argc, argv);
+}
+
+}
@@ -0,0 +1,299 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Unit tests for the seq_restore_read function of libaxf
+*/
+#include <ktst/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <klib/rc.h>
+#include <kfs/directory.h>
+#include <kproc/threadpool.h>
+#include <insdc/insdc.h>
+#include <insdc/sra.h>
+#include <vdb/manager.h>
+#include <vdb/schema.h>
+#include <vdb/database.h>
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+}
+
+using namespace std;
+
+TEST_SUITE(SeqRestoreReadTestSuite);
+
+static const char SchemaText [] =
+"version 1;\n"
+"include 'insdc/insdc.vschema';\n"
+"include 'insdc/sra.vschema';\n"
+"extern function\n"
+"INSDC:4na:bin NCBI:align:seq_restore_read #1 ( INSDC:4na:bin cmp_rd, I64 align_id,\n"
+"        INSDC:coord:len read_len, INSDC:SRA:xread_type rd_type )\n"
+"    = ALIGN:seq_restore_read;\n"
+"table test:align #1\n"
+"{\n"
+"    extern column INSDC:4na:bin READ;\n"
+"};\n"
+"table test:seq #1\n"
+"{\n"
+"    extern column INSDC:4na:bin CMP_READ;\n"
+"    extern column I64 PRIMARY_ALIGNMENT_ID;\n"
+"    extern column INSDC:coord:len READ_LEN;\n"
+"    extern column INSDC:SRA:xread_type READ_TYPE;\n"
+"    readonly column INSDC:4na:bin READ\n"
+"        = NCBI:align:seq_restore_read ( .CMP_READ, .PRIMARY_ALIGNMENT_ID, .READ_LEN, .READ_TYPE );\n"
+"};\n"
+"database test:db #1\n"
+"{\n"
+"    table test:seq #1 SEQUENCE;\n"
+"    table test:align #1 PRIMARY_ALIGNMENT;\n"
+"};\n"
+;
+
+class RestoreFixture
+{
+public:
+    static const unsigned Reads = 2;
+
+    RestoreFixture ()
+    : m_db ( 0 )
+    {
+        THROW_ON_RC ( KDirectoryNativeDir ( & m_dir ) );
+    }
+    ~RestoreFixture ()
+    {
+        VDatabaseRelease ( m_db );
+        if ( ! m_name . empty () )
+            KDirectoryRemove ( m_dir, true, "%s", m_name . c_str () );
+        KDirectoryRelease ( m_dir );
+    }
+
+    static INSDC_4na_bin Complement ( INSDC_4na_bin b )
+    {
+        return ( ( b & 1 ) << 3 ) | ( ( b & 2 ) << 1 ) | ( ( b & 4 ) >> 1 ) | ( ( b & 8 ) >> 3 );
+    }
+
+    /* every spot has a forward and a reverse read; the alignments are stored in
+       a shuffled order, and every 7th second read is unaligned */
+    void MakeDatabase ( const string & name, unsigned spots )
+    {
+        m_name = name;
+        KDirectoryRemove ( m_dir, true, "%s", m_name . c_str () );
+
+        VDBManager * mgr;
+        THROW_ON_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+        THROW_ON_RC ( VDBManagerAddSchemaIncludePath ( mgr, "%s", "../../interfaces" ) );
+        VSchema * schema;
+        THROW_ON_RC ( VDBManagerMakeSchema ( mgr, & schema ) );
+        THROW_ON_RC ( VSchemaParseText ( schema, NULL, SchemaText, sizeof SchemaText - 1 ) );
+        VDatabase * db;
+        THROW_ON_RC ( VDBManagerCreateDB ( mgr, & db, schema, "test:db", kcmInit + kcmMD5, "%s", m_name . c_str () ) );
+        THROW_ON_RC ( VSchemaRelease ( schema ) );
+
+        vector < int64_t > order;
+        for ( unsigned i = 0; i < spots * Reads; ++ i )
+            order . push_back ( i );
+        for ( unsigned i = ( unsigned ) order . size (); i > 1; -- i )
+            swap ( order [ i - 1 ], order [ ( i * 2654435761u ) % i ] );
+
+        expected . resize ( spots );
+        vector < string > aligned ( order . size () );
+        vector < int64_t > align_id ( order . size () );
+        int64_t next_id = 1;
+        for ( unsigned i = 0; i < order . size (); ++ i )
+        {
+            unsigned const spot = ( unsigned ) ( order [ i ] / Reads );
+            unsigned const read = ( unsigned ) ( order [ i ] % Reads );
+            unsigned const len = 30 + ( spot * 3 + read * 11 ) % 40;
+            string bases;
+            for ( unsigned j = 0; j < len; ++ j )
+                bases += ( char ) ( 1 << ( ( spot + j * ( read + 1 ) + j / 5 ) & 3 ) );
+
+            expected [ spot ] . resize ( Reads );
+            if ( read == 1 && spot % 7 == 0 )
+            {
+                expected [ spot ] [ read ] = bases;
+                continue;
+            }
+            if ( read == 1 )
+            {
+                /* the alignment holds the reverse complement */
+                string rc ( bases . rbegin (), bases . rend () );
+                for ( unsigned j = 0; j < rc . size (); ++ j )
+                    rc [ j ] = Complement ( rc [ j ] );
+                aligned [ next_id - 1 ] = rc;
+            }
+            else
+                aligned [ next_id - 1 ] = bases;
+            expected [ spot ] [ read ] = bases;
+            align_id [ order [ i ] ] = next_id ++;
+        }
+
+        {
+            VTable * tbl;
+            THROW_ON_RC ( VDatabaseCreateTable ( db, & tbl, "PRIMARY_ALIGNMENT", kcmInit + kcmMD5, "PRIMARY_ALIGNMENT" ) );
+            VCursor * curs;
+            THROW_ON_RC ( VTableCreateCursorWrite ( tbl, & curs, kcmInsert ) );
+            uint32_t read_idx;
+            THROW_ON_RC ( VCursorAddColumn ( curs, & read_idx, "READ" ) );
+            THROW_ON_RC ( VCursorOpen ( curs ) );
+            for ( int64_t id = 1; id < next_id; ++ id )
+            {
+                const string & r = aligned [ id - 1 ];
+                THROW_ON_RC ( VCursorOpenRow ( curs ) );
+                THROW_ON_RC ( VCursorWrite ( curs, read_idx, 8, r . data (), 0, r . size () ) );
+                THROW_ON_RC ( VCursorCommitRow ( curs ) );
+                THROW_ON_RC ( VCursorCloseRow ( curs ) );
+            }
+            THROW_ON_RC ( VCursorCommit ( curs ) );
+            THROW_ON_RC ( VCursorRelease ( curs ) );
+            THROW_ON_RC ( VTableRelease ( tbl ) );
+        }
+        {
+            VTable * tbl;
+            THROW_ON_RC ( VDatabaseCreateTable ( db, & tbl, "SEQUENCE", kcmInit + kcmMD5, "SEQUENCE" ) );
+            VCursor * curs;
+            THROW_ON_RC ( VTableCreateCursorWrite ( tbl, & curs, kcmInsert ) );
+            uint32_t cmp_idx, id_idx, len_idx, type_idx;
+            THROW_ON_RC ( VCursorAddColumn ( curs, & cmp_idx, "CMP_READ" ) );
+            THROW_ON_RC ( VCursorAddColumn ( curs, & id_idx, "PRIMARY_ALIGNMENT_ID" ) );
+            THROW_ON_RC ( VCursorAddColumn ( curs, & len_idx, "READ_LEN" ) );
+            THROW_ON_RC ( VCursorAddColumn ( curs, & type_idx, "READ_TYPE" ) );
+            THROW_ON_RC ( VCursorOpen ( curs ) );
+            for ( unsigned spot = 0; spot < spots; ++ spot )
+            {
+                string cmp;
+                INSDC_coord_len len [ Reads ];
+                INSDC_SRA_xread_type type [ Reads ];
+                for ( unsigned read = 0; read < Reads; ++ read )
+                {
+                    len [ read ] = ( INSDC_coord_len ) expected [ spot ] [ read ] . size ();
+                    type [ read ] = SRA_READ_TYPE_BIOLOGICAL |
+                        ( read == 0 ? SRA_READ_TYPE_FORWARD : SRA_READ_TYPE_REVERSE );
+                    if ( align_id [ spot * Reads + read ] == 0 )
+                        cmp += expected [ spot ] [ read ];
+                }
+                THROW_ON_RC ( VCursorOpenRow ( curs ) );
+                THROW_ON_RC ( VCursorWrite ( curs, cmp_idx, 8, cmp . data (), 0, cmp . size () ) );
+                THROW_ON_RC ( VCursorWrite ( curs, id_idx, 64, & align_id [ spot * Reads ], 0, Reads ) );
+                THROW_ON_RC ( VCursorWrite ( curs, len_idx, 32, len, 0, Reads ) );
+                THROW_ON_RC ( VCursorWrite ( curs, type_idx, 8, type, 0, Reads ) );
+                THROW_ON_RC ( VCursorCommitRow ( curs ) );
+                THROW_ON_RC ( VCursorCloseRow ( curs ) );
+            }
+            THROW_ON_RC ( VCursorCommit ( curs ) );
+            THROW_ON_RC ( VCursorRelease ( curs ) );
+            THROW_ON_RC ( VTableRelease ( tbl ) );
+        }
+        m_db = db;
+        THROW_ON_RC ( VDBManagerRelease ( mgr ) );
+    }
+
+    /* reads SEQUENCE.READ for the rows [ first, first + count ) */
+    bool CheckRows ( int64_t first, unsigned count )
+    {
+        const VTable * tbl;
+        THROW_ON_RC ( VDatabaseOpenTableRead ( m_db, & tbl, "SEQUENCE" ) );
+        const VCursor * curs;
+        THROW_ON_RC ( VTableCreateCursorRead ( tbl, & curs ) );
+        uint32_t idx;
+        THROW_ON_RC ( VCursorAddColumn ( curs, & idx, "READ" ) );
+        THROW_ON_RC ( VCursorOpen ( curs ) );
+
+        bool ok = true;
+        for ( int64_t row = first; ok && row < first + count; ++ row )
+        {
+            const void * base;
+            uint32_t elem_bits, boff, row_len;
+            THROW_ON_RC ( VCursorCellDataDirect ( curs, row, idx, & elem_bits, & base, & boff, & row_len ) );
+            const vector < string > & exp = expected [ row - 1 ];
+            string const got ( ( const char * ) base, row_len );
+            ok = ( got == exp [ 0 ] + exp [ 1 ] );
+        }
+        VCursorRelease ( curs );
+        VTableRelease ( tbl );
+        return ok;
+    }
+
+    vector < vector < string > > expected;
+
+private:
+    KDirectory * m_dir;
+    VDatabase * m_db;
+    string m_name;
+};
+
+FIXTURE_TEST_CASE ( Random, RestoreFixture )
+{
+    MakeDatabase ( GetName (), 500 );
+    /* too few sequential rows to start caching */
+    REQUIRE ( CheckRows ( 200, 50 ) );
+    REQUIRE ( CheckRows ( 1, 20 ) );
+}
+
+FIXTURE_TEST_CASE ( Sequential, RestoreFixture )
+{
+    /* large enough for the window to be fetched in parallel */
+    MakeDatabase ( GetName (), 30000 );
+    REQUIRE ( CheckRows ( 1, 30000 ) );
+    REQUIRE ( CheckRows ( 12345, 1000 ) );
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+
+rc_t CC UsageSummary ( const char * progname )
+{
+    return 0;
+}
+
+rc_t CC Usage( const Args* args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-seq-restore-read";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    /* large windows of alignments are fetched on the thread pool */
+    KThreadPoolSetDefaultThreads ( 4 );
+    return SeqRestoreReadTestSuite(argc, argv);
+}
+
+}
@@ -31,11 +31,14 @@
 #include <ktst/unit_test.hpp>
 
 #include <sysalloc.h>
+#include <cstring>
 
 #include <kdb/manager.h>
 #include <kdb/database.h>
 #include <kdb/index.h>
 #include <kdb/table.h>
+#include <kdb/column.h>
+#include <klib/data-buffer.h>
 
 #include <vfs/manager.h>
 
@@ -138,6 +141,41 @@ FIXTURE_TEST_CASE ( ColumnBlobRead_insufficient_buffer, ColumnBlobReadFixture )
     REQUIRE_EQ ( (size_t)0, m_remaining );
 }
 
+FIXTURE_TEST_CASE ( ColumnBlobReadAllV, ColumnBlobReadFixture )
+{   // blobs of two columns in one batch, checked against reading each alone
+    const KDBManager* mgr;
+    REQUIRE_RC ( KDBManagerMakeRead ( & mgr, NULL ) );
+    const KTable* tbl;
+    REQUIRE_RC ( KDBManagerOpenTableRead ( mgr, & tbl, "SRR000123" ) );
+    const KColumn* col;
+    REQUIRE_RC ( KTableOpenColumnRead ( tbl, & col, "Y" ) );
+
+    const KColumnBlob* blobs [ 2 ] = { m_blob, 0 };
+    REQUIRE_RC ( KColumnOpenBlobRead ( col, & blobs [ 1 ], 1 ) );
+
+    KDataBuffer buffers [ 2 ];
+    KColumnBlobCSData cs [ 2 ];
+    REQUIRE_RC ( KColumnBlobReadAllV ( blobs, 2, buffers, cs, sizeof cs [ 0 ] ) );
+
+    for ( int i = 0; i < 2; ++ i )
+    {
+        KDataBuffer expected;
+        KColumnBlobCSData expected_cs;
+        REQUIRE_RC ( KColumnBlobReadAll ( blobs [ i ], & expected, & expected_cs, sizeof expected_cs ) );
+        REQUIRE_EQ ( KDataBufferBytes ( & expected ), KDataBufferBytes ( & buffers [ i ] ) );
+        REQUIRE_EQ ( 0, memcmp ( expected . base, buffers [ i ] . base, KDataBufferBytes ( & expected ) ) );
+        REQUIRE_EQ ( 0, memcmp ( & expected_cs, & cs [ i ], sizeof expected_cs ) );
+        REQUIRE_RC ( KColumnBlobValidateBuffer ( blobs [ i ], & buffers [ i ], & cs [ i ], sizeof cs [ i ] ) );
+        REQUIRE_RC ( KDataBufferWhack ( & expected ) );
+        REQUIRE_RC ( KDataBufferWhack ( & buffers [ i ] ) );
+    }
+
+    REQUIRE_RC ( KColumnBlobRelease ( blobs [ 1 ] ) );
+    REQUIRE_RC ( KColumnRelease ( col ) );
+    REQUIRE_RC ( KTableRelease ( tbl ) );
+    REQUIRE_RC ( KDBManagerRelease ( mgr ) );
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
@@ -37,6 +37,7 @@
 
 #include <klib/out.h>
 #include <klib/rc.h>
+#include <klib/time.h>
 
 #include <kproc/thread.h>
 
@@ -44,6 +45,7 @@
 #include <kfs/directory.h>
 #include <kfs/file.h>
 #include <kfs/cacheteefile.h>
+#include <kfs/impl.h>
 
 using namespace std;
 
@@ -562,6 +564,207 @@ TEST_CASE( CacheTee_Multiple_Users_with_Promoting )
 	REQUIRE_RC( KDirectoryRelease( dir ) );
 }
 
+// a remote file that counts how often it is read from
+struct CountingFile
+{
+	KFile dad;
+	const KFile * inner;
+	uint32_t reads;
+};
+
+static rc_t CC CountingFileDestroy( KFile * self )
+{
+	CountingFile * cf = ( CountingFile * ) self;
+	KFileRelease( cf -> inner );
+	free( cf );
+	return 0;
+}
+
+static struct KSysFile * CC CountingFileGetSysFile( const KFile * self, uint64_t * offset )
+{
+	return NULL;
+}
+
+static rc_t CC CountingFileRandomAccess( const KFile * self )
+{
+	return 0;
+}
+
+static rc_t CC CountingFileSize( const KFile * self, uint64_t * size )
+{
+	return KFileSize( ( ( const CountingFile * ) self ) -> inner, size );
+}
+
+static rc_t CC CountingFileSetSize( KFile * self, uint64_t size )
+{
+	return RC ( rcFS, rcFile, rcUpdating, rcFile, rcReadonly );
+}
+
+static rc_t CC CountingFileRead( const KFile * self, uint64_t pos, void * buffer, size_t bsize, size_t * num_read )
+{
+	CountingFile * cf = ( CountingFile * ) self;
+	__sync_fetch_and_add( & cf -> reads, 1 );
+	return KFileRead( cf -> inner, pos, buffer, bsize, num_read );
+}
+
+static rc_t CC CountingFileWrite( KFile * self, uint64_t pos, const void * buffer, size_t size, size_t * num_writ )
+{
+	return RC ( rcFS, rcFile, rcWriting, rcFile, rcReadonly );
+}
+
+static KFile_vt_v1 vtCountingFile =
+{
+	1, 0,
+	CountingFileDestroy,
+	CountingFileGetSysFile,
+	CountingFileRandomAccess,
+	CountingFileSize,
+	CountingFileSetSize,
+	CountingFileRead,
+	CountingFileWrite
+};
+
+static rc_t make_counting_file( const KFile ** f, const KFile * inner )
+{
+	CountingFile * cf = ( CountingFile * ) calloc( 1, sizeof * cf );
+	if ( cf == NULL )
+		return RC ( rcFS, rcFile, rcConstructing, rcMemory, rcExhausted );
+	rc_t rc = KFileInit( & cf -> dad, ( const KFile_vt * ) & vtCountingFile, "CountingFile", "counting", true, false );
+	if ( rc == 0 )
+		rc = KFileAddRef( inner );
+	if ( rc != 0 )
+	{
+		free( cf );
+		return rc;
+	}
+	cf -> inner = inner;
+	* f = & cf -> dad;
+	return 0;
+}
+
+static uint32_t remote_reads( const KFile * f )
+{
+	return __sync_fetch_and_add( & ( ( CountingFile * ) f ) -> reads, 0 );
+}
+
+TEST_CASE( CacheTee_Fill )
+{
+	KOutMsg( "Test: CacheTee_Fill\n" );
+	remove_file( CACHEFILE );	// to start with a clean slate on caching...
+	remove_file( CACHEFILE1 );
+
+    KDirectory * dir;
+    REQUIRE_RC( KDirectoryNativeDir( &dir ) );
+
+	const KFile * org;
+    REQUIRE_RC( KDirectoryOpenFileRead( dir, &org, "%s", DATAFILE ) );
+	const KFile * remote;
+	REQUIRE_RC( make_counting_file( &remote, org ) );
+
+	const KFile * tee;
+	REQUIRE_RC( KDirectoryMakeCacheTee ( dir, &tee, remote, BLOCKSIZE, "%s", CACHEFILE ) );
+	REQUIRE_RC( KCacheTeeFileStartFill( tee, NULL, 0, 0 ) );
+	REQUIRE_RC_FAIL( KCacheTeeFileStartFill( tee, NULL, 0, 0 ) );	// only one filler at a time
+
+	/* reads go on while the filler runs */
+	REQUIRE_RC( compare_file_content( org, tee, 0, DATAFILESIZE ) );
+	REQUIRE_RC( KCacheTeeFileWaitFill( tee ) );
+
+	bool is_complete;
+	REQUIRE_RC( IsCacheTeeComplete( tee, &is_complete ) );
+	REQUIRE( is_complete );
+
+	/* the second pass comes from the cache alone */
+	uint32_t reads = remote_reads( remote );
+	REQUIRE_RC( compare_file_content( org, tee, 0, DATAFILESIZE ) );
+	REQUIRE_EQ( remote_reads( remote ), reads );
+	REQUIRE_RC( KFileRelease( tee ) );
+
+	const KFile * cache;
+	REQUIRE_RC( KDirectoryOpenFileRead( dir, &cache, "%s", CACHEFILE ) ); // promoted
+	REQUIRE_RC( KFileRelease( cache ) );
+
+	REQUIRE_RC( KFileRelease( remote ) );
+	REQUIRE_RC( KFileRelease( org ) );
+	REQUIRE_RC( KDirectoryRelease( dir ) );
+}
+
+TEST_CASE( CacheTee_Fill_Ranges )
+{
+	KOutMsg( "Test: CacheTee_Fill_Ranges\n" );
+	remove_file( CACHEFILE );	// to start with a clean slate on caching...
+	remove_file( CACHEFILE1 );
+
+    KDirectory * dir;
+    REQUIRE_RC( KDirectoryNativeDir( &dir ) );
+
+	const KFile * org;
+    REQUIRE_RC( KDirectoryOpenFileRead( dir, &org, "%s", DATAFILE ) );
+	const KFile * remote;
+	REQUIRE_RC( make_counting_file( &remote, org ) );
+
+	const KCacheTeeRange ranges[] =
+	{
+		{ DATAFILESIZE - 100, 1000 },		// crossing EOF
+		{ 10, 5000 },
+		{ DATAFILESIZE / 2 + 7, 20000 }
+	};
+
+	const KFile * tee;
+	REQUIRE_RC( KDirectoryMakeCacheTee ( dir, &tee, remote, BLOCKSIZE, "%s", CACHEFILE ) );
+	REQUIRE_RC( KCacheTeeFileStartFill( tee, ranges, 3, 0 ) );
+	REQUIRE_RC( KCacheTeeFileWaitFill( tee ) );
+	REQUIRE_RC( KFileRelease( tee ) );
+
+	/* a new instance finds the ranges in the cache-file */
+	REQUIRE_RC( KDirectoryMakeCacheTee ( dir, &tee, remote, BLOCKSIZE, "%s", CACHEFILE ) );
+	uint32_t reads = remote_reads( remote );
+	REQUIRE_RC( compare_file_content( org, tee, DATAFILESIZE - 100, 100 ) );
+	REQUIRE_RC( compare_file_content( org, tee, 10, 5000 ) );
+	REQUIRE_RC( compare_file_content( org, tee, DATAFILESIZE / 2 + 7, 20000 ) );
+	REQUIRE_EQ( remote_reads( remote ), reads );
+
+	bool is_complete;
+	REQUIRE_RC( IsCacheTeeComplete( tee, &is_complete ) );
+	REQUIRE( !is_complete );
+	REQUIRE_RC( KFileRelease( tee ) );
+
+	REQUIRE_RC( KFileRelease( remote ) );
+	REQUIRE_RC( KFileRelease( org ) );
+	REQUIRE_RC( KDirectoryRelease( dir ) );
+}
+
+TEST_CASE( CacheTee_Fill_Bandwidth )
+{
+	KOutMsg( "Test: CacheTee_Fill_Bandwidth\n" );
+	remove_file( CACHEFILE );	// to start with a clean slate on caching...
+	remove_file( CACHEFILE1 );
+
+    KDirectory * dir;
+    REQUIRE_RC( KDirectoryNativeDir( &dir ) );
+
+	const KFile * org;
+    REQUIRE_RC( KDirectoryOpenFileRead( dir, &org, "%s", DATAFILE ) );
+
+	/* 256KB at 1MB per second take at least a quarter second */
+	const KCacheTeeRange range = { 0, 256 * 1024 };
+	const KFile * tee;
+	REQUIRE_RC( KDirectoryMakeCacheTee ( dir, &tee, org, BLOCKSIZE, "%s", CACHEFILE ) );
+	KTimeMs_t start = KTimeMsStamp();
+	REQUIRE_RC( KCacheTeeFileStartFill( tee, &range, 1, 1024 * 1024 ) );
+	REQUIRE_RC( KCacheTeeFileWaitFill( tee ) );
+	REQUIRE_GE( KTimeMsStamp() - start, ( KTimeMs_t ) 240 );
+
+	/* releasing the file stops a slow filler right away */
+	start = KTimeMsStamp();
+	REQUIRE_RC( KCacheTeeFileStartFill( tee, NULL, 0, 1024 ) );
+	REQUIRE_RC( KFileRelease( tee ) );
+	REQUIRE_LT( KTimeMsStamp() - start, ( KTimeMs_t ) 1000 );
+
+	REQUIRE_RC( KFileRelease( org ) );
+	REQUIRE_RC( KDirectoryRelease( dir ) );
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
@@ -29,12 +29,18 @@
 */
 
 #include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 #include <ktst/unit_test.hpp>
 #include <kfs/mmap.h>
 #include <kfs/directory.h>
 #include <kfs/impl.h>
 #include <kfs/tar.h>
+#include <kfs/file.h>
+#include <klib/rc.h>
 
 #include <kfs/ffext.h>
 #include <kfs/ffmagic.h>
@@ -165,6 +171,161 @@ TEST_CASE(Tar_Parse)
     REQUIRE_RC(KDirectoryRelease(dir));
 }                                 
 
+// KFileReadV
+
+struct ReadCountingFile
+{
+    KFile dad;
+    const KFile * inner;
+    uint32_t reads;
+};
+
+static rc_t CC ReadCountingFileDestroy ( KFile * self )
+{
+    ReadCountingFile * cf = ( ReadCountingFile * ) self;
+    KFileRelease ( cf -> inner );
+    free ( cf );
+    return 0;
+}
+static struct KSysFile * CC ReadCountingFileGetSysFile ( const KFile * self, uint64_t * offset )
+{
+    return NULL;
+}
+static rc_t CC ReadCountingFileRandomAccess ( const KFile * self )
+{
+    return 0;
+}
+static rc_t CC ReadCountingFileSize ( const KFile * self, uint64_t * size )
+{
+    return KFileSize ( ( ( const ReadCountingFile * ) self ) -> inner, size );
+}
+static rc_t CC ReadCountingFileSetSize ( KFile * self, uint64_t size )
+{
+    return RC ( rcFS, rcFile, rcUpdating, rcFile, rcReadonly );
+}
+static rc_t CC ReadCountingFileRead ( const KFile * self, uint64_t pos, void * buffer, size_t bsize, size_t * num_read )
+{
+    ReadCountingFile * cf = ( ReadCountingFile * ) self;
+    ++ cf -> reads;
+    return KFileRead ( cf -> inner, pos, buffer, bsize, num_read );
+}
+static rc_t CC ReadCountingFileWrite ( KFile * self, uint64_t pos, const void * buffer, size_t size, size_t * num_writ )
+{
+    return RC ( rcFS, rcFile, rcWriting, rcFile, rcReadonly );
+}
+
+static KFile_vt_v1 vtReadCountingFile =
+{
+    1, 0,
+    ReadCountingFileDestroy,
+    ReadCountingFileGetSysFile,
+    ReadCountingFileRandomAccess,
+    ReadCountingFileSize,
+    ReadCountingFileSetSize,
+    ReadCountingFileRead,
+    ReadCountingFileWrite
+};
+
+class ReadVFixture
+{
+public:
+    static const size_t FileSize = 256 * 1024;
+
+    ReadVFixture ()
+    :   m_wd ( 0 ), m_file ( 0 ), m_fileName ( "readv.file" )
+    {
+        THROW_ON_RC ( KDirectoryNativeDir ( & m_wd ) );
+
+        KFile * file;
+        THROW_ON_RC ( KDirectoryCreateFile ( m_wd, & file, false, 0664, kcmInit, m_fileName ) );
+        for ( size_t i = 0; i < FileSize; ++ i )
+            m_data += ( char ) ( i * 7 + i / 251 );
+        size_t num_writ;
+        THROW_ON_RC ( KFileWriteAll ( file, 0, m_data.data(), FileSize, & num_writ ) );
+        THROW_ON_RC ( KFileRelease ( file ) );
+
+        const KFile * inner;
+        THROW_ON_RC ( KDirectoryOpenFileRead ( m_wd, & inner, m_fileName ) );
+
+        ReadCountingFile * cf = ( ReadCountingFile * ) calloc ( 1, sizeof * cf );
+        if ( cf == 0 )
+            throw logic_error ( "ReadVFixture: calloc failed" );
+        THROW_ON_RC ( KFileInit ( & cf -> dad, ( const KFile_vt * ) & vtReadCountingFile, "ReadCountingFile", m_fileName, true, false ) );
+        cf -> inner = inner;
+        m_file = cf;
+    }
+    ~ReadVFixture ()
+    {
+        KFileRelease ( & m_file -> dad );
+        KDirectoryRemove ( m_wd, true, m_fileName );
+        KDirectoryRelease ( m_wd );
+    }
+
+    KDirectory * m_wd;
+    ReadCountingFile * m_file;
+    const char * m_fileName;
+    string m_data;
+};
+
+FIXTURE_TEST_CASE ( KFileReadV_Merge, ReadVFixture )
+{
+    char buf [ 7 ] [ 4096 ];
+    KFileIOVec vec [ 7 ] =
+    {
+        { 200000, buf [ 0 ], 1000, 0 },                 // far from the rest
+        { 0, buf [ 1 ], 4096, 0 },
+        { 4096, buf [ 2 ], 4096, 0 },                   // adjacent
+        { 6000, buf [ 3 ], 4096, 0 },                   // overlapping
+        { 20000, buf [ 4 ], 100, 0 },                   // small gap
+        { 12345, buf [ 5 ], 0, 0 },                     // empty
+        { FileSize - 1000, buf [ 6 ], 4096, 0 },        // past eof
+    };
+
+    REQUIRE_RC ( KFileReadV ( & m_file -> dad, vec, 7 ) );
+    // three runs, the last taking one more read to find eof
+    REQUIRE_EQ ( ( uint32_t ) 4, m_file -> reads );
+
+    for ( size_t i = 0; i < 7; ++ i )
+    {
+        size_t expected = vec [ i ] . bsize;
+        if ( vec [ i ] . pos + expected > FileSize )
+            expected = FileSize - vec [ i ] . pos;
+        REQUIRE_EQ ( expected, vec [ i ] . num_read );
+        REQUIRE_EQ ( m_data.substr ( vec [ i ] . pos, expected ), string ( buf [ i ], vec [ i ] . num_read ) );
+    }
+}
+
+FIXTURE_TEST_CASE ( KFileReadV_Many, ReadVFixture )
+{   // more requests than fit on the stack, in reverse order
+    const uint32_t Count = 100;
+    std :: vector < char > buf ( Count * 64 );
+    std :: vector < KFileIOVec > vec ( Count );
+    for ( uint32_t i = 0; i < Count; ++ i )
+    {
+        vec [ i ] . pos = ( Count - 1 - i ) * 2000;
+        vec [ i ] . buffer = & buf [ i * 64 ];
+        vec [ i ] . bsize = 64;
+    }
+
+    REQUIRE_RC ( KFileReadV ( & m_file -> dad, & vec [ 0 ], Count ) );
+    REQUIRE_EQ ( ( uint32_t ) 1, m_file -> reads );
+    for ( uint32_t i = 0; i < Count; ++ i )
+    {
+        REQUIRE_EQ ( ( size_t ) 64, vec [ i ] . num_read );
+        REQUIRE_EQ ( m_data.substr ( vec [ i ] . pos, 64 ), string ( & buf [ i * 64 ], 64 ) );
+    }
+}
+
+TEST_CASE ( KFileReadV_Params )
+{
+    char buf [ 16 ];
+    KFileIOVec vec = { 0, buf, sizeof buf, 1 };
+    REQUIRE_RC_FAIL ( KFileReadV ( NULL, & vec, 1 ) );
+    REQUIRE_EQ ( ( size_t ) 0, vec . num_read );
+    REQUIRE_RC_FAIL ( KFileReadV ( NULL, NULL, 1 ) );
+    REQUIRE_RC ( KFileReadV ( NULL, NULL, 0 ) );
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
@@ -0,0 +1,198 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/*
+ * measures Pack and Unpack throughput for each element size,
+ * with and without the vector kernels. run by hand.
+ */
+
+#include <kapp/main.h>
+#include <kapp/args.h>
+#include <klib/pack.h>
+#include <klib/klib-priv.h>
+#include <klib/time.h>
+#include <klib/out.h>
+#include <klib/rc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_COUNT ( 1024 * 1024 )
+#define BENCH_MS 200
+
+/* unpacked bytes handled per second, in GB */
+static
+double bench_rate ( uint64_t bytes, KTimeMs_t ms )
+{
+    return ms == 0 ? 0.0 : ( double ) bytes / ( ( double ) ms * 1e6 );
+}
+
+static
+rc_t bench_one ( uint32_t unpacked, uint32_t packed,
+    uint8_t *orig, uint8_t *pbuf, uint8_t *ubuf, double *pack_rate, double *unpack_rate )
+{
+    rc_t rc = 0;
+    size_t ssize = ( size_t ) BENCH_COUNT * unpacked / 8;
+    uint64_t bytes;
+    KTimeMs_t start, elapsed;
+    bitsz_t psize = 0;
+    size_t usize;
+
+    for ( bytes = 0, start = KTimeMsStamp (), elapsed = 0; rc == 0 && elapsed < BENCH_MS; bytes += ssize )
+    {
+        rc = Pack ( unpacked, packed, orig, ssize, NULL, pbuf, 0, ( bitsz_t ) ssize * 8, & psize );
+        elapsed = KTimeMsStamp () - start;
+    }
+    * pack_rate = bench_rate ( bytes, elapsed );
+
+    for ( bytes = 0, start = KTimeMsStamp (), elapsed = 0; rc == 0 && elapsed < BENCH_MS; bytes += ssize )
+    {
+        rc = Unpack ( packed, unpacked, pbuf, 0, psize, NULL, ubuf, ssize, & usize );
+        elapsed = KTimeMsStamp () - start;
+    }
+    * unpack_rate = bench_rate ( bytes, elapsed );
+
+    if ( rc == 0 && memcmp ( orig, ubuf, ssize ) != 0 )
+        rc = RC ( rcExe, rcBuffer, rcValidating, rcData, rcCorrupt );
+
+    return rc;
+}
+
+static
+void fill ( uint32_t unpacked, uint32_t packed, uint8_t *buf )
+{
+    uint32_t i;
+    uint64_t mask = ( ( uint64_t ) 1 << packed ) - 1;
+    for ( i = 0; i < BENCH_COUNT; ++ i )
+    {
+        uint64_t v = ( uint64_t ) rand () & mask;
+        switch ( unpacked )
+        {
+        case 8:
+            buf [ i ] = ( uint8_t ) v;
+            break;
+        case 16:
+            ( ( uint16_t* ) buf ) [ i ] = ( uint16_t ) v;
+            break;
+        case 32:
+            ( ( uint32_t* ) buf ) [ i ] = ( uint32_t ) v;
+            break;
+        }
+    }
+}
+
+static
+rc_t run_bench ( void )
+{
+    rc_t rc = 0;
+    uint32_t unpacked, packed;
+
+    uint8_t *orig = malloc ( BENCH_COUNT * 4 );
+    uint8_t *pbuf = malloc ( BENCH_COUNT * 4 );
+    uint8_t *ubuf = malloc ( BENCH_COUNT * 4 );
+    if ( orig == NULL || pbuf == NULL || ubuf == NULL )
+        rc = RC ( rcExe, rcBuffer, rcAllocating, rcMemory, rcExhausted );
+
+    if ( rc == 0 )
+    {
+        rc = KOutMsg ( "%8s %6s %14s %14s %14s %14s\n", "unpacked", "packed",
+            "pack GB/s", "pack vec GB/s", "unpack GB/s", "unpack vec GB/s" );
+    }
+
+    for ( unpacked = 8; rc == 0 && unpacked <= 32; unpacked *= 2 )
+    {
+        for ( packed = 1; rc == 0 && packed < unpacked && packed <= 16; ++ packed )
+        {
+            double pack_scalar, unpack_scalar, pack_vec, unpack_vec;
+
+            fill ( unpacked, packed, orig );
+
+            PackDisableVector ( true );
+            rc = bench_one ( unpacked, packed, orig, pbuf, ubuf, & pack_scalar, & unpack_scalar );
+            PackDisableVector ( false );
+            if ( rc == 0 )
+                rc = bench_one ( unpacked, packed, orig, pbuf, ubuf, & pack_vec, & unpack_vec );
+            if ( rc == 0 )
+            {
+                rc = KOutMsg ( "%8u %6u %14.2f %14.2f %14.2f %14.2f\n", unpacked, packed,
+                    pack_scalar, pack_vec, unpack_scalar, unpack_vec );
+            }
+        }
+    }
+
+    free ( ubuf );
+    free ( pbuf );
+    free ( orig );
+    return rc;
+}
+
+ver_t CC KAppVersion ( void )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-pack-bench";
+
+rc_t CC UsageSummary ( const char * name )
+{
+    return KOutMsg (
+        "Usage:\n"
+        " %s\n"
+        "\n"
+        "    report Pack and Unpack throughput in GB/s of unpacked data\n"
+        "\n", name );
+}
+
+rc_t CC Usage ( const Args * args )
+{
+    const char * progname = UsageDefaultName;
+    const char * fullpath = UsageDefaultName;
+    rc_t rc;
+
+    if ( args == NULL )
+        rc = RC ( rcApp, rcArgv, rcAccessing, rcSelf, rcNull );
+    else
+        rc = ArgsProgram ( args, & fullpath, & progname );
+    UsageSummary ( progname );
+
+    KOutMsg ( "Options:\n" );
+
+    HelpOptionsStandard ();
+
+    return rc;
+}
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    Args * args;
+    rc_t rc = ArgsMakeAndHandle ( & args, argc, argv, 0 );
+    if ( rc == 0 )
+    {
+        rc = run_bench ();
+        ArgsWhack ( args );
+    }
+    return rc;
+}
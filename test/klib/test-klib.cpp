@@ -37,6 +37,8 @@
 #include <klib/num-gen.h>
 #include <klib/text.h>
 #include <klib/misc.h> /* is_user_admin() */
+#include <klib/pack.h>
+#include <klib/klib-priv.h>
 
 #include <cstdlib>
 #include <cstring>
@@ -731,6 +733,117 @@ TEST_CASE(KDataBuffer_Cast_W32Assert)
     KDataBufferWhack ( & src );
 }
 
+//////////////////////////////////////////// Pack/Unpack
+
+// straightforward big-bit-endian reference
+static void RefPack ( uint32_t unpacked, uint32_t packed, const void * src, uint32_t count, uint8_t * dst )
+{
+    memset ( dst, 0, ( ( size_t ) count * packed + 7 ) / 8 );
+    for ( uint32_t i = 0; i < count; ++ i )
+    {
+        uint64_t v;
+        switch ( unpacked )
+        {
+        case 8:  v = ( ( const uint8_t * ) src ) [ i ]; break;
+        case 16: v = ( ( const uint16_t * ) src ) [ i ]; break;
+        case 32: v = ( ( const uint32_t * ) src ) [ i ]; break;
+        default: v = ( ( const uint64_t * ) src ) [ i ]; break;
+        }
+        for ( uint32_t b = 0; b < packed; ++ b )
+        {
+            uint64_t bit = ( uint64_t ) i * packed + b;
+            if ( ( v >> ( packed - 1 - b ) ) & 1 )
+                dst [ bit >> 3 ] |= ( uint8_t ) ( 0x80 >> ( bit & 7 ) );
+        }
+    }
+}
+
+static void FillPackable ( uint32_t unpacked, uint32_t packed, void * buf, uint32_t count )
+{
+    uint64_t mask = packed == 64 ? ~ ( uint64_t ) 0 : ( ( uint64_t ) 1 << packed ) - 1;
+    for ( uint32_t i = 0; i < count; ++ i )
+    {
+        uint64_t v = ( ( uint64_t ) rand () << 32 ^ ( uint64_t ) rand () << 16 ^ rand () ) & mask;
+        switch ( unpacked )
+        {
+        case 8:  ( ( uint8_t * ) buf ) [ i ] = ( uint8_t ) v; break;
+        case 16: ( ( uint16_t * ) buf ) [ i ] = ( uint16_t ) v; break;
+        case 32: ( ( uint32_t * ) buf ) [ i ] = ( uint32_t ) v; break;
+        default: ( ( uint64_t * ) buf ) [ i ] = v; break;
+        }
+    }
+}
+
+TEST_CASE(KLib_PackUnpack_vs_reference)
+{
+    const uint32_t counts [] = { 1, 7, 63, 64, 65, 200, 1003, 4096 };
+    const uint32_t MaxCount = 4096;
+    uint64_t orig [ MaxCount ], unpacked_buf [ MaxCount ];
+    uint8_t ref [ MaxCount * 8 ], packed_buf [ MaxCount * 8 ];
+
+    srand ( 12345 );
+    for ( uint32_t unpacked = 8; unpacked <= 32; unpacked *= 2 )
+    {
+        for ( uint32_t packed = 1; packed < unpacked; ++ packed )
+        {
+            for ( size_t c = 0; c < sizeof counts / sizeof counts [ 0 ]; ++ c )
+            {
+                uint32_t count = counts [ c ];
+                size_t ssize = ( size_t ) count * unpacked / 8;
+                size_t pbytes = ( ( size_t ) count * packed + 7 ) / 8;
+                bitsz_t psize;
+                size_t usize;
+
+                FillPackable ( unpacked, packed, orig, count );
+                RefPack ( unpacked, packed, orig, count, ref );
+
+                memset ( packed_buf, 0, pbytes );
+                REQUIRE_RC ( Pack ( unpacked, packed, orig, ssize, NULL, packed_buf, 0, sizeof packed_buf * 8, & psize ) );
+                REQUIRE_EQ ( psize, ( bitsz_t ) count * packed );
+                REQUIRE_EQ ( memcmp ( packed_buf, ref, pbytes ), 0 );
+
+                REQUIRE_RC ( Unpack ( packed, unpacked, ref, 0, psize, NULL, unpacked_buf, sizeof unpacked_buf, & usize ) );
+                REQUIRE_EQ ( usize, ssize );
+                REQUIRE_EQ ( memcmp ( unpacked_buf, orig, ssize ), 0 );
+
+                /* in place */
+                memcpy ( unpacked_buf, ref, pbytes );
+                REQUIRE_RC ( Unpack ( packed, unpacked, unpacked_buf, 0, psize, NULL, unpacked_buf, sizeof unpacked_buf, & usize ) );
+                REQUIRE_EQ ( memcmp ( unpacked_buf, orig, ssize ), 0 );
+            }
+        }
+    }
+}
+
+TEST_CASE(KLib_PackUnpack_vector_vs_scalar)
+{
+    const uint32_t Count = 3001;
+    uint64_t orig [ Count ], vec [ Count ], scalar [ Count ];
+    uint8_t packed_buf [ Count * 8 ];
+
+    srand ( 54321 );
+    for ( uint32_t unpacked = 8; unpacked <= 32; unpacked *= 2 )
+    {
+        for ( uint32_t packed = 1; packed < unpacked && packed < 16; ++ packed )
+        {
+            bitsz_t psize;
+            size_t usize;
+
+            FillPackable ( unpacked, packed, orig, Count );
+            REQUIRE_RC ( Pack ( unpacked, packed, orig, ( size_t ) Count * unpacked / 8, NULL,
+                packed_buf, 0, sizeof packed_buf * 8, & psize ) );
+
+            PackDisableVector ( true );
+            REQUIRE_RC ( Unpack ( packed, unpacked, packed_buf, 0, psize, NULL, scalar, sizeof scalar, & usize ) );
+            PackDisableVector ( false );
+            REQUIRE_RC ( Unpack ( packed, unpacked, packed_buf, 0, psize, NULL, vec, sizeof vec, & usize ) );
+
+            REQUIRE_EQ ( memcmp ( vec, scalar, usize ), 0 );
+            REQUIRE_EQ ( memcmp ( vec, orig, usize ), 0 );
+        }
+    }
+}
+
 //////////////////////////////////////////// Log
 TEST_CASE(KLog_Formatting)
 {
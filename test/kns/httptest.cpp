@@ -39,6 +39,9 @@
 #include <kns/manager.h>
 #include <kns/kns-mgr-priv.h>
 #include <kns/http.h>
+#include <kns/endpoint.h>
+#include <kns/socket.h>
+#include <kns/stream.h>
 
 #include <../libs/kns/mgr-priv.h>
 #include <../libs/kns/http-priv.h>
@@ -48,12 +51,15 @@
 #include <kfs/defs.h>
 
 #include <kproc/thread.h>
+#include <kproc/lock.h>
 
 #include <sysalloc.h>
 #include <stdexcept>
 #include <cstring>
 #include <list>
+#include <vector>
 #include <sstream>
+#include <unistd.h> // getpid
 
 static rc_t argsHandler ( int argc, char * argv [] );
 TEST_SUITE_WITH_ARGS_HANDLER ( HttpTestSuite, argsHandler );
@@ -780,6 +786,330 @@ FIXTURE_TEST_CASE(HttpReliableRequest_POST_5xx_retry, HttpFixture)
 
 #endif
 
+//////////////////////////
+// Parallel range reads, against a local HTTP server
+
+// serves HEAD and ranged GET of one document,
+// with a thread per connection and keep-alive
+class RangeServer
+{
+public:
+    RangeServer ( KNSManager * mgr, const string & content )
+    : m_mgr ( mgr ), m_content ( content ), m_listener ( 0 ), m_accept ( 0 ), m_lock ( 0 ),
+      m_quit ( false ), m_connections ( 0 ), m_gets ( 0 ), m_port ( 0 ),
+      m_pool_per_host ( 0 ), m_pool_idle_ms ( 0 ), m_fail_from ( string::npos )
+    {
+        if ( KLockMake ( & m_lock ) != 0 )
+            throw logic_error ( "RangeServer: KLockMake failed" );
+        if ( KNSManagerGetHTTPConnectionPool ( m_mgr, & m_pool_per_host, & m_pool_idle_ms ) != 0 )
+            throw logic_error ( "RangeServer: KNSManagerGetHTTPConnectionPool failed" );
+
+        // find a free port
+        for ( uint16_t port = 20000 + getpid () % 20000, tries = 0; tries < 100; ++ port, ++ tries )
+        {
+            if ( KNSManagerInitIPv4Endpoint ( m_mgr, & m_ep, 0x7F000001, port ) == 0 &&
+                 KNSManagerMakeListener ( m_mgr, & m_listener, & m_ep ) == 0 )
+            {
+                m_port = port;
+                break;
+            }
+        }
+        if ( m_listener == 0 )
+            throw logic_error ( "RangeServer: KNSManagerMakeListener failed" );
+
+        if ( KThreadMake ( & m_accept, AcceptThread, this ) != 0 )
+            throw logic_error ( "RangeServer: KThreadMake failed" );
+    }
+
+    ~RangeServer ()
+    {
+        // connections parked in the manager's pool keep their threads alive
+        KNSManagerSetHTTPConnectionPool ( m_mgr, 0, 0 );
+        KNSManagerSetHTTPConnectionPool ( m_mgr, m_pool_per_host, m_pool_idle_ms );
+
+        // wake up the accepting thread
+        m_quit = true;
+        KSocket * conn;
+        if ( KNSManagerMakeConnection ( m_mgr, & conn, NULL, & m_ep ) == 0 )
+            KSocketRelease ( conn );
+        KThreadWait ( m_accept, NULL );
+        KThreadRelease ( m_accept );
+
+        for ( size_t i = 0; i < m_threads . size (); ++ i )
+        {
+            KThreadWait ( m_threads [ i ], NULL );
+            KThreadRelease ( m_threads [ i ] );
+        }
+        KListenerRelease ( m_listener );
+        KLockRelease ( m_lock );
+    }
+
+    string URL () const
+    {
+        ostringstream url;
+        url << "http://127.0.0.1:" << m_port << "/content";
+        return url . str ();
+    }
+
+    int Connections () const { return m_connections; }
+    int Gets () const { return m_gets; }
+
+    // drop the connection on any range starting at or after "offset"
+    void FailFrom ( size_t offset ) { m_fail_from = offset; }
+
+private:
+    struct Connection
+    {
+        RangeServer * server;
+        KSocket * socket;
+    };
+
+    static rc_t CC AcceptThread ( const KThread *self, void *data )
+    {
+        RangeServer * server = ( RangeServer * ) data;
+        while ( true )
+        {
+            KSocket * socket;
+            rc_t rc = KListenerAccept ( server -> m_listener, & socket );
+            if ( rc != 0 )
+                return rc;
+            if ( server -> m_quit )
+            {
+                KSocketRelease ( socket );
+                return 0;
+            }
+
+            Connection * c = new Connection;
+            c -> server = server;
+            c -> socket = socket;
+            KThread * t;
+            if ( KThreadMake ( & t, ConnectionThread, c ) != 0 )
+            {
+                KSocketRelease ( socket );
+                delete c;
+                continue;
+            }
+            server -> m_threads . push_back ( t );
+        }
+    }
+
+    static rc_t CC ConnectionThread ( const KThread *self, void *data )
+    {
+        Connection * c = ( Connection * ) data;
+        RangeServer * server = c -> server;
+        KStream * stream;
+        rc_t rc = KSocketGetStream ( c -> socket, & stream );
+        if ( rc == 0 )
+        {
+            server -> Count ( server -> m_connections );
+
+            string in;
+            while ( rc == 0 )
+            {
+                size_t end = in . find ( "\r\n\r\n" );
+                if ( end == string::npos )
+                {
+                    char buf [ 4096 ];
+                    size_t num_read;
+                    rc = KStreamRead ( stream, buf, sizeof buf, & num_read );
+                    if ( rc != 0 || num_read == 0 )
+                        break;
+                    in . append ( buf, num_read );
+                    continue;
+                }
+
+                string request = in . substr ( 0, end );
+                in . erase ( 0, end + 4 );
+                rc = server -> Respond ( stream, request );
+            }
+            KStreamRelease ( stream );
+        }
+        KSocketRelease ( c -> socket );
+        delete c;
+        return 0;
+    }
+
+    rc_t Respond ( KStream * stream, const string & request )
+    {
+        ostringstream out;
+        string body;
+        if ( request . compare ( 0, 5, "HEAD " ) == 0 )
+        {
+            out << "HTTP/1.1 200 OK\r\n"
+                   "Accept-Ranges: bytes\r\n"
+                   "Content-Length: " << m_content . size () << "\r\n\r\n";
+        }
+        else
+        {
+            size_t first = 0, last = m_content . size () - 1;
+            size_t range = request . find ( "Range: bytes=" );
+            if ( range != string::npos )
+                sscanf ( request . c_str () + range, "Range: bytes=%zu-%zu", & first, & last );
+            if ( first >= m_fail_from )
+                return RC ( rcNS, rcFile, rcReading, rcTransfer, rcIncomplete );
+            body = m_content . substr ( first, last + 1 - first );
+            Count ( m_gets );
+
+            out << "HTTP/1.1 206 Partial Content\r\n"
+                   "Accept-Ranges: bytes\r\n"
+                   "Content-Range: bytes " << first << "-" << last << "/" << m_content . size () << "\r\n"
+                   "Content-Length: " << body . size () << "\r\n\r\n";
+        }
+
+        string response = out . str () + body;
+        size_t num_writ;
+        return KStreamWriteAll ( stream, response . data (), response . size (), & num_writ );
+    }
+
+    void Count ( int & counter )
+    {
+        KLockAcquire ( m_lock );
+        ++ counter;
+        KLockUnlock ( m_lock );
+    }
+
+    KNSManager * m_mgr;
+    string m_content;
+    KEndPoint m_ep;
+    KListener * m_listener;
+    KThread * m_accept;
+    vector < KThread * > m_threads;
+    KLock * m_lock;
+    volatile bool m_quit;
+    int m_connections;
+    int m_gets;
+    uint16_t m_port;
+    uint32_t m_pool_per_host;
+    uint32_t m_pool_idle_ms;
+    volatile size_t m_fail_from;
+};
+
+static string MakeContent ( size_t size )
+{
+    string content ( size, 0 );
+    for ( size_t i = 0; i < size; ++ i )
+        content [ i ] = ( char ) ( ( i * 7919 ) >> 8 );
+    return content;
+}
+
+FIXTURE_TEST_CASE(HttpFile_ParallelRead, HttpFixture)
+{
+    const string content = MakeContent ( 8 * 1024 * 1024 + 12345 );
+    REQUIRE_RC ( KNSManagerSetHTTPProxyPath ( m_mgr, NULL ) );
+    REQUIRE_RC ( KNSManagerSetHTTPReadStreams ( m_mgr, 4 ) );
+    {
+        RangeServer server ( m_mgr, content );
+        REQUIRE_RC ( KNSManagerMakeHttpFile ( m_mgr, ( const KFile** ) & m_file, NULL, 0x01010000, server . URL () . c_str () ) );
+
+        // whole file, and an unaligned range running past the end
+        vector < char > buf ( content . size () + 100 );
+        size_t num_read = 0;
+        REQUIRE_RC ( KFileRead ( m_file, 0, & buf [ 0 ], buf . size (), & num_read ) );
+        REQUIRE_EQ ( content . size (), num_read );
+        REQUIRE ( memcmp ( & buf [ 0 ], content . data (), num_read ) == 0 );
+
+        REQUIRE_RC ( KFileRead ( m_file, 1001, & buf [ 0 ], buf . size (), & num_read ) );
+        REQUIRE_EQ ( content . size () - 1001, num_read );
+        REQUIRE ( memcmp ( & buf [ 0 ], content . data () + 1001, num_read ) == 0 );
+
+        // small reads stay on one connection
+        REQUIRE_RC ( KFileRead ( m_file, 77, & buf [ 0 ], 1000, & num_read ) );
+        REQUIRE_EQ ( ( size_t ) 1000, num_read );
+        REQUIRE ( memcmp ( & buf [ 0 ], content . data () + 77, num_read ) == 0 );
+
+        REQUIRE_RC ( KFileRelease ( m_file ) );
+        m_file = 0;
+
+        REQUIRE_GT ( server . Connections (), 1 );
+        REQUIRE_GT ( server . Gets (), 3 );
+    }
+}
+
+FIXTURE_TEST_CASE(HttpFile_ParallelReadPartial, HttpFixture)
+{
+    const string content = MakeContent ( 8 * 1024 * 1024 );
+    const size_t fail_from = 3 * 1024 * 1024 + 17;
+    REQUIRE_RC ( KNSManagerSetHTTPProxyPath ( m_mgr, NULL ) );
+    REQUIRE_RC ( KNSManagerSetHTTPReadStreams ( m_mgr, 4 ) );
+    {
+        RangeServer server ( m_mgr, content );
+        REQUIRE_RC ( KNSManagerMakeHttpFile ( m_mgr, ( const KFile** ) & m_file, NULL, 0x01010000, server . URL () . c_str () ) );
+        server . FailFrom ( fail_from );
+
+        // the ranges that arrived before the failing one are returned
+        vector < char > buf ( content . size () );
+        size_t num_read = 0;
+        REQUIRE_RC ( KFileRead ( m_file, 0, & buf [ 0 ], buf . size (), & num_read ) );
+        REQUIRE_GE ( num_read, fail_from );
+        REQUIRE_LT ( num_read, content . size () );
+        REQUIRE ( memcmp ( & buf [ 0 ], content . data (), num_read ) == 0 );
+
+        // and the next read reports the error
+        REQUIRE_RC_FAIL ( KFileRead ( m_file, num_read, & buf [ 0 ], buf . size () - num_read, & num_read ) );
+
+        REQUIRE_RC ( KFileRelease ( m_file ) );
+        m_file = 0;
+    }
+}
+
+FIXTURE_TEST_CASE(HttpFile_SingleStreamRead, HttpFixture)
+{
+    const string content = MakeContent ( 3 * 1024 * 1024 );
+    REQUIRE_RC ( KNSManagerSetHTTPProxyPath ( m_mgr, NULL ) );
+    REQUIRE_RC ( KNSManagerSetHTTPReadStreams ( m_mgr, 1 ) );
+    {
+        RangeServer server ( m_mgr, content );
+        REQUIRE_RC ( KNSManagerMakeHttpFile ( m_mgr, ( const KFile** ) & m_file, NULL, 0x01010000, server . URL () . c_str () ) );
+
+        vector < char > buf ( content . size () );
+        size_t num_read = 0;
+        REQUIRE_RC ( KFileRead ( m_file, 0, & buf [ 0 ], buf . size (), & num_read ) );
+        REQUIRE_EQ ( content . size (), num_read );
+        REQUIRE ( memcmp ( & buf [ 0 ], content . data (), num_read ) == 0 );
+
+        REQUIRE_RC ( KFileRelease ( m_file ) );
+        m_file = 0;
+
+        REQUIRE_EQ ( 1, server . Connections () );
+    }
+}
+
+FIXTURE_TEST_CASE(HttpFile_ReuseConnection, HttpFixture)
+{
+    const string content = MakeContent ( 100 * 1024 );
+    REQUIRE_RC ( KNSManagerSetHTTPProxyPath ( m_mgr, NULL ) );
+    REQUIRE_RC ( KNSManagerSetHTTPReadStreams ( m_mgr, 1 ) );
+    {
+        RangeServer server ( m_mgr, content );
+        vector < char > buf ( content . size () );
+
+        // successive files on the same server share the connection
+        for ( int i = 0; i < 3; ++ i )
+        {
+            REQUIRE_RC ( KNSManagerMakeHttpFile ( m_mgr, ( const KFile** ) & m_file, NULL, 0x01010000, server . URL () . c_str () ) );
+
+            size_t num_read = 0;
+            REQUIRE_RC ( KFileRead ( m_file, i, & buf [ 0 ], buf . size (), & num_read ) );
+            REQUIRE_EQ ( content . size () - i, num_read );
+            REQUIRE ( memcmp ( & buf [ 0 ], content . data () + i, num_read ) == 0 );
+
+            REQUIRE_RC ( KFileRelease ( m_file ) );
+            m_file = 0;
+        }
+        REQUIRE_EQ ( 1, server . Connections () );
+
+        // without the pool every file connects again
+        REQUIRE_RC ( KNSManagerSetHTTPConnectionPool ( m_mgr, 0, 0 ) );
+        for ( int i = 0; i < 2; ++ i )
+        {
+            REQUIRE_RC ( KNSManagerMakeHttpFile ( m_mgr, ( const KFile** ) & m_file, NULL, 0x01010000, server . URL () . c_str () ) );
+            REQUIRE_RC ( KFileRelease ( m_file ) );
+            m_file = 0;
+        }
+        REQUIRE_EQ ( 3, server . Connections () );
+    }
+}
+
 /* VDB-3059: KHttpRequestPOST generates incorrect Content-Length after retry :
  it makes web server to return 400 Bad Request */
 TEST_CASE(ContentLength) {
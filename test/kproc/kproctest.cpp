@@ -42,6 +42,8 @@
 #include <kproc/thread.h>
 #include <kproc/timeout.h>
 #include <kproc/queue.h>
+#include <kproc/threadpool.h>
+#include <kproc/impl.h>
 
 #include <stdexcept>
 #include <sstream>
@@ -950,6 +952,408 @@ FIXTURE_TEST_CASE(KQueue_Single_Reader_Multi_Writer_Seal, KQueueFixture)
     REQUIRE_LT ( (int)(timeAfter - timeBefore), timeoutMs );
 }
 
+///////////////////////// lock-free KQueue
+TEST_CASE( KQueueLockFree_NULL )
+{
+    REQUIRE_RC_FAIL(KQueueMakeLockFree(NULL, 1));
+}
+
+TEST_CASE(KQueueLockFree_Simple)
+{
+    KQueue * queue = NULL;
+    REQUIRE_RC(KQueueMakeLockFree(&queue, 2));
+
+    void *item = NULL;
+    for (int round = 0; round < 3; ++round)
+    {   // pushed 2 = capacity (ok), 3rd fails; popped 2 (ok), 3rd fails
+        for (uint64_t i = 1; i < 3; ++i)
+            REQUIRE_RC(KQueuePush(queue, (void*)i, NULL));
+        REQUIRE_RC_FAIL(KQueuePush(queue, (void*)3, NULL));
+        for (uint64_t i = 1; i < 3; ++i) {
+            REQUIRE_RC(KQueuePop(queue, &item, NULL));
+            REQUIRE_EQ(i, (uint64_t)item);
+        }
+        REQUIRE_RC_FAIL(KQueuePop(queue, &item, NULL));
+    }
+
+    // sealed: no more pushes, but what is queued can still be popped
+    REQUIRE_RC(KQueuePush(queue, (void*)1, NULL));
+    REQUIRE_RC(KQueueSeal(queue));
+    REQUIRE(KQueueSealed(queue));
+    REQUIRE_RC_FAIL(KQueuePush(queue, (void*)2, NULL));
+    REQUIRE_RC(KQueuePop(queue, &item, NULL));
+    REQUIRE_EQ((uint64_t)1, (uint64_t)item);
+    rc_t rc = KQueuePop(queue, &item, NULL);
+    REQUIRE_EQ(rc, RC ( rcCont, rcQueue, rcRemoving, rcData, rcDone ));
+
+    REQUIRE_RC(KQueueRelease(queue));
+}
+
+class KQueueLockFreeFixture : public KQueueFixture
+{
+public:
+    KQueueLockFreeFixture()
+    {
+        if (KQueueRelease(queue) != 0 || KQueueMakeLockFree(&queue, nThreads) != 0)
+            throw logic_error("KQueueLockFreeFixture: KQueueMakeLockFree failed");
+    }
+};
+
+FIXTURE_TEST_CASE(KQueueLockFree_Single_Reader_Single_Writer, KQueueLockFreeFixture)
+{
+    StartThreads(1, 1);
+    WaitThreads();
+}
+
+FIXTURE_TEST_CASE(KQueueLockFree_Multi_Reader_Multi_Writer, KQueueLockFreeFixture)
+{
+    StartThreads(16, 16, false, 5000);
+    WaitThreads();
+}
+
+FIXTURE_TEST_CASE(KQueueLockFree_Multi_Reader_Single_Writer_Seal, KQueueLockFreeFixture)
+{
+    KTimeMs_t timeBefore = KTimeMsStamp();
+    const int numReaders = 31;
+    const int timeoutMs = 5000;
+    StartThreads(numReaders, 1, false, timeoutMs);
+    threadsData[numReaders].finish = true;
+    WaitThreads(false);
+    KTimeMs_t timeAfter = KTimeMsStamp();
+    for (unsigned i = 0; i < nStartedThreads; ++i)
+    {
+        rc_t expectedRc = (i == numReaders) ? 0 : SILENT_RC ( rcCont, rcQueue, rcRemoving, rcData, rcDone );
+        REQUIRE_EQ ( threadRcs[i], expectedRc );
+    }
+    REQUIRE_LT ( (int)(timeAfter - timeBefore), timeoutMs );
+}
+
+FIXTURE_TEST_CASE(KQueueLockFree_Single_Reader_Multi_Writer_Seal, KQueueLockFreeFixture)
+{
+    KTimeMs_t timeBefore = KTimeMsStamp();
+    const int numWriters = 31;
+    const int timeoutMs = 5000;
+    StartThreads(1, numWriters, false, timeoutMs);
+    threadsData[0].finish = true;
+    WaitThreads(false);
+    KTimeMs_t timeAfter = KTimeMsStamp();
+    for (unsigned i = 0; i < nStartedThreads; ++i)
+    {
+        rc_t expectedRc = (i == 0) ? 0 : SILENT_RC ( rcCont, rcQueue, rcInserting, rcQueue, rcReadonly );
+        REQUIRE_EQ ( threadRcs[i], expectedRc );
+    }
+    REQUIRE_LT ( (int)(timeAfter - timeBefore), timeoutMs );
+}
+
+// every producer pushes 1..N in batches, consumers pop in batches until sealed
+struct BatchData
+{
+    KQueue * queue;
+    uint64_t sum;
+    uint64_t count;
+};
+
+static const uint64_t BatchItems = 100000;
+
+static rc_t CC BatchProducer ( const KThread *self, void *data )
+{
+    BatchData * d = ( BatchData * ) data;
+    const void * items [ 16 ];
+    uint64_t next = 1;
+    while ( next <= BatchItems )
+    {
+        uint32_t n = 0;
+        for ( ; n < 16 && next + n <= BatchItems; ++ n )
+            items [ n ] = ( const void * ) ( next + n );
+
+        timeout_t tm;
+        TimeoutInit ( & tm, 5000 );
+        uint32_t pushed;
+        rc_t rc = KQueuePushBatch ( d -> queue, items, n, & pushed, & tm );
+        if ( rc != 0 )
+            return rc;
+        next += pushed;
+    }
+    return 0;
+}
+
+static rc_t CC BatchConsumer ( const KThread *self, void *data )
+{
+    BatchData * d = ( BatchData * ) data;
+    while ( true )
+    {
+        void * items [ 16 ];
+        uint32_t popped;
+        timeout_t tm;
+        TimeoutInit ( & tm, 5000 );
+        rc_t rc = KQueuePopBatch ( d -> queue, items, 16, & popped, & tm );
+        if ( rc != 0 )
+            return GetRCState ( rc ) == rcDone ? 0 : rc;
+        for ( uint32_t i = 0; i < popped; ++ i )
+            d -> sum += ( uint64_t ) items [ i ];
+        d -> count += popped;
+    }
+}
+
+static void RunBatches ( KQueue * queue, uint64_t & sum, uint64_t & count )
+{
+    const int Producers = 4, Consumers = 4;
+    BatchData pd [ Producers ], cd [ Consumers ];
+    KThread * pt [ Producers ], * ct [ Consumers ];
+    for ( int i = 0; i < Consumers; ++ i )
+    {
+        cd [ i ] . queue = queue;
+        cd [ i ] . sum = cd [ i ] . count = 0;
+        if ( KThreadMake ( & ct [ i ], BatchConsumer, & cd [ i ] ) != 0 )
+            throw logic_error ( "RunBatches: KThreadMake failed" );
+    }
+    for ( int i = 0; i < Producers; ++ i )
+    {
+        pd [ i ] . queue = queue;
+        if ( KThreadMake ( & pt [ i ], BatchProducer, & pd [ i ] ) != 0 )
+            throw logic_error ( "RunBatches: KThreadMake failed" );
+    }
+    rc_t status, failed = 0;
+    for ( int i = 0; i < Producers; ++ i )
+    {
+        KThreadWait ( pt [ i ], & status );
+        KThreadRelease ( pt [ i ] );
+        if ( status != 0 )
+            failed = status;
+    }
+    KQueueSeal ( queue );
+    sum = count = 0;
+    for ( int i = 0; i < Consumers; ++ i )
+    {
+        KThreadWait ( ct [ i ], & status );
+        KThreadRelease ( ct [ i ] );
+        if ( status != 0 )
+            failed = status;
+        sum += cd [ i ] . sum;
+        count += cd [ i ] . count;
+    }
+    if ( failed != 0 )
+        throw logic_error ( "RunBatches: thread failed" );
+}
+
+TEST_CASE( KQueue_Batches )
+{
+    KQueue * queue;
+    REQUIRE_RC ( KQueueMake ( & queue, 64 ) );
+    uint64_t sum, count;
+    RunBatches ( queue, sum, count );
+    REQUIRE_EQ ( 4 * BatchItems, count );
+    REQUIRE_EQ ( 4 * BatchItems * ( BatchItems + 1 ) / 2, sum );
+    REQUIRE_RC ( KQueueRelease ( queue ) );
+}
+
+TEST_CASE( KQueueLockFree_Batches )
+{
+    KQueue * queue;
+    REQUIRE_RC ( KQueueMakeLockFree ( & queue, 64 ) );
+    uint64_t sum, count;
+    RunBatches ( queue, sum, count );
+    REQUIRE_EQ ( 4 * BatchItems, count );
+    REQUIRE_EQ ( 4 * BatchItems * ( BatchItems + 1 ) / 2, sum );
+    REQUIRE_RC ( KQueueRelease ( queue ) );
+}
+
+///////////////////////// KThreadPool
+struct TestTask
+{
+    KTask dad;
+    atomic32_t * counter;
+    volatile bool * running;    // set when started, if not NULL
+    volatile bool * release;    // waits for this before finishing, if not NULL
+    rc_t result;
+};
+
+static rc_t CC TestTaskDestroy ( KTask * self )
+{
+    KTaskDestroy ( self, "TestTask" );
+    free ( self );
+    return 0;
+}
+
+static rc_t CC TestTaskExecute ( KTask * self )
+{
+    TestTask * t = ( TestTask * ) self;
+    if ( t -> running != NULL )
+        * t -> running = true;
+    if ( t -> release != NULL )
+    {
+        while ( ! * t -> release )
+            TestEnv::SleepMs ( 1 );
+    }
+    atomic32_inc ( t -> counter );
+    return t -> result;
+}
+
+static KTask_vt_v1 vtTestTask = { 1, 0, TestTaskDestroy, TestTaskExecute };
+
+static KTask * MakeTestTask ( atomic32_t * counter, rc_t result = 0,
+    volatile bool * running = NULL, volatile bool * release = NULL )
+{
+    TestTask * t = ( TestTask * ) calloc ( 1, sizeof * t );
+    if ( t == NULL || KTaskInit ( & t -> dad, ( const KTask_vt * ) & vtTestTask, "TestTask", "test" ) != 0 )
+        throw logic_error ( "MakeTestTask failed" );
+    t -> counter = counter;
+    t -> running = running;
+    t -> release = release;
+    t -> result = result;
+    return & t -> dad;
+}
+
+// polls, so as not to run a queued task on the test thread
+static bool WaitDone ( const KTaskFuture * f, uint32_t ms )
+{
+    for ( uint32_t i = 0; i < ms && ! KTaskFutureDone ( f ); ++ i )
+        TestEnv::SleepMs ( 1 );
+    return KTaskFutureDone ( f );
+}
+
+TEST_CASE( KThreadPool_NULL )
+{
+    REQUIRE_RC_FAIL ( KThreadPoolMake ( NULL, 1 ) );
+    atomic32_t counter;
+    atomic32_set ( & counter, 0 );
+    KTask * task = MakeTestTask ( & counter );
+    KTaskFuture * f;
+    REQUIRE_RC_FAIL ( KThreadPoolSubmit ( NULL, task, & f ) );
+    REQUIRE_NULL ( f );
+    rc_t status;
+    REQUIRE_RC_FAIL ( KTaskFutureWait ( NULL, & status, NULL ) );
+    REQUIRE_RC ( KTaskRelease ( task ) );
+    REQUIRE_EQ ( 0, ( int ) atomic32_read ( & counter ) );
+}
+
+TEST_CASE( KThreadPool_Futures )
+{
+    KThreadPool * pool;
+    REQUIRE_RC ( KThreadPoolMake ( & pool, 4 ) );
+    REQUIRE_EQ ( 4u, KThreadPoolThreads ( pool ) );
+
+    const int N = 1000;
+    atomic32_t counter;
+    atomic32_set ( & counter, 0 );
+    KTaskFuture * f [ N ];
+    for ( int i = 0; i < N; ++ i )
+    {
+        KTask * task = MakeTestTask ( & counter, ( rc_t ) i );
+        REQUIRE_RC ( KThreadPoolSubmit ( pool, task, & f [ i ] ) );
+        REQUIRE_RC ( KTaskRelease ( task ) );
+    }
+    for ( int i = 0; i < N; ++ i )
+    {
+        rc_t status;
+        REQUIRE_RC ( KTaskFutureWait ( f [ i ], & status, NULL ) );
+        REQUIRE_EQ ( ( rc_t ) i, status );
+        REQUIRE ( KTaskFutureDone ( f [ i ] ) );
+        REQUIRE_RC ( KTaskFutureRelease ( f [ i ] ) );
+    }
+    REQUIRE_EQ ( N, ( int ) atomic32_read ( & counter ) );
+    REQUIRE_RC ( KThreadPoolRelease ( pool ) );
+}
+
+TEST_CASE( KThreadPool_ReleaseRunsQueued )
+{
+    KThreadPool * pool;
+    REQUIRE_RC ( KThreadPoolMake ( & pool, 2 ) );
+
+    const int N = 500;
+    atomic32_t counter;
+    atomic32_set ( & counter, 0 );
+    for ( int i = 0; i < N; ++ i )
+    {
+        KTask * task = MakeTestTask ( & counter );
+        REQUIRE_RC ( KThreadPoolSubmit ( pool, task, NULL ) );
+        REQUIRE_RC ( KTaskRelease ( task ) );
+    }
+    REQUIRE_RC ( KThreadPoolRelease ( pool ) );
+    REQUIRE_EQ ( N, ( int ) atomic32_read ( & counter ) );
+}
+
+TEST_CASE( KThreadPool_Stealing )
+{
+    KThreadPool * pool;
+    REQUIRE_RC ( KThreadPoolMake ( & pool, 2 ) );
+
+    // occupy one worker
+    atomic32_t counter;
+    atomic32_set ( & counter, 0 );
+    volatile bool running = false, release = false;
+    KTask * blocker = MakeTestTask ( & counter, 0, & running, & release );
+    KTaskFuture * fb;
+    REQUIRE_RC ( KThreadPoolSubmit ( pool, blocker, & fb ) );
+    REQUIRE_RC ( KTaskRelease ( blocker ) );
+    while ( ! running )
+        TestEnv::SleepMs ( 1 );
+
+    // half of these land in the busy worker's queue; the other worker takes them all
+    const int N = 10;
+    KTaskFuture * f [ N ];
+    for ( int i = 0; i < N; ++ i )
+    {
+        KTask * task = MakeTestTask ( & counter );
+        REQUIRE_RC ( KThreadPoolSubmit ( pool, task, & f [ i ] ) );
+        REQUIRE_RC ( KTaskRelease ( task ) );
+    }
+    for ( int i = 0; i < N; ++ i )
+    {
+        REQUIRE ( WaitDone ( f [ i ], 5000 ) );
+        REQUIRE_RC ( KTaskFutureRelease ( f [ i ] ) );
+    }
+    REQUIRE ( ! KTaskFutureDone ( fb ) );
+
+    release = true;
+    rc_t status;
+    REQUIRE_RC ( KTaskFutureWait ( fb, & status, NULL ) );
+    REQUIRE_RC ( KTaskFutureRelease ( fb ) );
+    REQUIRE_EQ ( N + 1, ( int ) atomic32_read ( & counter ) );
+    REQUIRE_RC ( KThreadPoolRelease ( pool ) );
+}
+
+TEST_CASE( KThreadPool_WaitRunsQueued )
+{
+    KThreadPool * pool;
+    REQUIRE_RC ( KThreadPoolMake ( & pool, 1 ) );
+
+    atomic32_t counter;
+    atomic32_set ( & counter, 0 );
+    volatile bool running = false, release = false;
+    KTask * blocker = MakeTestTask ( & counter, 0, & running, & release );
+    REQUIRE_RC ( KThreadPoolSubmit ( pool, blocker, NULL ) );
+    REQUIRE_RC ( KTaskRelease ( blocker ) );
+    while ( ! running )
+        TestEnv::SleepMs ( 1 );
+
+    // the only worker is busy, so waiting runs the task right here
+    KTask * task = MakeTestTask ( & counter, 7 );
+    KTaskFuture * f;
+    REQUIRE_RC ( KThreadPoolSubmit ( pool, task, & f ) );
+    REQUIRE_RC ( KTaskRelease ( task ) );
+    rc_t status;
+    REQUIRE_RC ( KTaskFutureWait ( f, & status, NULL ) );
+    REQUIRE_EQ ( ( rc_t ) 7, status );
+    REQUIRE_RC ( KTaskFutureRelease ( f ) );
+    REQUIRE_EQ ( 1, ( int ) atomic32_read ( & counter ) );
+
+    release = true;
+    REQUIRE_RC ( KThreadPoolRelease ( pool ) );
+    REQUIRE_EQ ( 2, ( int ) atomic32_read ( & counter ) );
+}
+
+TEST_CASE( KThreadPool_Default )
+{
+    KThreadPool * p1, * p2;
+    REQUIRE_RC ( KThreadPoolGetDefault ( & p1 ) );
+    REQUIRE_RC ( KThreadPoolGetDefault ( & p2 ) );
+    REQUIRE_EQ ( p1, p2 );
+    REQUIRE_GT ( KThreadPoolThreads ( p1 ), 0u );
+    REQUIRE_RC ( KThreadPoolRelease ( p2 ) );
+    REQUIRE_RC ( KThreadPoolRelease ( p1 ) );
+}
+
 //TODO: KConditionWait, KConditionTimedWait, KConditionSignal, KConditionBroadcast
 
 //TODO: KSemaphore
@@ -0,0 +1,262 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/*
+ * measures KQueue throughput under contention, for the locked and the
+ * lock-free queue, with single and batched push/pop. run by hand.
+ */
+
+#include <kapp/main.h>
+#include <kapp/args.h>
+#include <kproc/queue.h>
+#include <kproc/thread.h>
+#include <kproc/timeout.h>
+#include <klib/time.h>
+#include <klib/out.h>
+#include <klib/rc.h>
+
+#include <stdlib.h>
+
+#define BENCH_ITEMS ( 2 * 1024 * 1024 )
+#define BENCH_CAPACITY 1024
+#define BENCH_BATCH 32
+#define BENCH_WAIT_MS 10000
+
+typedef struct BenchThread BenchThread;
+struct BenchThread
+{
+    KQueue * q;
+    uint64_t items;     /* producers: to push, consumers: popped */
+    uint32_t batch;
+};
+
+static
+rc_t CC producer ( const KThread *self, void *data )
+{
+    BenchThread * t = data;
+    const void * items [ BENCH_BATCH ];
+    uint64_t i, done = 0;
+    rc_t rc = 0;
+
+    for ( i = 0; i < BENCH_BATCH; ++ i )
+        items [ i ] = ( const void * ) ( size_t ) ( i + 1 );
+
+    while ( rc == 0 && done < t -> items )
+    {
+        timeout_t tm;
+        uint32_t n = t -> items - done < t -> batch ? ( uint32_t ) ( t -> items - done ) : t -> batch;
+        TimeoutInit ( & tm, BENCH_WAIT_MS );
+        if ( t -> batch == 1 )
+        {
+            rc = KQueuePush ( t -> q, items [ 0 ], & tm );
+            n = 1;
+        }
+        else
+            rc = KQueuePushBatch ( t -> q, items, n, & n, & tm );
+        done += n;
+    }
+    return rc;
+}
+
+static
+rc_t CC consumer ( const KThread *self, void *data )
+{
+    BenchThread * t = data;
+    void * items [ BENCH_BATCH ];
+    rc_t rc = 0;
+
+    t -> items = 0;
+    while ( rc == 0 )
+    {
+        timeout_t tm;
+        uint32_t n;
+        TimeoutInit ( & tm, BENCH_WAIT_MS );
+        if ( t -> batch == 1 )
+        {
+            rc = KQueuePop ( t -> q, & items [ 0 ], & tm );
+            n = 1;
+        }
+        else
+            rc = KQueuePopBatch ( t -> q, items, t -> batch, & n, & tm );
+        if ( rc == 0 )
+            t -> items += n;
+    }
+    /* the end of the run */
+    return GetRCState ( rc ) == rcDone ? 0 : rc;
+}
+
+/* millions of items per second through "q" with "np" producers and "nc" consumers */
+static
+rc_t bench_one ( KQueue * q, uint32_t np, uint32_t nc, uint32_t batch, double * rate )
+{
+    rc_t rc = 0;
+    BenchThread pt [ 16 ], ct [ 16 ];
+    KThread * pth [ 16 ], * cth [ 16 ];
+    uint32_t i, started_p = 0, started_c = 0;
+    uint64_t popped = 0;
+    KTimeMs_t start, elapsed;
+
+    start = KTimeMsStamp ();
+    for ( i = 0; rc == 0 && i < nc; ++ i, ++ started_c )
+    {
+        ct [ i ] . q = q;
+        ct [ i ] . batch = batch;
+        rc = KThreadMake ( & cth [ i ], consumer, & ct [ i ] );
+    }
+    for ( i = 0; rc == 0 && i < np; ++ i, ++ started_p )
+    {
+        pt [ i ] . q = q;
+        pt [ i ] . batch = batch;
+        pt [ i ] . items = BENCH_ITEMS / np;
+        rc = KThreadMake ( & pth [ i ], producer, & pt [ i ] );
+    }
+    if ( rc != 0 )
+    {
+        -- started_p;
+        -- started_c;
+    }
+
+    for ( i = 0; i < started_p; ++ i )
+    {
+        rc_t status;
+        KThreadWait ( pth [ i ], & status );
+        KThreadRelease ( pth [ i ] );
+        if ( rc == 0 )
+            rc = status;
+    }
+    KQueueSeal ( q );
+    for ( i = 0; i < started_c; ++ i )
+    {
+        rc_t status;
+        KThreadWait ( cth [ i ], & status );
+        KThreadRelease ( cth [ i ] );
+        if ( rc == 0 )
+            rc = status;
+        popped += ct [ i ] . items;
+    }
+    elapsed = KTimeMsStamp () - start;
+
+    if ( rc == 0 && popped != ( uint64_t ) ( BENCH_ITEMS / np ) * np )
+        rc = RC ( rcExe, rcQueue, rcValidating, rcData, rcCorrupt );
+
+    * rate = elapsed == 0 ? 0.0 : ( double ) popped / ( ( double ) elapsed * 1e3 );
+    return rc;
+}
+
+static
+rc_t bench_kind ( bool lockfree, uint32_t np, uint32_t nc, uint32_t batch, double * rate )
+{
+    KQueue * q;
+    rc_t rc = lockfree ?
+        KQueueMakeLockFree ( & q, BENCH_CAPACITY ) :
+        KQueueMake ( & q, BENCH_CAPACITY );
+    if ( rc == 0 )
+    {
+        rc = bench_one ( q, np, nc, batch, rate );
+        KQueueRelease ( q );
+    }
+    return rc;
+}
+
+static
+rc_t run_bench ( void )
+{
+    static const uint32_t threads [] = { 1, 2, 4, 8 };
+    rc_t rc;
+    uint32_t i, j;
+
+    rc = KOutMsg ( "%9s %9s %12s %12s %14s %14s\n", "producers", "consumers",
+        "locked M/s", "lockfree M/s", "locked x32 M/s", "lockfree x32 M/s" );
+
+    for ( i = 0; rc == 0 && i < sizeof threads / sizeof threads [ 0 ]; ++ i )
+    {
+        for ( j = 0; rc == 0 && j < sizeof threads / sizeof threads [ 0 ]; ++ j )
+        {
+            double locked, lockfree, locked_batch, lockfree_batch;
+            rc = bench_kind ( false, threads [ i ], threads [ j ], 1, & locked );
+            if ( rc == 0 )
+                rc = bench_kind ( true, threads [ i ], threads [ j ], 1, & lockfree );
+            if ( rc == 0 )
+                rc = bench_kind ( false, threads [ i ], threads [ j ], BENCH_BATCH, & locked_batch );
+            if ( rc == 0 )
+                rc = bench_kind ( true, threads [ i ], threads [ j ], BENCH_BATCH, & lockfree_batch );
+            if ( rc == 0 )
+            {
+                rc = KOutMsg ( "%9u %9u %12.2f %12.2f %14.2f %14.2f\n", threads [ i ], threads [ j ],
+                    locked, lockfree, locked_batch, lockfree_batch );
+            }
+        }
+    }
+    return rc;
+}
+
+ver_t CC KAppVersion ( void )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-queue-bench";
+
+rc_t CC UsageSummary ( const char * name )
+{
+    return KOutMsg (
+        "Usage:\n"
+        " %s\n"
+        "\n"
+        "    report KQueue throughput in millions of items per second\n"
+        "\n", name );
+}
+
+rc_t CC Usage ( const Args * args )
+{
+    const char * progname = UsageDefaultName;
+    const char * fullpath = UsageDefaultName;
+    rc_t rc;
+
+    if ( args == NULL )
+        rc = RC ( rcApp, rcArgv, rcAccessing, rcSelf, rcNull );
+    else
+        rc = ArgsProgram ( args, & fullpath, & progname );
+    UsageSummary ( progname );
+
+    KOutMsg ( "Options:\n" );
+
+    HelpOptionsStandard ();
+
+    return rc;
+}
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    Args * args;
+    rc_t rc = ArgsMakeAndHandle ( & args, argc, argv, 0 );
+    if ( rc == 0 )
+    {
+        rc = run_bench ();
+        ArgsWhack ( args );
+    }
+    return rc;
+}
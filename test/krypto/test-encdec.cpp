@@ -575,6 +575,253 @@ TEST_CASE(KDectryptInvalidKey)
     REQUIRE_RC ( KDirectoryRelease ( current_dir ) );
 }
 
+TEST_CASE(KDecryptRandomAccess)
+{
+    const char pw [] = "first pw";
+    KKey key;
+    REQUIRE_RC (KKeyInitUpdate (&key, kkeyAES128, pw, strlen (pw)));
+
+    const char file_path [] = TMP_FOLDER "/enc_file_random_access";
+
+    KFile * enc_file;
+
+    struct KDirectory * current_dir;
+    REQUIRE_RC ( KDirectoryNativeDir ( &current_dir ) );
+
+    // just in case if it still there
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+
+    // content that differs from block to block
+    const size_t content_size = 51 * BLOCK_32K_SIZE + 123;
+    uint8_t * content = new uint8_t [ content_size ];
+    for ( size_t i = 0; i < content_size; ++i )
+        content [ i ] = ( uint8_t ) ( ( i * 7919 ) >> 8 );
+
+    size_t num_written;
+    REQUIRE_RC ( TCreateEncFile( current_dir, file_path, TFileOpenMode_Write, &key, &enc_file ) );
+    REQUIRE_RC ( KFileWriteAll ( enc_file, 0, content, content_size, &num_written ) );
+    REQUIRE_EQ ( content_size, num_written );
+    REQUIRE_RC ( KFileRelease ( enc_file ) );
+
+    REQUIRE_RC ( TOpenEncFile( current_dir, file_path, TFileOpenMode_Read, &key, &enc_file ) );
+
+    const size_t buffer_size = content_size + 1000;
+    uint8_t * buffer = new uint8_t [ buffer_size ];
+    size_t num_read;
+
+    // the whole file in one request, spanning several windows
+    REQUIRE_RC ( KFileReadAll ( enc_file, 0, buffer, buffer_size, &num_read ) );
+    REQUIRE_EQ ( content_size, num_read );
+    REQUIRE ( memcmp ( buffer, content, content_size ) == 0 );
+
+    // scattered reads, backwards and across block boundaries
+    uint64_t seed = 12345;
+    for ( int i = 0; i < 200; ++i )
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t pos = ( seed >> 20 ) % ( content_size + 10 );
+        size_t size = ( size_t ) ( ( seed >> 40 ) % ( 3 * BLOCK_32K_SIZE ) ) + 1;
+
+        REQUIRE_RC ( KFileReadAll ( enc_file, pos, buffer, size, &num_read ) );
+        size_t expected = pos >= content_size ? 0 : ( size < content_size - pos ? size : content_size - pos );
+        REQUIRE_EQ ( expected, num_read );
+        REQUIRE ( memcmp ( buffer, content + pos, num_read ) == 0 );
+    }
+
+    // small sequential reads
+    for ( uint64_t pos = 0; pos < content_size; pos += num_read )
+    {
+        REQUIRE_RC ( KFileRead ( enc_file, pos, buffer, 1000, &num_read ) );
+        REQUIRE_NE ( ( size_t ) 0, num_read );
+        REQUIRE ( memcmp ( buffer, content + pos, num_read ) == 0 );
+    }
+
+    REQUIRE_RC ( KFileRelease ( enc_file ) );
+
+    delete [] buffer;
+    delete [] content;
+
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+
+    REQUIRE_RC ( KDirectoryRelease ( current_dir ) );
+}
+
+// content that differs from block to block
+static uint8_t ContentByte ( size_t i )
+{
+    return ( uint8_t ) ( ( i * 7919 ) >> 8 );
+}
+
+static rc_t WriteContentFile ( struct KDirectory * dir, const char * path, const KKey * key, size_t content_size )
+{
+    uint8_t * content = new uint8_t [ content_size ];
+    for ( size_t i = 0; i < content_size; ++i )
+        content [ i ] = ContentByte ( i );
+
+    KFile * enc_file;
+    size_t num_written;
+    rc_t rc = TCreateEncFile( dir, path, TFileOpenMode_Write, key, &enc_file );
+    if ( rc == 0 )
+    {
+        rc = KFileWriteAll ( enc_file, 0, content, content_size, &num_written );
+        if ( rc == 0 && num_written != content_size )
+            rc = RC ( rcKrypto, rcFile, rcWriting, rcTransfer, rcIncomplete );
+        rc_t rc2 = KFileRelease ( enc_file );
+        if ( rc == 0 )
+            rc = rc2;
+    }
+
+    delete [] content;
+    return rc;
+}
+
+// reads "size" bytes at "pos" and compares them with the content
+static bool ReadMatches ( const KFile * enc_file, size_t content_size, uint64_t pos, size_t size )
+{
+    uint8_t * buffer = new uint8_t [ size ];
+    size_t num_read;
+    bool ok = KFileReadAll ( enc_file, pos, buffer, size, &num_read ) == 0;
+    if ( ok )
+    {
+        size_t expected = pos >= content_size ? 0 : ( size < content_size - pos ? size : content_size - pos );
+        ok = num_read == expected;
+        for ( size_t i = 0; ok && i < num_read; ++i )
+            ok = buffer [ i ] == ContentByte ( pos + i );
+    }
+    delete [] buffer;
+    return ok;
+}
+
+TEST_CASE(KDecryptWindowBoundaries)
+{
+    const char pw [] = "first pw";
+    KKey key;
+    REQUIRE_RC (KKeyInitUpdate (&key, kkeyAES128, pw, strlen (pw)));
+
+    const char file_path [] = TMP_FOLDER "/enc_file_window_boundaries";
+
+    struct KDirectory * current_dir;
+    REQUIRE_RC ( KDirectoryNativeDir ( &current_dir ) );
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+
+    // more than two caches of 32 blocks, with a short final block
+    const size_t content_size = 70 * BLOCK_32K_SIZE + 321;
+    REQUIRE_RC ( WriteContentFile ( current_dir, file_path, &key, content_size ) );
+
+    KFile * enc_file;
+    REQUIRE_RC ( TOpenEncFile( current_dir, file_path, TFileOpenMode_Read, &key, &enc_file ) );
+
+    // windows are 16 blocks and the cache holds 32
+    const uint64_t boundaries [] = { 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64, 65, 70 };
+    const size_t num_boundaries = sizeof boundaries / sizeof boundaries [ 0 ];
+
+    // forward, then backward over the same boundaries
+    for ( size_t i = 0; i < 2 * num_boundaries; ++i )
+    {
+        uint64_t b = boundaries [ i < num_boundaries ? i : 2 * num_boundaries - 1 - i ];
+        uint64_t pos = b * BLOCK_32K_SIZE;
+
+        REQUIRE ( ReadMatches ( enc_file, content_size, pos - 7, 14 ) );
+        REQUIRE ( ReadMatches ( enc_file, content_size, pos - BLOCK_32K_SIZE / 2, 2 * BLOCK_32K_SIZE ) );
+    }
+
+    // whole windows read at unaligned positions, straddling two fetches
+    REQUIRE ( ReadMatches ( enc_file, content_size, 10 * BLOCK_32K_SIZE + 5, 16 * BLOCK_32K_SIZE ) );
+    REQUIRE ( ReadMatches ( enc_file, content_size, 30 * BLOCK_32K_SIZE + 5, 20 * BLOCK_32K_SIZE ) );
+
+    // far apart reads, evicting the cache in between
+    REQUIRE ( ReadMatches ( enc_file, content_size, 0, 100 ) );
+    REQUIRE ( ReadMatches ( enc_file, content_size, 20 * BLOCK_32K_SIZE, 40 * BLOCK_32K_SIZE ) );
+    REQUIRE ( ReadMatches ( enc_file, content_size, 0, 100 ) );
+    REQUIRE ( ReadMatches ( enc_file, content_size, 69 * BLOCK_32K_SIZE + 1, 100 ) );
+
+    REQUIRE_RC ( KFileRelease ( enc_file ) );
+
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+    REQUIRE_RC ( KDirectoryRelease ( current_dir ) );
+}
+
+TEST_CASE(KDecryptBackwardReads)
+{
+    const char pw [] = "first pw";
+    KKey key;
+    REQUIRE_RC (KKeyInitUpdate (&key, kkeyAES128, pw, strlen (pw)));
+
+    const char file_path [] = TMP_FOLDER "/enc_file_backward_reads";
+
+    struct KDirectory * current_dir;
+    REQUIRE_RC ( KDirectoryNativeDir ( &current_dir ) );
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+
+    const size_t content_size = 40 * BLOCK_32K_SIZE + 4000;
+    REQUIRE_RC ( WriteContentFile ( current_dir, file_path, &key, content_size ) );
+
+    KFile * enc_file;
+    REQUIRE_RC ( TOpenEncFile( current_dir, file_path, TFileOpenMode_Read, &key, &enc_file ) );
+
+    // overlapping reads stepping back from the end
+    const size_t step = BLOCK_32K_SIZE / 3;
+    for ( uint64_t end = content_size; end > 0; end = end > step ? end - step : 0 )
+    {
+        uint64_t pos = end > BLOCK_32K_SIZE / 2 ? end - BLOCK_32K_SIZE / 2 : 0;
+        REQUIRE ( ReadMatches ( enc_file, content_size, pos, ( size_t ) ( end - pos ) ) );
+    }
+
+    // one block at a time from the last down to the first
+    for ( uint64_t b = 41; b > 0; --b )
+        REQUIRE ( ReadMatches ( enc_file, content_size, ( b - 1 ) * BLOCK_32K_SIZE, BLOCK_32K_SIZE ) );
+
+    REQUIRE_RC ( KFileRelease ( enc_file ) );
+
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+    REQUIRE_RC ( KDirectoryRelease ( current_dir ) );
+}
+
+TEST_CASE(KDecryptShortFinalBlock)
+{
+    const char pw [] = "first pw";
+    KKey key;
+    REQUIRE_RC (KKeyInitUpdate (&key, kkeyAES128, pw, strlen (pw)));
+
+    const char file_path [] = TMP_FOLDER "/enc_file_short_final_block";
+
+    struct KDirectory * current_dir;
+    REQUIRE_RC ( KDirectoryNativeDir ( &current_dir ) );
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+
+    // the final block is short, alone or at the end of a window
+    const size_t sizes [] = { 1, BLOCK_32K_SIZE - 1, BLOCK_32K_SIZE + 1,
+                              16 * BLOCK_32K_SIZE + 1, 32 * BLOCK_32K_SIZE - 5 };
+
+    for ( size_t i = 0; i < sizeof sizes / sizeof sizes [ 0 ]; ++i )
+    {
+        const size_t content_size = sizes [ i ];
+        REQUIRE_RC ( WriteContentFile ( current_dir, file_path, &key, content_size ) );
+
+        KFile * enc_file;
+        REQUIRE_RC ( TOpenEncFile( current_dir, file_path, TFileOpenMode_Read, &key, &enc_file ) );
+
+        uint64_t size;
+        REQUIRE_RC ( KFileSize ( enc_file, &size ) );
+        REQUIRE_EQ ( ( uint64_t ) content_size, size );
+
+        uint64_t last_block = ( content_size - 1 ) / BLOCK_32K_SIZE * BLOCK_32K_SIZE;
+
+        // the final block first, then everything, then past the end
+        REQUIRE ( ReadMatches ( enc_file, content_size, content_size - 1, 10 ) );
+        REQUIRE ( ReadMatches ( enc_file, content_size, last_block, BLOCK_32K_SIZE ) );
+        REQUIRE ( ReadMatches ( enc_file, content_size, 0, content_size + 1000 ) );
+        REQUIRE ( ReadMatches ( enc_file, content_size, content_size, 10 ) );
+        REQUIRE ( ReadMatches ( enc_file, content_size, content_size + BLOCK_32K_SIZE, 10 ) );
+
+        REQUIRE_RC ( KFileRelease ( enc_file ) );
+        REQUIRE_RC ( KDirectoryRemove ( current_dir, false, file_path ) );
+    }
+
+    KDirectoryRemove ( current_dir, true, TMP_FOLDER );
+    REQUIRE_RC ( KDirectoryRelease ( current_dir ) );
+}
+
 //////////////////////////////////////////// Main
 
 extern "C"
@@ -0,0 +1,260 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Unit tests for the loader's key to id map
+*/
+#include <ktst/unit_test.hpp>
+
+#include <klib/printf.h>
+#include <kproc/thread.h>
+
+#include <vector>
+
+extern "C" {
+#include <loader/keyidmap.h>
+}
+
+using namespace std;
+
+TEST_SUITE(KeyIdMapTestSuite);
+
+static size_t MakeKey ( char * buf, size_t bsize, uint32_t n )
+{
+    size_t len = 0;
+    string_printf ( buf, bsize, & len, "SRR000001.%u", n );
+    return len;
+}
+
+TEST_CASE ( KeyIdMap_DensePerSpace )
+{
+    struct KeyIdMap * map;
+    REQUIRE_RC ( KeyIdMapMake ( & map, NULL, 0 ) );
+
+    const uint32_t N = 1000;
+    char key [ 64 ];
+
+    // the same keys in every space get ids counting from 0 in each
+    for ( uint32_t i = 0; i != N; ++i )
+    {
+        for ( unsigned space = 0; space != 4; ++space )
+        {
+            uint32_t id;
+            bool inserted;
+            REQUIRE_RC ( KeyIdMapEntry ( map, & id, & inserted, space, key, MakeKey ( key, sizeof key, i ) ) );
+            REQUIRE ( inserted );
+            REQUIRE_EQ ( i, id );
+        }
+    }
+    for ( unsigned space = 0; space != 4; ++space )
+        REQUIRE_EQ ( N, KeyIdMapCount ( map, space ) );
+    REQUIRE_EQ ( 0u, KeyIdMapCount ( map, 4 ) );
+
+    // known keys keep their ids
+    for ( uint32_t i = N; i != 0; --i )
+    {
+        uint32_t id;
+        bool inserted;
+        REQUIRE_RC ( KeyIdMapEntry ( map, & id, & inserted, 2, key, MakeKey ( key, sizeof key, i - 1 ) ) );
+        REQUIRE ( ! inserted );
+        REQUIRE_EQ ( i - 1, id );
+    }
+    REQUIRE_EQ ( N, KeyIdMapCount ( map, 2 ) );
+
+    // an empty key is a key like any other
+    uint32_t id;
+    bool inserted;
+    REQUIRE_RC ( KeyIdMapEntry ( map, & id, & inserted, 1, "", 0 ) );
+    REQUIRE ( inserted );
+    REQUIRE_EQ ( N, id );
+
+    REQUIRE_RC_FAIL ( KeyIdMapEntry ( map, & id, & inserted, 256, key, 1 ) );
+
+    KeyIdMapWhack ( map );
+}
+
+struct InsertThread
+{
+    struct KeyIdMap * map;
+    unsigned space;
+    uint32_t first;
+    uint32_t count;
+    vector < uint32_t > ids;
+    uint32_t inserted;
+    rc_t rc;
+};
+
+static rc_t CC InsertKeys ( const KThread *, void * data )
+{
+    InsertThread * t = ( InsertThread * ) data;
+    char key [ 64 ];
+
+    t -> inserted = 0;
+    t -> rc = 0;
+    for ( uint32_t i = 0; i != t -> count && t -> rc == 0; ++i )
+    {
+        // each thread starts at a different key and wraps around
+        uint32_t n = ( t -> first + i ) % t -> count;
+        bool inserted;
+        t -> rc = KeyIdMapEntry ( t -> map, & t -> ids [ n ], & inserted, t -> space, key, MakeKey ( key, sizeof key, n ) );
+        if ( inserted )
+            ++ t -> inserted;
+    }
+    return t -> rc;
+}
+
+TEST_CASE ( KeyIdMap_ConcurrentInserts )
+{
+    struct KeyIdMap * map;
+    REQUIRE_RC ( KeyIdMapMake ( & map, NULL, 0 ) );
+
+    const uint32_t N = 50000;
+    const unsigned THREADS = 6;
+    InsertThread t [ THREADS ];
+    KThread * thread [ THREADS ];
+
+    // three threads per space, all inserting the same keys
+    for ( unsigned i = 0; i != THREADS; ++i )
+    {
+        t [ i ] . map = map;
+        t [ i ] . space = i % 2;
+        t [ i ] . first = i * ( N / THREADS );
+        t [ i ] . count = N;
+        t [ i ] . ids . resize ( N );
+        REQUIRE_RC ( KThreadMake ( & thread [ i ], InsertKeys, & t [ i ] ) );
+    }
+    for ( unsigned i = 0; i != THREADS; ++i )
+    {
+        rc_t status;
+        REQUIRE_RC ( KThreadWait ( thread [ i ], & status ) );
+        REQUIRE_RC ( status );
+        REQUIRE_RC ( KThreadRelease ( thread [ i ] ) );
+    }
+
+    for ( unsigned space = 0; space != 2; ++space )
+    {
+        REQUIRE_EQ ( N, KeyIdMapCount ( map, space ) );
+
+        // every key was inserted once and the ids are a permutation of [ 0, N )
+        uint32_t inserted = 0;
+        vector < bool > seen ( N, false );
+        for ( unsigned i = space; i < THREADS; i += 2 )
+        {
+            inserted += t [ i ] . inserted;
+            REQUIRE ( t [ i ] . ids == t [ space ] . ids );
+        }
+        REQUIRE_EQ ( N, inserted );
+        for ( uint32_t n = 0; n != N; ++n )
+        {
+            uint32_t id = t [ space ] . ids [ n ];
+            REQUIRE_LT ( id, N );
+            REQUIRE ( ! seen [ id ] );
+            seen [ id ] = true;
+        }
+    }
+
+    KeyIdMapWhack ( map );
+}
+
+TEST_CASE ( KeyIdMap_SpillAndLookup )
+{
+    struct KeyIdMap * map;
+
+    // the smallest limit spills every shard many times over,
+    // so that its runs are merged as well
+    REQUIRE_RC ( KeyIdMapMake ( & map, "./keyidmap-test", 1 ) );
+
+    const uint32_t N = 1500000;
+    char key [ 64 ];
+
+    // counted rather than required one by one to keep the loops fast
+    uint32_t wrong = 0;
+    for ( uint32_t i = 0; i != N; ++i )
+    {
+        uint32_t id;
+        bool inserted;
+        if ( KeyIdMapEntry ( map, & id, & inserted, i % 2, key, MakeKey ( key, sizeof key, i ) ) != 0
+             || ! inserted || id != i / 2 )
+            ++ wrong;
+    }
+    REQUIRE_EQ ( 0u, wrong );
+    REQUIRE_EQ ( N / 2, KeyIdMapCount ( map, 0 ) );
+    REQUIRE_EQ ( N / 2, KeyIdMapCount ( map, 1 ) );
+
+    // every key is found again, in memory or in a run
+    for ( uint32_t i = 0; i != N; ++i )
+    {
+        uint32_t id;
+        bool inserted;
+        if ( KeyIdMapEntry ( map, & id, & inserted, i % 2, key, MakeKey ( key, sizeof key, i ) ) != 0
+             || inserted || id != i / 2 )
+            ++ wrong;
+    }
+    REQUIRE_EQ ( 0u, wrong );
+
+    // a key spilled from one space is still new in the other
+    uint32_t id;
+    bool inserted;
+    REQUIRE_RC ( KeyIdMapEntry ( map, & id, & inserted, 1, key, MakeKey ( key, sizeof key, 0 ) ) );
+    REQUIRE ( inserted );
+    REQUIRE_EQ ( N / 2, id );
+
+    KeyIdMapWhack ( map );
+}
+
+//////////////////////////////////////////// Main
+#include <kapp/args.h>
+#include <klib/out.h>
+#include <kfg/config.h>
+
+extern "C"
+{
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+
+const char UsageDefaultName[] = "test-keyidmap";
+
+rc_t CC UsageSummary (const char * progname)
+{
+    return KOutMsg ( "Usage:\n" "\t%s [options]\n\n", progname );
+}
+
+rc_t CC Usage( const Args* args )
+{
+    return 0;
+}
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    KConfigDisableUserSettings();
+    rc_t rc=KeyIdMapTestSuite(argc, argv);
+    return rc;
+}
+
+}
@@ -0,0 +1,259 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Unit tests for the loader's memory mapped array
+*/
+#include <ktst/unit_test.hpp>
+
+#include <kfs/directory.h>
+#include <kfs/file.h>
+
+extern "C" {
+#include <loader/mmarray.h>
+}
+
+using namespace std;
+
+TEST_SUITE(MMArrayTestSuite);
+
+// elements of a sub-chunk, and the bytes of one holding uint32_t's
+static const uint64_t SUBCHUNK = 1u << 24;
+static const uint64_t SUBCHUNK_BYTES = SUBCHUNK * sizeof ( uint32_t );
+
+// the n-th sub-chunk touched, spread over the id spaces
+static uint64_t Element ( unsigned n, uint32_t offset )
+{
+    return ( ( uint64_t ) ( n % 3 ) << 32 ) + ( n / 3 ) * SUBCHUNK + offset;
+}
+
+class MMArrayFixture
+{
+public:
+    MMArrayFixture()
+    :   m_dir ( 0 ),
+        m_file ( 0 ),
+        m_array ( 0 )
+    {
+        if ( KDirectoryNativeDir ( & m_dir ) != 0 )
+            throw logic_error ( "MMArrayFixture: KDirectoryNativeDir failed" );
+    }
+    ~MMArrayFixture()
+    {
+        if ( m_array != 0 )
+            MMArrayWhack ( m_array );
+        KFileRelease ( m_file );
+        KDirectoryRemove ( m_dir, true, FileName );
+        KDirectoryRelease ( m_dir );
+    }
+
+    void MakeFile()
+    {
+        if ( KDirectoryCreateFile ( m_dir, & m_file, true, 0600, kcmInit, FileName ) != 0 )
+            throw logic_error ( "MMArrayFixture: KDirectoryCreateFile failed" );
+    }
+
+    // stores a value at the first and last element of the n-th sub-chunk
+    rc_t Touch ( unsigned n )
+    {
+        void * value;
+        rc_t rc = MMArrayGet ( m_array, & value, Element ( n, 0 ) );
+        if ( rc == 0 )
+        {
+            * ( uint32_t * ) value = n + 1;
+            rc = MMArrayGet ( m_array, & value, Element ( n, SUBCHUNK - 1 ) );
+            if ( rc == 0 )
+                * ( uint32_t * ) value = ~ n;
+        }
+        return rc;
+    }
+
+    bool Check ( unsigned n )
+    {
+        void * first;
+        void * last;
+        return MMArrayGet ( m_array, & first, Element ( n, 0 ) ) == 0
+            && MMArrayGet ( m_array, & last, Element ( n, SUBCHUNK - 1 ) ) == 0
+            && * ( uint32_t * ) first == n + 1
+            && * ( uint32_t * ) last == ~ n;
+    }
+
+    static const char * FileName;
+
+    KDirectory * m_dir;
+    KFile * m_file;
+    struct MMArray * m_array;
+};
+
+const char * MMArrayFixture::FileName = "mmarray-test.tmp";
+
+FIXTURE_TEST_CASE ( MMArray_RegionGrowth, MMArrayFixture )
+{
+    REQUIRE_RC ( MMArrayMake ( & m_array, NULL, sizeof ( uint32_t ) ) );
+    MMArraySetGrowth ( m_array, 4 );
+
+    // regions of 1, 2, 4 and 4 sub-chunks
+    const unsigned expected_maps [] = { 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+    for ( unsigned n = 0; n != sizeof expected_maps / sizeof expected_maps [ 0 ]; ++n )
+    {
+        REQUIRE_RC ( Touch ( n ) );
+
+        MMArrayStats stats;
+        MMArrayGetStats ( m_array, & stats );
+        REQUIRE_EQ ( ( uint64_t ) n + 1, stats . subchunks );
+        REQUIRE_EQ ( ( uint64_t ) expected_maps [ n ], stats . anonMaps );
+        REQUIRE_EQ ( ( uint64_t ) 0, stats . fileMaps );
+    }
+
+    MMArrayStats stats;
+    MMArrayGetStats ( m_array, & stats );
+    REQUIRE_EQ ( 11 * SUBCHUNK_BYTES, stats . anonBytes );
+
+    // touching a sub-chunk again reserves nothing
+    for ( unsigned n = 0; n != 11; ++n )
+        REQUIRE ( Check ( n ) );
+    MMArrayGetStats ( m_array, & stats );
+    REQUIRE_EQ ( ( uint64_t ) 11, stats . subchunks );
+    REQUIRE_EQ ( ( uint64_t ) 4, stats . anonMaps );
+
+    // elements beyond the id spaces are refused
+    void * value;
+    REQUIRE_RC_FAIL ( MMArrayGet ( m_array, & value, ( uint64_t ) NUM_ID_SPACES << 32 ) );
+}
+
+FIXTURE_TEST_CASE ( MMArray_SpillToFile, MMArrayFixture )
+{
+    MakeFile();
+    REQUIRE_RC ( MMArrayMake ( & m_array, m_file, sizeof ( uint32_t ) ) );
+    MMArraySetGrowth ( m_array, 2 );
+    MMArraySetMemoryLimit ( m_array, 3 * SUBCHUNK_BYTES );
+
+    // regions of 1 and 2 sub-chunks fit in memory, the next 2 go to the file
+    for ( unsigned n = 0; n != 7; ++n )
+        REQUIRE_RC ( Touch ( n ) );
+
+    MMArrayStats stats;
+    MMArrayGetStats ( m_array, & stats );
+    REQUIRE_EQ ( ( uint64_t ) 7, stats . subchunks );
+    REQUIRE_EQ ( ( uint64_t ) 2, stats . anonMaps );
+    REQUIRE_EQ ( 3 * SUBCHUNK_BYTES, stats . anonBytes );
+    REQUIRE_EQ ( ( uint64_t ) 2, stats . fileMaps );
+    REQUIRE_EQ ( 4 * SUBCHUNK_BYTES, stats . fileBytes );
+
+    uint64_t size;
+    REQUIRE_RC ( KFileSize ( m_file, & size ) );
+    REQUIRE_EQ ( stats . fileBytes, size );
+
+    for ( unsigned n = 0; n != 7; ++n )
+        REQUIRE ( Check ( n ) );
+}
+
+FIXTURE_TEST_CASE ( MMArray_FileOffsets, MMArrayFixture )
+{
+    MakeFile();
+    REQUIRE_RC ( MMArrayMake ( & m_array, m_file, sizeof ( uint32_t ) ) );
+    MMArraySetGrowth ( m_array, 2 );
+
+    // regions of 1, 2 and 2 sub-chunks, each mapped just past the previous one
+    for ( unsigned n = 0; n != 5; ++n )
+        REQUIRE_RC ( Touch ( n ) );
+
+    MMArrayStats stats;
+    MMArrayGetStats ( m_array, & stats );
+    REQUIRE_EQ ( ( uint64_t ) 3, stats . fileMaps );
+    REQUIRE_EQ ( ( uint64_t ) 0, stats . anonMaps );
+    REQUIRE_EQ ( 5 * SUBCHUNK_BYTES, stats . fileBytes );
+
+    uint64_t size;
+    REQUIRE_RC ( KFileSize ( m_file, & size ) );
+    REQUIRE_EQ ( 5 * SUBCHUNK_BYTES, size );
+
+    // sub-chunks are laid out in the file in the order of first touch
+    for ( unsigned n = 0; n != 5; ++n )
+    {
+        uint32_t first, last;
+        size_t num_read;
+        REQUIRE_RC ( KFileReadAll ( m_file, n * SUBCHUNK_BYTES, & first, sizeof first, & num_read ) );
+        REQUIRE_EQ ( sizeof first, num_read );
+        REQUIRE_EQ ( n + 1, first );
+        REQUIRE_RC ( KFileReadAll ( m_file, ( n + 1 ) * SUBCHUNK_BYTES - sizeof last, & last, sizeof last, & num_read ) );
+        REQUIRE_EQ ( sizeof last, num_read );
+        REQUIRE_EQ ( ~ n, last );
+    }
+
+    for ( unsigned n = 0; n != 5; ++n )
+        REQUIRE ( Check ( n ) );
+}
+
+FIXTURE_TEST_CASE ( MMArray_Populate, MMArrayFixture )
+{
+    REQUIRE_RC ( MMArrayMake ( & m_array, NULL, sizeof ( uint32_t ) ) );
+    MMArraySetGrowth ( m_array, 1 );
+    MMArraySetPopulate ( m_array, true );
+
+    REQUIRE_RC ( Touch ( 0 ) );
+    REQUIRE ( Check ( 0 ) );
+
+    // the whole region was faulted in, not just the two pages written
+    MMArrayStats stats;
+    MMArrayGetStats ( m_array, & stats );
+    REQUIRE_EQ ( ( uint64_t ) 1, stats . anonMaps );
+    REQUIRE_GT ( stats . minorFaults + stats . majorFaults, ( uint64_t ) 2 );
+}
+
+//////////////////////////////////////////// Main
+#include <kapp/args.h>
+#include <klib/out.h>
+#include <kfg/config.h>
+
+extern "C"
+{
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+
+const char UsageDefaultName[] = "test-mmarray";
+
+rc_t CC UsageSummary (const char * progname)
+{
+    return KOutMsg ( "Usage:\n" "\t%s [options]\n\n", progname );
+}
+
+rc_t CC Usage( const Args* args )
+{
+    return 0;
+}
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    KConfigDisableUserSettings();
+    rc_t rc=MMArrayTestSuite(argc, argv);
+    return rc;
+}
+
+}
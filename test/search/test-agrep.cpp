@@ -891,10 +891,127 @@ TEST_CASE ( Nucstrstr_Positional_AND_OR_NOT_Found )
 }
 
 TEST_CASE ( Nucstrstr_Positional_Error )
-{   
+{
     REQUIRE_THROW ( RunNucStrtr ( "ACGTACGT", "(TACC", true ) );
 }
 
+// the vector code is checked against a simple scan
+static
+string RandomBases ( size_t len, const char * alphabet )
+{
+    string s;
+    size_t n = strlen ( alphabet );
+    for ( size_t i = 0; i < len; ++ i )
+        s += alphabet [ rand () % n ];
+    return s;
+}
+
+static
+bool BaseMatches ( char q, char b )
+{
+    switch ( q )
+    {
+    case 'N': return true;
+    case 'R': return b == 'A' || b == 'G';
+    case 'Y': return b == 'C' || b == 'T';
+    }
+    return q == b;
+}
+
+static
+bool ScanFor ( const string & ref, const string & query, size_t pos )
+{
+    for ( ; pos + query . size () <= ref . size (); ++ pos )
+    {
+        size_t i;
+        for ( i = 0; i < query . size (); ++ i )
+        {
+            if ( ! BaseMatches ( query [ i ], ref [ pos + i ] ) )
+                break;
+        }
+        if ( i == query . size () )
+            return true;
+    }
+    return false;
+}
+
+static
+bool HaveAVX2 ()
+{
+#if ( defined __GNUC__ || defined __clang__ ) && defined __x86_64__
+    return __builtin_cpu_supports ( "avx2" );
+#else
+    return false;
+#endif
+}
+
+TEST_CASE ( Nucstrstr_Vector_vs_Scan )
+{
+    srand ( 2024 );
+    for ( int iter = 0; iter < 2000; ++ iter )
+    {
+        string ref = RandomBases ( 1 + rand () % 400, "ACGT" );
+        string query;
+        if ( iter % 3 == 0 )
+            query = RandomBases ( 1 + rand () % 13, "ACGTNRY" );   // 4na
+        else
+        {
+            size_t qlen = 1 + rand () % 29;
+            if ( iter % 3 == 1 && qlen < ref . size () )
+                query = ref . substr ( rand () % ( ref . size () - qlen ), qlen );
+            else
+                query = RandomBases ( qlen, "ACGT" );
+        }
+
+        unsigned char buf2na [ 256 ];
+        ConvertAsciiTo2NAPacked ( ref, buf2na, sizeof buf2na );
+
+        NucStrstr *nss;
+        REQUIRE_EQ ( 0, NucStrstrMake ( & nss, 0, query . c_str (), ( unsigned int ) query . size () ) );
+
+        // the 128-bit code only starts on whole bytes
+        unsigned int pos = ( unsigned int ) ( rand () % ref . size () );
+        if ( ! HaveAVX2 () )
+            pos &= ~ 3;
+        unsigned int len = ( unsigned int ) ref . size () - pos;
+
+        bool expected = ScanFor ( ref, query, pos );
+        if ( expected != ( NucStrstrSearch ( nss, buf2na, pos, len, NULL ) != 0 ) )
+            FAIL ( ( "ref=" + ref + " query=" + query ) . c_str () );
+
+        NucStrstrWhack ( nss );
+    }
+}
+
+TEST_CASE ( Nucstrstr_SearchMany )
+{
+    const char * queries [] = { "ACGT", "TTTT", "GTACGTACG", "ACNNT", "CGTACGTACGTACGTACGTAC", "A", "GGGGGGGGGGGG", "!TACG", "TACG|CCCC", "RYRY" };
+    const size_t count = sizeof queries / sizeof queries [ 0 ];
+    const string ref = "ACGTACGTACGTACGTACGTACGTACGTACGTTGCAACGTACGTACGTACGTACGTACGT";
+
+    unsigned char buf2na [ 256 ];
+    ConvertAsciiTo2NAPacked ( ref, buf2na, sizeof buf2na );
+
+    NucStrstr * nss [ count ];
+    for ( size_t i = 0; i < count; ++ i )
+        REQUIRE_EQ ( 0, NucStrstrMake ( & nss [ i ], 0, queries [ i ], ( unsigned int ) strlen ( queries [ i ] ) ) );
+
+    int found [ count ];
+    unsigned int total = NucStrstrSearchMany ( nss, ( unsigned int ) count, buf2na, 0, ( unsigned int ) ref . size (), found );
+
+    unsigned int expected_total = 0;
+    for ( size_t i = 0; i < count; ++ i )
+    {
+        int expected = NucStrstrSearch ( nss [ i ], buf2na, 0, ( unsigned int ) ref . size (), NULL );
+        REQUIRE_EQ ( expected != 0, found [ i ] != 0 );
+        if ( expected != 0 )
+            ++ expected_total;
+        NucStrstrWhack ( nss [ i ] );
+    }
+    REQUIRE_EQ ( expected_total, total );
+    REQUIRE_NE ( 0u, total );
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
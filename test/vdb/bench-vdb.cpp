@@ -0,0 +1,416 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/*
+ * Microbenchmarks of the VDB read paths.
+ *
+ * A synthetic table is written through a write cursor, with one column
+ * per vxf codec, from a fixed pseudo-random sequence and with a fixed
+ * number of rows per blob, so that the same build produces the same
+ * table every time. Each benchmark is repeated and the fastest run is
+ * reported as one tab-separated line per benchmark and column:
+ *
+ *   bench  column  rows  bytes  seconds  rows_per_sec  mb_per_sec
+ *
+ * where "bytes" is the decoded size of the data read and MB is 10^6 bytes.
+ * Lines starting with '#' are comments.
+ */
+
+#include <vdb/manager.h>
+#include <vdb/schema.h>
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+#include <vdb/blob.h>
+#include <kfs/directory.h>
+#include <klib/printf.h>
+#include <klib/time.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+static
+string print_err ( const char * expr, rc_t rc )
+{
+    size_t num_writ;
+    char buffer [ 4096 ];
+    rc_t rc2 = string_printf ( buffer, sizeof buffer, & num_writ, "%s: rc = %R", expr, rc );
+    if ( rc2 != 0 )
+        return string ( "wow!" );
+    return string ( buffer, num_writ );
+}
+
+#define CALL( x ) \
+    if ( ( rc = x ) != 0 ) throw print_err ( #x, rc )
+
+static const char SchemaText [] =
+    "fmtdef izip_fmt;"
+    "fmtdef fzip_fmt;"
+    "fmtdef rle_fmt;"
+    "fmtdef zlib_fmt;"
+    "fmtdef bzip2_fmt;"
+    "fmtdef zstd_fmt;"
+    "function izip_fmt izip #2.1 ( any in ) = vdb:izip;"
+    "function any iunzip #2.1 ( izip_fmt in ) = vdb:iunzip;"
+    "function fzip_fmt fzip #1.0 < U32 mantissa > ( any in ) = vdb:fzip;"
+    "function any funzip #1.0 ( fzip_fmt in ) = vdb:funzip;"
+    "function rle_fmt rlencode #1.0 ( any in ) = vdb:rlencode;"
+    "function any rldecode #1.0 ( rle_fmt in ) = vdb:rldecode;"
+    "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+    "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+    "function bzip2_fmt bzip #1.0 < * U32 blockSize100k, U32 workFactor > ( any in ) = vdb:bzip;"
+    "function any bunzip #1.0 ( bzip2_fmt in ) = vdb:bunzip;"
+    "function zstd_fmt zstd #1.0 < * I32 level, ascii dict > ( any in ) = vdb:zstd;"
+    "function any unzstd #1.0 < * ascii dict > ( zstd_fmt in ) = vdb:unzstd;"
+    "physical < type T > T izip_encoding #1.0 { decode { return iunzip ( @ ); } encode { return izip ( @ ); } };"
+    "physical < type T > T fzip_encoding #1.0 < U32 mantissa > { decode { return funzip ( @ ); } encode { return fzip < mantissa > ( @ ); } };"
+    "physical < type T > T rle_encoding #1.0 { decode { return rldecode ( @ ); } encode { return rlencode ( @ ); } };"
+    "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+    "physical < type T > T bzip_encoding #1.0 { decode { return bunzip ( @ ); } encode { return bzip ( @ ); } };"
+    "physical < type T > T zstd_encoding #1.0 { decode { return unzstd ( @ ); } encode { return zstd ( @ ); } };"
+    "table bench_table #1.0.0 {"
+    "  column U32 raw_u32;"
+    "  column < U32 > izip_encoding izip_u32;"
+    "  column < U32 > rle_encoding rle_u32;"
+    "  column < U32 > zip_encoding zip_u32;"
+    "  column < U32 > zstd_encoding zstd_u32;"
+    "  column < F32 > fzip_encoding < 24 > fzip_f32;"
+    "  column ascii raw_ascii;"
+    "  column < ascii > zip_encoding zip_ascii;"
+    "  column < ascii > bzip_encoding bzip_ascii;"
+    "  column < ascii > zstd_encoding zstd_ascii;"
+    "};";
+
+/* what is generated for a column */
+enum Kind { kU32, kRunU32, kF32, kAscii };
+
+struct Column
+{
+    const char * name;
+    Kind kind;
+    uint32_t elem_bits;
+};
+
+static const Column Columns [] =
+{
+    { "raw_u32", kU32, 32 },
+    { "izip_u32", kU32, 32 },
+    { "rle_u32", kRunU32, 32 },
+    { "zip_u32", kU32, 32 },
+    { "zstd_u32", kU32, 32 },
+    { "fzip_f32", kF32, 32 },
+    { "raw_ascii", kAscii, 8 },
+    { "zip_ascii", kAscii, 8 },
+    { "bzip_ascii", kAscii, 8 },
+    { "zstd_ascii", kAscii, 8 }
+};
+
+static const size_t ColumnCount = sizeof Columns / sizeof Columns [ 0 ];
+
+/* fixed for reproducible tables */
+static const uint32_t RowsPerBlob = 4096;
+static const size_t CursorCacheBytes = 32 * 1024 * 1024;
+
+/* a small LCG, so the data does not depend on the C library */
+class Random
+{
+public:
+    Random ( uint64_t seed ) : m_state ( seed ) {}
+
+    uint32_t Next ()
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return ( uint32_t ) ( m_state >> 33 );
+    }
+
+private:
+    uint64_t m_state;
+};
+
+static
+void MakeCell ( const Column & col, int64_t row_id, Random & rnd, vector < char > & cell, uint32_t & count )
+{
+    switch ( col . kind )
+    {
+    case kU32:
+    case kRunU32:
+    {
+        count = 1 + rnd . Next () % 8;
+        cell . resize ( count * sizeof ( uint32_t ) );
+        uint32_t * v = reinterpret_cast < uint32_t* > ( & cell [ 0 ] );
+        for ( uint32_t i = 0; i < count; ++ i )
+        {
+            if ( col . kind == kRunU32 )
+                v [ i ] = ( uint32_t ) ( row_id / 64 );
+            else
+                v [ i ] = ( uint32_t ) row_id * 4 + rnd . Next () % 16;
+        }
+        break;
+    }
+    case kF32:
+    {
+        count = 1 + rnd . Next () % 8;
+        cell . resize ( count * sizeof ( float ) );
+        float * v = reinterpret_cast < float* > ( & cell [ 0 ] );
+        for ( uint32_t i = 0; i < count; ++ i )
+            v [ i ] = ( float ) ( rnd . Next () % 4000 ) / 100;
+        break;
+    }
+    case kAscii:
+    {
+        static const char bases [] = "ACGTACGTACGTACGN";
+        count = 80 + rnd . Next () % 41;
+        cell . resize ( count );
+        for ( uint32_t i = 0; i < count; ++ i )
+            cell [ i ] = bases [ rnd . Next () % 16 ];
+        break;
+    }
+    }
+}
+
+static
+void MakeTable ( VDBManager * mgr, const string & path, int64_t rows )
+{
+    rc_t rc;
+
+    VSchema * schema;
+    CALL ( VDBManagerMakeSchema ( mgr, & schema ) );
+    CALL ( VSchemaParseText ( schema, NULL, SchemaText, sizeof SchemaText - 1 ) );
+
+    VTable * tbl;
+    CALL ( VDBManagerCreateTable ( mgr, & tbl, schema, "bench_table",
+        ( KCreateMode ) ( kcmInit | kcmParents ), "%s", path . c_str () ) );
+    CALL ( VSchemaRelease ( schema ) );
+
+    VCursor * curs;
+    uint32_t idx [ ColumnCount ];
+    CALL ( VTableCreateCursorWrite ( tbl, & curs, kcmInsert ) );
+    for ( size_t c = 0; c < ColumnCount; ++ c )
+        CALL ( VCursorAddColumn ( curs, & idx [ c ], "%s", Columns [ c ] . name ) );
+    CALL ( VCursorOpen ( curs ) );
+
+    Random rnd ( 20161018 );
+    vector < char > cell;
+    for ( int64_t row_id = 1; row_id <= rows; ++ row_id )
+    {
+        CALL ( VCursorOpenRow ( curs ) );
+        for ( size_t c = 0; c < ColumnCount; ++ c )
+        {
+            uint32_t count = 0;
+            MakeCell ( Columns [ c ], row_id, rnd, cell, count );
+            CALL ( VCursorWrite ( curs, idx [ c ], Columns [ c ] . elem_bits, & cell [ 0 ], 0, count ) );
+        }
+        CALL ( VCursorCommitRow ( curs ) );
+        CALL ( VCursorCloseRow ( curs ) );
+        if ( row_id % RowsPerBlob == 0 )
+            CALL ( VCursorFlushPage ( curs ) );
+    }
+    CALL ( VCursorCommit ( curs ) );
+    CALL ( VCursorRelease ( curs ) );
+    CALL ( VTableRelease ( tbl ) );
+}
+
+/* rows and decoded bytes touched by one run */
+struct Work
+{
+    uint64_t rows;
+    uint64_t bytes;
+};
+
+typedef Work ( * BenchFunc ) ( const VCursor * curs, uint32_t idx, const Column & col, int64_t rows );
+
+static
+Work ScanRows ( const VCursor * curs, uint32_t idx, const Column & col, int64_t rows )
+{
+    rc_t rc;
+    Work w = { 0, 0 };
+    char buffer [ 4096 ];
+    uint32_t blen = sizeof buffer * 8 / col . elem_bits;
+
+    for ( int64_t row_id = 1; row_id <= rows; ++ row_id )
+    {
+        uint32_t row_len;
+        CALL ( VCursorReadDirect ( curs, row_id, idx, col . elem_bits, buffer, blen, & row_len ) );
+        w . rows += 1;
+        w . bytes += ( uint64_t ) row_len * col . elem_bits / 8;
+    }
+    return w;
+}
+
+static
+Work RandomRows ( const VCursor * curs, uint32_t idx, const Column & col, int64_t rows )
+{
+    rc_t rc;
+    Work w = { 0, 0 };
+    char buffer [ 4096 ];
+    uint32_t blen = sizeof buffer * 8 / col . elem_bits;
+
+    Random rnd ( 42 );
+    for ( int64_t i = 0; i < rows / 10; ++ i )
+    {
+        uint32_t row_len;
+        int64_t row_id = 1 + rnd . Next () % rows;
+        CALL ( VCursorReadDirect ( curs, row_id, idx, col . elem_bits, buffer, blen, & row_len ) );
+        w . rows += 1;
+        w . bytes += ( uint64_t ) row_len * col . elem_bits / 8;
+    }
+    return w;
+}
+
+static
+Work ScanBlobs ( const VCursor * curs, uint32_t idx, const Column & col, int64_t rows )
+{
+    rc_t rc;
+    Work w = { 0, 0 };
+
+    for ( int64_t row_id = 1; row_id <= rows; )
+    {
+        const VBlob * blob;
+        int64_t first;
+        uint64_t count;
+        size_t bytes;
+
+        CALL ( VCursorGetBlobDirect ( curs, & blob, row_id, idx ) );
+        CALL ( VBlobIdRange ( blob, & first, & count ) );
+        CALL ( VBlobSize ( blob, & bytes ) );
+        CALL ( VBlobRelease ( blob ) );
+
+        w . rows += count;
+        w . bytes += bytes;
+        row_id = first + ( int64_t ) count;
+    }
+    return w;
+}
+
+static
+void RunBench ( const VTable * tbl, const char * name, BenchFunc f, int64_t rows, uint32_t reps )
+{
+    rc_t rc;
+
+    for ( size_t c = 0; c < ColumnCount; ++ c )
+    {
+        const Column & col = Columns [ c ];
+        Work w = { 0, 0 };
+        uint64_t best_ns = 0;
+
+        for ( uint32_t r = 0; r < reps; ++ r )
+        {
+            /* fresh cursor, so that every run decodes every blob again */
+            const VCursor * curs;
+            uint32_t idx;
+            CALL ( VTableCreateCachedCursorRead ( tbl, & curs, CursorCacheBytes ) );
+            CALL ( VCursorAddColumn ( curs, & idx, "%s", col . name ) );
+            CALL ( VCursorOpen ( curs ) );
+
+            uint64_t start = KTimeNsStamp ();
+            w = f ( curs, idx, col, rows );
+            uint64_t ns = KTimeNsStamp () - start;
+
+            CALL ( VCursorRelease ( curs ) );
+
+            if ( r == 0 || ns < best_ns )
+                best_ns = ns;
+        }
+
+        double seconds = best_ns == 0 ? 1e-9 : best_ns / 1e9;
+        char line [ 256 ];
+        snprintf ( line, sizeof line, "%s\t%s\t%lu\t%lu\t%.6f\t%.0f\t%.2f",
+            name, col . name, ( unsigned long ) w . rows, ( unsigned long ) w . bytes,
+            seconds, w . rows / seconds, w . bytes / seconds / 1e6 );
+        cout << line << endl;
+    }
+}
+
+static
+int Usage ( const char * prog )
+{
+    cerr << "Usage: " << prog << " [ --rows N ] [ --reps N ] [ --dir PATH ]" << endl;
+    return 1;
+}
+
+int main ( int argc, char * argv [] )
+{
+    int64_t rows = 200000;
+    uint32_t reps = 3;
+    string dir = "db/bench-vdb";
+
+    for ( int i = 1; i < argc; ++ i )
+    {
+        if ( i + 1 < argc && strcmp ( argv [ i ], "--rows" ) == 0 )
+            rows = strtol ( argv [ ++ i ], NULL, 10 );
+        else if ( i + 1 < argc && strcmp ( argv [ i ], "--reps" ) == 0 )
+            reps = strtoul ( argv [ ++ i ], NULL, 10 );
+        else if ( i + 1 < argc && strcmp ( argv [ i ], "--dir" ) == 0 )
+            dir = argv [ ++ i ];
+        else
+            return Usage ( argv [ 0 ] );
+    }
+    if ( rows <= 0 || reps == 0 )
+        return Usage ( argv [ 0 ] );
+
+    try
+    {
+        rc_t rc;
+        VDBManager * mgr;
+        CALL ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+
+        MakeTable ( mgr, dir, rows );
+
+        const VTable * tbl;
+        CALL ( VDBManagerOpenTableRead ( mgr, & tbl, NULL, "%s", dir . c_str () ) );
+
+        cout << "# bench-vdb rows=" << rows << " reps=" << reps
+             << " rows_per_blob=" << RowsPerBlob << endl;
+        cout << "# bench\tcolumn\trows\tbytes\tseconds\trows_per_sec\tmb_per_sec" << endl;
+
+        RunBench ( tbl, "scan", ScanRows, rows, reps );
+        RunBench ( tbl, "random", RandomRows, rows, reps );
+        RunBench ( tbl, "blob", ScanBlobs, rows, reps );
+
+        CALL ( VTableRelease ( tbl ) );
+        CALL ( VDBManagerRelease ( mgr ) );
+
+        KDirectory * wd;
+        if ( KDirectoryNativeDir ( & wd ) == 0 )
+        {
+            KDirectoryRemove ( wd, true, "%s", dir . c_str () );
+            KDirectoryRelease ( wd );
+        }
+    }
+    catch ( string & x )
+    {
+        cerr << "failed: " << x << endl;
+        return 2;
+    }
+
+    return 0;
+}
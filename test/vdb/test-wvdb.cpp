@@ -28,6 +28,7 @@
 #include <vdb/database.h>
 #include <vdb/table.h>
 #include <vdb/cursor.h>
+#include <vdb/blob.h>
 #include <vdb/schema.h> /* VSchemaRelease */
 #include <vdb/vdb-priv.h>
 
@@ -36,11 +37,22 @@
 #include <kdb/meta.h>
 #include <kdb/table.h>
 
+#include <kproc/threadpool.h>
+
+extern "C" {
+    #include <../libs/vdb/blob-priv.h>
+    #include <../libs/vdb/page-map.h>
+}
+// use the exported functions rather than the library-internal macros
+#undef VBlobAddRef
+#undef VBlobRelease
+
 #include <ktst/unit_test.hpp> // TEST_CASE
 
 #include <sysalloc.h>
 
 #include <sstream>
+#include <vector>
 #include <cstdlib>
 
 using namespace std;
@@ -487,6 +499,1132 @@ FIXTURE_TEST_CASE ( VCursor_FindNextRowIdDirect, WVDB_Fixture )
 }
 
 
+FIXTURE_TEST_CASE ( VTable_SharedBlobCache, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText = "table table1 #1.0.0 { column ascii column1; };"
+                        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const char* ColumnName = "column1";
+    // enough rows for blobs to start and end in different spans of the cache
+    const int RowCount = 40000;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, ColumnName ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( int i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    REQUIRE_RC ( VTableSetSharedBlobCacheCapacity ( table, 64 * 1024 * 1024 ) );
+
+    const VCursor* cursors [ 2 ];
+    uint32_t column_idx [ 2 ];
+    for ( int c = 0; c < 2; ++ c )
+    {
+        REQUIRE_RC ( VTableCreateCachedCursorRead ( table, & cursors [ c ], 1024 * 1024 ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursors [ c ], & column_idx [ c ], ColumnName ) );
+        REQUIRE_RC ( VCursorOpen ( cursors [ c ] ) );
+    }
+
+    for ( int i = 0; i < RowCount; ++ i )
+    {
+        ostringstream out;
+        out << i;
+        for ( int c = 0; c < 2; ++ c )
+        {
+            char buf [ 16 ];
+            uint32_t row_len;
+            REQUIRE_RC ( VCursorReadDirect ( cursors [ c ], i + 1, column_idx [ c ], 8, buf, sizeof buf, & row_len ) );
+            REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+        }
+    }
+
+    VCursorColumnStats stats;
+    REQUIRE_RC ( VCursorGetStats ( cursors [ 1 ], column_idx [ 1 ], & stats ) );
+    REQUIRE_NE ( ( uint64_t ) 0, stats . shared_hits );
+    REQUIRE_EQ ( ( uint64_t ) 0, stats . prefetch_hits );
+
+    // a cursor without a blob cache of its own reads through the shared one too
+    const VCursor* plain;
+    uint32_t plain_idx;
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & plain ) );
+    REQUIRE_RC ( VCursorAddColumn ( plain, & plain_idx, ColumnName ) );
+    REQUIRE_RC ( VCursorOpen ( plain ) );
+
+    // every cursor must see the very blob decoded by the first one
+    const int rows [] = { 1, RowCount / 2, RowCount - 1 };
+    for ( size_t r = 0; r < sizeof rows / sizeof rows [ 0 ]; ++ r )
+    {
+        const VBlob* blobs [ 3 ];
+        for ( int c = 0; c < 2; ++ c )
+            REQUIRE_RC ( VCursorGetBlobDirect ( cursors [ c ], & blobs [ c ], rows [ r ], column_idx [ c ] ) );
+        REQUIRE_RC ( VCursorGetBlobDirect ( plain, & blobs [ 2 ], rows [ r ], plain_idx ) );
+        REQUIRE_EQ ( blobs [ 0 ], blobs [ 1 ] );
+        REQUIRE_EQ ( blobs [ 0 ], blobs [ 2 ] );
+        for ( int c = 0; c < 3; ++ c )
+            REQUIRE_RC ( VBlobRelease ( blobs [ c ] ) );
+    }
+    REQUIRE_RC ( VCursorGetStats ( plain, plain_idx, & stats ) );
+    REQUIRE_EQ ( ( uint64_t ) 3, stats . shared_hits );
+
+    for ( int c = 0; c < 2; ++ c )
+        REQUIRE_RC ( VCursorRelease ( cursors [ c ] ) );
+    REQUIRE_RC ( VCursorRelease ( plain ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( VCursor_ReadAhead, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText = "table table1 #1.0.0 { column ascii column1; column U32 column2; };"
+                        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const int RowCount = 2000;
+    const int RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx [ 2 ];
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 0 ], 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 1 ], 32, & i, 0, 1 ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+
+    const VCursor* cursor;
+    uint32_t column_idx [ 2 ];
+    REQUIRE_RC ( VTableCreateCachedCursorRead ( table, & cursor, 1024 * 1024 ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+    REQUIRE_RC_FAIL ( VCursorSetReadAhead ( cursor, 4 ) ); // not open yet
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+    REQUIRE_RC ( VCursorSetReadAhead ( cursor, 4 ) );
+
+    // a sequential pass, then a jump backwards into the middle
+    const int starts [] = { 0, RowCount / 2 - RowsPerBlob / 2 };
+    for ( size_t s = 0; s < sizeof starts / sizeof starts [ 0 ]; ++ s )
+    {
+        for ( uint32_t i = starts [ s ]; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            char buf [ 16 ];
+            uint32_t row_len;
+            REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 0 ], 8, buf, sizeof buf, & row_len ) );
+            REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+
+            uint32_t val;
+            REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & val, 1, & row_len ) );
+            REQUIRE_EQ ( i, val );
+        }
+    }
+
+    // jumps forward past the blob being prefetched
+    for ( uint32_t i = 0; i < RowCount; i += 3 * RowsPerBlob + 7 )
+    {
+        uint32_t val, row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & val, 1, & row_len ) );
+        REQUIRE_EQ ( i, val );
+    }
+
+    // a window larger than is sane is clamped rather than allocated
+    REQUIRE_RC ( VCursorSetReadAhead ( cursor, UINT32_MAX ) );
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        uint32_t val, row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & val, 1, & row_len ) );
+        REQUIRE_EQ ( i, val );
+    }
+
+    REQUIRE_RC ( VCursorSetReadAhead ( cursor, 0 ) );
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( VCursor_ReadRange, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText = "table table1 #1.0.0 { column ascii column1; };"
+                        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const char* ColumnName = "column1";
+    const uint32_t RowCount = 1000;
+    const uint32_t RowsPerBlob = 64;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, ColumnName ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx;
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, ColumnName ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    // copying reads cross blob boundaries and stop on a full buffer
+    uint32_t row_lens [ RowCount ];
+    uint32_t rows_read;
+    char buf [ 4 * RowCount ];
+    REQUIRE_RC_FAIL ( VCursorReadRange ( cursor, 1, column_idx, 8, buf, 0, row_lens, RowCount, & rows_read ) );
+    REQUIRE_EQ ( 0u, rows_read );
+    REQUIRE_EQ ( 1u, row_lens [ 0 ] );
+
+    uint32_t first = 0;
+    while ( first < RowCount )
+    {
+        REQUIRE_RC ( VCursorReadRange ( cursor, first + 1, column_idx, 8, buf, 300, row_lens, RowCount, & rows_read ) );
+        REQUIRE_NE ( 0u, rows_read );
+        const char* p = buf;
+        for ( uint32_t i = 0; i < rows_read; ++ i )
+        {
+            ostringstream out;
+            out << first + i;
+            REQUIRE_EQ ( out.str(), string ( p, row_lens [ i ] ) );
+            p += row_lens [ i ];
+        }
+        first += rows_read;
+    }
+    REQUIRE_EQ ( RowCount, first );
+
+    // zero-copy access is limited to one blob
+    const VBlob* blob;
+    uint32_t elem_bits;
+    const void* base;
+    uint32_t offsets [ RowCount ];
+    REQUIRE_RC ( VCursorCellRangeDirect ( cursor, 11, column_idx, & blob, & elem_bits, & base,
+                                          offsets, row_lens, RowCount, & rows_read ) );
+    REQUIRE_EQ ( 8u, elem_bits );
+    REQUIRE_EQ ( RowsPerBlob - 10, rows_read );
+    for ( uint32_t i = 0; i < rows_read; ++ i )
+    {
+        ostringstream out;
+        out << 10 + i;
+        REQUIRE_EQ ( out.str(), string ( ( const char* ) base + offsets [ i ], row_lens [ i ] ) );
+    }
+    REQUIRE_RC ( VBlobRelease ( blob ) );
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( VCursor_BatchedColumnReads, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText = "table table1 #1.0.0 { column ascii column1; column U32 column2; column U64 column3; };"
+                        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const uint32_t RowCount = 1000;
+    const uint32_t RowsPerBlob = 50;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx [ 3 ];
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 2 ], "column3" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            uint64_t wide = ( uint64_t ) i << 32;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 0 ], 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 1 ], 32, & i, 0, 1 ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 2 ], 64, & wide, 0, 1 ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx [ 3 ];
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 2 ], "column3" ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    // once every column has been read, a blob miss in one column fetches the
+    // blobs of the others along with it; check sequential reads, jumps,
+    // and rows where only some columns are read
+    const uint32_t rows [] = { 0, 1, 49, 50, 51, 120, 99, 500, 501, 999, 0, 733, 734, 260 };
+    for ( uint32_t pass = 0; pass < 2; ++ pass )
+    {
+        for ( size_t r = 0; r < sizeof rows / sizeof rows [ 0 ] + RowCount; ++ r )
+        {
+            uint32_t i = r < RowCount ? ( uint32_t ) r : rows [ r - RowCount ];
+            bool all = pass == 0 || i % 3 == 0;
+
+            char buf [ 16 ];
+            uint32_t row_len;
+            if ( all || i % 3 == 1 )
+            {
+                ostringstream out;
+                out << i;
+                REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 0 ], 8, buf, sizeof buf, & row_len ) );
+                REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+            }
+
+            uint32_t val;
+            REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & val, 1, & row_len ) );
+            REQUIRE_EQ ( i, val );
+
+            if ( all )
+            {
+                uint64_t wide;
+                REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 2 ], 64, & wide, 1, & row_len ) );
+                REQUIRE_EQ ( ( uint64_t ) i << 32, wide );
+            }
+        }
+    }
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( VCursor_BatchedColumnReadsDecodeAhead, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText =
+        "fmtdef zlib_fmt;"
+        "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+        "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+        "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+        "table table1 #1.0.0 { column < ascii > zip_encoding column1; column < U32 > zip_encoding column2; };"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const uint32_t RowCount = 3000;
+    const uint32_t RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx [ 2 ];
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << "row " << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 0 ], 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 1 ], 32, & i, 0, 1 ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VDBManager* mgr;
+    REQUIRE_RC ( VDatabaseOpenManagerRead ( m_db, & mgr ) );
+    REQUIRE_RC ( VDBManagerSetDecodeThreads ( mgr, 4 ) );
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx [ 2 ];
+    REQUIRE_RC ( VTableCreateCachedCursorRead ( table, & cursor, 1024 * 1024 ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 0 ], "column1" ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ 1 ], "column2" ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    // both columns decode ahead of the reader; staging must neither
+    // fetch blobs a column already read ahead nor drop staged blobs
+    // before they are used, so every blob is read exactly once
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        ostringstream out;
+        out << "row " << i;
+        char buf [ 16 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 0 ], 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+
+        uint32_t val;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & val, 1, & row_len ) );
+        REQUIRE_EQ ( i, val );
+    }
+
+    for ( uint32_t c = 0; c < 2; ++ c )
+    {
+        VCursorColumnStats stats;
+        REQUIRE_RC ( VCursorGetStats ( cursor, column_idx [ c ], & stats ) );
+        REQUIRE_EQ ( ( uint64_t ) ( RowCount / RowsPerBlob ), stats . blobs_read );
+    }
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+    REQUIRE_RC ( VDBManagerSetDecodeThreads ( mgr, 0 ) );
+    REQUIRE_RC ( VDBManagerRelease ( mgr ) );
+}
+
+FIXTURE_TEST_CASE ( VDBManager_DecodeThreads, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText =
+        "fmtdef zlib_fmt;"
+        "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+        "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+        "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+        "table table1 #1.0.0 { column < ascii > zip_encoding column1; };"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const char* ColumnName = "column1";
+    const uint32_t RowCount = 5000;
+    const uint32_t RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, ColumnName ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << "row " << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VDBManager* mgr;
+    REQUIRE_RC ( VDatabaseOpenManagerRead ( m_db, & mgr ) );
+    REQUIRE_RC ( VDBManagerSetDecodeThreads ( mgr, 4 ) );
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx;
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, ColumnName ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    // a sequential pass, a jump backwards and a skip past the window
+    const uint32_t starts [] = { 0, RowCount / 2, RowsPerBlob * 3 / 2 };
+    for ( size_t s = 0; s < sizeof starts / sizeof starts [ 0 ]; ++ s )
+    {
+        for ( uint32_t i = starts [ s ]; i < RowCount; i += ( s == 2 ? RowsPerBlob * 11 : 1 ) )
+        {
+            ostringstream out;
+            out << "row " << i;
+            char buf [ 32 ];
+            uint32_t row_len;
+            REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx, 8, buf, sizeof buf, & row_len ) );
+            REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+        }
+    }
+
+    // release with decoding in progress
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+    REQUIRE_RC ( VDBManagerSetDecodeThreads ( mgr, 0 ) );
+    REQUIRE_RC ( VDBManagerRelease ( mgr ) );
+}
+
+FIXTURE_TEST_CASE ( VCursor_ParallelEncoding, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    // column4 is constant and stays static
+    string schemaText =
+        "fmtdef zlib_fmt;"
+        "fmtdef izip_fmt;"
+        "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+        "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+        "function izip_fmt izip #2.1 ( any in ) = vdb:izip;"
+        "function any iunzip #2.1 ( izip_fmt in ) = vdb:iunzip;"
+        "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+        "physical < type T > T izip_encoding #1.0 { decode { return iunzip ( @ ); } encode { return izip ( @ ); } };"
+        "table table1 #1.0.0 {"
+        "  column < ascii > zip_encoding column1;"
+        "  column < U32 > izip_encoding column2;"
+        "  column < U64 > izip_encoding column3;"
+        "  column < U32 > izip_encoding column4;"
+        "};"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const char* ColumnNames [] = { "column1", "column2", "column3", "column4" };
+    const uint32_t RowCount = 3000;
+    const uint32_t RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx [ 4 ];
+        for ( uint32_t c = 0; c < 4; ++ c )
+            REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ c ], ColumnNames [ c ] ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << "row " << i;
+            uint32_t narrow = i * 7;
+            uint64_t wide = ( uint64_t ) i << 32;
+            uint32_t constant = 42;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 0 ], 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 1 ], 32, & narrow, 0, 1 ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 2 ], 64, & wide, 0, 1 ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 3 ], 32, & constant, 0, 1 ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx [ 4 ];
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    for ( uint32_t c = 0; c < 4; ++ c )
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ c ], ColumnNames [ c ] ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    bool is_static;
+    REQUIRE_RC ( VCursorIsStaticColumn ( cursor, column_idx [ 3 ], & is_static ) );
+    REQUIRE ( is_static );
+
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        ostringstream out;
+        out << "row " << i;
+        char buf [ 32 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 0 ], 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+
+        uint32_t narrow;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 32, & narrow, 1, & row_len ) );
+        REQUIRE_EQ ( i * 7, narrow );
+
+        uint64_t wide;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 2 ], 64, & wide, 1, & row_len ) );
+        REQUIRE_EQ ( ( uint64_t ) i << 32, wide );
+
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 3 ], 32, & narrow, 1, & row_len ) );
+        REQUIRE_EQ ( 42u, narrow );
+    }
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( ZstdEncoding, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    // column2 is encoded with a dictionary kept in the table metadata
+    string schemaText =
+        "fmtdef zstd_fmt;"
+        "function zstd_fmt zstd #1.0 < * I32 level, ascii dict > ( any in ) = vdb:zstd;"
+        "function any unzstd #1.0 < * ascii dict > ( zstd_fmt in ) = vdb:unzstd;"
+        "physical < type T > T zstd_encoding #1.0 < * I32 level, ascii dict >"
+        "  { decode { return unzstd < dict > ( @ ); } encode { return zstd < level, dict > ( @ ); } };"
+        "table table1 #1.0.0 {"
+        "  column < ascii > zstd_encoding column1;"
+        "  column < ascii > zstd_encoding < 5, 'zstd/dict' > column2;"
+        "  column < U32 > zstd_encoding < -1 > column3;"
+        "};"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const char* ColumnNames [] = { "column1", "column2", "column3" };
+    const string Dict = "AGCTTTTCATTCTGACTGCAACGGGCAATATGTCTCTGTGTGGATTAAAAAAAGAGTGTCTGATAGCAGC";
+    const uint32_t RowCount = 2000;
+    const uint32_t RowsPerBlob = 250;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+        {
+            KMetadata* meta;
+            REQUIRE_RC ( VTableOpenMetadataUpdate ( table, & meta ) );
+            KMDataNode* node;
+            REQUIRE_RC ( KMetadataOpenNodeUpdate ( meta, & node, "zstd/dict" ) );
+            REQUIRE_RC ( KMDataNodeWrite ( node, Dict.c_str(), Dict.size() ) );
+            REQUIRE_RC ( KMDataNodeRelease ( node ) );
+            REQUIRE_RC ( KMetadataRelease ( meta ) );
+        }
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx [ 3 ];
+        for ( uint32_t c = 0; c < 3; ++ c )
+            REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ c ], ColumnNames [ c ] ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << "row " << i;
+            string bases = Dict.substr ( i % 17, 40 );
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 0 ], 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 1 ], 8, bases.c_str(), 0, bases.size() ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx [ 2 ], 32, & i, 0, 1 ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx [ 3 ];
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    for ( uint32_t c = 0; c < 3; ++ c )
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx [ c ], ColumnNames [ c ] ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        ostringstream out;
+        out << "row " << i;
+        char buf [ 64 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 0 ], 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 1 ], 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( Dict.substr ( i % 17, 40 ), string ( buf, row_len ) );
+        uint32_t val;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx [ 2 ], 32, & val, 1, & row_len ) );
+        REQUIRE_EQ ( i, val );
+    }
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+// alternating runs of equidistant, repeated and variable-length rows make a page map of many regions
+static
+void MakeManyRegions ( PageMap * pm, vector < uint32_t > & offset, vector < uint32_t > & length, uint32_t groups = 300 )
+{
+    uint32_t data_offset = 0;
+    for ( uint32_t i = 0; i < groups; ++ i )
+    {
+        for ( uint32_t j = 0; j < 10; ++ j )
+        {
+            THROW_ON_RC ( PageMapAppendRow ( pm, 5 + i % 3, false ) );
+            offset . push_back ( data_offset );
+            length . push_back ( 5 + i % 3 );
+            data_offset += 5 + i % 3;
+        }
+        THROW_ON_RC ( PageMapAppendRow ( pm, 9, false ) );
+        offset . push_back ( data_offset );
+        length . push_back ( 9 );
+        for ( uint32_t j = 1; j < 10; ++ j )
+        {
+            THROW_ON_RC ( PageMapAppendRow ( pm, 9, true ) );
+            offset . push_back ( data_offset );
+            length . push_back ( 9 );
+        }
+        data_offset += 9;
+        for ( uint32_t j = 0; j < 3; ++ j )
+        {
+            THROW_ON_RC ( PageMapAppendRow ( pm, 20 + j * 7 + i % 5, false ) );
+            offset . push_back ( data_offset );
+            length . push_back ( 20 + j * 7 + i % 5 );
+            data_offset += 20 + j * 7 + i % 5;
+        }
+    }
+}
+
+TEST_CASE ( PageMap_RowIndex )
+{
+    vector < uint32_t > offset, length;
+    PageMap * pm;
+    REQUIRE_RC ( PageMapNew ( & pm, 16 ) );
+    MakeManyRegions ( pm, offset, length );
+    REQUIRE_EQ ( ( size_t ) 0, PageMapRowIndexBytes ( pm ) );
+
+    // random lookups build the index lazily; every row must resolve as before
+    for ( uint32_t k = 0; k < 2; ++ k )
+    {
+        for ( uint32_t i = 0; i < offset . size (); ++ i )
+        {
+            uint32_t row = ( uint32_t ) ( ( i * 2654435761u ) % offset . size () );
+            uint32_t data_offset, data_length;
+            REQUIRE_RC ( PageMapFindRow ( pm, row, & data_offset, & data_length, NULL ) );
+            REQUIRE_EQ ( offset [ row ], data_offset );
+            REQUIRE_EQ ( length [ row ], data_length );
+        }
+        REQUIRE_NE ( ( size_t ) 0, PageMapRowIndexBytes ( pm ) );
+        REQUIRE ( PageMapRowIndexBytes ( pm ) <= ( size_t ) pm -> exp_rgn_cnt * sizeof ( pm_size_t ) );
+    }
+    REQUIRE_RC ( PageMapRelease ( pm ) );
+
+    // fully expanding the map builds it up front
+    REQUIRE_RC ( PageMapNew ( & pm, 16 ) );
+    offset . clear ();
+    length . clear ();
+    MakeManyRegions ( pm, offset, length );
+    REQUIRE_RC ( PageMapExpandAll ( pm ) );
+    REQUIRE_NE ( ( size_t ) 0, PageMapRowIndexBytes ( pm ) );
+    for ( uint32_t row = 0; row < offset . size (); ++ row )
+    {
+        uint32_t data_offset, data_length;
+        REQUIRE_RC ( PageMapFindRow ( pm, row, & data_offset, & data_length, NULL ) );
+        REQUIRE_EQ ( offset [ row ], data_offset );
+        REQUIRE_EQ ( length [ row ], data_length );
+    }
+    REQUIRE_RC ( PageMapRelease ( pm ) );
+}
+
+TEST_CASE ( PageMap_PublishedIsReadOnly )
+{
+    // a published map may be shared between threads: lookups must not write to it,
+    // whether or not it has enough regions for a row index
+    for ( uint32_t groups = 2; groups <= 300; groups += 298 )
+    {
+        vector < uint32_t > offset, length;
+        PageMap * pm;
+        REQUIRE_RC ( PageMapNew ( & pm, 16 ) );
+        MakeManyRegions ( pm, offset, length, groups );
+        REQUIRE_RC ( PageMapExpandAll ( pm ) );
+        REQUIRE ( pm -> published );
+
+        vector < char > before ( ( const char * ) pm, ( const char * ) ( pm + 1 ) );
+        for ( uint32_t i = 0; i < offset . size (); ++ i )
+        {
+            uint32_t row = ( uint32_t ) ( ( i * 2654435761u ) % offset . size () );
+            uint32_t data_offset, data_length;
+            REQUIRE_RC ( PageMapFindRow ( pm, row, & data_offset, & data_length, NULL ) );
+            REQUIRE_EQ ( offset [ row ], data_offset );
+            REQUIRE_EQ ( length [ row ], data_length );
+
+            PageMapIterator iter;
+            REQUIRE_RC ( PageMapNewIterator ( pm, & iter, row, 1 ) );
+            REQUIRE_EQ ( offset [ row ], PageMapIteratorDataOffset ( & iter ) );
+        }
+        REQUIRE ( memcmp ( & before [ 0 ], pm, sizeof * pm ) == 0 );
+        REQUIRE_RC ( PageMapRelease ( pm ) );
+    }
+}
+
+FIXTURE_TEST_CASE ( RecycledAllocations, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText = "table table1 #1.0.0 { column ascii column1; };"
+                        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const uint32_t RowCount = 2000;
+    const uint32_t RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    uint64_t blob_reuses, pm_reuses, buffer_reuses;
+    VBlobGetAllocStats ( NULL, & blob_reuses );
+    PageMapGetAllocStats ( NULL, & pm_reuses );
+    KDataBufferGetAllocStats ( NULL, & buffer_reuses );
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx;
+    REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        ostringstream out;
+        out << i;
+        char buf [ 16 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx, 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( out.str(), string ( buf, row_len ) );
+    }
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+
+    // every blob after the first few reuses the storage of a released one
+    uint64_t allocs, reuses;
+    VBlobGetAllocStats ( & allocs, & reuses );
+    REQUIRE_GT ( reuses, blob_reuses + RowCount / RowsPerBlob / 2 );
+    PageMapGetAllocStats ( & allocs, & reuses );
+    REQUIRE_GT ( reuses, pm_reuses + RowCount / RowsPerBlob / 2 );
+    KDataBufferGetAllocStats ( & allocs, & reuses );
+    REQUIRE_GT ( reuses, buffer_reuses + RowCount / RowsPerBlob / 2 );
+}
+
+static
+rc_t CC AppendToString ( void *dst, const void *buffer, size_t bsize )
+{
+    static_cast < string* > ( dst ) -> append ( static_cast < const char* > ( buffer ), bsize );
+    return 0;
+}
+
+static
+void CC CountFunction ( const char *name, uint64_t calls, uint64_t decode_ns, void *data )
+{
+    if ( string ( name ) == "unzip" )
+        * static_cast < uint64_t* > ( data ) += calls;
+}
+
+FIXTURE_TEST_CASE ( VCursor_Stats, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText =
+        "fmtdef zlib_fmt;"
+        "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+        "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+        "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+        "table table1 #1.0.0 { column < ascii > zip_encoding column1; };"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+    const uint32_t RowCount = 1000;
+    const uint32_t RowsPerBlob = 100;
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+
+        for ( uint32_t i = 0; i < RowCount; ++ i )
+        {
+            ostringstream out;
+            out << "row " << i;
+            REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+            REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, out.str().c_str(), 0, out.str().size() ) );
+            REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+            REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+            if ( ( i + 1 ) % RowsPerBlob == 0 )
+                REQUIRE_RC ( VCursorFlushPage ( cursor ) );
+        }
+
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+
+    const VTable* table;
+    REQUIRE_RC ( VDatabaseOpenTableRead ( m_db , & table, TableName ) );
+    const VCursor* cursor;
+    uint32_t column_idx;
+    REQUIRE_RC ( VTableCreateCachedCursorRead ( table, & cursor, 1024 * 1024 ) );
+    REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+    REQUIRE_RC ( VCursorOpen ( cursor ) );
+    for ( uint32_t i = 0; i < RowCount; ++ i )
+    {
+        char buf [ 16 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, i + 1, column_idx, 8, buf, sizeof buf, & row_len ) );
+    }
+
+    VCursorColumnStats stats;
+    REQUIRE_RC ( VCursorGetStats ( cursor, column_idx, & stats ) );
+    REQUIRE_EQ ( ( uint64_t ) ( RowCount / RowsPerBlob ), stats . blobs_read );
+    REQUIRE_EQ ( stats . blobs_read, stats . cache_misses );
+    REQUIRE_EQ ( ( uint64_t ) ( RowCount - RowCount / RowsPerBlob ), stats . cache_hits );
+    REQUIRE_GT ( stats . raw_bytes, ( uint64_t ) 0 );
+    REQUIRE_GT ( stats . decoded_bytes, stats . raw_bytes );
+
+    uint64_t unzip_calls = 0;
+    REQUIRE_RC ( VCursorListFunctionStats ( cursor, column_idx, CountFunction, & unzip_calls ) );
+    REQUIRE_EQ ( stats . blobs_read, unzip_calls );
+
+    string dump;
+    REQUIRE_RC ( VCursorDumpStats ( cursor, AppendToString, & dump ) );
+    REQUIRE_EQ ( string ( "column1: " ), dump . substr ( 0, 9 ) );
+    REQUIRE_NE ( string::npos, dump . find ( "    unzip: calls " ) );
+
+    REQUIRE_RC_FAIL ( VCursorGetStats ( cursor, column_idx + 1, & stats ) );
+
+    REQUIRE_RC ( VCursorRelease ( cursor ) );
+    REQUIRE_RC ( VTableRelease ( table ) );
+}
+
+FIXTURE_TEST_CASE ( VDBManager_SchemaCache, WVDB_Fixture )
+{
+    m_databaseName = ScratchDir + GetName();
+    RemoveDatabase();
+
+    string schemaText =
+        "fmtdef zlib_fmt;"
+        "function zlib_fmt zip #1.0 < * I32 strategy, I32 level > ( any in ) = vdb:zip;"
+        "function any unzip #1.0 ( zlib_fmt in ) = vdb:unzip;"
+        "physical < type T > T zip_encoding #1.0 { decode { return unzip ( @ ); } encode { return zip ( @ ); } };"
+        "table table1 #1.0.0 { column < ascii > zip_encoding column1; };"
+        "database root_database #1 { table table1 #1 TABLE1; } ;";
+
+    const char* TableName = "TABLE1";
+
+    MakeDatabase ( schemaText, "root_database" );
+    {
+        VTable* table;
+        REQUIRE_RC ( VDatabaseCreateTable ( m_db , & table, TableName, kcmInit + kcmMD5, TableName ) );
+
+        VCursor* cursor;
+        REQUIRE_RC ( VTableCreateCursorWrite ( table, & cursor, kcmInsert ) );
+        uint32_t column_idx;
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+        REQUIRE_RC ( VCursorOpenRow ( cursor ) );
+        REQUIRE_RC ( VCursorWrite ( cursor, column_idx, 8, "row 1", 0, 5 ) );
+        REQUIRE_RC ( VCursorCommitRow ( cursor ) );
+        REQUIRE_RC ( VCursorCloseRow ( cursor ) );
+        REQUIRE_RC ( VCursorCommit ( cursor ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+    }
+    REQUIRE_RC ( VDatabaseRelease ( m_db ) );
+    m_db = 0;
+
+    VDBManager* mgr;
+    REQUIRE_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+    REQUIRE_RC ( VDBManagerSetSchemaCacheEntries ( mgr, 8 ) );
+
+    const VSchema* first = 0;
+    for ( int i = 0; i < 3; ++ i )
+    {
+        const VDatabase* db;
+        REQUIRE_RC ( VDBManagerOpenDBRead ( mgr, & db, NULL, "%s", m_databaseName . c_str () ) );
+
+        const VTable* table;
+        REQUIRE_RC ( VDatabaseOpenTableRead ( db, & table, TableName ) );
+        const VCursor* cursor;
+        uint32_t column_idx;
+        REQUIRE_RC ( VTableCreateCursorRead ( table, & cursor ) );
+        REQUIRE_RC ( VCursorAddColumn ( cursor, & column_idx, "column1" ) );
+        REQUIRE_RC ( VCursorOpen ( cursor ) );
+        char buf [ 16 ];
+        uint32_t row_len;
+        REQUIRE_RC ( VCursorReadDirect ( cursor, 1, column_idx, 8, buf, sizeof buf, & row_len ) );
+        REQUIRE_EQ ( string ( "row 1" ), string ( buf, row_len ) );
+        REQUIRE_RC ( VCursorRelease ( cursor ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+
+        // every open of the database shares the parsed schema
+        const VSchema* schema;
+        REQUIRE_RC ( VDatabaseOpenSchema ( db, & schema ) );
+        if ( first == 0 )
+            first = schema;
+        else
+        {
+            REQUIRE_EQ ( first, schema );
+            REQUIRE_RC ( VSchemaRelease ( schema ) );
+        }
+
+        REQUIRE_RC ( VDatabaseRelease ( db ) );
+    }
+    REQUIRE_RC ( VSchemaRelease ( first ) );
+
+    // the database was parsed once, its table once against the cached database schema
+    VDBManagerSchemaCacheStats stats;
+    REQUIRE_RC ( VDBManagerGetSchemaCacheStats ( mgr, & stats ) );
+    REQUIRE_EQ ( ( uint64_t ) 2, stats . misses );
+    REQUIRE_EQ ( ( uint64_t ) 4, stats . hits );
+    REQUIRE_EQ ( ( uint64_t ) 0, stats . uncached );
+    REQUIRE_EQ ( ( uint32_t ) 2, stats . entries );
+    REQUIRE_GT ( stats . parse_ns, ( uint64_t ) 0 );
+    REQUIRE_GT ( stats . saved_ns, ( uint64_t ) 0 );
+
+    // disabling drops the entries, and opens parse privately
+    REQUIRE_RC ( VDBManagerSetSchemaCacheEntries ( mgr, 0 ) );
+    {
+        const VDatabase* db;
+        REQUIRE_RC ( VDBManagerOpenDBRead ( mgr, & db, NULL, "%s", m_databaseName . c_str () ) );
+        const VTable* table;
+        REQUIRE_RC ( VDatabaseOpenTableRead ( db, & table, TableName ) );
+        REQUIRE_RC ( VTableRelease ( table ) );
+        REQUIRE_RC ( VDatabaseRelease ( db ) );
+    }
+    REQUIRE_RC ( VDBManagerGetSchemaCacheStats ( mgr, & stats ) );
+    REQUIRE_EQ ( ( uint32_t ) 0, stats . entries );
+    REQUIRE_EQ ( ( uint32_t ) 2, stats . evictions );
+    REQUIRE_EQ ( ( uint64_t ) 2, stats . uncached );
+
+    REQUIRE_RC ( VDBManagerRelease ( mgr ) );
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
@@ -513,6 +1651,8 @@ const char UsageDefaultName[] = "test-wvdb";
 rc_t CC KMain ( int argc, char *argv [] )
 {
     KConfigDisableUserSettings();
+    // flushed pages are encoded serially on a single worker
+    KThreadPoolSetDefaultThreads ( 4 );
     rc_t rc=WVdbTestSuite(argc, argv);
     return rc;
 }
@@ -0,0 +1,246 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/* --------------------------------------------------------------------------
+ * codec-bench
+ *  compares decoding speed of zlib, as used by vdb:unzip,
+ *  with that of zstd, as used by vdb:unzstd, on the pages of
+ *  real blobs. not part of the test run:
+ *
+ *      codec-bench <table> [ <column> ... ]
+ */
+
+#include <vdb/manager.h>
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+#include <vdb/blob.h>
+#include <klib/rc.h>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    typedef vector < uint8_t > Bytes;
+
+    const int Rounds = 20;
+
+    /* the decoded pages of one column, a blob at a time */
+    rc_t ReadPages ( const VTable * tbl, const char * column, vector < Bytes > & pages )
+    {
+        const VCursor * curs;
+        rc_t rc = VTableCreateCursorRead ( tbl, & curs );
+        if ( rc != 0 )
+            return rc;
+
+        uint32_t idx;
+        rc = VCursorAddColumn ( curs, & idx, "%s", column );
+        if ( rc == 0 )
+            rc = VCursorOpen ( curs );
+
+        int64_t first;
+        uint64_t count;
+        if ( rc == 0 )
+            rc = VCursorIdRange ( curs, idx, & first, & count );
+
+        for ( int64_t row = first; rc == 0 && row < first + ( int64_t ) count; )
+        {
+            VBlob * blob;
+            rc = VCursorGetBlobDirect ( curs, ( const VBlob** ) & blob, row, idx );
+            if ( rc != 0 )
+                break;
+
+            int64_t start;
+            uint64_t rows;
+            rc = VBlobIdRange ( blob, & start, & rows );
+            Bytes page;
+            for ( int64_t r = row; rc == 0 && r < start + ( int64_t ) rows; ++ r )
+            {
+                uint32_t bits, boff, len;
+                const uint8_t * data;
+                rc = VCursorCellDataDirect ( curs, r, idx, & bits, ( const void** ) & data, & boff, & len );
+                if ( rc == 0 )
+                    page . insert ( page . end (), data + ( boff >> 3 ), data + ( boff >> 3 ) + ( ( size_t ) bits * len + 7 ) / 8 );
+            }
+            VBlobRelease ( blob );
+
+            pages . push_back ( page );
+            row = start + rows;
+        }
+
+        VCursorRelease ( curs );
+        return rc;
+    }
+
+    /* parameters of vdb:zip by default */
+    void Deflate ( const Bytes & in, Bytes & out )
+    {
+        z_stream s;
+        memset ( & s, 0, sizeof s );
+        deflateInit2 ( & s, Z_BEST_SPEED, Z_DEFLATED, -15, 9, Z_RLE );
+        out . resize ( deflateBound ( & s, in . size () ) );
+        s . next_in = ( Bytef* ) & in [ 0 ];
+        s . avail_in = in . size ();
+        s . next_out = & out [ 0 ];
+        s . avail_out = out . size ();
+        deflate ( & s, Z_FINISH );
+        out . resize ( s . total_out );
+        deflateEnd ( & s );
+    }
+
+    bool Inflate ( const Bytes & in, Bytes & out )
+    {
+        z_stream s;
+        memset ( & s, 0, sizeof s );
+        inflateInit2 ( & s, -15 );
+        s . next_in = ( Bytef* ) & in [ 0 ];
+        s . avail_in = in . size ();
+        s . next_out = & out [ 0 ];
+        s . avail_out = out . size ();
+        int zr = inflate ( & s, Z_FINISH );
+        inflateEnd ( & s );
+        return zr == Z_STREAM_END && s . total_out == out . size ();
+    }
+
+    void Compress ( const Bytes & in, Bytes & out )
+    {
+        out . resize ( ZSTD_compressBound ( in . size () ) );
+        out . resize ( ZSTD_compress ( & out [ 0 ], out . size (), & in [ 0 ], in . size (), ZSTD_CLEVEL_DEFAULT ) );
+    }
+
+    bool Decompress ( const Bytes & in, Bytes & out )
+    {
+        /* a context per call, as vdb:unzstd does */
+        ZSTD_DCtx * ctx = ZSTD_createDCtx ();
+        size_t zr = ZSTD_decompressDCtx ( ctx, & out [ 0 ], out . size (), & in [ 0 ], in . size () );
+        ZSTD_freeDCtx ( ctx );
+        return zr == out . size ();
+    }
+
+    typedef bool ( * Decoder ) ( const Bytes & in, Bytes & out );
+
+    double DecodeMBs ( const vector < Bytes > & pages, const vector < Bytes > & packed, Decoder decode, size_t total )
+    {
+        Bytes out;
+        chrono :: steady_clock :: time_point start = chrono :: steady_clock :: now ();
+        for ( int i = 0; i < Rounds; ++ i )
+        {
+            for ( size_t p = 0; p < pages . size (); ++ p )
+            {
+                out . resize ( pages [ p ] . size () );
+                if ( ! decode ( packed [ p ], out ) )
+                    return 0;
+            }
+        }
+        chrono :: duration < double > secs = chrono :: steady_clock :: now () - start;
+        return ( double ) total * Rounds / secs . count () / ( 1024 * 1024 );
+    }
+
+    void Bench ( const char * column, const vector < Bytes > & pages )
+    {
+        vector < Bytes > zipped ( pages . size () ), zstded ( pages . size () );
+        size_t total = 0, zip_size = 0, zstd_size = 0;
+        for ( size_t p = 0; p < pages . size (); ++ p )
+        {
+            Deflate ( pages [ p ], zipped [ p ] );
+            Compress ( pages [ p ], zstded [ p ] );
+            total += pages [ p ] . size ();
+            zip_size += zipped [ p ] . size ();
+            zstd_size += zstded [ p ] . size ();
+        }
+        if ( total == 0 )
+            return;
+
+        cout << setw ( 16 ) << left << column << right
+             << setw ( 8 ) << pages . size () << " pages "
+             << setw ( 12 ) << total << " bytes | zlib "
+             << fixed << setprecision ( 2 ) << setw ( 6 ) << ( double ) zip_size / total << " "
+             << setprecision ( 0 ) << setw ( 8 ) << DecodeMBs ( pages, zipped, Inflate, total ) << " MB/s | zstd "
+             << setprecision ( 2 ) << setw ( 6 ) << ( double ) zstd_size / total << " "
+             << setprecision ( 0 ) << setw ( 8 ) << DecodeMBs ( pages, zstded, Decompress, total ) << " MB/s"
+             << endl;
+    }
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+
+ver_t CC KAppVersion ( void ) { return 0x1000000; }
+rc_t CC UsageSummary ( const char * progname ) { return 0; }
+rc_t CC Usage ( const Args * args ) { return 0; }
+
+const char UsageDefaultName[] = "codec-bench";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    if ( argc < 2 )
+    {
+        cerr << "usage: " << UsageDefaultName << " <table> [ <column> ... ]" << endl;
+        return RC ( rcExe, rcArgv, rcParsing, rcParam, rcInsufficient );
+    }
+
+    const VDBManager * mgr;
+    rc_t rc = VDBManagerMakeRead ( & mgr, NULL );
+    if ( rc == 0 )
+    {
+        const VTable * tbl;
+        rc = VDBManagerOpenTableRead ( mgr, & tbl, NULL, "%s", argv [ 1 ] );
+        if ( rc == 0 )
+        {
+            const char * dflt [] = { "READ", "QUALITY" };
+            const char * const * columns = argc > 2 ? argv + 2 : dflt;
+            int count = argc > 2 ? argc - 2 : 2;
+
+            for ( int i = 0; rc == 0 && i < count; ++ i )
+            {
+                vector < Bytes > pages;
+                rc = ReadPages ( tbl, columns [ i ], pages );
+                if ( rc == 0 )
+                    Bench ( columns [ i ], pages );
+            }
+            VTableRelease ( tbl );
+        }
+        VDBManagerRelease ( mgr );
+    }
+
+    if ( rc != 0 )
+        cerr << "failed: " << rc << endl;
+    return rc;
+}
+
+}